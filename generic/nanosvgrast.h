@@ -78,6 +78,24 @@ NANOSVG_SCOPE void nsvgRasterize(NSVGrasterizer* r,
 				   NSVGimage* image, float tx, float ty, float scale,
 				   unsigned char* dst, int w, int h, int stride);
 
+/* Rasterizes rows y0 to y1-1 of an SVG image, leaving the other rows of
+ * dst untouched. The result is premultiplied RGBA, exactly what
+ * nsvgRasterize would produce in those rows before it unpremultiplies, so
+ * rows can be rasterized separately, by several rasterizer contexts at
+ * once, and then passed to nsvgUnpremultiplyAlpha as a whole.
+ *   y0,y1 - first row and one past the last row to rasterize
+ *   other arguments as for nsvgRasterize
+ */
+NANOSVG_SCOPE void nsvgRasterizeRows(NSVGrasterizer* r,
+				   NSVGimage* image, float tx, float ty, float scale,
+				   unsigned char* dst, int w, int h, int stride,
+				   int y0, int y1);
+
+/* Converts an image rasterized with nsvgRasterizeRows to non-premultiplied
+ * alpha, as nsvgRasterize does. */
+NANOSVG_SCOPE void nsvgUnpremultiplyAlpha(unsigned char* dst, int w, int h,
+				   int stride);
+
 /* Deletes rasterizer context. */
 NANOSVG_SCOPE void nsvgDeleteRasterizer(NSVGrasterizer*);
 
@@ -116,6 +134,7 @@ typedef struct NSVGactiveEdge {
 	int x,dx;
 	float ey;
 	int dir;
+	int index;	/* index of the edge, orders edges with equal x */
 	struct NSVGactiveEdge *next;
 } NSVGactiveEdge;
 
@@ -898,10 +917,49 @@ static NSVGactiveEdge* nsvg__addActive(NSVGrasterizer* r, NSVGedge* e, float sta
 	z->ey = e->y1;
 	z->next = 0;
 	z->dir = e->dir;
+	z->index = (int)(e - r->edges);
 
 	return z;
 }
 
+/* Active edges are kept sorted by x, and edges with equal x by index, so
+ * that their order on a scanline does not depend on earlier scanlines. */
+static int nsvg__activeAfter(NSVGactiveEdge* a, NSVGactiveEdge* b)
+{
+	return a->x > b->x || (a->x == b->x && a->index > b->index);
+}
+
+static void nsvg__insertActive(NSVGactiveEdge** active, NSVGactiveEdge* z)
+{
+	if (*active == NULL) {
+		*active = z;
+	} else if (nsvg__activeAfter(*active, z)) {
+		/* insert at front */
+		z->next = *active;
+		*active = z;
+	} else {
+		/* find thing to insert AFTER */
+		NSVGactiveEdge* p = *active;
+		while (p->next && nsvg__activeAfter(z, p->next))
+			p = p->next;
+		/* at this point, p->next is NOT before z */
+		z->next = p->next;
+		p->next = z;
+	}
+}
+
+/* Index of the first subsample scanline whose center is at or below y. */
+static int nsvg__firstScanline(float y)
+{
+	int k;
+
+	if (y <= 0.5f) return 0;
+	k = (int)(y - 0.5f);
+	while (k > 0 && y <= (float)(k-1) + 0.5f) k--;
+	while (y > (float)k + 0.5f) k++;
+	return k;
+}
+
 static void nsvg__freeActive(NSVGrasterizer* r, NSVGactiveEdge* z)
 {
 	z->next = r->freelist;
@@ -1137,7 +1195,7 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 	}
 }
 
-static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, float scale, NSVGcachedPaint* cache, char fillRule)
+static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, float scale, NSVGcachedPaint* cache, char fillRule, int ystart, int yend)
 {
 	NSVGactiveEdge *active = NULL;
 	int y, s;
@@ -1145,7 +1203,27 @@ static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, fl
 	int maxWeight = (255 / NSVG__SUBSAMPLES);  /* weight per vertical scanline */
 	int xmin, xmax;
 
-	for (y = 0; y < r->height; y++) {
+	if (ystart > 0) {
+		/* Set up the active edges as scanning from row 0 would have
+		 * left them after the last subsample scanline before ystart:
+		 * each edge is added where it would have been and advanced once
+		 * per scanline since. */
+		int last = ystart*NSVG__SUBSAMPLES - 1;
+		float scany = (float)last + 0.5f;
+
+		while (e < r->nedges && r->edges[e].y0 <= scany) {
+			if (r->edges[e].y1 > scany) {
+				int first = nsvg__firstScanline(r->edges[e].y0);
+				NSVGactiveEdge* z = nsvg__addActive(r, &r->edges[e], (float)first + 0.5f);
+				if (z == NULL) break;
+				z->x = (int)((unsigned int)z->x + (unsigned int)(last - first) * (unsigned int)z->dx);
+				nsvg__insertActive(&active, z);
+			}
+			e++;
+		}
+	}
+
+	for (y = ystart; y < yend; y++) {
 		memset(r->scanline, 0, r->width);
 		xmin = r->width;
 		xmax = 0;
@@ -1173,7 +1251,7 @@ static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, fl
 				int changed = 0;
 				step = &active;
 				while (*step && (*step)->next) {
-					if ((*step)->x > (*step)->next->x) {
+					if (nsvg__activeAfter(*step, (*step)->next)) {
 						NSVGactiveEdge* t = *step;
 						NSVGactiveEdge* q = t->next;
 						t->next = q->next;
@@ -1191,22 +1269,7 @@ static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, fl
 				if (r->edges[e].y1 > scany) {
 					NSVGactiveEdge* z = nsvg__addActive(r, &r->edges[e], scany);
 					if (z == NULL) break;
-					/* find insertion point */
-					if (active == NULL) {
-						active = z;
-					} else if (z->x < active->x) {
-						/* insert at front */
-						z->next = active;
-						active = z;
-					} else {
-						/* find thing to insert AFTER */
-						NSVGactiveEdge* p = active;
-						while (p->next && p->next->x < z->x)
-							p = p->next;
-						/* at this point, p->next->x is NOT < z->x */
-						z->next = p->next;
-						p->next = z;
-					}
+					nsvg__insertActive(&active, z);
 				}
 				e++;
 			}
@@ -1225,7 +1288,8 @@ static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, fl
 
 }
 
-static void nsvg__unpremultiplyAlpha(unsigned char* image, int w, int h, int stride)
+NANOSVG_SCOPE
+void nsvgUnpremultiplyAlpha(unsigned char* image, int w, int h, int stride)
 {
 	int x,y;
 
@@ -1392,6 +1456,22 @@ NANOSVG_SCOPE
 void nsvgRasterize(NSVGrasterizer* r,
 				   NSVGimage* image, float tx, float ty, float scale,
 				   unsigned char* dst, int w, int h, int stride)
+{
+	if (w > r->cscanline) {
+		r->cscanline = w;
+		r->scanline = (unsigned char*)NANOSVG_realloc(r->scanline, w);
+		if (r->scanline == NULL) return;
+	}
+
+	nsvgRasterizeRows(r, image, tx, ty, scale, dst, w, h, stride, 0, h);
+	nsvgUnpremultiplyAlpha(dst, w, h, stride);
+}
+
+NANOSVG_SCOPE
+void nsvgRasterizeRows(NSVGrasterizer* r,
+				   NSVGimage* image, float tx, float ty, float scale,
+				   unsigned char* dst, int w, int h, int stride,
+				   int y0, int y1)
 {
 	NSVGshape *shape = NULL;
 	NSVGedge *e = NULL;
@@ -1411,7 +1491,9 @@ void nsvgRasterize(NSVGrasterizer* r,
 		if (r->scanline == NULL) return;
 	}
 
-	for (i = 0; i < h; i++)
+	if (y0 < 0) y0 = 0;
+	if (y1 > h) y1 = h;
+	for (i = y0; i < y1; i++)
 		memset(&dst[i*stride], 0, w*4);
 
 	for (shape = image->shapes; shape != NULL; shape = shape->next) {
@@ -1443,7 +1525,7 @@ void nsvgRasterize(NSVGrasterizer* r,
 				/* now, traverse the scanlines and find the intersections on each scanline, use non-zero rule */
 				nsvg__initPaint(&cache, &shape->fill, shape->opacity);
 
-				nsvg__rasterizeSortedEdges(r, tx,ty,scale, &cache, shape->fillRule);
+				nsvg__rasterizeSortedEdges(r, tx,ty,scale, &cache, shape->fillRule, y0, y1);
 			}
 			if (paintOrder == NSVG_PAINT_STROKE && shape->stroke.type != NSVG_PAINT_NONE && (shape->strokeWidth * scale) > 0.01f) {
 				nsvg__resetPool(r);
@@ -1470,13 +1552,11 @@ void nsvgRasterize(NSVGrasterizer* r,
 				/* now, traverse the scanlines and find the intersections on each scanline, use non-zero rule */
 				nsvg__initPaint(&cache, &shape->stroke, shape->opacity);
 
-				nsvg__rasterizeSortedEdges(r, tx,ty,scale, &cache, NSVG_FILLRULE_NONZERO);
+				nsvg__rasterizeSortedEdges(r, tx,ty,scale, &cache, NSVG_FILLRULE_NONZERO, y0, y1);
 			}
 		}
 	}
 
-	nsvg__unpremultiplyAlpha(dst, w, h, stride);
-
 	r->bitmap = NULL;
 	r->width = 0;
 	r->height = 0;
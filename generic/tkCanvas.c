@@ -3010,10 +3010,12 @@ DisplayCanvas(
     Pixmap pixmap;
     int screenX1, screenX2, screenY1, screenY2, width, height;
     int borderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     if (canvasPtr->tkwin == NULL) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     if (!Tk_IsMapped(tkwin)) {
 	goto done;
@@ -3031,6 +3033,7 @@ DisplayCanvas(
 	tkwin = canvasPtr->tkwin;
 	Tcl_Release(canvasPtr);
 	if (tkwin == NULL) {
+	    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 	    return;
 	}
     }
@@ -3111,10 +3114,9 @@ DisplayCanvas(
 
 	canvasPtr->drawableXOrigin = screenX1 - 30;
 	canvasPtr->drawableYOrigin = screenY1 - 30;
-	pixmap = Tk_GetPixmap(Tk_Display(tkwin), Tk_WindowId(tkwin),
+	pixmap = TkGetBufferPixmap(tkwin,
 	    (screenX2 + 30 - canvasPtr->drawableXOrigin),
-	    (screenY2 + 30 - canvasPtr->drawableYOrigin),
-	    Tk_Depth(tkwin));
+	    (screenY2 + 30 - canvasPtr->drawableYOrigin));
 #else
 	canvasPtr->drawableXOrigin = canvasPtr->xOrigin;
 	canvasPtr->drawableYOrigin = canvasPtr->yOrigin;
@@ -3198,7 +3200,7 @@ DisplayCanvas(
 		screenY1 - canvasPtr->drawableYOrigin,
 		(unsigned int) width, (unsigned int) height,
 		screenX1 - canvasPtr->xOrigin, screenY1 - canvasPtr->yOrigin);
-	Tk_FreePixmap(Tk_Display(tkwin), pixmap);
+	TkFreeBufferPixmap(Tk_Display(tkwin), pixmap);
 #else
 	Tk_ClipDrawableToRect(Tk_Display(tkwin), pixmap, 0, 0, -1, -1);
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -3244,6 +3246,7 @@ DisplayCanvas(
     if (canvasPtr->flags & UPDATE_SCROLLBARS) {
 	CanvasUpdateScrollbars(canvasPtr);
     }
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -47,6 +47,8 @@ static int		CaretCmd(void *dummy, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const *objv);
 static int		InactiveCmd(void *dummy, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const *objv);
+static int		PerfCmd(void *dummy, Tcl_Interp *interp,
+			    Tcl_Size objc, Tcl_Obj *const *objv);
 static int		ScalingCmd(void *dummy, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const *objv);
 static int		UseinputmethodsCmd(void *dummy, Tcl_Interp *interp,
@@ -60,6 +62,28 @@ MODULE_SCOPE const TkEnsemble tkFontchooserEnsemble[];
 #define tkFontchooserEnsemble NULL
 #endif
 
+/*
+ * The counters reported by "tk perf" are kept per thread, since all
+ * interpreters of a thread share its event loop; only the switch that
+ * turns them on is global, so that it can be tested without a lookup.
+ */
+
+typedef struct {
+    Tcl_WideInt calls[TK_PERF_COUNT];
+				/* Number of times each chokepoint ran. */
+    Tcl_WideInt usec[TK_PERF_COUNT];
+				/* Time spent in each, in microseconds. Nested
+				 * chokepoints are included in their caller. */
+} ThreadSpecificData;
+static Tcl_ThreadDataKey dataKey;
+
+int tkPerfEnabled = 0;
+
+static const char *const perfNames[] = {
+    "event", "display", "grid", "pack", "measure", "dither", "sync",
+    "roundtrip", NULL
+};
+
 /*
  * Table of tk subcommand names and implementations.
  */
@@ -71,6 +95,7 @@ static const TkEnsemble tkCmdMap[] = {
     {"busy",		Tk_BusyObjCmd, NULL },
     {"caret",		CaretCmd, NULL },
     {"inactive",	InactiveCmd, NULL },
+    {"perf",		PerfCmd, NULL },
     {"scaling",		ScalingCmd, NULL },
     {"useinputmethods",	UseinputmethodsCmd, NULL },
     {"windowingsystem",	WindowingsystemCmd, NULL },
@@ -1272,6 +1297,195 @@ InactiveCmd(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPerfClock, TkPerfRecord --
+ *
+ *	Read the clock used by the "tk perf" counters, and charge the time
+ *	since a start value obtained from it to a counter. These are called
+ *	through the TkPerfStart and TkPerfStop macros.
+ *
+ * Results:
+ *	TkPerfClock returns the current time in microseconds.
+ *
+ * Side effects:
+ *	TkPerfRecord updates the counters of the current thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_WideInt
+TkPerfClock(void)
+{
+    Tcl_Time now;
+
+    Tcl_GetTime(&now);
+    return (Tcl_WideInt)now.sec * 1000000 + now.usec;
+}
+
+void
+TkPerfRecord(
+    TkPerfCounter counter,	/* Chokepoint that ran. */
+    Tcl_WideInt start)		/* Value of TkPerfClock when it started. */
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+
+    tsdPtr->calls[counter]++;
+    tsdPtr->usec[counter] += TkPerfClock() - start;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerfCmd --
+ *
+ *	This function is invoked to process the "tk perf" Tcl command:
+ *
+ *	    tk perf ?counters?
+ *	    tk perf caches
+ *	    tk perf enable ?boolean?
+ *	    tk perf reset
+ *
+ * Results:
+ *	A standard Tcl result. "counters" returns a dictionary that maps
+ *	each counter to a dictionary with its number of calls and the time
+ *	spent in microseconds. "caches" returns a dictionary that maps each
+ *	resource cache of the main window's display to a dictionary with its
+ *	hits, misses, trims and current size.
+ *
+ * Side effects:
+ *	The counters may be switched on or off, or set to zero.
+ *
+ *----------------------------------------------------------------------
+ */
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheStatsObj, ResetCacheStats --
+ *
+ *	Helpers for "tk perf" that report and clear the statistics of one
+ *	resource cache. The size is left alone by ResetCacheStats, since it
+ *	describes the current contents of the cache.
+ *
+ * Results:
+ *	CacheStatsObj returns a new dictionary object.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+CacheStatsObj(
+    const TkCacheStats *statsPtr)
+{
+    Tcl_Obj *statsObj = Tcl_NewDictObj();
+
+    Tcl_DictObjPut(NULL, statsObj, Tcl_NewStringObj("hits", -1),
+	    Tcl_NewWideIntObj(statsPtr->hits));
+    Tcl_DictObjPut(NULL, statsObj, Tcl_NewStringObj("misses", -1),
+	    Tcl_NewWideIntObj(statsPtr->misses));
+    Tcl_DictObjPut(NULL, statsObj, Tcl_NewStringObj("trims", -1),
+	    Tcl_NewWideIntObj(statsPtr->trims));
+    Tcl_DictObjPut(NULL, statsObj, Tcl_NewStringObj("size", -1),
+	    Tcl_NewWideIntObj(statsPtr->size));
+    return statsObj;
+}
+
+static void
+ResetCacheStats(
+    TkCacheStats *statsPtr)
+{
+    statsPtr->hits = statsPtr->misses = statsPtr->trims = 0;
+}
+
+int
+PerfCmd(
+    void *clientData,		/* Main window associated with interpreter. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const options[] = {
+	"caches", "counters", "enable", "reset", NULL
+    };
+    enum {
+	PERF_CACHES, PERF_COUNTERS, PERF_ENABLE, PERF_RESET
+    };
+    TkDisplay *dispPtr = ((TkWindow *)clientData)->dispPtr;
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    int index = PERF_COUNTERS, i, enable;
+    Tcl_Obj *resultObj, *counterObj;
+
+    if (objc > 3) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?option? ?arg?");
+	return TCL_ERROR;
+    }
+    if (objc > 1 && Tcl_GetIndexFromObjStruct(interp, objv[1], options,
+	    sizeof(char *), "option", 0, &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (objc == 3 && index != PERF_ENABLE) {
+	Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	return TCL_ERROR;
+    }
+
+    switch (index) {
+    case PERF_CACHES:
+	resultObj = Tcl_NewDictObj();
+	Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("color", -1),
+		CacheStatsObj(&dispPtr->colorStats));
+	Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("gc", -1),
+		CacheStatsObj(&dispPtr->gcStats));
+	Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("pixmap", -1),
+		CacheStatsObj(&dispPtr->pixmapStats));
+	Tcl_SetObjResult(interp, resultObj);
+	break;
+    case PERF_COUNTERS:
+	resultObj = Tcl_NewDictObj();
+	for (i = 0; i < TK_PERF_COUNT; i++) {
+	    counterObj = Tcl_NewDictObj();
+	    Tcl_DictObjPut(NULL, counterObj, Tcl_NewStringObj("calls", -1),
+		    Tcl_NewWideIntObj(tsdPtr->calls[i]));
+	    Tcl_DictObjPut(NULL, counterObj, Tcl_NewStringObj("usec", -1),
+		    Tcl_NewWideIntObj(tsdPtr->usec[i]));
+	    Tcl_DictObjPut(NULL, resultObj,
+		    Tcl_NewStringObj(perfNames[i], -1), counterObj);
+	}
+	Tcl_SetObjResult(interp, resultObj);
+	break;
+    case PERF_ENABLE:
+	if (objc == 2) {
+	    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(tkPerfEnabled));
+	    break;
+	}
+	if (Tcl_IsSafe(interp)) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "enabling the performance counters "
+		    "is not allowed in a safe interpreter", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "SAFE", "PERF", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	if (Tcl_GetBooleanFromObj(interp, objv[2], &enable) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	tkPerfEnabled = enable;
+	break;
+    case PERF_RESET:
+	memset(tsdPtr, 0, sizeof(ThreadSpecificData));
+	ResetCacheStats(&dispPtr->colorStats);
+	ResetCacheStats(&dispPtr->gcStats);
+	ResetCacheStats(&dispPtr->pixmapStats);
+	break;
+    }
+    return TCL_OK;
+}
+
 int
 ScalingCmd(
     void *clientData,		/* Main window associated with interpreter. */
@@ -1671,7 +1885,10 @@ Tk_UpdateObjCmd(
 
 	for (dispPtr = TkGetDisplayList(); dispPtr != NULL;
 		dispPtr = dispPtr->nextPtr) {
+	    Tcl_WideInt perfStart = TkPerfStart();
+
 	    XSync(dispPtr->display, False);
+	    TkPerfStop(TK_PERF_ROUNDTRIP, perfStart);
 	}
 
 	/*
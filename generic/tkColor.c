@@ -31,6 +31,15 @@ typedef struct {
     Display *display;		/* Display for colormap. */
 } ValueKey;
 
+/*
+ * Colors whose last use goes away are kept for at most COLOR_RETAIN_MS, and
+ * at most COLOR_RETAIN_COUNT of them per display, so that a color that is
+ * freed and allocated again soon after does not cost a round trip.
+ */
+
+#define COLOR_RETAIN_COUNT	64
+#define COLOR_RETAIN_MS		10000
+
 /*
  * The structure below is used to allocate thread-local data.
  */
@@ -45,6 +54,9 @@ static Tcl_ThreadDataKey dataKey;
  */
 
 static void		ColorInit(TkDisplay *dispPtr);
+static void		ColorTrimProc(void *clientData);
+static void		DeleteColor(TkColor *tkColPtr);
+static void		ReuseColor(TkDisplay *dispPtr, TkColor *tkColPtr);
 static void		DupColorObjProc(Tcl_Obj *srcObjPtr,Tcl_Obj *dupObjPtr);
 static void		FreeColorObj(Tcl_Obj *objPtr);
 static void		FreeColorObjProc(Tcl_Obj *objPtr);
@@ -99,6 +111,7 @@ Tk_AllocColorFromObj(
 				 * "#ff0000".*/
 {
     TkColor *tkColPtr;
+    TkDisplay *dispPtr = ((TkWindow *) tkwin)->dispPtr;
 
     if (objPtr->typePtr != &tkColorObjType) {
 	InitColorObj(objPtr);
@@ -111,7 +124,7 @@ Tk_AllocColorFromObj(
      */
 
     if (tkColPtr != NULL) {
-	if (tkColPtr->resourceRefCount == 0) {
+	if (tkColPtr->resourceRefCount == 0 && !tkColPtr->retained) {
 	    /*
 	     * This is a stale reference: it refers to a TkColor that's no
 	     * longer in use. Clear the reference.
@@ -120,7 +133,11 @@ Tk_AllocColorFromObj(
 	    tkColPtr = NULL;
 	} else if ((Tk_Screen(tkwin) == tkColPtr->screen)
 		&& (Tk_Colormap(tkwin) == tkColPtr->colormap)) {
+	    if (tkColPtr->retained) {
+		ReuseColor(dispPtr, tkColPtr);
+	    }
 	    tkColPtr->resourceRefCount++;
+	    dispPtr->colorStats.hits++;
 	    return (XColor *) tkColPtr;
 	}
     }
@@ -139,8 +156,12 @@ Tk_AllocColorFromObj(
 		tkColPtr = tkColPtr->nextPtr) {
 	    if ((Tk_Screen(tkwin) == tkColPtr->screen)
 		    && (Tk_Colormap(tkwin) == tkColPtr->colormap)) {
+		if (tkColPtr->retained) {
+		    ReuseColor(dispPtr, tkColPtr);
+		}
 		tkColPtr->resourceRefCount++;
 		tkColPtr->objRefCount++;
+		dispPtr->colorStats.hits++;
 		objPtr->internalRep.twoPtrValue.ptr1 = tkColPtr;
 		return (XColor *) tkColPtr;
 	    }
@@ -213,7 +234,11 @@ Tk_GetColor(
 		tkColPtr = tkColPtr->nextPtr) {
 	    if ((tkColPtr->screen == Tk_Screen(tkwin))
 		    && (Tk_Colormap(tkwin) == tkColPtr->colormap)) {
+		if (tkColPtr->retained) {
+		    ReuseColor(dispPtr, tkColPtr);
+		}
 		tkColPtr->resourceRefCount++;
+		dispPtr->colorStats.hits++;
 		return &tkColPtr->color;
 	    }
 	}
@@ -259,7 +284,10 @@ Tk_GetColor(
     tkColPtr->type = TK_COLOR_BY_NAME;
     tkColPtr->hashPtr = nameHashPtr;
     tkColPtr->nextPtr = existingColPtr;
+    tkColPtr->retained = false;
+    tkColPtr->newerPtr = tkColPtr->olderPtr = NULL;
     Tcl_SetHashValue(nameHashPtr, tkColPtr);
+    dispPtr->colorStats.misses++;
 
     return &tkColPtr->color;
 }
@@ -320,7 +348,11 @@ Tk_GetColorByValue(
 	    (char *) &valueKey, &isNew);
     if (!isNew) {
 	tkColPtr = (TkColor *)Tcl_GetHashValue(valueHashPtr);
+	if (tkColPtr->retained) {
+	    ReuseColor(dispPtr, tkColPtr);
+	}
 	tkColPtr->resourceRefCount++;
+	dispPtr->colorStats.hits++;
 	return &tkColPtr->color;
     }
 
@@ -340,7 +372,10 @@ Tk_GetColorByValue(
     tkColPtr->type = TK_COLOR_BY_VALUE;
     tkColPtr->hashPtr = valueHashPtr;
     tkColPtr->nextPtr = NULL;
+    tkColPtr->retained = false;
+    tkColPtr->newerPtr = tkColPtr->olderPtr = NULL;
     Tcl_SetHashValue(valueHashPtr, tkColPtr);
+    dispPtr->colorStats.misses++;
     return &tkColPtr->color;
 }
 
@@ -460,8 +495,9 @@ Tk_GCForColor(
  *	None.
  *
  * Side effects:
- *	The reference count associated with colorPtr is deleted, and the color
- *	is released to X if there are no remaining uses for it.
+ *	The reference count associated with colorPtr is deleted. If there are
+ *	no remaining uses for the color, it is kept for reuse for a while when
+ *	that costs no colormap entry; otherwise it is released to X.
  *
  *----------------------------------------------------------------------
  */
@@ -474,7 +510,8 @@ Tk_FreeColor(
 {
     TkColor *tkColPtr = (TkColor *) colorPtr;
     Screen *screen = tkColPtr->screen;
-    TkColor *prevPtr;
+    TkDisplay *dispPtr;
+    int c_class;
 
     /*
      * Do a quick sanity check to make sure this color was really allocated by
@@ -489,6 +526,104 @@ Tk_FreeColor(
 	return;
     }
 
+    /*
+     * Keep the color if it comes from the default colormap of a visual with
+     * read-only cells: holding on to it then takes nothing away from other
+     * applications, and the colormap cannot go away under it.
+     */
+
+    dispPtr = TkGetDisplay(DisplayOfScreen(screen));
+    c_class = tkColPtr->visual->c_class;
+    if (dispPtr != NULL && dispPtr->colorInit > 0
+	    && tkColPtr->colormap == DefaultColormapOfScreen(screen)
+	    && (c_class == TrueColor || c_class == StaticColor
+		    || c_class == StaticGray)) {
+	tkColPtr->retained = true;
+	tkColPtr->freeTime = TkCacheMilliseconds();
+	tkColPtr->newerPtr = NULL;
+	tkColPtr->olderPtr = dispPtr->colorNewestPtr;
+	if (dispPtr->colorNewestPtr != NULL) {
+	    dispPtr->colorNewestPtr->newerPtr = tkColPtr;
+	} else {
+	    dispPtr->colorOldestPtr = tkColPtr;
+	}
+	dispPtr->colorNewestPtr = tkColPtr;
+	if (++dispPtr->colorStats.size > COLOR_RETAIN_COUNT) {
+	    tkColPtr = dispPtr->colorOldestPtr;
+	    ReuseColor(dispPtr, tkColPtr);
+	    DeleteColor(tkColPtr);
+	    dispPtr->colorStats.trims++;
+	}
+	if (dispPtr->colorTimer == NULL) {
+	    dispPtr->colorTimer = Tcl_CreateTimerHandler(COLOR_RETAIN_MS,
+		    ColorTrimProc, dispPtr);
+	}
+	return;
+    }
+    DeleteColor(tkColPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReuseColor --
+ *
+ *	Takes a retained color off the display's list of retained colors,
+ *	before it is used again or deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The list and its size are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReuseColor(
+    TkDisplay *dispPtr,
+    TkColor *tkColPtr)
+{
+    if (tkColPtr->newerPtr != NULL) {
+	tkColPtr->newerPtr->olderPtr = tkColPtr->olderPtr;
+    } else {
+	dispPtr->colorNewestPtr = tkColPtr->olderPtr;
+    }
+    if (tkColPtr->olderPtr != NULL) {
+	tkColPtr->olderPtr->newerPtr = tkColPtr->newerPtr;
+    } else {
+	dispPtr->colorOldestPtr = tkColPtr->newerPtr;
+    }
+    tkColPtr->newerPtr = tkColPtr->olderPtr = NULL;
+    tkColPtr->retained = false;
+    dispPtr->colorStats.size--;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DeleteColor --
+ *
+ *	Releases a color that has no active uses left to X.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The color is removed from its hash table, and its TkColor structure
+ *	is freed unless objects still refer to it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DeleteColor(
+    TkColor *tkColPtr)
+{
+    Screen *screen = tkColPtr->screen;
+    TkColor *prevPtr;
+
     /*
      * This color is no longer being actively used, so free the color
      * resources associated with it and remove it from the hash table. No
@@ -525,6 +660,80 @@ Tk_FreeColor(
 	Tcl_Free(tkColPtr);
     }
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ColorTrimProc --
+ *
+ *	Timer callback that releases the retained colors of a display that
+ *	were freed more than COLOR_RETAIN_MS ago.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Colors may be released; the timer is rescheduled while retained
+ *	colors remain.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ColorTrimProc(
+    void *clientData)		/* Display whose colors to trim. */
+{
+    TkDisplay *dispPtr = (TkDisplay *)clientData;
+    Tcl_WideInt now = TkCacheMilliseconds();
+    TkColor *tkColPtr;
+
+    dispPtr->colorTimer = NULL;
+    while (dispPtr->colorOldestPtr != NULL
+	    && now - dispPtr->colorOldestPtr->freeTime >= COLOR_RETAIN_MS) {
+	tkColPtr = dispPtr->colorOldestPtr;
+	ReuseColor(dispPtr, tkColPtr);
+	DeleteColor(tkColPtr);
+	dispPtr->colorStats.trims++;
+    }
+    if (dispPtr->colorOldestPtr != NULL) {
+	dispPtr->colorTimer = Tcl_CreateTimerHandler((int) (COLOR_RETAIN_MS
+		- (now - dispPtr->colorOldestPtr->freeTime)), ColorTrimProc,
+		dispPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkColorCleanup --
+ *
+ *	Releases the retained colors of a display that is being closed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Colors are released and the trim timer is cancelled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkColorCleanup(
+    TkDisplay *dispPtr)		/* Display being closed. */
+{
+    TkColor *tkColPtr;
+
+    if (dispPtr->colorTimer != NULL) {
+	Tcl_DeleteTimerHandler(dispPtr->colorTimer);
+	dispPtr->colorTimer = NULL;
+    }
+    while (dispPtr->colorOldestPtr != NULL) {
+	tkColPtr = dispPtr->colorOldestPtr;
+	ReuseColor(dispPtr, tkColPtr);
+	DeleteColor(tkColPtr);
+    }
+}
 
 /*
  *----------------------------------------------------------------------
@@ -592,7 +801,7 @@ FreeColorObj(
 
     if (tkColPtr != NULL) {
 	if ((tkColPtr->objRefCount-- <= 1)
-		&& (tkColPtr->resourceRefCount == 0)) {
+		&& (tkColPtr->resourceRefCount == 0) && !tkColPtr->retained) {
 	    Tcl_Free(tkColPtr);
 	}
 	objPtr->internalRep.twoPtrValue.ptr1 = NULL;
@@ -60,6 +60,14 @@ typedef struct TkColor {
 				 * nameTable. For colors in valueTable (those
 				 * allocated by Tk_GetColorByValue) this field
 				 * is always NULL. */
+    bool retained;		/* Set while the color has no active uses
+				 * but is kept, still in its hash table, in
+				 * case it is allocated again soon. */
+    Tcl_WideInt freeTime;	/* Time (ms) the color was last released. */
+    struct TkColor *newerPtr;	/* Next more recently released retained
+				 * color. */
+    struct TkColor *olderPtr;	/* Next less recently released retained
+				 * color. */
 } TkColor;
 
 /*
@@ -95,9 +95,13 @@ typedef struct TkOption {
  * OPTION_NEEDS_FREEING -	1 means that FreeResources must be invoked to
  *				free resources associated with the option when
  *				it is no longer needed.
+ * OPTION_CANNOT_FAIL -		1 means that DoObjConfig accepts any value for
+ *				the option, so setting it never has to be
+ *				undone because of the option itself.
  */
 
 #define OPTION_NEEDS_FREEING		1
+#define OPTION_CANNOT_FAIL		2
 
 /*
  * One of the following exists for each Tk_OptionSpec array that has been
@@ -117,6 +121,11 @@ typedef struct OptionTable {
 				 * templates, this points to the table
 				 * corresponding to the next template in the
 				 * chain. */
+    Tcl_HashTable *namesPtr;	/* Maps the full names of the options in this
+				 * table and the ones chained to it to the
+				 * first matching entry, so that exact names
+				 * are found without scanning the chain. NULL
+				 * until a name is first looked up. */
     size_t numOptions;		/* The number of items in the options array
 				 * below. */
     Option options[1];		/* Information about the individual options in
@@ -234,6 +243,7 @@ Tk_CreateOptionTable(
     tablePtr->refCount = 1;
     tablePtr->hashEntryPtr = hashEntryPtr;
     tablePtr->nextPtr = NULL;
+    tablePtr->namesPtr = NULL;
     tablePtr->numOptions = numOptions;
 
     /*
@@ -302,6 +312,9 @@ Tk_CreateOptionTable(
 		|| (specPtr->type == TK_OPTION_CUSTOM)) {
 	    optionPtr->flags |= OPTION_NEEDS_FREEING;
 	}
+	if (specPtr->type == TK_OPTION_STRING) {
+	    optionPtr->flags |= OPTION_CANNOT_FAIL;
+	}
     }
     tablePtr->hashEntryPtr = hashEntryPtr;
     Tcl_SetHashValue(hashEntryPtr, tablePtr);
@@ -365,6 +378,10 @@ Tk_DeleteOptionTable(
 	    Tcl_DecrRefCount(optionPtr->extra.monoColorPtr);
 	}
     }
+    if (tablePtr->namesPtr != NULL) {
+	Tcl_DeleteHashTable(tablePtr->namesPtr);
+	Tcl_Free(tablePtr->namesPtr);
+    }
     Tcl_DeleteHashEntry(tablePtr->hashEntryPtr);
     Tcl_Free(tablePtr);
 }
@@ -1147,7 +1164,7 @@ TkObjIsEmpty(
  *	*not* the "real" entry that the synonym refers to.
  *
  * Side effects:
- *	None.
+ *	The first call for a table builds its index of full option names.
  *
  *----------------------------------------------------------------------
  */
@@ -1162,6 +1179,34 @@ GetOption(
     OptionTable *tablePtr2;
     const char *p1, *p2;
     size_t count;
+    Tcl_HashEntry *hPtr;
+    int isNew;
+
+    /*
+     * Full names are the common case: look them up in the index, which
+     * holds the first entry of the chain for each name.
+     */
+
+    if (tablePtr->namesPtr == NULL) {
+	tablePtr->namesPtr = (Tcl_HashTable *)Tcl_Alloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(tablePtr->namesPtr, TCL_STRING_KEYS);
+	for (tablePtr2 = tablePtr; tablePtr2 != NULL;
+		tablePtr2 = tablePtr2->nextPtr) {
+	    for (optionPtr = tablePtr2->options,
+		    count = tablePtr2->numOptions; count > 0;
+		    optionPtr++, count--) {
+		hPtr = Tcl_CreateHashEntry(tablePtr->namesPtr,
+			optionPtr->specPtr->optionName, &isNew);
+		if (isNew) {
+		    Tcl_SetHashValue(hPtr, optionPtr);
+		}
+	    }
+	}
+    }
+    hPtr = Tcl_FindHashEntry(tablePtr->namesPtr, name);
+    if (hPtr != NULL) {
+	return (Option *)Tcl_GetHashValue(hPtr);
+    }
 
     /*
      * Search through all of the option tables in the chain to find the best
@@ -1502,6 +1547,112 @@ Tk_SetOptions(
     }
     return TCL_ERROR;
 }
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSetOptionsForRecords --
+ *
+ *	Apply the same name-value pairs to several records that share an
+ *	option table, such as a batch of widgets created together. The option
+ *	names are resolved and checked once, before any record is modified.
+ *
+ * Results:
+ *	TCL_OK if all the records were configured; *maskPtr, if maskPtr isn't
+ *	NULL, then holds the OR of the typeMask bits of the options. If any
+ *	value is rejected, TCL_ERROR is returned with a message in interp's
+ *	result (unless interp is NULL), and all the records are left as they
+ *	were.
+ *
+ * Side effects:
+ *	The fields of the records get filled in with the new values. When all
+ *	the options are of a kind that accepts any value, nothing can go wrong
+ *	once the names are resolved, so the old values are released right away
+ *	instead of being saved for a rollback.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkSetOptionsForRecords(
+    Tcl_Interp *interp,		/* Interpreter for error reporting. If NULL,
+				 * then no error message is returned. */
+    Tcl_Size numRecords,	/* Number of records to configure. */
+    void *const recordPtrs[],	/* The records to configure. */
+    Tk_Window const tkwins[],	/* Window associated with each record, or
+				 * NULL if none of them has one. */
+    Tk_OptionTable optionTable,	/* Describes valid options. */
+    Tcl_Size objc,		/* The number of elements in objv. */
+    Tcl_Obj *const objv[],	/* Contains one or more name-value pairs. */
+    int *maskPtr)		/* If non-NULL, receives the OR of the
+				 * typeMask fields of all options set. */
+{
+    OptionTable *tablePtr = (OptionTable *)optionTable;
+    Option *optionPtr;
+    Tk_SavedOptions *savedPtr = NULL;
+    Tcl_Size i;
+    int mask = 0, canFail = 0, result = TCL_OK;
+
+    for (i = 0; i < objc; i += 2) {
+	optionPtr = GetOptionFromObj(interp, objv[i], tablePtr);
+	if (optionPtr == NULL) {
+	    return TCL_ERROR;
+	}
+	if (optionPtr->specPtr->type == TK_OPTION_SYNONYM) {
+	    optionPtr = optionPtr->extra.synonymPtr;
+	}
+	if (i + 1 >= objc) {
+	    if (interp != NULL) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"value for \"%s\" missing", Tcl_GetString(objv[i])));
+		Tcl_SetErrorCode(interp, "TK", "VALUE_MISSING", (char *)NULL);
+	    }
+	    return TCL_ERROR;
+	}
+	if (!(optionPtr->flags & OPTION_CANNOT_FAIL)) {
+	    canFail = 1;
+	}
+	mask |= optionPtr->specPtr->typeMask;
+    }
+
+    /*
+     * The names are known to be good, and are now cached in their objects,
+     * so Tk_SetOptions finds them again without a search.
+     */
+
+    if (canFail && (numRecords > 0)) {
+	savedPtr = (Tk_SavedOptions *)
+		Tcl_Alloc(numRecords * sizeof(Tk_SavedOptions));
+    }
+    for (i = 0; i < numRecords; i++) {
+	result = Tk_SetOptions(interp, recordPtrs[i], optionTable, objc, objv,
+		(tkwins != NULL) ? tkwins[i] : NULL,
+		(savedPtr != NULL) ? &savedPtr[i] : NULL, NULL);
+	if (result != TCL_OK) {
+	    break;
+	}
+    }
+    if (savedPtr != NULL) {
+	Tcl_Size j;
+
+	/*
+	 * Tk_SetOptions already restored the record that failed, if any.
+	 */
+
+	for (j = 0; j < i; j++) {
+	    if (result == TCL_OK) {
+		Tk_FreeSavedOptions(&savedPtr[j]);
+	    } else {
+		Tk_RestoreSavedOptions(&savedPtr[j]);
+	    }
+	}
+	Tcl_Free(savedPtr);
+    }
+    if ((result == TCL_OK) && (maskPtr != NULL)) {
+	*maskPtr = mask;
+    }
+    return result;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -1622,6 +1622,7 @@ DisplayEntry(
     Pixmap pixmap;
     Tk_3DBorder border;
     int borderWidth, selBorderWidth, insertWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     entryPtr->flags &= ~REDRAW_PENDING;
     if ((entryPtr->flags & ENTRY_DELETED) || !Tk_IsMapped(tkwin)) {
@@ -1651,6 +1652,7 @@ DisplayEntry(
 	}
 	Tcl_Release(entryPtr);
     }
+    perfStart = TkPerfStart();
 
 #ifndef TK_NO_DOUBLE_BUFFERING
     /*
@@ -1660,8 +1662,7 @@ DisplayEntry(
      * on-screen image has been cleared.
      */
 
-    pixmap = Tk_GetPixmap(entryPtr->display, Tk_WindowId(tkwin),
-	    Tk_Width(tkwin), Tk_Height(tkwin), Tk_Depth(tkwin));
+    pixmap = TkGetBufferPixmap(tkwin, Tk_Width(tkwin), Tk_Height(tkwin));
 #else
     pixmap = Tk_WindowId(tkwin);
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -1947,9 +1948,10 @@ DisplayEntry(
     XCopyArea(entryPtr->display, pixmap, Tk_WindowId(tkwin), entryPtr->textGC,
 	    0, 0, (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin),
 	    0, 0);
-    Tk_FreePixmap(entryPtr->display, pixmap);
+    TkFreeBufferPixmap(entryPtr->display, pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
     entryPtr->flags &= ~BORDER_NEEDED;
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -1106,6 +1106,7 @@ Tk_HandleEvent(
     Tcl_Interp *interp = NULL;
     ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
 	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    Tcl_WideInt perfStart = TkPerfStart();
 
 
 #if !defined(_WIN32) && !defined(MAC_OSX_TK)
@@ -1297,6 +1298,7 @@ Tk_HandleEvent(
 
   releaseEventResources:
     CleanUpTkEvent(eventPtr);
+    TkPerfStop(TK_PERF_EVENT, perfStart);
 }
 
 /*
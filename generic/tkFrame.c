@@ -95,6 +95,9 @@ typedef struct {
 				 * Tk_GetImage, or NULL if bgimgPtr is
 				 * NULL. */
     bool tile;			/* Whether to tile the bgimg. */
+    bool sharedBuffer;		/* Value of -sharedbuffer option: whether the
+				 * descendants of a toplevel share one
+				 * double-buffering pixmap. */
 #ifndef TK_NO_DOUBLE_BUFFERING
     GC copyGC;			/* GC for copying when double-buffering. */
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -141,6 +144,25 @@ typedef struct {
 #define LABELSPACING 1
 #define LABELMARGIN 4
 
+/*
+ * One of the following structures is kept in the display's list for each
+ * toplevel with -sharedbuffer set. The widgets inside the toplevel borrow
+ * the pixmap to double-buffer their redisplay, one at a time, instead of
+ * allocating and freeing a pixmap of their own every time.
+ */
+
+typedef struct TkSharedBuffer {
+    TkWindow *topPtr;		/* Toplevel that owns the buffer. NULL means
+				 * the toplevel let go of the buffer while it
+				 * was lent out; it is freed when returned. */
+    Pixmap pixmap;		/* The buffer, or None until first used. */
+    int width, height;		/* Size of pixmap. */
+    int depth;			/* Depth of pixmap. */
+    bool inUse;			/* Whether pixmap is currently lent out. */
+    struct TkSharedBuffer *nextPtr;
+				/* Next buffer of the same display. */
+} TkSharedBuffer;
+
 /*
  * Flag bits for frames:
  *
@@ -260,6 +282,9 @@ static const Tk_OptionSpec toplevelOptSpec[] = {
     {TK_OPTION_STRING, "-screen", "screen", "Screen",
 	DEF_TOPLEVEL_SCREEN, offsetof(Frame, screenNameObj), TCL_INDEX_NONE,
 	TK_OPTION_NULL_OK, 0, 0},
+    {TK_OPTION_BOOLEAN, "-sharedbuffer", "sharedBuffer", "SharedBuffer",
+	DEF_TOPLEVEL_SHARED_BUFFER, TCL_INDEX_NONE, offsetof(Frame, sharedBuffer),
+	TK_OPTION_VAR(bool), 0, 0},
     {TK_OPTION_BOOLEAN, "-tile", "tile", "Tile",
 	DEF_FRAME_BG_TILE, TCL_INDEX_NONE, offsetof(Frame, tile), TK_OPTION_VAR(bool), 0, 0},
     {TK_OPTION_STRING, "-use", "use", "Use",
@@ -342,6 +367,7 @@ static void		FrameStructureProc(void *clientData,
 static Tcl_ObjCmdProc2 FrameWidgetObjCmd;
 static void		FrameWorldChanged(void *instanceData);
 static void		MapFrame(void *clientData);
+static void		SetSharedBuffer(Frame *framePtr, bool share);
 
 /*
  * The structure below defines frame class behavior by means of functions that
@@ -883,6 +909,9 @@ DestroyFramePartly(
 	labelframePtr->labelWin = NULL;
     }
 
+    if (framePtr->type == TYPE_TOPLEVEL) {
+	SetSharedBuffer(framePtr, false);
+    }
     Tk_FreeConfigOptions(framePtr, framePtr->optionTable,
 	    framePtr->tkwin);
 }
@@ -980,6 +1009,10 @@ ConfigureFrame(
 	Tk_SetWindowBackgroundPixmap(framePtr->tkwin, None);
     }
 
+    if (framePtr->type == TYPE_TOPLEVEL) {
+	SetSharedBuffer(framePtr, framePtr->sharedBuffer);
+    }
+
     /*
      * If a -labelwidget is specified, check that it is valid and set up
      * geometry management for it.
@@ -1413,11 +1446,13 @@ DisplayFrame(
     Pixmap pixmap;
     Bool useClipping = False;
     int borderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     framePtr->flags &= ~REDRAW_PENDING;
     if ((framePtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     /*
      * Highlight shall always be drawn if it exists, so do that first.
@@ -1446,6 +1481,7 @@ DisplayFrame(
      */
 
     if (framePtr->border == NULL) {
+	TkPerfStop(TK_PERF_DISPLAY, perfStart);
 	return;
     }
 
@@ -1459,10 +1495,9 @@ DisplayFrame(
      * crashes, see [610aa08858].
      */
 
-    pixmap = Tk_GetPixmap(framePtr->display, Tk_WindowId(tkwin),
+    pixmap = TkGetBufferPixmap(tkwin,
 	(Tk_Width(tkwin) > 0 ? Tk_Width(tkwin) : 1),
-	(Tk_Height(tkwin) > 0 ? Tk_Height(tkwin) : 1),
-	Tk_Depth(tkwin));
+	(Tk_Height(tkwin) > 0 ? Tk_Height(tkwin) : 1));
 #else
     pixmap = Tk_WindowId(tkwin);
     Tk_ClipDrawableToRect(Tk_Display(tkwin), pixmap, 0, 0,
@@ -1612,10 +1647,11 @@ DisplayFrame(
 	    (unsigned) (Tk_Width(tkwin) - 2 * highlightWidth),
 	    (unsigned) (Tk_Height(tkwin) - 2 * highlightWidth),
 	    highlightWidth, highlightWidth);
-    Tk_FreePixmap(framePtr->display, pixmap);
+    TkFreeBufferPixmap(framePtr->display, pixmap);
 #else
     Tk_ClipDrawableToRect(framePtr->display, pixmap, 0, 0, -1, -1);
 #endif /* TK_NO_DOUBLE_BUFFERING */
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -2070,6 +2106,180 @@ TkToplevelWindowForCommand(
     }
     return framePtr->tkwin;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SetSharedBuffer --
+ *
+ *	Give a toplevel a shared double-buffering pixmap, or take it away,
+ *	according to its -sharedbuffer option.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A buffer is added to or removed from the display's list. A buffer
+ *	that is lent out is only disowned, and freed when it is returned.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SetSharedBuffer(
+    Frame *framePtr,		/* Toplevel to update. */
+    bool share)			/* Whether the toplevel should have a shared
+				 * buffer. */
+{
+    TkWindow *topPtr = (TkWindow *)framePtr->tkwin;
+    TkDisplay *dispPtr = topPtr->dispPtr;
+    TkSharedBuffer *bufPtr, **prevPtrPtr;
+
+    for (prevPtrPtr = &dispPtr->sharedBufferList; *prevPtrPtr != NULL;
+	    prevPtrPtr = &(*prevPtrPtr)->nextPtr) {
+	if ((*prevPtrPtr)->topPtr == topPtr) {
+	    break;
+	}
+    }
+    bufPtr = *prevPtrPtr;
+
+    if (share && bufPtr == NULL) {
+	bufPtr = (TkSharedBuffer *)Tcl_Alloc(sizeof(TkSharedBuffer));
+	bufPtr->topPtr = topPtr;
+	bufPtr->pixmap = None;
+	bufPtr->width = bufPtr->height = bufPtr->depth = 0;
+	bufPtr->inUse = false;
+	bufPtr->nextPtr = dispPtr->sharedBufferList;
+	dispPtr->sharedBufferList = bufPtr;
+    } else if (!share && bufPtr != NULL) {
+	if (bufPtr->inUse) {
+	    bufPtr->topPtr = NULL;
+	    return;
+	}
+	*prevPtrPtr = bufPtr->nextPtr;
+	if (bufPtr->pixmap != None) {
+	    Tk_FreePixmap(dispPtr->display, bufPtr->pixmap);
+	}
+	Tcl_Free(bufPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkGetBufferPixmap, TkFreeBufferPixmap --
+ *
+ *	Get a pixmap for double-buffering the redisplay of a window, and give
+ *	it back. When the window's toplevel has -sharedbuffer set and its
+ *	buffer is not already lent out and has the window's depth, the buffer
+ *	is returned, grown if needed; otherwise the pixmap comes from the
+ *	display's pixmap pool. The pixmap may be larger than requested, and
+ *	its contents are undefined.
+ *
+ * Results:
+ *	TkGetBufferPixmap returns the pixmap.
+ *
+ * Side effects:
+ *	A pixmap may be allocated or freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Pixmap
+TkGetBufferPixmap(
+    Tk_Window tkwin,		/* Window that will be drawn. */
+    int width, int height)	/* Minimum size of the pixmap. */
+{
+    TkWindow *winPtr = (TkWindow *)tkwin;
+    TkWindow *topPtr = winPtr;
+    TkSharedBuffer *bufPtr;
+
+    if (winPtr->dispPtr->sharedBufferList == NULL) {
+	goto privatePixmap;
+    }
+    while (!Tk_TopWinHierarchy(topPtr) && topPtr->parentPtr != NULL) {
+	topPtr = topPtr->parentPtr;
+    }
+    for (bufPtr = winPtr->dispPtr->sharedBufferList; bufPtr != NULL;
+	    bufPtr = bufPtr->nextPtr) {
+	if (bufPtr->topPtr == topPtr) {
+	    break;
+	}
+    }
+    if (bufPtr == NULL || bufPtr->inUse) {
+	goto privatePixmap;
+    }
+    if (bufPtr->pixmap != None && bufPtr->depth != Tk_Depth(tkwin)) {
+	/*
+	 * A window with a visual of its own: don't throw away the buffer the
+	 * rest of the toplevel uses.
+	 */
+
+	goto privatePixmap;
+    }
+
+    if (bufPtr->pixmap != None
+	    && (bufPtr->width < width || bufPtr->height < height)) {
+	Tk_FreePixmap(winPtr->display, bufPtr->pixmap);
+	bufPtr->pixmap = None;
+    }
+    if (bufPtr->pixmap == None) {
+	/*
+	 * Make the buffer large enough for any window that fits into the
+	 * toplevel, so that it rarely has to grow.
+	 */
+
+	if (bufPtr->width < width) {
+	    bufPtr->width = width;
+	}
+	if (bufPtr->width < Tk_Width(topPtr)) {
+	    bufPtr->width = Tk_Width(topPtr);
+	}
+	if (bufPtr->height < height) {
+	    bufPtr->height = height;
+	}
+	if (bufPtr->height < Tk_Height(topPtr)) {
+	    bufPtr->height = Tk_Height(topPtr);
+	}
+	bufPtr->depth = Tk_Depth(tkwin);
+	bufPtr->pixmap = Tk_GetPixmap(winPtr->display, Tk_WindowId(tkwin),
+		bufPtr->width, bufPtr->height, bufPtr->depth);
+    }
+    bufPtr->inUse = true;
+    return bufPtr->pixmap;
+
+  privatePixmap:
+    return TkGetPooledPixmap(tkwin, width, height);
+}
+
+void
+TkFreeBufferPixmap(
+    Display *display,		/* Display for which pixmap was allocated. */
+    Pixmap pixmap)		/* Pixmap from TkGetBufferPixmap. */
+{
+    TkDisplay *dispPtr = TkGetDisplay(display);
+    TkSharedBuffer *bufPtr, **prevPtrPtr;
+
+    if (dispPtr != NULL) {
+	for (prevPtrPtr = &dispPtr->sharedBufferList; *prevPtrPtr != NULL;
+		prevPtrPtr = &(*prevPtrPtr)->nextPtr) {
+	    bufPtr = *prevPtrPtr;
+	    if (bufPtr->pixmap != pixmap || !bufPtr->inUse) {
+		continue;
+	    }
+	    bufPtr->inUse = false;
+	    if (bufPtr->topPtr == NULL) {
+		*prevPtrPtr = bufPtr->nextPtr;
+		Tk_FreePixmap(display, pixmap);
+		Tcl_Free(bufPtr);
+	    }
+	    return;
+	}
+	TkFreePooledPixmap(dispPtr, pixmap);
+	return;
+    }
+    Tk_FreePixmap(display, pixmap);
+}
 
 /*
  *----------------------------------------------------------------------
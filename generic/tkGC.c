@@ -17,15 +17,23 @@
  * One of the following data structures exists for each GC that is currently
  * active. The structure is indexed with two hash tables, one based on the
  * values in the graphics context and the other based on the display and GC
- * identifier.
+ * identifier. A GC whose reference count drops to zero is kept for a while
+ * on a list ordered by release time, so that widgets that keep allocating
+ * and freeing the same GC do not create a new one each time. This does not
+ * help GCs that name a font: the font is usually freed along with the last
+ * widget using it, and when it is loaded again it gets a new font ID, so the
+ * old GC no longer matches.
  */
 
-typedef struct {
+typedef struct TkGC {
     GC gc;			/* Graphics context. */
     Display *display;		/* Display to which gc belongs. */
     size_t refCount;		/* Number of active uses of gc. */
     Tcl_HashEntry *valueHashPtr;/* Entry in valueTable (needed when deleting
 				 * this structure). */
+    Tcl_WideInt freeTime;	/* Time (ms) refCount dropped to zero. */
+    struct TkGC *newerPtr;	/* Next more recently released unused GC. */
+    struct TkGC *olderPtr;	/* Next less recently released unused GC. */
 } TkGC;
 
 typedef struct {
@@ -35,11 +43,23 @@ typedef struct {
     int depth;			/* and depth for which GC is valid. */
 } ValueKey;
 
+/*
+ * Unused GCs are kept for at most GC_RETAIN_MS, and at most GC_RETAIN_COUNT
+ * of them per display.
+ */
+
+#define GC_RETAIN_COUNT	64
+#define GC_RETAIN_MS	10000
+
 /*
  * Forward declarations for functions defined in this file:
  */
 
+static void		DeleteGC(TkDisplay *dispPtr, TkGC *gcPtr,
+			    Tcl_HashEntry *idHashPtr);
 static void		GCInit(TkDisplay *dispPtr);
+static void		GCTrimProc(void *clientData);
+static void		UnlinkUnusedGC(TkDisplay *dispPtr, TkGC *gcPtr);
 
 /*
  *----------------------------------------------------------------------
@@ -219,7 +239,11 @@ Tk_GetGC(
 	    (char *) &valueKey, &isNew);
     if (!isNew) {
 	gcPtr = (TkGC *)Tcl_GetHashValue(valueHashPtr);
+	if (gcPtr->refCount == 0) {
+	    UnlinkUnusedGC(dispPtr, gcPtr);
+	}
 	gcPtr->refCount++;
+	dispPtr->gcStats.hits++;
 	return gcPtr->gc;
     }
 
@@ -229,6 +253,7 @@ Tk_GetGC(
      */
 
     gcPtr = (TkGC *)Tcl_Alloc(sizeof(TkGC));
+    dispPtr->gcStats.misses++;
 
     /*
      * Find or make a drawable to use to specify the screen and depth of the
@@ -253,6 +278,7 @@ Tk_GetGC(
     gcPtr->display = valueKey.display;
     gcPtr->refCount = 1;
     gcPtr->valueHashPtr = valueHashPtr;
+    gcPtr->newerPtr = gcPtr->olderPtr = NULL;
     idHashPtr = Tcl_CreateHashEntry(&dispPtr->gcIdTable,
 	    (char *) gcPtr->gc, &isNew);
     if (!isNew) {
@@ -279,8 +305,9 @@ Tk_GetGC(
  *	None.
  *
  * Side effects:
- *	The reference count associated with gc is decremented, and gc is
- *	officially deallocated if no-one is using it anymore.
+ *	The reference count associated with gc is decremented. When no-one is
+ *	using gc anymore, it is kept for reuse for a while, or deallocated if
+ *	it refers to pixmaps, which may go away.
  *
  *----------------------------------------------------------------------
  */
@@ -292,6 +319,7 @@ Tk_FreeGC(
 {
     Tcl_HashEntry *idHashPtr;
     TkGC *gcPtr;
+    ValueKey *valueKeyPtr;
     TkDisplay *dispPtr = TkGetDisplay(display);
 
     if (!dispPtr->gcInit) {
@@ -312,11 +340,148 @@ Tk_FreeGC(
 	Tcl_Panic("Tk_FreeGC received unknown gc argument");
     }
     gcPtr = (TkGC *)Tcl_GetHashValue(idHashPtr);
-    if (gcPtr->refCount-- <= 1) {
-	XFreeGC(gcPtr->display, gcPtr->gc);
-	Tcl_DeleteHashEntry(gcPtr->valueHashPtr);
-	Tcl_DeleteHashEntry(idHashPtr);
-	Tcl_Free(gcPtr);
+    if (gcPtr->refCount-- > 1) {
+	return;
+    }
+
+    /*
+     * Don't keep GCs that refer to pixmaps: their ids may be reused once the
+     * pixmaps are freed.
+     */
+
+    valueKeyPtr = (ValueKey *)Tcl_GetHashKey(&dispPtr->gcValueTable,
+	    gcPtr->valueHashPtr);
+    if (valueKeyPtr->values.tile != None
+	    || valueKeyPtr->values.stipple != None
+	    || valueKeyPtr->values.clip_mask != None) {
+	DeleteGC(dispPtr, gcPtr, idHashPtr);
+	return;
+    }
+
+    gcPtr->freeTime = TkCacheMilliseconds();
+    gcPtr->newerPtr = NULL;
+    gcPtr->olderPtr = dispPtr->gcNewestPtr;
+    if (dispPtr->gcNewestPtr != NULL) {
+	dispPtr->gcNewestPtr->newerPtr = gcPtr;
+    } else {
+	dispPtr->gcOldestPtr = gcPtr;
+    }
+    dispPtr->gcNewestPtr = gcPtr;
+    if (++dispPtr->gcStats.size > GC_RETAIN_COUNT) {
+	gcPtr = dispPtr->gcOldestPtr;
+	UnlinkUnusedGC(dispPtr, gcPtr);
+	DeleteGC(dispPtr, gcPtr, NULL);
+	dispPtr->gcStats.trims++;
+    }
+    if (dispPtr->gcTimer == NULL) {
+	dispPtr->gcTimer = Tcl_CreateTimerHandler(GC_RETAIN_MS, GCTrimProc,
+		dispPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UnlinkUnusedGC --
+ *
+ *	Removes a GC from the display's list of unused GCs.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The list and its size are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UnlinkUnusedGC(
+    TkDisplay *dispPtr,
+    TkGC *gcPtr)
+{
+    if (gcPtr->newerPtr != NULL) {
+	gcPtr->newerPtr->olderPtr = gcPtr->olderPtr;
+    } else {
+	dispPtr->gcNewestPtr = gcPtr->olderPtr;
+    }
+    if (gcPtr->olderPtr != NULL) {
+	gcPtr->olderPtr->newerPtr = gcPtr->newerPtr;
+    } else {
+	dispPtr->gcOldestPtr = gcPtr->newerPtr;
+    }
+    gcPtr->newerPtr = gcPtr->olderPtr = NULL;
+    dispPtr->gcStats.size--;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DeleteGC --
+ *
+ *	Frees a GC and removes it from the display's tables.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The GC and its TkGC structure are freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DeleteGC(
+    TkDisplay *dispPtr,
+    TkGC *gcPtr,
+    Tcl_HashEntry *idHashPtr)	/* Entry of gcPtr in gcIdTable, or NULL if
+				 * it must be looked up. */
+{
+    if (idHashPtr == NULL) {
+	idHashPtr = Tcl_FindHashEntry(&dispPtr->gcIdTable, gcPtr->gc);
+    }
+    XFreeGC(gcPtr->display, gcPtr->gc);
+    Tcl_DeleteHashEntry(gcPtr->valueHashPtr);
+    Tcl_DeleteHashEntry(idHashPtr);
+    Tcl_Free(gcPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GCTrimProc --
+ *
+ *	Timer callback that frees the unused GCs of a display that were
+ *	released more than GC_RETAIN_MS ago.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	GCs may be freed; the timer is rescheduled while unused GCs remain.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+GCTrimProc(
+    void *clientData)		/* Display whose GCs to trim. */
+{
+    TkDisplay *dispPtr = (TkDisplay *)clientData;
+    Tcl_WideInt now = TkCacheMilliseconds();
+    TkGC *gcPtr;
+
+    dispPtr->gcTimer = NULL;
+    while (dispPtr->gcOldestPtr != NULL
+	    && now - dispPtr->gcOldestPtr->freeTime >= GC_RETAIN_MS) {
+	gcPtr = dispPtr->gcOldestPtr;
+	UnlinkUnusedGC(dispPtr, gcPtr);
+	DeleteGC(dispPtr, gcPtr, NULL);
+	dispPtr->gcStats.trims++;
+    }
+    if (dispPtr->gcOldestPtr != NULL) {
+	dispPtr->gcTimer = Tcl_CreateTimerHandler((int) (GC_RETAIN_MS
+		- (now - dispPtr->gcOldestPtr->freeTime)), GCTrimProc, dispPtr);
     }
 }
 
@@ -345,6 +510,12 @@ TkGCCleanup(
     Tcl_HashSearch search;
     TkGC *gcPtr;
 
+    if (dispPtr->gcTimer != NULL) {
+	Tcl_DeleteTimerHandler(dispPtr->gcTimer);
+	dispPtr->gcTimer = NULL;
+    }
+    dispPtr->gcNewestPtr = dispPtr->gcOldestPtr = NULL;
+    dispPtr->gcStats.size = 0;
     for (entryPtr = Tcl_FirstHashEntry(&dispPtr->gcIdTable, &search);
 	    entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
 	gcPtr = (TkGC *)Tcl_GetHashValue(entryPtr);
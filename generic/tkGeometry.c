@@ -49,10 +49,75 @@ typedef struct MaintainContainer {
 				 * this container. */
 } MaintainContainer;
 
+/*
+ * Containers waiting to be arranged by their geometry manager are kept per
+ * display in a structure of the following type, so that they can all be
+ * arranged in a single idle callback. It runs in phases: bottom-up phases
+ * arrange the deepest containers first, so that requested sizes propagate
+ * all the way up before anything is allocated, and top-down phases arrange
+ * the shallowest containers first, so that each container is laid out after
+ * its own container has allocated its space. A container scheduled during a
+ * phase joins it if it comes later in the phase's order, and waits for the
+ * next phase otherwise; this happens in particular to a container that asks
+ * for a new size and reschedules itself to be laid out once its container
+ * has dealt with the request.
+ */
+
+typedef struct {
+    Tcl_IdleProc *proc;		/* Arrange procedure of the geometry manager,
+				 * or NULL if the call was cancelled. */
+    void *clientData;		/* Argument for proc. */
+    int depth;			/* Number of ancestors of the container in its
+				 * toplevel. */
+    Tcl_Size seq;		/* Orders calls of the same depth in the order
+				 * they were scheduled. */
+} ArrangeCall;
+
+typedef struct TkArrangeQueue {
+    TkDisplay *dispPtr;		/* Display the containers are on. */
+    ArrangeCall *pending;	/* Calls waiting for the next phase. */
+    Tcl_Size numPending, maxPending;
+    ArrangeCall *phase;		/* Calls of the current phase, sorted in the
+				 * order they are made. */
+    Tcl_Size numPhase, maxPhase;
+    Tcl_Size next;		/* Index in phase of the next call to make. */
+    int direction;		/* ARRANGE_UP or ARRANGE_DOWN while a phase is
+				 * running, 0 otherwise. */
+    int depth;			/* Depth of the container being arranged. */
+    Tcl_Size seq;		/* Sequence number for the next call. */
+    int phaseCount;		/* Number of phases run since everything was
+				 * last laid out. */
+    Tcl_Size settleStart;	/* Value of the display's arrangeCount when
+				 * the current settle started. */
+    bool scheduled;		/* ArrangeIdleProc is scheduled. */
+    bool deleted;		/* The display was closed while a phase was
+				 * running. */
+} TkArrangeQueue;
+
+#define ARRANGE_UP		1
+#define ARRANGE_DOWN		2
+
+/*
+ * Number of phases run by one call of ArrangeIdleProc. Layouts which keep
+ * changing after that many get the rest of their phases in later idle
+ * callbacks, so that they cannot lock up the event loop.
+ */
+
+#define ARRANGE_MAX_PHASES	64
+
 /*
  * Prototypes for static procedures in this file:
  */
 
+static void		AddArrangeCall(ArrangeCall **callsPtr,
+			    Tcl_Size *numPtr, Tcl_Size *maxPtr,
+			    Tcl_Size index, const ArrangeCall *callPtr);
+static int		ArrangeCallComesBefore(int direction,
+			    const ArrangeCall *aPtr, const ArrangeCall *bPtr);
+static void		ArrangeIdleProc(void *clientData);
+static void		FreeArrangeQueue(TkArrangeQueue *queuePtr);
+static int		SortArrangeUp(const void *a, const void *b);
+static int		SortArrangeDown(const void *a, const void *b);
 static void		MaintainCheckProc(void *clientData);
 static void		MaintainContainerProc(void *clientData,
 			    XEvent *eventPtr);
@@ -778,6 +843,381 @@ MaintainCheckProc(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkScheduleArrange --
+ *
+ *	Arranges for a geometry manager to lay out a container at idle time.
+ *	This is used by the packer, gridder and placer instead of
+ *	Tcl_DoWhenIdle, so that all the containers of a display waiting to be
+ *	laid out are handled together, deepest first and then shallowest
+ *	first, as described above for TkArrangeQueue. Like with
+ *	Tcl_DoWhenIdle, the caller must make sure not to schedule the same
+ *	call twice.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Proc will be called with clientData at idle time, unless the call is
+ *	cancelled with TkCancelArrange.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkScheduleArrange(
+    Tk_Window container,	/* Window to be laid out. */
+    Tcl_IdleProc *proc,		/* Procedure of the geometry manager that lays
+				 * it out. */
+    void *clientData)		/* Argument to pass to proc. */
+{
+    TkWindow *winPtr = (TkWindow *) container;
+    TkDisplay *dispPtr = winPtr->dispPtr;
+    TkArrangeQueue *queuePtr = dispPtr->arrangeQueuePtr;
+    ArrangeCall call;
+    Tcl_Size lo, hi, mid;
+
+    if (queuePtr == NULL) {
+	queuePtr = (TkArrangeQueue *)Tcl_Alloc(sizeof(TkArrangeQueue));
+	memset(queuePtr, 0, sizeof(TkArrangeQueue));
+	queuePtr->dispPtr = dispPtr;
+	queuePtr->settleStart = dispPtr->arrangeCount;
+	dispPtr->arrangeQueuePtr = queuePtr;
+    }
+
+    call.proc = proc;
+    call.clientData = clientData;
+    call.seq = queuePtr->seq++;
+    for (call.depth = 0; !Tk_TopWinHierarchy(winPtr)
+	    && (winPtr->parentPtr != NULL); winPtr = winPtr->parentPtr) {
+	call.depth++;
+    }
+
+    /*
+     * While a phase is running, a call that comes after the current one in
+     * the phase's order joins the phase, at its place in the order.
+     */
+
+    if (queuePtr->direction != 0 && ((queuePtr->direction == ARRANGE_UP)
+	    ? (call.depth < queuePtr->depth) : (call.depth > queuePtr->depth))) {
+	lo = queuePtr->next;
+	hi = queuePtr->numPhase;
+	while (lo < hi) {
+	    mid = lo + (hi - lo) / 2;
+	    if (ArrangeCallComesBefore(queuePtr->direction,
+		    &queuePtr->phase[mid], &call)) {
+		lo = mid + 1;
+	    } else {
+		hi = mid;
+	    }
+	}
+	AddArrangeCall(&queuePtr->phase, &queuePtr->numPhase,
+		&queuePtr->maxPhase, lo, &call);
+	return;
+    }
+
+    AddArrangeCall(&queuePtr->pending, &queuePtr->numPending,
+	    &queuePtr->maxPending, queuePtr->numPending, &call);
+    if (queuePtr->direction == 0 && !queuePtr->scheduled) {
+	queuePtr->scheduled = true;
+	Tcl_DoWhenIdle(ArrangeIdleProc, queuePtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkCancelArrange --
+ *
+ *	Cancels a call scheduled with TkScheduleArrange.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	If proc was scheduled to be called with clientData, it won't be.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkCancelArrange(
+    Tk_Window container,	/* Window that was to be laid out. */
+    Tcl_IdleProc *proc,		/* Procedure passed to TkScheduleArrange. */
+    void *clientData)		/* Argument passed to TkScheduleArrange. */
+{
+    TkArrangeQueue *queuePtr;
+    Tcl_Size i;
+
+    if (container == NULL) {
+	return;
+    }
+    queuePtr = ((TkWindow *) container)->dispPtr->arrangeQueuePtr;
+    if (queuePtr == NULL) {
+	return;
+    }
+    for (i = queuePtr->next; i < queuePtr->numPhase; i++) {
+	if ((queuePtr->phase[i].proc == proc)
+		&& (queuePtr->phase[i].clientData == clientData)) {
+	    queuePtr->phase[i].proc = NULL;
+	}
+    }
+    for (i = 0; i < queuePtr->numPending; i++) {
+	if ((queuePtr->pending[i].proc == proc)
+		&& (queuePtr->pending[i].clientData == clientData)) {
+	    queuePtr->pending[i].proc = NULL;
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkArrangeCleanup --
+ *
+ *	Frees the queue of containers waiting to be laid out when a display
+ *	is closed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Pending calls are dropped. If a phase is running, the queue is freed
+ *	when it returns.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkArrangeCleanup(
+    TkDisplay *dispPtr)		/* Display being closed. */
+{
+    TkArrangeQueue *queuePtr = dispPtr->arrangeQueuePtr;
+
+    if (queuePtr == NULL) {
+	return;
+    }
+    dispPtr->arrangeQueuePtr = NULL;
+    if (queuePtr->scheduled) {
+	Tcl_CancelIdleCall(ArrangeIdleProc, queuePtr);
+    }
+    if (queuePtr->direction != 0) {
+	queuePtr->deleted = true;
+	queuePtr->numPhase = queuePtr->numPending = 0;
+    } else {
+	FreeArrangeQueue(queuePtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ArrangeIdleProc --
+ *
+ *	Idle callback which lays out all the containers of a display waiting
+ *	for it, in alternating bottom-up and top-down phases, until none are
+ *	left.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the geometry managers do. The arrange statistics of the
+ *	display are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ArrangeIdleProc(
+    void *clientData)		/* The TkArrangeQueue. */
+{
+    TkArrangeQueue *queuePtr = (TkArrangeQueue *)clientData;
+    TkDisplay *dispPtr;
+    ArrangeCall *calls, call;
+    Tcl_Size max;
+    int phases;
+
+    queuePtr->scheduled = false;
+    for (phases = 0; queuePtr->numPending > 0; phases++) {
+	if (phases == ARRANGE_MAX_PHASES) {
+	    queuePtr->scheduled = true;
+	    Tcl_DoWhenIdle(ArrangeIdleProc, queuePtr);
+	    return;
+	}
+
+	/*
+	 * The pending calls make up the new phase; the arrays are swapped so
+	 * that both keep their memory.
+	 */
+
+	calls = queuePtr->phase;
+	max = queuePtr->maxPhase;
+	queuePtr->phase = queuePtr->pending;
+	queuePtr->numPhase = queuePtr->numPending;
+	queuePtr->maxPhase = queuePtr->maxPending;
+	queuePtr->pending = calls;
+	queuePtr->numPending = 0;
+	queuePtr->maxPending = max;
+	queuePtr->next = 0;
+	queuePtr->direction = (queuePtr->phaseCount & 1)
+		? ARRANGE_DOWN : ARRANGE_UP;
+	qsort(queuePtr->phase, queuePtr->numPhase, sizeof(ArrangeCall),
+		(queuePtr->direction == ARRANGE_UP)
+		? SortArrangeUp : SortArrangeDown);
+
+	while (queuePtr->next < queuePtr->numPhase) {
+	    call = queuePtr->phase[queuePtr->next++];
+	    if (call.proc == NULL) {
+		continue;
+	    }
+	    queuePtr->depth = call.depth;
+	    queuePtr->dispPtr->arrangeCount++;
+	    call.proc(call.clientData);
+	    if (queuePtr->deleted) {
+		FreeArrangeQueue(queuePtr);
+		return;
+	    }
+	}
+	queuePtr->direction = 0;
+	queuePtr->phaseCount++;
+    }
+
+    /*
+     * Everything is laid out. The next settle starts with a bottom-up
+     * phase again.
+     */
+
+    if (queuePtr->phaseCount > 0) {
+	dispPtr = queuePtr->dispPtr;
+	dispPtr->arrangeSettleCount++;
+	dispPtr->lastSettleArranges = dispPtr->arrangeCount
+		- queuePtr->settleStart;
+	queuePtr->settleStart = dispPtr->arrangeCount;
+	queuePtr->phaseCount = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AddArrangeCall --
+ *
+ *	Inserts a call at the given index of an array of calls, growing it
+ *	if needed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The array may be reallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AddArrangeCall(
+    ArrangeCall **callsPtr,	/* The array. */
+    Tcl_Size *numPtr,		/* Number of calls in it. */
+    Tcl_Size *maxPtr,		/* Number of calls there is room for. */
+    Tcl_Size index,		/* Where to insert the call. */
+    const ArrangeCall *callPtr)	/* The call. */
+{
+    if (*numPtr == *maxPtr) {
+	*maxPtr = (*maxPtr == 0) ? 16 : 2 * *maxPtr;
+	*callsPtr = (ArrangeCall *)Tcl_Realloc(*callsPtr,
+		*maxPtr * sizeof(ArrangeCall));
+    }
+    memmove(*callsPtr + index + 1, *callsPtr + index,
+	    (*numPtr - index) * sizeof(ArrangeCall));
+    (*callsPtr)[index] = *callPtr;
+    (*numPtr)++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ArrangeCallComesBefore, SortArrangeUp, SortArrangeDown --
+ *
+ *	Orderings of arrange calls: deepest first in bottom-up phases,
+ *	shallowest first in top-down ones, and in the order they were
+ *	scheduled for the same depth.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ArrangeCallComesBefore(
+    int direction,
+    const ArrangeCall *aPtr,
+    const ArrangeCall *bPtr)
+{
+    if (aPtr->depth != bPtr->depth) {
+	return (direction == ARRANGE_UP) ? (aPtr->depth > bPtr->depth)
+		: (aPtr->depth < bPtr->depth);
+    }
+    return aPtr->seq < bPtr->seq;
+}
+
+static int
+SortArrangeUp(
+    const void *a,
+    const void *b)
+{
+    const ArrangeCall *aPtr = (const ArrangeCall *)a;
+    const ArrangeCall *bPtr = (const ArrangeCall *)b;
+
+    if (aPtr->seq == bPtr->seq) {
+	return 0;
+    }
+    return ArrangeCallComesBefore(ARRANGE_UP, aPtr, bPtr) ? -1 : 1;
+}
+
+static int
+SortArrangeDown(
+    const void *a,
+    const void *b)
+{
+    const ArrangeCall *aPtr = (const ArrangeCall *)a;
+    const ArrangeCall *bPtr = (const ArrangeCall *)b;
+
+    if (aPtr->seq == bPtr->seq) {
+	return 0;
+    }
+    return ArrangeCallComesBefore(ARRANGE_DOWN, aPtr, bPtr) ? -1 : 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeArrangeQueue --
+ *
+ *	Frees a TkArrangeQueue.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeArrangeQueue(
+    TkArrangeQueue *queuePtr)
+{
+    if (queuePtr->pending != NULL) {
+	Tcl_Free(queuePtr->pending);
+    }
+    if (queuePtr->phase != NULL) {
+	Tcl_Free(queuePtr->phase);
+    }
+    Tcl_Free(queuePtr);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -123,6 +123,43 @@ typedef struct GridLayout {
 				 * bottom/right to top/left. */
 } GridLayout;
 
+/*
+ * The result of solving the constraints of one axis of a container. The slot
+ * offsets only depend on the slot constraints and on the sizes requested by
+ * the content, so a relayout that changes neither (for example after the
+ * container itself was resized) can restore them instead of solving again.
+ */
+
+typedef struct GridSolve {
+    int state;			/* How far the cached solution can be trusted;
+				 * see below for definitions. */
+    int count;			/* Number of slots in the cached solution. */
+    int space;			/* Number of slots allocated in minPtr and
+				 * offsetPtr. */
+    int size;			/* Natural size of the layout, in pixels. */
+    int *minPtr;		/* Minimum size of each slot once the content
+				 * spanning a single slot has been taken into
+				 * account. */
+    int *offsetPtr;		/* Resolved offset of each slot. Shares the
+				 * allocation of minPtr. */
+} GridSolve;
+
+/*
+ * Values for the state of a GridSolve:
+ *
+ * SOLVE_INVALID		The slot constraints or the set of content
+ *				changed: the axis must be solved from scratch.
+ * SOLVE_CHECK			Some content requested a new size. The slot
+ *				minimums must be recomputed, but if they and
+ *				the sizes of the spanning content are unchanged
+ *				the cached offsets are still correct.
+ * SOLVE_VALID			The cached offsets can be used as they are.
+ */
+
+#define SOLVE_INVALID		0
+#define SOLVE_CHECK		1
+#define SOLVE_VALID		2
+
 /*
  * Keep one of these for each geometry container.
  */
@@ -144,6 +181,8 @@ typedef struct {
 				 * container. */
     Tk_Anchor anchor;		/* Value of anchor option: specifies where a
 				 * grid without weight should be placed. */
+    GridSolve columnSolve;	/* Cached solution for the columns. */
+    GridSolve rowSolve;		/* Cached solution for the rows. */
 } GridContainer;
 
 /*
@@ -202,6 +241,8 @@ typedef struct Gridder {
     struct Gridder *binNextPtr;	/* Link to next span>1 content in this bin. */
     int size;			/* Nominal size (width or height) in pixels of
 				 * the content. This includes the padding. */
+    int solvedWidth;		/* Values of size used for the columns and */
+    int solvedHeight;		/* rows when the container was last solved. */
 } Gridder;
 
 /*
@@ -234,9 +275,9 @@ typedef struct UniformGroup {
 /*
  * Flag values for Grid structures:
  *
- * REQUESTED_RELAYOUT		1 means a Tcl_DoWhenIdle request has already
- *				been made to re-arrange all the content of this
- *				window.
+ * REQUESTED_RELAYOUT		1 means a TkScheduleArrange request has
+ *				already been made to re-arrange all the content
+ *				of this window.
  * DONT_PROPAGATE		1 means don't set this window's requested
  *				size. 0 means if this window is a container then
  *				Tk will set its requested size to fit the
@@ -292,6 +333,8 @@ static void		GridLostContentProc(void *clientData,
 			    Tk_Window tkwin);
 static void		GridReqProc(void *clientData, Tk_Window tkwin);
 static void		InitContainerData(Gridder *containerPtr);
+static void		InvalidateSolve(Gridder *containerPtr, int slotTypes,
+			    int state);
 static Tcl_Obj *	NewPairObj(Tcl_WideInt, Tcl_WideInt);
 static Tcl_Obj *	NewQuadObj(Tcl_WideInt, Tcl_WideInt, Tcl_WideInt, Tcl_WideInt);
 static int		ResolveConstraints(Gridder *gridPtr, int rowOrColumn,
@@ -487,7 +530,7 @@ GridAnchorCommand(
 	}
 	if (!(containerPtr->flags & REQUESTED_RELAYOUT)) {
 	    containerPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
 	}
     }
     return TCL_OK;
@@ -684,7 +727,8 @@ GridForgetRemoveCommand(
 		}
 		contentPtr->doubleBw = 2*Tk_Changes(tkwin)->border_width;
 		if (contentPtr->flags & REQUESTED_RELAYOUT) {
-		    Tcl_CancelIdleCall(ArrangeGrid, contentPtr);
+		    TkCancelArrange(contentPtr->tkwin, ArrangeGrid,
+			    contentPtr);
 		}
 		contentPtr->flags = 0;
 		contentPtr->sticky = 0;
@@ -844,7 +888,7 @@ GridLocationCommand(
      */
 
     while (containerPtr->flags & REQUESTED_RELAYOUT) {
-	Tcl_CancelIdleCall(ArrangeGrid, containerPtr);
+	TkCancelArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
 	ArrangeGrid(containerPtr);
     }
     SetGridSize(containerPtr);
@@ -959,7 +1003,7 @@ GridPropagateCommand(
 	}
 	if (!(containerPtr->flags & REQUESTED_RELAYOUT)) {
 	    containerPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
 	}
     }
     return TCL_OK;
@@ -1285,12 +1329,18 @@ GridRowColumnConfigureCommand(
 	}
     }
 
+    /*
+     * Weights and uniform groups affect every slot of the axis, so the
+     * cached solution is of no use anymore.
+     */
+
+    InvalidateSolve(containerPtr, slotType, SOLVE_INVALID);
     if (containerPtr->abortPtr != NULL) {
 	*containerPtr->abortPtr = 1;
     }
     if (!(containerPtr->flags & REQUESTED_RELAYOUT)) {
 	containerPtr->flags |= REQUESTED_RELAYOUT;
-	Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
     }
     return TCL_OK;
 
@@ -1465,12 +1515,32 @@ GridReqProc(
     TCL_UNUSED(Tk_Window))		/* Other Tk-related information about the
 				 * window. */
 {
-    Gridder *gridPtr = (Gridder *)clientData;
+    Gridder *contentPtr = (Gridder *)clientData;
+    Gridder *gridPtr = contentPtr->containerPtr;
+
+    if (gridPtr != NULL) {
+	int slotTypes = 0;
+
+	/*
+	 * Only the axes along which the content really changed its size need
+	 * their constraints checked again.
+	 */
 
-    gridPtr = gridPtr->containerPtr;
+	if (Tk_ReqWidth(contentPtr->tkwin) + contentPtr->padX
+		+ contentPtr->iPadX + contentPtr->doubleBw
+		!= contentPtr->solvedWidth) {
+	    slotTypes |= COLUMN;
+	}
+	if (Tk_ReqHeight(contentPtr->tkwin) + contentPtr->padY
+		+ contentPtr->iPadY + contentPtr->doubleBw
+		!= contentPtr->solvedHeight) {
+	    slotTypes |= ROW;
+	}
+	InvalidateSolve(gridPtr, slotTypes, SOLVE_CHECK);
+    }
     if (gridPtr && !(gridPtr->flags & REQUESTED_RELAYOUT)) {
 	gridPtr->flags |= REQUESTED_RELAYOUT;
-	Tcl_DoWhenIdle(ArrangeGrid, gridPtr);
+	TkScheduleArrange(gridPtr->tkwin, ArrangeGrid, gridPtr);
     }
 }
 
@@ -1736,7 +1806,7 @@ AdjustForSticky(
  *
  * ArrangeGrid --
  *
- *	This procedure is invoked (using the Tcl_DoWhenIdle mechanism) to
+ *	This procedure is invoked (using the TkScheduleArrange mechanism) to
  *	re-layout a set of windows managed by the grid. It is invoked at idle
  *	time so that a series of grid requests can be merged into a single
  *	layout operation.
@@ -1762,6 +1832,7 @@ ArrangeGrid(
     int width, height;		/* Requested size of layout, in pixels. */
     int realWidth, realHeight;	/* Actual size layout should take-up. */
     int usedX, usedY;
+    Tcl_WideInt perfStart;
 
     containerPtr->flags &= ~REQUESTED_RELAYOUT;
 
@@ -1785,6 +1856,7 @@ ArrangeGrid(
      * necessary.
      */
 
+    perfStart = TkPerfStart();
     if (containerPtr->abortPtr != NULL) {
 	*containerPtr->abortPtr = 1;
     }
@@ -1817,10 +1889,11 @@ ArrangeGrid(
 	Tk_GeometryRequest(containerPtr->tkwin, width, height);
 	if (width>1 && height>1) {
 	    containerPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
 	}
 	containerPtr->abortPtr = NULL;
 	Tcl_Release(containerPtr);
+	TkPerfStop(TK_PERF_GRID, perfStart);
 	return;
     }
 
@@ -1906,6 +1979,7 @@ ArrangeGrid(
 
     containerPtr->abortPtr = NULL;
     Tcl_Release(containerPtr);
+    TkPerfStop(TK_PERF_GRID, perfStart);
 }
 
 /*
@@ -1923,7 +1997,9 @@ ArrangeGrid(
  *
  * Side effects:
  *	The slot offsets are copied into the SlotInfo structure for the
- *	geometry container.
+ *	geometry container. The solution is cached, and reused by later calls
+ *	for as long as neither the slot constraints nor the effective content
+ *	sizes change.
  *
  *----------------------------------------------------------------------
  */
@@ -1964,6 +2040,9 @@ ResolveConstraints(
 				 * groups. */
     int minSize;
     int prevGrow, accWeight, grow;
+    GridSolve *solvePtr;	/* Cached solution for this axis. */
+    int spanChanged = 0;	/* Whether any content spanning several slots
+				 * changed its size since the last solve. */
 
     /*
      * For typical sized tables, we'll use stack space for the layout data to
@@ -1976,17 +2055,35 @@ ResolveConstraints(
 	constraintCount = containerPtr->containerDataPtr->columnMax;
 	slotCount = containerPtr->containerDataPtr->columnEnd;
 	slotPtr = containerPtr->containerDataPtr->columnPtr;
+	solvePtr = &containerPtr->containerDataPtr->columnSolve;
     } else {
 	constraintCount = containerPtr->containerDataPtr->rowMax;
 	slotCount = containerPtr->containerDataPtr->rowEnd;
 	slotPtr = containerPtr->containerDataPtr->rowPtr;
+	solvePtr = &containerPtr->containerDataPtr->rowSolve;
+    }
+    gridCount = MAX(constraintCount, slotCount);
+
+    /*
+     * Nothing the offsets depend on changed since they were last computed,
+     * so restore them; ArrangeGrid may have adjusted them to the size of
+     * the container since.
+     */
+
+    if (solvePtr->count != gridCount || maxOffset != 0) {
+	solvePtr->state = SOLVE_INVALID;
+    }
+    if (solvePtr->state == SOLVE_VALID) {
+	for (slot=0; slot < gridCount; slot++) {
+	    slotPtr[slot].offset = solvePtr->offsetPtr[slot];
+	}
+	return solvePtr->size;
     }
 
     /*
      * Make sure there is enough memory for the layout.
      */
 
-    gridCount = MAX(constraintCount, slotCount);
     if (gridCount >= TYPICAL_SIZE) {
 	layoutPtr = (GridLayout *)Tcl_Alloc(sizeof(GridLayout) * (1+gridCount));
     } else {
@@ -2047,6 +2144,11 @@ ResolveConstraints(
 
 	    contentPtr->size = Tk_ReqWidth(contentPtr->tkwin) + contentPtr->padX
 		    + contentPtr->iPadX + contentPtr->doubleBw;
+	    if (contentPtr->numCols > 1
+		    && contentPtr->size != contentPtr->solvedWidth) {
+		spanChanged = 1;
+	    }
+	    contentPtr->solvedWidth = contentPtr->size;
 	    if (contentPtr->numCols > 1) {
 		contentPtr->binNextPtr = layoutPtr[rightEdge].binNextPtr;
 		layoutPtr[rightEdge].binNextPtr = contentPtr;
@@ -2066,6 +2168,11 @@ ResolveConstraints(
 
 	    contentPtr->size = Tk_ReqHeight(contentPtr->tkwin) + contentPtr->padY
 		    + contentPtr->iPadY + contentPtr->doubleBw;
+	    if (contentPtr->numRows > 1
+		    && contentPtr->size != contentPtr->solvedHeight) {
+		spanChanged = 1;
+	    }
+	    contentPtr->solvedHeight = contentPtr->size;
 	    if (contentPtr->numRows > 1) {
 		contentPtr->binNextPtr = layoutPtr[rightEdge].binNextPtr;
 		layoutPtr[rightEdge].binNextPtr = contentPtr;
@@ -2080,6 +2187,44 @@ ResolveConstraints(
 	break;
     }
 
+    /*
+     * Only the content sizes may have changed since the last solve. Unless
+     * that moved the minimum of some slot or the size of some content
+     * spanning several slots, the cached offsets are still correct.
+     * Otherwise remember the new minimums and solve the whole axis again:
+     * the change cascades into the offsets of all the following slots, and
+     * through uniform groups into unrelated ones.
+     */
+
+    if (solvePtr->state == SOLVE_CHECK && !spanChanged) {
+	for (slot=0; slot < gridCount; slot++) {
+	    if (layoutPtr[slot].minSize != solvePtr->minPtr[slot]) {
+		break;
+	    }
+	}
+	if (slot == gridCount) {
+	    for (slot=0; slot < gridCount; slot++) {
+		slotPtr[slot].offset = solvePtr->offsetPtr[slot];
+	    }
+	    solvePtr->state = SOLVE_VALID;
+	    requiredSize = solvePtr->size;
+	    goto done;
+	}
+    }
+    if (maxOffset == 0) {
+	if (gridCount > solvePtr->space) {
+	    if (solvePtr->minPtr != NULL) {
+		Tcl_Free(solvePtr->minPtr);
+	    }
+	    solvePtr->space = gridCount;
+	    solvePtr->minPtr = (int *)Tcl_Alloc(sizeof(int) * 2 * gridCount);
+	    solvePtr->offsetPtr = solvePtr->minPtr + gridCount;
+	}
+	for (slot=0; slot < gridCount; slot++) {
+	    solvePtr->minPtr[slot] = layoutPtr[slot].minSize;
+	}
+    }
+
     /*
      * Step 2b.
      * Consider demands on uniform sizes.
@@ -2423,7 +2568,16 @@ ResolveConstraints(
     for (slot=0; slot < gridCount; slot++) {
 	slotPtr[slot].offset = layoutPtr[slot].minOffset;
     }
+    if (maxOffset == 0) {
+	for (slot=0; slot < gridCount; slot++) {
+	    solvePtr->offsetPtr[slot] = layoutPtr[slot].minOffset;
+	}
+	solvePtr->count = gridCount;
+	solvePtr->size = requiredSize;
+	solvePtr->state = SOLVE_VALID;
+    }
 
+  done:
     --layoutPtr;
     if (layoutPtr != layoutData) {
 	Tcl_Free(layoutPtr);
@@ -2503,6 +2657,8 @@ GetGrid(
     gridPtr->flags = 0;
     gridPtr->sticky = 0;
     gridPtr->size = 0;
+    gridPtr->solvedWidth = -1;
+    gridPtr->solvedHeight = -1;
     gridPtr->in = NULL;
     Tcl_SetHashValue(hPtr, gridPtr);
     Tk_CreateEventHandler(tkwin, StructureNotifyMask,
@@ -2584,6 +2740,9 @@ SetContentColumn(
 
     contentPtr->column = newColumn;
     contentPtr->numCols = newNumCols;
+    if (contentPtr->containerPtr != NULL) {
+	InvalidateSolve(contentPtr->containerPtr, COLUMN, SOLVE_INVALID);
+    }
     return TCL_OK;
 }
 
@@ -2625,6 +2784,9 @@ SetContentRow(
 
     contentPtr->row = newRow;
     contentPtr->numRows = newNumRows;
+    if (contentPtr->containerPtr != NULL) {
+	InvalidateSolve(contentPtr->containerPtr, ROW, SOLVE_INVALID);
+    }
     return TCL_OK;
 }
 
@@ -2753,11 +2915,51 @@ InitContainerData(
 	gridPtr->startX = 0;
 	gridPtr->startY = 0;
 	gridPtr->anchor = GRID_DEFAULT_ANCHOR;
+	memset(&gridPtr->columnSolve, 0, sizeof(GridSolve));
+	memset(&gridPtr->rowSolve, 0, sizeof(GridSolve));
 
 	memset(gridPtr->columnPtr, 0, size);
 	memset(gridPtr->rowPtr, 0, size);
     }
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * InvalidateSolve --
+ *
+ *	Lower the trust in the cached constraint solutions of a geometry
+ *	container, so that the next ArrangeGrid checks them again or solves
+ *	the affected axes from scratch.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The state of the row and/or column solutions is lowered to at most
+ *	state.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+InvalidateSolve(
+    Gridder *containerPtr,	/* Geometry container. */
+    int slotTypes,		/* COLUMN, ROW, or both OR-ed together. */
+    int state)			/* SOLVE_INVALID or SOLVE_CHECK. */
+{
+    GridContainer *gridPtr = containerPtr->containerDataPtr;
+
+    if (gridPtr == NULL) {
+	return;
+    }
+    if ((slotTypes & COLUMN) && (gridPtr->columnSolve.state > state)) {
+	gridPtr->columnSolve.state = state;
+    }
+    if ((slotTypes & ROW) && (gridPtr->rowSolve.state > state)) {
+	gridPtr->rowSolve.state = state;
+    }
+}
 
 /*
  *----------------------------------------------------------------------
@@ -2800,9 +3002,10 @@ Unlink(
 	    }
 	}
     }
+    InvalidateSolve(containerPtr, COLUMN|ROW, SOLVE_INVALID);
     if (!(containerPtr->flags & REQUESTED_RELAYOUT)) {
 	containerPtr->flags |= REQUESTED_RELAYOUT;
-	Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
     }
     if (containerPtr->abortPtr != NULL) {
 	*containerPtr->abortPtr = 1;
@@ -2852,9 +3055,6 @@ DestroyGrid(
 {
     Gridder *gridPtr = (Gridder *)memPtr;
 
-    if (gridPtr->flags & REQUESTED_RELAYOUT) {
-	Tcl_CancelIdleCall(ArrangeGrid, gridPtr);
-    }
     if (gridPtr->containerDataPtr != NULL) {
 	if (gridPtr->containerDataPtr->rowPtr != NULL) {
 	    Tcl_Free(gridPtr->containerDataPtr -> rowPtr);
@@ -2862,6 +3062,12 @@ DestroyGrid(
 	if (gridPtr->containerDataPtr->columnPtr != NULL) {
 	    Tcl_Free(gridPtr->containerDataPtr -> columnPtr);
 	}
+	if (gridPtr->containerDataPtr->columnSolve.minPtr != NULL) {
+	    Tcl_Free(gridPtr->containerDataPtr->columnSolve.minPtr);
+	}
+	if (gridPtr->containerDataPtr->rowSolve.minPtr != NULL) {
+	    Tcl_Free(gridPtr->containerDataPtr->rowSolve.minPtr);
+	}
 	Tcl_Free(gridPtr->containerDataPtr);
     }
     if (gridPtr->in != NULL) {
@@ -2901,14 +3107,16 @@ GridStructureProc(
 	if ((gridPtr->contentPtr != NULL)
 		&& !(gridPtr->flags & REQUESTED_RELAYOUT)) {
 	    gridPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, gridPtr);
+	    TkScheduleArrange(gridPtr->tkwin, ArrangeGrid, gridPtr);
 	}
 	if ((gridPtr->containerPtr != NULL) &&
 		(gridPtr->doubleBw != 2*Tk_Changes(gridPtr->tkwin)->border_width)) {
+	    InvalidateSolve(gridPtr->containerPtr, COLUMN|ROW, SOLVE_CHECK);
 	    if (!(gridPtr->containerPtr->flags & REQUESTED_RELAYOUT)) {
 		gridPtr->doubleBw = 2*Tk_Changes(gridPtr->tkwin)->border_width;
 		gridPtr->containerPtr->flags |= REQUESTED_RELAYOUT;
-		Tcl_DoWhenIdle(ArrangeGrid, gridPtr->containerPtr);
+		TkScheduleArrange(gridPtr->containerPtr->tkwin, ArrangeGrid,
+			gridPtr->containerPtr);
 	    }
 	}
     } else if (eventPtr->type == DestroyNotify) {
@@ -2928,7 +3136,8 @@ GridStructureProc(
 	Tcl_DeleteHashEntry(Tcl_FindHashEntry(&dispPtr->gridHashTable,
 		gridPtr->tkwin));
 	if (gridPtr->flags & REQUESTED_RELAYOUT) {
-	    Tcl_CancelIdleCall(ArrangeGrid, gridPtr);
+	    TkCancelArrange(gridPtr->tkwin, ArrangeGrid, gridPtr);
+	    gridPtr->flags &= ~REQUESTED_RELAYOUT;
 	}
 	gridPtr->tkwin = NULL;
 	Tcl_EventuallyFree(gridPtr, DestroyGrid);
@@ -2936,7 +3145,7 @@ GridStructureProc(
 	if ((gridPtr->contentPtr != NULL)
 		&& !(gridPtr->flags & REQUESTED_RELAYOUT)) {
 	    gridPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, gridPtr);
+	    TkScheduleArrange(gridPtr->tkwin, ArrangeGrid, gridPtr);
 	}
     } else if (eventPtr->type == UnmapNotify) {
 	Gridder *contentPtr;
@@ -3201,6 +3410,16 @@ ConfigureContent(
 	    continue;
 	}
 
+	/*
+	 * Any option may change the space the content needs, so the container
+	 * it is in has to be solved again.
+	 */
+
+	if (contentPtr->containerPtr != NULL) {
+	    InvalidateSolve(contentPtr->containerPtr, COLUMN|ROW,
+		    SOLVE_INVALID);
+	}
+
 	/*
 	 * The following statement is taken from tkPack.c:
 	 *
@@ -3466,12 +3685,13 @@ ConfigureContent(
 	 */
 
     scheduleLayout:
+	InvalidateSolve(containerPtr, COLUMN|ROW, SOLVE_INVALID);
 	if (containerPtr->abortPtr != NULL) {
 	    *containerPtr->abortPtr = 1;
 	}
 	if (!(containerPtr->flags & REQUESTED_RELAYOUT)) {
 	    containerPtr->flags |= REQUESTED_RELAYOUT;
-	    Tcl_DoWhenIdle(ArrangeGrid, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, ArrangeGrid, containerPtr);
 	}
     }
 
@@ -192,12 +192,12 @@ Tk_ImageObjCmd(
     Tcl_Obj *const objv[])	/* Argument strings. */
 {
     static const char *const imageOptions[] = {
-	"create", "delete", "height", "inuse", "names", "type", "types",
-	"width", NULL
+	"create", "delete", "height", "inuse", "load", "names", "type",
+	"types", "width", NULL
     };
     enum options {
-	IMAGE_CREATE, IMAGE_DELETE, IMAGE_HEIGHT, IMAGE_INUSE, IMAGE_NAMES,
-	IMAGE_TYPE, IMAGE_TYPES, IMAGE_WIDTH
+	IMAGE_CREATE, IMAGE_DELETE, IMAGE_HEIGHT, IMAGE_INUSE, IMAGE_LOAD,
+	IMAGE_NAMES, IMAGE_TYPE, IMAGE_TYPES, IMAGE_WIDTH
     };
     TkWindow *winPtr = (TkWindow *)clientData;
     Tcl_Size i, firstOption;
@@ -367,6 +367,8 @@ Tk_ImageObjCmd(
 	    DeleteImage((char *)modelPtr);
 	}
 	break;
+    case IMAGE_LOAD:
+	return TkPhotoLoadObjCmd(clientData, interp, objc, objv);
     case IMAGE_NAMES:
 	if (objc != 2) {
 	    Tcl_WrongNumArgs(interp, 2, objv, NULL);
@@ -492,6 +494,13 @@ Tk_ImageChanged(
     ImageModel *modelPtr = (ImageModel *) imageModel;
     Image *imagePtr;
 
+    /*
+     * Photo images decoded by "image load" worker threads have no model.
+     */
+
+    if (modelPtr == NULL) {
+	return;
+    }
     modelPtr->width = imageWidth;
     modelPtr->height = imageHeight;
     for (imagePtr = modelPtr->instancePtr; imagePtr != NULL;
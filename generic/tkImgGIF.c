@@ -68,8 +68,70 @@ typedef struct mFile {
     int c;			/* bits left over from previous character */
     int state;			/* decoder state (0-4 or GIF_DONE) */
     Tcl_Size length;			/* Total amount of bytes in data */
+    unsigned char *start;	/* Start of the source string. */
+    Tcl_Obj *dataObj;		/* Object holding the source string, if
+				 * known. */
 } MFile;
 
+/*
+ * Position in the source of a GIF image, as needed to get back to it later:
+ * for a file, the offset in the file; for inline data, the offset in the
+ * string, plus the state of the base64 decoder.
+ */
+
+typedef struct {
+    Tcl_WideInt offset;		/* Offset in the file or string. */
+    int c;			/* Base64 decoder bits left over. */
+    int state;			/* Base64 decoder state. */
+} GIFPosition;
+
+/*
+ * Index of the frames of a multi-frame GIF. Animations are usually played by
+ * reading each frame with "-index n"; the index records where each frame
+ * starts, so that such a read goes straight to the frame rather than
+ * scanning all the frames before it again, which made playing an animation
+ * quadratic in the number of frames. An index is built as frames are looked
+ * for, and kept for a few sources per thread.
+ */
+
+typedef struct {
+    GIFPosition position;	/* Position of the image separator. */
+    GIFGraphicControlExtensionBlock control;
+				/* Graphic control extension in scope for the
+				 * frame. */
+    Tcl_Obj *commentObj;	/* Comment read before the frame, or NULL. */
+} GIFFrame;
+
+typedef struct {
+    const unsigned char *dataBytes;
+				/* Start of the inline data indexed, or NULL.
+				 * Only compared, never dereferenced: no
+				 * reference is held on the object, so the
+				 * data may be gone. */
+    unsigned int fingerprint;	/* Hash of a sample of the inline data, to
+				 * tell it from other data later stored at
+				 * the same address. */
+    Tcl_Obj *pathObj;		/* Normalized name of the file indexed, or
+				 * NULL. */
+    Tcl_WideInt size;		/* Size of the file or inline data. */
+    Tcl_WideInt mtime;		/* Modification time of the file. */
+    int numFrames;		/* Number of frames found so far. */
+    int maxFrames;		/* Number of frames there is room for. */
+    bool complete;		/* Whether the end of the image was seen, so
+				 * numFrames is the number of frames. */
+    GIFFrame *frames;		/* Where each frame starts. */
+} GIFFrameIndex;
+
+#define GIF_INDEX_CACHE_SIZE	4
+
+typedef struct {
+    GIFFrameIndex indexes[GIF_INDEX_CACHE_SIZE];
+				/* Indexes of the last sources read. */
+    int nextIndex;		/* Slot for the next source. */
+    bool initialized;		/* Whether the exit handler is set up. */
+} ThreadSpecificData;
+static Tcl_ThreadDataKey dataKey;
+
 /*
  * Non-ASCII encoding support:
  * Most data in a GIF image is binary and is treated as such. However, a few
@@ -109,13 +171,6 @@ static const char GIF89a[] = {			/* ASCII GIF89a */
 typedef struct {
     const char *fromData;
     unsigned char workingBuffer[280];
-    struct {
-	int bytes;
-	int done;
-	unsigned int window;
-	int bitsInWindow;
-	unsigned char *c;
-    } reader;
 } GIFImageConfig;
 
 /*
@@ -193,20 +248,47 @@ static int		DoExtension(GIFImageConfig *gifConfPtr,
 			    GIFGraphicControlExtensionBlock
 			    *gifGraphicControlExtensionBlock,
 			    Tcl_Obj *metadataOutObj);
-static int		GetCode(Tcl_Channel chan, int code_size, int flag,
-			    GIFImageConfig *gifConfPtr);
 static int		GetDataBlock(GIFImageConfig *gifConfPtr,
 			    Tcl_Channel chan, unsigned char *buf);
 static int		ReadColorMap(GIFImageConfig *gifConfPtr,
 			    Tcl_Channel chan, int number,
 			    unsigned char buffer[MAXCOLORMAPSIZE][4]);
+static int		ReadGIF(Tcl_Interp *interp, Tcl_Channel chan,
+			    const char *fromData, const char *fileName,
+			    Tcl_Obj *format, Tk_PhotoHandle imageHandle,
+			    int destX, int destY, int width, int height,
+			    int srcX, int srcY, Tcl_Obj *metadataOutObj);
 static int		ReadGIFHeader(GIFImageConfig *gifConfPtr,
 			    Tcl_Channel chan, int *widthPtr, int *heightPtr);
 static int		ReadImage(GIFImageConfig *gifConfPtr,
 			    Tcl_Interp *interp, unsigned char *imagePtr,
 			    Tcl_Channel chan, int len, int rows,
-			    unsigned char cmap[MAXCOLORMAPSIZE][4], int srcX,
-			    int srcY, int interlace, int transparent);
+			    unsigned char cmap[MAXCOLORMAPSIZE][4],
+			    int interlace, int transparent);
+static int		SkipImage(GIFImageConfig *gifConfPtr,
+			    Tcl_Channel chan);
+static int		PutControlMetadata(Tcl_Interp *interp,
+			    GIFGraphicControlExtensionBlock *controlPtr,
+			    Tcl_Obj *metadataOutObj);
+
+/*
+ * Frame index support.
+ */
+
+static unsigned int	DataFingerprint(const unsigned char *bytes,
+			    Tcl_WideInt size);
+static void		FreeFrameIndex(GIFFrameIndex *indexPtr);
+static void		FreeFrameIndexes(void *clientData);
+static GIFFrameIndex *	GetFrameIndex(GIFImageConfig *gifConfPtr,
+			    Tcl_Channel chan, const char *fileName);
+static int		GetPosition(GIFImageConfig *gifConfPtr,
+			    Tcl_Channel chan, GIFPosition *posPtr);
+static void		RecordFrame(GIFFrameIndex *indexPtr,
+			    GIFPosition *posPtr,
+			    GIFGraphicControlExtensionBlock *controlPtr,
+			    Tcl_Obj *metadataObj);
+static int		SetPosition(GIFImageConfig *gifConfPtr,
+			    Tcl_Channel chan, GIFPosition *posPtr);
 
 /*
  * these are for the BASE64 image reader code only
@@ -420,14 +502,100 @@ FileReadGIF(
     int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
 				 * image being read. */
     Tcl_Obj *metadataOutObj)	/* metadata return dict, may be NULL */
+{
+    return ReadGIF(interp, chan, NULL, fileName, format, imageHandle,
+	    destX, destY, width, height, srcX, srcY, metadataOutObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkReadMappedGIF --
+ *
+ *	This function is called by the photo image type to read a large GIF
+ *	file that it has mapped into memory, in place of FileReadGIF. The
+ *	mapped file is read like binary -data, but frame indexes are still
+ *	kept by file name, so they are shared with reads through a channel.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	New data is added to the image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkReadMappedGIF(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    const unsigned char *data,	/* The contents of the image file. */
+    Tcl_Size length,		/* Number of bytes in data. */
+    const char *fileName,	/* The name of the image file. */
+    Tcl_Obj *format,		/* User-specified format object, or NULL. */
+    TCL_UNUSED(Tcl_Obj *),	/* metadata input, may be NULL */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj *metadataOutObj)	/* metadata return dict, may be NULL */
+{
+    MFile handle;
+
+    mInit((unsigned char *) data, &handle, length);
+    return ReadGIF(interp, (Tcl_Channel) &handle, INLINE_DATA_BINARY,
+	    fileName, format, imageHandle, destX, destY, width, height, srcX,
+	    srcY, metadataOutObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadGIF --
+ *
+ *	Reads GIF format data from a file or from inline data, and writes it
+ *	into a given photo image.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	The read position in chan is changed, and new data is added to the
+ *	image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadGIF(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Channel chan,		/* The image file, or the MFile holding the
+				 * data. */
+    const char *fromData,	/* INLINE_DATA_BINARY or INLINE_DATA_BASE64
+				 * if chan is an MFile, otherwise NULL. */
+    const char *fileName,	/* The name of the image file, or NULL for
+				 * -data. */
+    Tcl_Obj *format,		/* User-specified format object, or NULL. */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj *metadataOutObj)	/* metadata return dict, may be NULL */
 {
     int fileWidth, fileHeight, imageWidth, imageHeight;
     unsigned int nBytes;
-    int index = 0, result = TCL_ERROR;
+    int index = 0, frameNum = 0, result = TCL_ERROR;
     Tcl_Size objc = 0, i;
     Tcl_Obj **objv;
     unsigned char buf[100];
-    unsigned char *trashBuffer = NULL;
     int bitPixel;
     int gifLabel;
     unsigned char colorMap[MAXCOLORMAPSIZE][4];
@@ -436,17 +604,17 @@ FileReadGIF(
 	"-index", NULL
     };
     GIFImageConfig gifConf, *gifConfPtr = &gifConf;
+    GIFFrameIndex *indexPtr = NULL;
+    GIFPosition position, startPosition;
+    Tcl_Obj *scanMetadataObj = metadataOutObj, *commentKeyObj = NULL;
+    const char *pathName = NULL;
 
     gifGraphicControlExtensionBlock.blockPresent = false;
-    /*
-     * Decode the magic used to convey when we're sourcing data from a string
-     * source and not a file.
-     */
-
     memset(colorMap, 0, MAXCOLORMAPSIZE*4);
     memset(gifConfPtr, 0, sizeof(GIFImageConfig));
-    if (fileName == INLINE_DATA_BINARY || fileName == INLINE_DATA_BASE64) {
-	gifConfPtr->fromData = fileName;
+    gifConfPtr->fromData = fromData;
+    pathName = fileName;
+    if (fileName == NULL) {
 	fileName = "inline data";
     }
 
@@ -550,16 +718,81 @@ FileReadGIF(
      */
 
     /*
-     * Search for the frame from the GIF to display.
+     * Search for the frame from the GIF to display. If it is not the first,
+     * start from the closest frame found by an earlier read of the same
+     * source, and note where the frames met on the way start.
      */
 
+    if (index > 0) {
+	indexPtr = GetFrameIndex(gifConfPtr, chan, pathName);
+    }
+    if (indexPtr != NULL) {
+	if (GetPosition(gifConfPtr, chan, &startPosition) != TCL_OK) {
+	    indexPtr = NULL;
+	} else if (indexPtr->complete && index >= indexPtr->numFrames) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "no image data for this index", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "NO_DATA",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+    if (indexPtr != NULL) {
+	if (scanMetadataObj == NULL) {
+	    scanMetadataObj = Tcl_NewDictObj();
+	    Tcl_IncrRefCount(scanMetadataObj);
+	}
+	frameNum = indexPtr->numFrames - 1;
+	if (frameNum > index) {
+	    frameNum = index;
+	}
+	if (frameNum > 0) {
+	    GIFFrame *framePtr = &indexPtr->frames[frameNum];
+
+	    if ((SetPosition(gifConfPtr, chan, &framePtr->position) == TCL_OK)
+		    && (Fread(gifConfPtr, buf, 1, 1, chan) == 1)
+		    && (buf[0] == GIF_START)
+		    && (SetPosition(gifConfPtr, chan,
+			    &framePtr->position) == TCL_OK)) {
+		gifGraphicControlExtensionBlock = framePtr->control;
+		if (framePtr->commentObj != NULL) {
+		    commentKeyObj = Tcl_NewStringObj("comment", TCL_INDEX_NONE);
+		    Tcl_IncrRefCount(commentKeyObj);
+		    Tcl_DictObjPut(NULL, scanMetadataObj, commentKeyObj,
+			    framePtr->commentObj);
+		}
+	    } else {
+		/*
+		 * The source doesn't match the index after all: start again
+		 * from the first frame.
+		 */
+
+		FreeFrameIndex(indexPtr);
+		indexPtr = NULL;
+		frameNum = 0;
+		if (SetPosition(gifConfPtr, chan, &startPosition) != TCL_OK) {
+		    goto error;
+		}
+	    }
+	} else {
+	    frameNum = 0;
+	}
+    }
+
     while (true) {
+	if (indexPtr != NULL
+		&& GetPosition(gifConfPtr, chan, &position) != TCL_OK) {
+	    goto error;
+	}
 	if (-1 == (gifLabel = ReadOneByte( interp, gifConfPtr, chan ) ) ) {
 	    goto error;
 	}
 
 	switch (gifLabel) {
 	case GIF_TERMINATOR:
+	    if (indexPtr != NULL) {
+		indexPtr->complete = true;
+	    }
 	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
 		    "no image data for this index", TCL_INDEX_NONE));
 	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "NO_DATA",
@@ -576,7 +809,7 @@ FileReadGIF(
 	    }
 	    if (DoExtension(gifConfPtr, chan, gifLabel,
 		    gifConfPtr->workingBuffer, &gifGraphicControlExtensionBlock,
-		    metadataOutObj)
+		    scanMetadataObj)
 		    < 0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"error reading extension in GIF image", TCL_INDEX_NONE));
@@ -586,6 +819,10 @@ FileReadGIF(
 	    }
 	    continue;
 	case GIF_START:
+	    if (indexPtr != NULL && frameNum == indexPtr->numFrames) {
+		RecordFrame(indexPtr, &position,
+			&gifGraphicControlExtensionBlock, scanMetadataObj);
+	    }
 	    if (Fread(gifConfPtr, buf, 1, 9, chan) != 9) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"couldn't read left/top/width/height in GIF image",
@@ -612,13 +849,14 @@ FileReadGIF(
 	imageHeight = LM_to_uint(buf[6], buf[7]);
 	bitPixel = 1 << ((buf[8] & 0x07) + 1);
 
-	if (index--) {
+	if (frameNum < index) {
 	    /*
-	     * This is not the GIF frame we want to read: skip it.
+	     * This is not the GIF frame we want to read: skip it, without
+	     * decoding it.
 	     */
 
 	    if (BitSet(buf[8], LOCALCOLORMAP)) {
-		if (!ReadColorMap(gifConfPtr, chan, bitPixel, colorMap)) {
+		if (!ReadColorMap(gifConfPtr, chan, bitPixel, NULL)) {
 		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			    "error reading color map", TCL_INDEX_NONE));
 		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF",
@@ -626,41 +864,11 @@ FileReadGIF(
 		    goto error;
 		}
 	    }
-
-	    /*
-	     * If we've not yet allocated a trash buffer, do so now.
-	     */
-
-	    if (trashBuffer == NULL) {
-		if (fileWidth > (int)((UINT_MAX/3)/fileHeight)) {
-		    goto error;
-		}
-		nBytes = fileWidth * fileHeight * 3;
-		trashBuffer = (unsigned char *)Tcl_Alloc(nBytes);
-		if (trashBuffer) {
-		    memset(trashBuffer, 0, nBytes);
-		}
-	    }
-
-	    /*
-	     * Slurp! Process the data for this image and stuff it in a trash
-	     * buffer.
-	     *
-	     * Yes, it might be more efficient here to *not* store the data
-	     * (we're just going to throw it away later). However, I elected
-	     * to implement it this way for good reasons. First, I wanted to
-	     * avoid duplicating the (fairly complex) LWZ decoder in
-	     * ReadImage. Fine, you say, why didn't you just modify it to
-	     * allow the use of a NULL specifier for the output buffer? I
-	     * tried that, but it negatively impacted the performance of what
-	     * I think will be the common case: reading the first image in the
-	     * file. Rather than marginally improve the speed of the less
-	     * frequent case, I chose to maintain high performance for the
-	     * common case.
-	     */
-
-	    if (ReadImage(gifConfPtr, interp, trashBuffer, chan, imageWidth,
-		    imageHeight, colorMap, 0, 0, 0, -1) != TCL_OK) {
+	    if (SkipImage(gifConfPtr, chan) != TCL_OK) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"premature end of image data", TCL_INDEX_NONE));
+		Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "PREMATURE_END",
+			(char *)NULL);
 		goto error;
 	    }
 
@@ -669,6 +877,7 @@ FileReadGIF(
 	     * data should be cleared
 	     */
 	    gifGraphicControlExtensionBlock.blockPresent = false;
+	    frameNum++;
 
 	    continue;
 	}
@@ -750,7 +959,7 @@ FileReadGIF(
 
 	block.pixelPtr = pixelPtr;
 	if (ReadImage(gifConfPtr, interp, block.pixelPtr, chan, imageWidth,
-		imageHeight, colorMap, srcX, srcY, BitSet(buf[8], INTERLACE),
+		imageHeight, colorMap, BitSet(buf[8], INTERLACE),
 		transparent) != TCL_OK) {
 	    Tcl_Free(pixelPtr);
 	    goto error;
@@ -793,64 +1002,33 @@ FileReadGIF(
 	 * dictionary
 	 */
 
-	if (gifGraphicControlExtensionBlock.blockPresent) {
-	    if ( gifGraphicControlExtensionBlock.delayTime != 0) {
-		if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
-			Tcl_NewStringObj("delay time",-1),
-			Tcl_NewIntObj(gifGraphicControlExtensionBlock.delayTime)
-			)) {
-		    result = TCL_ERROR;
-		    goto error;
-		}
-	    }
-	    switch ( gifGraphicControlExtensionBlock.disposalMethod ) {
-	    case 1: /* Do not dispose */
-		if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
-			Tcl_NewStringObj("disposal method",-1),
-			Tcl_NewStringObj("do not dispose",-1))) {
-		    result = TCL_ERROR;
-		    goto error;
-		}
-		break;
-	    case 2: /* Restore to background color */
-		if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
-			Tcl_NewStringObj("disposal method",-1),
-			Tcl_NewStringObj("restore to background color",-1))) {
-		    result = TCL_ERROR;
-		    goto error;
-		}
-		break;
-	    case 3: /* Restore to previous */
-		if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
-			Tcl_NewStringObj("disposal method",-1),
-			Tcl_NewStringObj("restore to previous",-1))) {
-		    result = TCL_ERROR;
-		    goto error;
-		}
-		break;
-	    }
-	    if ( gifGraphicControlExtensionBlock.userInteraction != 0) {
-		if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
-			Tcl_NewStringObj("user interaction",-1),
-			Tcl_NewBooleanObj(1))) {
-		    result = TCL_ERROR;
-		    goto error;
-		}
-	    }
+	if (PutControlMetadata(interp, &gifGraphicControlExtensionBlock,
+		metadataOutObj) != TCL_OK) {
+	    goto error;
 	}
     }
 
     /*
      * We've successfully read the GIF frame (or there was nothing to read,
-     * which suits as well). We're done.
+     * which suits as well). We're done. Reading on to the end of the frame
+     * finds where the next one starts, which is noted in the index for when
+     * it is asked for.
      */
 
+    gifGraphicControlExtensionBlock.blockPresent = false;
     while (true) {
+	if (indexPtr != NULL
+		&& GetPosition(gifConfPtr, chan, &position) != TCL_OK) {
+	    goto error;
+	}
 	if (-1 == (gifLabel = ReadOneByte( interp, gifConfPtr, chan ) ) ) {
 	    goto error;
 	}
 	switch (gifLabel) {
 	case GIF_TERMINATOR:
+	    if (indexPtr != NULL && frameNum + 1 == indexPtr->numFrames) {
+		indexPtr->complete = true;
+	    }
 	    break;
 
 	case GIF_EXTENSION:
@@ -863,7 +1041,7 @@ FileReadGIF(
 	    }
 	    if (DoExtension(gifConfPtr, chan, gifLabel,
 		    gifConfPtr->workingBuffer, &gifGraphicControlExtensionBlock,
-		    metadataOutObj)
+		    scanMetadataObj)
 		    < 0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"error reading extension in GIF image", TCL_INDEX_NONE));
@@ -876,6 +1054,11 @@ FileReadGIF(
 	    /*
 	     * There should not be a second image block - bail out without error
 	     */
+
+	    if (indexPtr != NULL && frameNum + 1 == indexPtr->numFrames) {
+		RecordFrame(indexPtr, &position,
+			&gifGraphicControlExtensionBlock, scanMetadataObj);
+	    }
 	    break;
 	default:
 	    /*
@@ -891,13 +1074,11 @@ FileReadGIF(
     result = TCL_OK;
 
 error:
-
-    /*
-     * If a trash buffer has been allocated, free it now.
-     */
-
-    if (trashBuffer != NULL) {
-	Tcl_Free(trashBuffer);
+    if (scanMetadataObj != metadataOutObj) {
+	Tcl_DecrRefCount(scanMetadataObj);
+    }
+    if (commentKeyObj != NULL) {
+	Tcl_DecrRefCount(commentKeyObj);
     }
     return result;
 }
@@ -941,6 +1122,73 @@ ReadOneByte(
     return buf[0];
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PutControlMetadata --
+ *
+ *	Copies the data of a Graphic Control Extension Block to a metadata
+ *	dictionary.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Keys are added to the dictionary.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PutControlMetadata(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    GIFGraphicControlExtensionBlock *controlPtr,
+				/* The block to copy. */
+    Tcl_Obj *metadataOutObj)	/* metadata return dict */
+{
+    if (controlPtr->blockPresent) {
+	if ( controlPtr->delayTime != 0) {
+	    if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
+		    Tcl_NewStringObj("delay time",-1),
+		    Tcl_NewIntObj(controlPtr->delayTime)
+		    )) {
+		return TCL_ERROR;
+	    }
+	}
+	switch ( controlPtr->disposalMethod ) {
+	case 1: /* Do not dispose */
+	    if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
+		    Tcl_NewStringObj("disposal method",-1),
+		    Tcl_NewStringObj("do not dispose",-1))) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case 2: /* Restore to background color */
+	    if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
+		    Tcl_NewStringObj("disposal method",-1),
+		    Tcl_NewStringObj("restore to background color",-1))) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case 3: /* Restore to previous */
+	    if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
+		    Tcl_NewStringObj("disposal method",-1),
+		    Tcl_NewStringObj("restore to previous",-1))) {
+		return TCL_ERROR;
+	    }
+	    break;
+	}
+	if ( controlPtr->userInteraction != 0) {
+	    if ( TCL_OK != Tcl_DictObjPut(interp, metadataOutObj,
+		    Tcl_NewStringObj("user interaction",-1),
+		    Tcl_NewBooleanObj(1))) {
+		return TCL_ERROR;
+	    }
+	}
+    }
+    return TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1034,7 +1282,7 @@ StringReadGIF(
     Tcl_Interp *interp,		/* interpreter for reporting errors in */
     Tcl_Obj *dataObj,		/* object containing the image */
     Tcl_Obj *format,		/* format object, or NULL */
-    Tcl_Obj *metadataInObj,	/* metadata input, may be NULL */
+    TCL_UNUSED(Tcl_Obj *),	/* metadata input, may be NULL */
     Tk_PhotoHandle imageHandle,	/* the image to write this data into */
     int destX, int destY,	/* The rectangular region of the */
     int width, int height,	/* image to copy */
@@ -1047,6 +1295,7 @@ StringReadGIF(
     unsigned char *data = Tcl_GetByteArrayFromObj(dataObj, &length);
 
     mInit(data, hdlPtr, length);
+    hdlPtr->dataObj = dataObj;
 
     /*
      * Check whether the data is Base64 encoded by doing a character-by-
@@ -1067,71 +1316,301 @@ StringReadGIF(
      * pseudo-channel to pull the data from.
      */
 
-    return FileReadGIF(interp, (Tcl_Channel) hdlPtr, xferFormat, format,
-	    metadataInObj, imageHandle, destX, destY, width, height, srcX, srcY,
+    return ReadGIF(interp, (Tcl_Channel) hdlPtr, xferFormat, NULL, format,
+	    imageHandle, destX, destY, width, height, srcX, srcY,
 	    metadataOutObj);
 }
 
 /*
  *----------------------------------------------------------------------
  *
- * ReadGIFHeader --
+ * TkGifReadFrames --
  *
- *	This function reads the GIF header from the beginning of a GIF file
- *	and returns the dimensions of the image.
+ *	Decodes all the frames of a GIF image in one pass, for animation
+ *	players, which otherwise have to read the image once per frame with
+ *	"-index". The data may be binary or base64 encoded, as for the -data
+ *	option of photo images. For each frame, proc is called with the
+ *	frame's pixels, its position in the logical screen, and a metadata
+ *	dictionary like the one photo images get when reading the frame.
  *
  * Results:
- *	The return value is 1 if file "f" appears to start with a valid GIF
- *	header, 0 otherwise. If the header is valid, then *widthPtr and
- *	*heightPtr are modified to hold the dimensions of the image.
+ *	A standard Tcl result. If proc returns anything but TCL_OK, decoding
+ *	stops and that is returned.
  *
  * Side effects:
- *	The access position in f advances.
+ *	Whatever proc does.
  *
  *----------------------------------------------------------------------
  */
 
-static int
-ReadGIFHeader(
-    GIFImageConfig *gifConfPtr,
-    Tcl_Channel chan,		/* Image file to read the header from */
-    int *widthPtr, int *heightPtr)
-				/* The dimensions of the image are returned
-				 * here. */
+int
+TkGifReadFrames(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Obj *dataObj,		/* The GIF data. */
+    TkGifFrameProc *proc,	/* Function to call for each frame. */
+    void *clientData)		/* Arbitrary value to pass to proc. */
 {
-    unsigned char buf[7];
+    MFile handle;
+    Tcl_Channel chan = (Tcl_Channel) &handle;
+    GIFImageConfig gifConf, *gifConfPtr = &gifConf;
+    GIFGraphicControlExtensionBlock control;
+    unsigned char globalMap[MAXCOLORMAPSIZE][4], colorMap[MAXCOLORMAPSIZE][4];
+    unsigned char buf[10], *data, *pixelPtr = NULL;
+    size_t bufferSize = 0, nBytes;
+    Tcl_Size length;
+    Tcl_Obj *metadataObj = NULL;
+    Tk_PhotoImageBlock block;
+    int fileWidth, fileHeight, gifLabel, frameNum = 0, transparent;
+    int result = TCL_ERROR;
 
-    if ((Fread(gifConfPtr, buf, 1, 6, chan) != 6)
-	    || ((strncmp(GIF87a, (char *) buf, 6) != 0)
-	    && (strncmp(GIF89a, (char *) buf, 6) != 0))) {
-	return 0;
+    data = Tcl_GetByteArrayFromObj(dataObj, &length);
+    if (data == NULL) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"couldn't read GIF header from file \"inline data\"",
+		TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "HEADER",
+		(char *)NULL);
+	return TCL_ERROR;
     }
-
-    if (Fread(gifConfPtr, buf, 1, 4, chan) != 4) {
-	return 0;
+    mInit(data, &handle, length);
+    handle.dataObj = dataObj;
+    memset(gifConfPtr, 0, sizeof(GIFImageConfig));
+    memset(globalMap, 0, sizeof(globalMap));
+    control.blockPresent = false;
+    if (length >= 6 && (!strncmp(GIF87a, (char *) data, 6)
+	    || !strncmp(GIF89a, (char *) data, 6))) {
+	gifConfPtr->fromData = INLINE_DATA_BINARY;
+    } else {
+	gifConfPtr->fromData = INLINE_DATA_BASE64;
     }
 
-    *widthPtr = LM_to_uint(buf[0], buf[1]);
-    *heightPtr = LM_to_uint(buf[2], buf[3]);
-    return 1;
-}
-
-/*
- *-----------------------------------------------------------------
- * The code below is copied from the giftoppm program and modified just
- * slightly.
- *-----------------------------------------------------------------
- */
-
-static int
-ReadColorMap(
-    GIFImageConfig *gifConfPtr,
-    Tcl_Channel chan,
-    int number,
-    unsigned char buffer[MAXCOLORMAPSIZE][4])
-{
-    int i;
-    unsigned char rgb[3];
+    if (!ReadGIFHeader(gifConfPtr, chan, &fileWidth, &fileHeight)) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"couldn't read GIF header from file \"inline data\"",
+		TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "HEADER",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+    if (Fread(gifConfPtr, buf, 1, 3, chan) != 3) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"GIF file truncated", TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "TRUNCATED",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+    if (BitSet(buf[0], LOCALCOLORMAP)
+	    && !ReadColorMap(gifConfPtr, chan, 2 << (buf[0] & 0x07),
+		    globalMap)) {
+	goto colorMapError;
+    }
+
+    metadataObj = Tcl_NewDictObj();
+    Tcl_IncrRefCount(metadataObj);
+    while (true) {
+	if (-1 == (gifLabel = ReadOneByte(interp, gifConfPtr, chan))) {
+	    goto error;
+	}
+	switch (gifLabel) {
+	case GIF_TERMINATOR:
+	    result = TCL_OK;
+	    goto error;
+	case GIF_EXTENSION:
+	    if (-1 == (gifLabel = ReadOneByte(interp, gifConfPtr, chan))) {
+		goto error;
+	    }
+	    if (DoExtension(gifConfPtr, chan, gifLabel,
+		    gifConfPtr->workingBuffer, &control, metadataObj) < 0) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"error reading extension in GIF image", TCL_INDEX_NONE));
+		Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "BAD_EXT",
+			(char *)NULL);
+		goto error;
+	    }
+	    continue;
+	case GIF_START:
+	    break;
+	default:
+	    continue;
+	}
+
+	if (Fread(gifConfPtr, buf, 1, 9, chan) != 9) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "couldn't read left/top/width/height in GIF image",
+		    TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "DIMENSIONS",
+		    (char *)NULL);
+	    goto error;
+	}
+
+	/*
+	 * Each frame gets its own copy of the color map, as decoding makes
+	 * the transparent color transparent in it.
+	 */
+
+	memcpy(colorMap, globalMap, sizeof(colorMap));
+	if (BitSet(buf[8], LOCALCOLORMAP)
+		&& !ReadColorMap(gifConfPtr, chan, 1 << ((buf[8] & 0x07) + 1),
+			colorMap)) {
+	    goto colorMapError;
+	}
+	transparent = control.blockPresent ? control.transparent : -1;
+	block.width = LM_to_uint(buf[4], buf[5]);
+	block.height = LM_to_uint(buf[6], buf[7]);
+
+	/*
+	 * A frame without pixels can't be decoded, but still counts, so that
+	 * frame numbers agree with the -index option.
+	 */
+
+	if (block.width <= 0 || block.height <= 0) {
+	    if (SkipImage(gifConfPtr, chan) != TCL_OK) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"premature end of image data", TCL_INDEX_NONE));
+		Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF",
+			"PREMATURE_END", (char *)NULL);
+		goto error;
+	    }
+	    control.blockPresent = false;
+	    Tcl_DecrRefCount(metadataObj);
+	    metadataObj = Tcl_NewDictObj();
+	    Tcl_IncrRefCount(metadataObj);
+	    frameNum++;
+	    continue;
+	}
+	block.pixelSize = (transparent >= 0) ? 4 : 3;
+	block.pitch = block.pixelSize * block.width;
+	block.offset[0] = 0;
+	block.offset[1] = 1;
+	block.offset[2] = 2;
+	block.offset[3] = (transparent >= 0) ? 3 : 0;
+
+	/*
+	 * The pixel buffer is reused from frame to frame.
+	 */
+
+	nBytes = (size_t) block.pitch * block.height;
+	if (nBytes > bufferSize) {
+	    unsigned char *newPtr = (unsigned char *)
+		    Tcl_AttemptRealloc(pixelPtr, nBytes);
+
+	    if (newPtr == NULL) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"not enough free memory for image buffer",
+			TCL_INDEX_NONE));
+		Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
+		goto error;
+	    }
+	    pixelPtr = newPtr;
+	    bufferSize = nBytes;
+	}
+	if (nBytes > 0) {
+	    memset(pixelPtr, 0, nBytes);
+	}
+	block.pixelPtr = pixelPtr;
+	if (ReadImage(gifConfPtr, interp, pixelPtr, chan, block.width,
+		block.height, colorMap, BitSet(buf[8], INTERLACE),
+		transparent) != TCL_OK) {
+	    goto error;
+	}
+
+	if (PutControlMetadata(interp, &control, metadataObj) != TCL_OK) {
+	    goto error;
+	}
+	result = proc(clientData, frameNum, LM_to_uint(buf[0], buf[1]),
+		LM_to_uint(buf[2], buf[3]), &block, metadataObj);
+	if (result != TCL_OK) {
+	    goto error;
+	}
+	result = TCL_ERROR;
+
+	/*
+	 * The next frame starts a new scope for extensions.
+	 */
+
+	control.blockPresent = false;
+	Tcl_DecrRefCount(metadataObj);
+	metadataObj = Tcl_NewDictObj();
+	Tcl_IncrRefCount(metadataObj);
+	frameNum++;
+    }
+
+  colorMapError:
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "error reading color map", TCL_INDEX_NONE));
+    Tcl_SetErrorCode(interp, "TK", "IMAGE", "GIF", "COLOR_MAP",
+	    (char *)NULL);
+
+  error:
+    if (metadataObj != NULL) {
+	Tcl_DecrRefCount(metadataObj);
+    }
+    if (pixelPtr != NULL) {
+	Tcl_Free(pixelPtr);
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadGIFHeader --
+ *
+ *	This function reads the GIF header from the beginning of a GIF file
+ *	and returns the dimensions of the image.
+ *
+ * Results:
+ *	The return value is 1 if file "f" appears to start with a valid GIF
+ *	header, 0 otherwise. If the header is valid, then *widthPtr and
+ *	*heightPtr are modified to hold the dimensions of the image.
+ *
+ * Side effects:
+ *	The access position in f advances.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadGIFHeader(
+    GIFImageConfig *gifConfPtr,
+    Tcl_Channel chan,		/* Image file to read the header from */
+    int *widthPtr, int *heightPtr)
+				/* The dimensions of the image are returned
+				 * here. */
+{
+    unsigned char buf[7];
+
+    if ((Fread(gifConfPtr, buf, 1, 6, chan) != 6)
+	    || ((strncmp(GIF87a, (char *) buf, 6) != 0)
+	    && (strncmp(GIF89a, (char *) buf, 6) != 0))) {
+	return 0;
+    }
+
+    if (Fread(gifConfPtr, buf, 1, 4, chan) != 4) {
+	return 0;
+    }
+
+    *widthPtr = LM_to_uint(buf[0], buf[1]);
+    *heightPtr = LM_to_uint(buf[2], buf[3]);
+    return 1;
+}
+
+/*
+ *-----------------------------------------------------------------
+ * The code below is copied from the giftoppm program and modified just
+ * slightly.
+ *-----------------------------------------------------------------
+ */
+
+static int
+ReadColorMap(
+    GIFImageConfig *gifConfPtr,
+    Tcl_Channel chan,
+    int number,
+    unsigned char buffer[MAXCOLORMAPSIZE][4])
+{
+    int i;
+    unsigned char rgb[3];
 
     for (i = 0; i < number; ++i) {
 	if (Fread(gifConfPtr, rgb, sizeof(rgb), 1, chan) <= 0) {
@@ -1292,15 +1771,13 @@ GetDataBlock(
  *	Process a GIF image from a given source, with a given height, width,
  *	transparency, etc.
  *
- *	This code is based on the code found in the ImageMagick GIF decoder,
- *	which is © 2000 ImageMagick Studio.
- *
- *	Some thoughts on our implementation:
- *	It sure would be nice if ReadImage didn't take 11 parameters! I think
- *	that if we were smarter, we could avoid doing that.
- *
- *	Possible further optimizations: we could pull the GetCode function
- *	directly into ReadImage, which would improve our speed.
+ *	The decoder keeps, for each code of the LZW table, the code of its
+ *	prefix, its last pixel, its first pixel and its length. The string of
+ *	pixels for a code can then be written straight into the image,
+ *	back to front along the prefix chain, without going through a stack
+ *	unless it runs across the end of a row. Codes are read from a bit
+ *	window that is refilled a byte at a time from the data sub-blocks.
+ *	Nothing is allocated: the tables live on the C stack.
  *
  * Results:
  *	Processes a GIF image and loads the pixel data into a memory array.
@@ -1315,26 +1792,29 @@ static int
 ReadImage(
     GIFImageConfig *gifConfPtr,
     Tcl_Interp *interp,
-    unsigned char *imagePtr,
+    unsigned char *imagePtr,	/* Where to put the pixels. */
     Tcl_Channel chan,
-    int len, int rows,
+    int len, int rows,		/* Size of the image. */
     unsigned char cmap[MAXCOLORMAPSIZE][4],
-    TCL_UNUSED(int),
-    TCL_UNUSED(int),
-    int interlace,
-    int transparent)
+    int interlace,		/* Whether the rows are interlaced. */
+    int transparent)		/* Transparent color index, or -1. */
 {
     unsigned char initialCodeSize;
-    int xpos = 0, ypos = 0, pass = 0, i, count;
-    unsigned char *pixelPtr;
+    int xpos = 0, ypos = 0, pass = 0, rowsLeft = rows, i, count;
+    int pixelSize = (transparent >= 0) ? 4 : 3;
+    int pitch = len * pixelSize;
+    unsigned char *pixelPtr, *bytePtr = NULL, *top, *colorPtr;
     static const int interlaceStep[] = { 8, 8, 4, 2 };
     static const int interlaceStart[] = { 0, 4, 2, 1 };
     unsigned short prefix[(1 << MAX_LWZ_BITS)];
-    unsigned char append[(1 << MAX_LWZ_BITS)];
-    unsigned char stack[(1 << MAX_LWZ_BITS)*2];
-    unsigned char *top;
-    int codeSize, clearCode, inCode, endCode, oldCode, maxCode;
-    int code, firstCode, v;
+    unsigned short length[(1 << MAX_LWZ_BITS)];
+    unsigned char suffix[(1 << MAX_LWZ_BITS)];
+    unsigned char first[(1 << MAX_LWZ_BITS)];
+    unsigned char stack[(1 << MAX_LWZ_BITS)];
+    int codeSize, clearCode, endCode, oldCode, nextCode, code, c;
+    unsigned int window = 0;
+    int bitsInWindow = 0, bytesLeft = 0;
+    bool dataDone = false;
 
     /*
      * Initialize the decoder
@@ -1369,180 +1849,192 @@ ReadImage(
      * clear code	reset the decoder
      * end code		stop decoding
      * code size	size of the next code to retrieve
-     * max code		next available table position
+     * next code	next available table position
      */
 
     clearCode = 1 << (int) initialCodeSize;
     endCode = clearCode + 1;
     codeSize = (int) initialCodeSize + 1;
-    maxCode = clearCode + 2;
+    nextCode = clearCode + 2;
     oldCode = -1;
-    firstCode = -1;
 
-    memset(prefix, 0, (1 << MAX_LWZ_BITS) * sizeof(short));
-    memset(append, 0, (1 << MAX_LWZ_BITS) * sizeof(char));
-    for (i = 0; i < clearCode; i++) {
-	append[i] = i;
+    for (i = 0; i < clearCode && i < (1 << MAX_LWZ_BITS); i++) {
+	prefix[i] = 0;
+	suffix[i] = first[i] = (unsigned char) i;
+	length[i] = 1;
     }
-    top = stack;
-
-    GetCode(chan, 0, 1, gifConfPtr);
 
     /*
      * Read until we finish the image
      */
 
-    for (i = 0, ypos = 0; i < rows; i++) {
-	for (xpos = 0; xpos < len; ) {
-	    if (top == stack) {
-		/*
-		 * Bummer - our stack is empty. Now we have to work!
-		 */
-
-		code = GetCode(chan, codeSize, 0, gifConfPtr);
-		if (code < 0) {
-		    return TCL_OK;
-		}
-
-		if (code > maxCode || code == endCode) {
-		    /*
-		     * If we're doing things right, we should never receive a
-		     * code that is greater than our current maximum code. If
-		     * we do, bail, because our decoder does not yet have that
-		     * code set up.
-		     *
-		     * If the code is the magic endCode value, quit.
-		     */
-
-		    return TCL_OK;
-		}
-
-		if (code == clearCode) {
-		    /*
-		     * Reset the decoder.
-		     */
+    while (rowsLeft > 0) {
+	/*
+	 * Get the next code from the bit window, refilling it from the data
+	 * sub-blocks as needed.
+	 */
 
-		    codeSize = initialCodeSize + 1;
-		    maxCode = clearCode + 2;
-		    oldCode = -1;
-		    continue;
+	while (bitsInWindow < codeSize) {
+	    if (bytesLeft == 0) {
+		count = GetDataBlock(gifConfPtr, chan, gifConfPtr->workingBuffer);
+		if (count <= 0) {
+		    dataDone = true;
+		    goto done;
 		}
+		bytePtr = gifConfPtr->workingBuffer;
+		bytesLeft = count;
+	    }
+	    window |= (unsigned int) *bytePtr++ << bitsInWindow;
+	    bitsInWindow += 8;
+	    bytesLeft--;
+	}
+	code = window & ((1 << codeSize) - 1);
+	window >>= codeSize;
+	bitsInWindow -= codeSize;
 
-		if (oldCode == -1) {
-		    /*
-		     * Last pass reset the decoder, so the first code we see
-		     * must be a singleton. Seed the stack with it, and set up
-		     * the old/first code pointers for insertion into the
-		     * codes table. We can't just roll this into the clearCode
-		     * test above, because at that point we have not yet read
-		     * the next code.
-		     */
-
-		    *top++ = append[code];
-		    oldCode = code;
-		    firstCode = code;
-		    continue;
-		}
+	if (code == clearCode) {
+	    /*
+	     * Reset the decoder.
+	     */
 
-		inCode = code;
+	    codeSize = initialCodeSize + 1;
+	    nextCode = clearCode + 2;
+	    oldCode = -1;
+	    continue;
+	}
 
-		if ((code == maxCode) && (maxCode < (1 << MAX_LWZ_BITS))) {
-		    /*
-		     * maxCode is always one bigger than our highest assigned
-		     * code. If the code we see is equal to maxCode, then we
-		     * are about to add a new entry to the codes table.
-		     */
+	if (code == endCode) {
+	    break;
+	}
 
-		    *top++ = firstCode;
-		    code = oldCode;
-		}
+	if (oldCode == -1) {
+	    /*
+	     * Last pass reset the decoder, so the first code we see must be a
+	     * singleton.
+	     */
 
-		while (code > clearCode) {
-		    /*
-		     * Populate the stack by tracing the code in the codes
-		     * table from its tail to its head
-		     */
+	    if (code > clearCode) {
+		break;
+	    }
+	} else {
+	    /*
+	     * If we're doing things right, we should never receive a code
+	     * that is greater than the next one to be defined. If we do,
+	     * bail, because our decoder does not yet have that code set up.
+	     */
 
-		    *top++ = append[code];
-		    code = prefix[code];
-		}
-		firstCode = append[code];
+	    if (code > nextCode
+		    || (code == nextCode && nextCode >= (1 << MAX_LWZ_BITS))) {
+		break;
+	    }
 
+	    if (nextCode < (1 << MAX_LWZ_BITS)) {
 		/*
-		 * Push the head of the code onto the stack.
+		 * Add a new entry to the codes table: the string for the old
+		 * code followed by the first pixel of the string for this
+		 * code. If this code is the one being defined, its first
+		 * pixel is that of the old code. If there's no more room,
+		 * keep using the current table; see DEFERRED CLEAR CODE IN
+		 * LZW COMPRESSION in the GIF89a specification.
 		 */
 
-		*top++ = firstCode;
-
-		if (maxCode < (1 << MAX_LWZ_BITS)) {
-		    /*
-		     * If there's still room in our codes table, add a new entry.
-		     * Otherwise don't, and keep using the current table.
-		     * See DEFERRED CLEAR CODE IN LZW COMPRESSION in the GIF89a
-		     * specification.
-		     */
-
-		    prefix[maxCode] = oldCode;
-		    append[maxCode] = firstCode;
-		    maxCode++;
-		}
+		prefix[nextCode] = oldCode;
+		suffix[nextCode] =
+			first[(code == nextCode) ? oldCode : code];
+		first[nextCode] = first[oldCode];
+		length[nextCode] = length[oldCode] + 1;
+		nextCode++;
 
 		/*
-		 * maxCode tells us the maximum code value we can accept. If
+		 * nextCode tells us the maximum code value we can accept. If
 		 * we see that we need more bits to represent it than we are
 		 * requesting from the unpacker, we need to increase the
 		 * number we ask for.
 		 */
 
-		if ((maxCode >= (1 << codeSize))
-			&& (maxCode < (1<<MAX_LWZ_BITS))) {
+		if ((nextCode >= (1 << codeSize))
+			&& (codeSize < MAX_LWZ_BITS)) {
 		    codeSize++;
 		}
-		oldCode = inCode;
 	    }
+	}
+	oldCode = code;
 
+	/*
+	 * Put the string of pixels for the code in the image.
+	 */
+
+	count = length[code];
+	if (count <= len - xpos) {
 	    /*
-	     * Pop the next color index off the stack.
+	     * The common case: the string fits in the current row, so write
+	     * it in place from its end.
 	     */
 
-	    v = *(--top);
-	    if (v < 0) {
-		return TCL_OK;
-	    }
+	    unsigned char *p = pixelPtr + count * pixelSize;
 
+	    for (c = code, i = count; i > 0; i--) {
+		p -= pixelSize;
+		colorPtr = cmap[suffix[c]];
+		p[0] = colorPtr[CM_RED];
+		p[1] = colorPtr[CM_GREEN];
+		p[2] = colorPtr[CM_BLUE];
+		if (pixelSize == 4) {
+		    p[3] = colorPtr[CM_ALPHA];
+		}
+		c = prefix[c];
+	    }
+	    pixelPtr += count * pixelSize;
+	    xpos += count;
+	    top = NULL;
+	} else {
 	    /*
-	     * If pixelPtr is null, we're skipping this image (presumably
-	     * there are more in the file and we will be called to read one of
-	     * them later)
+	     * The string runs across rows: unpack it onto the stack first.
 	     */
 
-	    *pixelPtr++ = cmap[v][CM_RED];
-	    *pixelPtr++ = cmap[v][CM_GREEN];
-	    *pixelPtr++ = cmap[v][CM_BLUE];
-	    if (transparent >= 0) {
-		*pixelPtr++ = cmap[v][CM_ALPHA];
+	    top = stack + count;
+	    for (c = code, i = count; i > 0; i--) {
+		*--top = suffix[c];
+		c = prefix[c];
 	    }
-	    xpos++;
-
 	}
 
-	/*
-	 * If interlacing, the next ypos is not just +1.
-	 */
+	while (true) {
+	    if (xpos == len) {
+		/*
+		 * If interlacing, the next ypos is not just +1.
+		 */
 
-	if (interlace) {
-	    ypos += interlaceStep[pass];
-	    while (ypos >= rows) {
-		pass++;
-		if (pass > 3) {
-		    return TCL_OK;
+		rowsLeft--;
+		if (interlace) {
+		    ypos += interlaceStep[pass];
+		    while (ypos >= rows) {
+			pass++;
+			if (pass > 3) {
+			    rowsLeft = 0;
+			    break;
+			}
+			ypos = interlaceStart[pass];
+		    }
+		} else {
+		    ypos++;
 		}
-		ypos = interlaceStart[pass];
+		xpos = 0;
+		pixelPtr = imagePtr + ypos * pitch;
 	    }
-	} else {
-	    ypos++;
+	    if (top == NULL || top == stack + count || rowsLeft <= 0) {
+		break;
+	    }
+	    colorPtr = cmap[*top++];
+	    pixelPtr[0] = colorPtr[CM_RED];
+	    pixelPtr[1] = colorPtr[CM_GREEN];
+	    pixelPtr[2] = colorPtr[CM_BLUE];
+	    if (pixelSize == 4) {
+		pixelPtr[3] = colorPtr[CM_ALPHA];
+	    }
+	    pixelPtr += pixelSize;
+	    xpos++;
 	}
-	pixelPtr = imagePtr + (ypos) * len * ((transparent>=0)?4:3);
     }
 
     /*
@@ -1550,120 +2042,367 @@ ReadImage(
      * It was observed that there might be 1 length blocks
      * (test imgPhoto-14.1) which are not read.
      *
-     * The field "stack" is abused for temporary buffer. it has 4096 bytes
-     * and we need 256.
-     *
      * Loop until we hit a 0 length block which is the end sign.
      */
-    while ( 0 < (count = GetDataBlock(gifConfPtr, chan, stack)))
-    {
-	if (-1 == count ) {
-	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
-		    "error reading GIF image: %s", Tcl_PosixError(interp)));
-	    return TCL_ERROR;
-	}
+
+  done:
+    if (dataDone) {
+	return TCL_OK;
+    }
+    while (0 < (count = GetDataBlock(gifConfPtr, chan,
+	    gifConfPtr->workingBuffer))) {
+	/* Skip the block. */
+    }
+    if (count < 0 && rowsLeft <= 0) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"error reading GIF image: %s", Tcl_PosixError(interp)));
+	return TCL_ERROR;
     }
     return TCL_OK;
 }
-
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SkipImage --
+ *
+ *	Skips over the data of a GIF image that is not wanted, without
+ *	decoding it.
+ *
+ * Results:
+ *	TCL_OK, or TCL_ERROR if the data ended prematurely.
+ *
+ * Side effects:
+ *	The access position in the source advances past the image data.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SkipImage(
+    GIFImageConfig *gifConfPtr,
+    Tcl_Channel chan)
+{
+    unsigned char initialCodeSize;
+    int count;
+
+    if (Fread(gifConfPtr, &initialCodeSize, 1, 1, chan) <= 0) {
+	return TCL_ERROR;
+    }
+    do {
+	count = GetDataBlock(gifConfPtr, chan, gifConfPtr->workingBuffer);
+    } while (count > 0);
+    return (count < 0) ? TCL_ERROR : TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
- * GetCode --
- *
- *	Extract the next compression code from the file. In GIF's, the
- *	compression codes are between 3 and 12 bits long and are then packed
- *	into 8 bit bytes, left to right, for example:
- *		bbbaaaaa
- *		dcccccbb
- *		eeeedddd
- *		...
- *	We use a byte buffer read from the file and a sliding window to unpack
- *	the bytes. Thanks to ImageMagick for the sliding window idea.
- *	args:  chan	    the channel to read from
- *	       code_size    size of the code to extract
- *	       flag	    boolean indicating whether the extractor should be
- *			    reset or not
+ * GetPosition, SetPosition --
+ *
+ *	Get and set the position in the source of a GIF image.
  *
  * Results:
- *	code		    the next compression code
+ *	A standard Tcl result; TCL_ERROR if the source is a channel that
+ *	can't seek.
  *
  * Side effects:
- *	May consume more input from chan.
+ *	SetPosition moves the access position in the source.
  *
  *----------------------------------------------------------------------
  */
 
 static int
-GetCode(
+GetPosition(
+    GIFImageConfig *gifConfPtr,
     Tcl_Channel chan,
-    int code_size,
-    int flag,
-    GIFImageConfig *gifConfPtr)
+    GIFPosition *posPtr)	/* Where to store the position. */
 {
-    int ret;
+    if (gifConfPtr->fromData) {
+	MFile *handle = (MFile *) chan;
 
-    if (flag) {
-	/*
-	 * Initialize the decoder.
-	 */
+	posPtr->offset = handle->data - handle->start;
+	posPtr->c = handle->c;
+	posPtr->state = handle->state;
+	return TCL_OK;
+    }
+    posPtr->offset = Tcl_Tell(chan);
+    posPtr->c = 0;
+    posPtr->state = 0;
+    return (posPtr->offset < 0) ? TCL_ERROR : TCL_OK;
+}
 
-	gifConfPtr->reader.bitsInWindow = 0;
-	gifConfPtr->reader.bytes = 0;
-	gifConfPtr->reader.window = 0;
-	gifConfPtr->reader.done = 0;
-	gifConfPtr->reader.c = NULL;
-	return 0;
+static int
+SetPosition(
+    GIFImageConfig *gifConfPtr,
+    Tcl_Channel chan,
+    GIFPosition *posPtr)	/* Position to go to. */
+{
+    if (gifConfPtr->fromData) {
+	MFile *handle = (MFile *) chan;
+
+	handle->length += (handle->data - handle->start) - posPtr->offset;
+	handle->data = handle->start + posPtr->offset;
+	handle->c = posPtr->c;
+	handle->state = posPtr->state;
+	return TCL_OK;
     }
+    return (Tcl_Seek(chan, posPtr->offset, SEEK_SET) < 0)
+	    ? TCL_ERROR : TCL_OK;
+}
 
-    while (gifConfPtr->reader.bitsInWindow < code_size) {
-	/*
-	 * Not enough bits in our window to cover the request.
-	 */
+/*
+ *----------------------------------------------------------------------
+ *
+ * DataFingerprint --
+ *
+ *	Hashes a sample of some inline GIF data: the first and last bytes and
+ *	a few spread through the rest. This is cheap whatever the size of the
+ *	data, and is enough to tell it from other data that happens to be
+ *	stored where a freed byte array used to be.
+ *
+ * Results:
+ *	The hash value.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	if (gifConfPtr->reader.done) {
-	    return -1;
+#define GIF_FINGERPRINT_SAMPLES	256
+
+static unsigned int
+DataFingerprint(
+    const unsigned char *bytes,	/* The data. */
+    Tcl_WideInt size)		/* Its size in bytes. */
+{
+    unsigned int hash = 2166136261U;
+    Tcl_WideInt i, step;
+
+    if (size <= GIF_FINGERPRINT_SAMPLES) {
+	step = 1;
+    } else {
+	step = size / GIF_FINGERPRINT_SAMPLES;
+    }
+    for (i = 0; i < size; i += step) {
+	hash = (hash ^ bytes[i]) * 16777619U;
+    }
+    if (size > 0) {
+	hash = (hash ^ bytes[size - 1]) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetFrameIndex --
+ *
+ *	Finds the frame index for the source of a GIF image, creating an empty
+ *	one if there is none yet. Inline data is identified by where its bytes
+ *	are, its size and a hash of a sample of it, so that the index doesn't
+ *	keep the data alive; a file, whether read through a channel or mapped into
+ *	memory, by its name, size and modification time.
+ *
+ * Results:
+ *	The frame index, or NULL if the source can't be indexed.
+ *
+ * Side effects:
+ *	An index may be created, pushing out the least recently created one.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static GIFFrameIndex *
+GetFrameIndex(
+    GIFImageConfig *gifConfPtr,
+    Tcl_Channel chan,		/* The source of the image. */
+    const char *fileName)	/* The name of the file being read, or NULL
+				 * for inline data. */
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    GIFFrameIndex *indexPtr;
+    const unsigned char *dataBytes = NULL;
+    unsigned int fingerprint = 0;
+    Tcl_Obj *pathObj = NULL;
+    Tcl_WideInt size, mtime = 0;
+    int i;
+
+    if (fileName == NULL) {
+	MFile *handle = (MFile *) chan;
+
+	if (handle->dataObj == NULL) {
+	    return NULL;
 	}
-	if (gifConfPtr->reader.bytes == 0) {
-	    /*
-	     * Not enough bytes in our buffer to add to the window.
-	     */
+	dataBytes = handle->start;
+	size = (handle->data - handle->start) + handle->length;
+	fingerprint = DataFingerprint(dataBytes, size);
+    } else {
+	Tcl_StatBuf *statPtr;
+	Tcl_Obj *nameObj;
 
-	    gifConfPtr->reader.bytes =
-		    GetDataBlock(gifConfPtr, chan, gifConfPtr->workingBuffer);
-	    gifConfPtr->reader.c = gifConfPtr->workingBuffer;
-	    if (gifConfPtr->reader.bytes <= 0) {
-		gifConfPtr->reader.done = 1;
-		break;
+	if (!gifConfPtr->fromData && Tcl_Tell(chan) < 0) {
+	    return NULL;
+	}
+	nameObj = Tcl_NewStringObj(fileName, TCL_INDEX_NONE);
+	Tcl_IncrRefCount(nameObj);
+	pathObj = Tcl_FSGetNormalizedPath(NULL, nameObj);
+	statPtr = Tcl_AllocStatBuf();
+	if (pathObj == NULL || Tcl_FSStat(pathObj, statPtr) != 0) {
+	    Tcl_Free(statPtr);
+	    Tcl_DecrRefCount(nameObj);
+	    return NULL;
+	}
+	pathObj = Tcl_DuplicateObj(pathObj);
+	Tcl_DecrRefCount(nameObj);
+	size = (Tcl_WideInt) Tcl_GetSizeFromStat(statPtr);
+	mtime = Tcl_GetModificationTimeFromStat(statPtr);
+	Tcl_Free(statPtr);
+    }
+
+    for (i = 0; i < GIF_INDEX_CACHE_SIZE; i++) {
+	indexPtr = &tsdPtr->indexes[i];
+	if (dataBytes != NULL) {
+	    if (indexPtr->dataBytes == dataBytes && indexPtr->size == size
+		    && indexPtr->fingerprint == fingerprint) {
+		return indexPtr;
 	    }
+	} else if (indexPtr->pathObj != NULL && indexPtr->size == size
+		&& indexPtr->mtime == mtime
+		&& !strcmp(Tcl_GetString(indexPtr->pathObj),
+			Tcl_GetString(pathObj))) {
+	    Tcl_BounceRefCount(pathObj);
+	    return indexPtr;
 	}
-
-	/*
-	 * Tack another byte onto the window, see if that's enough.
-	 */
-
-	gifConfPtr->reader.window +=
-		(*gifConfPtr->reader.c) << gifConfPtr->reader.bitsInWindow;
-	gifConfPtr->reader.c++;
-	gifConfPtr->reader.bitsInWindow += 8;
-	gifConfPtr->reader.bytes--;
     }
 
     /*
-     * The next code will always be the last code_size bits of the window.
+     * Not found: make a new index, in place of the oldest one.
      */
 
-    ret = gifConfPtr->reader.window & ((1 << code_size) - 1);
+    if (!tsdPtr->initialized) {
+	tsdPtr->initialized = true;
+	TkCreateThreadExitHandler(FreeFrameIndexes, tsdPtr);
+    }
+    indexPtr = &tsdPtr->indexes[tsdPtr->nextIndex];
+    tsdPtr->nextIndex = (tsdPtr->nextIndex + 1) % GIF_INDEX_CACHE_SIZE;
+    FreeFrameIndex(indexPtr);
+    if (dataBytes != NULL) {
+	indexPtr->dataBytes = dataBytes;
+	indexPtr->fingerprint = fingerprint;
+    } else {
+	indexPtr->pathObj = pathObj;
+	Tcl_IncrRefCount(pathObj);
+    }
+    indexPtr->size = size;
+    indexPtr->mtime = mtime;
+    return indexPtr;
+}
 
-    /*
-     * Shift data in the window to put the next code at the end.
-     */
+/*
+ *----------------------------------------------------------------------
+ *
+ * RecordFrame --
+ *
+ *	Adds the next frame of a GIF image to its frame index.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The index may grow.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RecordFrame(
+    GIFFrameIndex *indexPtr,	/* The index to add to. */
+    GIFPosition *posPtr,	/* Position of the frame's image separator. */
+    GIFGraphicControlExtensionBlock *controlPtr,
+				/* Graphic control extension in scope. */
+    Tcl_Obj *metadataObj)	/* Metadata read so far, may be NULL. */
+{
+    GIFFrame *framePtr;
+    Tcl_Obj *commentObj = NULL;
+
+    if (indexPtr->numFrames == indexPtr->maxFrames) {
+	int maxFrames = indexPtr->maxFrames ? 2 * indexPtr->maxFrames : 16;
+	GIFFrame *framesPtr = (GIFFrame *)Tcl_AttemptRealloc(indexPtr->frames,
+		maxFrames * sizeof(GIFFrame));
+
+	if (framesPtr == NULL) {
+	    return;
+	}
+	indexPtr->frames = framesPtr;
+	indexPtr->maxFrames = maxFrames;
+    }
+    framePtr = &indexPtr->frames[indexPtr->numFrames++];
+    framePtr->position = *posPtr;
+    framePtr->control = *controlPtr;
+    if (metadataObj != NULL) {
+	Tcl_Obj *keyObj = Tcl_NewStringObj("comment", TCL_INDEX_NONE);
 
-    gifConfPtr->reader.window >>= code_size;
-    gifConfPtr->reader.bitsInWindow -= code_size;
-    return ret;
+	Tcl_DictObjGet(NULL, metadataObj, keyObj, &commentObj);
+	Tcl_BounceRefCount(keyObj);
+    }
+    framePtr->commentObj = commentObj;
+    if (commentObj != NULL) {
+	Tcl_IncrRefCount(commentObj);
+    }
 }
-
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeFrameIndex, FreeFrameIndexes --
+ *
+ *	Empty a frame index, or all those of a thread when it exits.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory and object references are released.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeFrameIndex(
+    GIFFrameIndex *indexPtr)
+{
+    int i;
+
+    for (i = 0; i < indexPtr->numFrames; i++) {
+	if (indexPtr->frames[i].commentObj != NULL) {
+	    Tcl_DecrRefCount(indexPtr->frames[i].commentObj);
+	}
+    }
+    if (indexPtr->frames != NULL) {
+	Tcl_Free(indexPtr->frames);
+    }
+    if (indexPtr->pathObj != NULL) {
+	Tcl_DecrRefCount(indexPtr->pathObj);
+    }
+    memset(indexPtr, 0, sizeof(GIFFrameIndex));
+}
+
+static void
+FreeFrameIndexes(
+    void *clientData)		/* Thread specific data. */
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)clientData;
+    int i;
+
+    for (i = 0; i < GIF_INDEX_CACHE_SIZE; i++) {
+	FreeFrameIndex(&tsdPtr->indexes[i]);
+    }
+    tsdPtr->initialized = false;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1690,6 +2429,8 @@ mInit(
     handle->state = 0;
     handle->c = 0;
     handle->length = length;
+    handle->start = string;
+    handle->dataObj = NULL;
 }
 
 /*
@@ -113,6 +113,28 @@ static const int startLine[8] = {
 #define	PNG_INTERLACE_NONE	0
 #define PNG_INTERLACE_ADAM7	1
 
+/*
+ * Filter types of the standard filter method, which are given at the start
+ * of each scan line. PNG_FILTER_ADAPTIVE is not a filter type: it asks the
+ * encoder to choose one for each line.
+ */
+
+#define PNG_FILTER_ADAPTIVE	(-1)
+#define	PNG_FILTER_NONE		0
+#define	PNG_FILTER_SUB		1
+#define	PNG_FILTER_UP		2
+#define	PNG_FILTER_AVG		3
+#define	PNG_FILTER_PAETH	4
+
+/*
+ * Pixel data are filtered and compressed in bands of about this many bytes,
+ * which are worked on in parallel for large images. The bands are
+ * compressed separately and joined with full flushes, so that the size of
+ * the bands, and thus the output, does not depend on the number of threads.
+ */
+
+#define PNG_BAND_SZ		(1 << 20)
+
 /*
  * State information, used to store everything about the PNG image being
  * currently parsed or created.
@@ -131,6 +153,9 @@ typedef struct {
     unsigned char base64Bits;	/* Remaining bits from last base64 read. */
     unsigned char base64State;	/* Current state of base64 decoder. */
     double alpha;		/* Alpha from -format option. */
+    int level;			/* Compression level from -format option. */
+    int filterType;		/* Row filter from -format option, or
+				 * PNG_FILTER_ADAPTIVE. */
 
     /*
      * Image header information.
@@ -176,6 +201,20 @@ typedef struct {
     int lineSize;		/* Number of bytes in a PNG line. */
     int phaseSize;		/* Number of bytes/line in current phase. */
 
+    /*
+     * The chunk being read once the IDAT chunks have been reached, kept here
+     * so that a progressive decode can stop between two scan lines and
+     * resume later.
+     */
+
+    Tcl_Size chunkSz;		/* Bytes left to read in the chunk. */
+    unsigned long chunkType;	/* Type of the chunk. */
+    unsigned long crc;		/* Running CRC of the chunk. */
+    bool paused;		/* Decoding of the IDAT chunks was suspended
+				 * before the end of the image. */
+    bool progressive;		/* Whether -progressive was given in the
+				 * -format option. */
+
 
     /*
      * Physical size: pHYS chunks.
@@ -186,6 +225,59 @@ typedef struct {
 
 } PNGImage;
 
+/*
+ * State of a progressive decode, which goes on in idle handlers after the
+ * photo image format reader has returned.
+ */
+
+typedef struct {
+    PNGImage png;		/* The decoder state. */
+    Tcl_Interp *interp;		/* Interpreter to report errors to. */
+    Tk_PhotoHandle imageHandle;	/* The photo image to write into. */
+    int destX, destY;		/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, height;		/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, srcY;		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    int rowsShown;		/* Number of rows of a non-interlaced image
+				 * already put into the photo image. */
+    int passesShown;		/* Number of passes of an interlaced image
+				 * already put into the photo image. */
+} PNGProgress;
+
+/*
+ * State of the encoding of the pixel data of an image, which is shared by
+ * the threads encoding its bands, and the result for each band.
+ */
+
+typedef struct {
+    unsigned char *bytes;	/* Compressed data, allocated with Tcl_Alloc,
+				 * or NULL if the band could not be
+				 * encoded. */
+    Tcl_Size size;		/* Number of bytes of compressed data. */
+    Tcl_Size length;		/* Number of bytes of uncompressed data. */
+    unsigned long adler;	/* Adler-32 of the uncompressed data. */
+} PNGBand;
+
+typedef struct {
+    PNGImage *pngPtr;		/* The image being written. */
+    Tk_PhotoImageBlock *blockPtr;
+				/* Its pixels. */
+    int lineSize;		/* Number of bytes in a PNG line. */
+    int rowsPerBand;		/* Number of rows in each band but the last. */
+    int numBands;		/* Number of bands. */
+    bool contiguous;		/* Whether rows can be copied from the block
+				 * as they are. */
+    PNGBand *bands;		/* Result for each band. */
+} PNGEncodeJob;
+
+/*
+ * How long each slice of a progressive decode may run, in microseconds.
+ */
+
+#define PNG_SLICE_USEC	10000
+
 /*
  * Maximum size of various chunks.
  */
@@ -197,7 +289,9 @@ typedef struct {
  * Forward declarations of non-global functions defined in this file:
  */
 
-static void		ApplyAlpha(PNGImage *pngPtr);
+static void		ApplyAlpha(PNGImage *pngPtr, unsigned char *pixelPtr,
+			    int count, int pixStride);
+static void		CancelProgressiveDecode(void *clientData);
 static int		CheckColor(Tcl_Interp *interp, PNGImage *pngPtr);
 static inline int	CheckCRC(Tcl_Interp *interp, PNGImage *pngPtr,
 			    unsigned long calculated);
@@ -207,9 +301,14 @@ static int		DecodePNG(Tcl_Interp *interp, PNGImage *pngPtr,
 			    Tcl_Obj *fmtObj, Tk_PhotoHandle imageHandle,
 			    int destX, int destY, int width, int height,
 			    int srcX, int srcY);
+static unsigned long	CombineAdler32(unsigned long adler1,
+			    unsigned long adler2, Tcl_Size len2);
+static void		EncodeBand(void *clientData, int index);
 static int		EncodePNG(Tcl_Interp *interp,
 			    Tk_PhotoImageBlock *blockPtr, PNGImage *pngPtr,
 			    Tcl_Obj *metadataInObj);
+static void		ExtractLine(PNGEncodeJob *jobPtr, int rowNum,
+			    unsigned char *destPtr);
 static int		FileMatchPNG(Tcl_Interp *interp, Tcl_Channel chan,
 			    const char *fileName, Tcl_Obj *fmtObj,
 			    Tcl_Obj *metadataInObj, int *widthPtr,
@@ -222,11 +321,19 @@ static int		FileReadPNG(Tcl_Interp *interp, Tcl_Channel chan,
 static int		FileWritePNG(Tcl_Interp *interp, const char *filename,
 			    Tcl_Obj *fmtObj, Tcl_Obj *metadataInObj,
 			    Tk_PhotoImageBlock *blockPtr);
+static void		FillInterlacePreview(PNGImage *pngPtr, int passes);
+static unsigned char *	FilterLine(const unsigned char *thisLine,
+			    const unsigned char *lastLine, int lineLen,
+			    int bpp, int filterType,
+			    unsigned char *filtered[5]);
 static int		InitPNGImage(Tcl_Interp *interp, PNGImage *pngPtr,
 			    Tcl_Channel chan, Tcl_Obj *objPtr, int dir);
 static inline unsigned char Paeth(int a, int b, int c);
 static int		ParseFormat(Tcl_Interp *interp, Tcl_Obj *fmtObj,
 			    PNGImage *pngPtr);
+static void		ProgressiveDecodeProc(void *clientData);
+static int		PutDecodedRows(Tcl_Interp *interp,
+			    PNGProgress *progPtr, int firstRow, int lastRow);
 static int		ReadBase64(Tcl_Interp *interp, PNGImage *pngPtr,
 			    unsigned char *destPtr, Tcl_Size destSz,
 			    unsigned long *crcPtr);
@@ -240,16 +347,26 @@ static int		ReadChunkHeader(Tcl_Interp *interp, PNGImage *pngPtr,
 			    Tcl_Size *sizePtr, unsigned long *typePtr,
 			    unsigned long *crcPtr);
 static int		ReadIDAT(Tcl_Interp *interp, PNGImage *pngPtr,
-			    int chunkSz, unsigned long crc);
+			    const Tcl_Time *deadline);
 static int		ReadIHDR(Tcl_Interp *interp, PNGImage *pngPtr);
+static int		ReadImageData(Tcl_Interp *interp, PNGImage *pngPtr,
+			    const Tcl_Time *deadline);
 static inline int	ReadInt32(Tcl_Interp *interp, PNGImage *pngPtr,
 			    unsigned long *resultPtr, unsigned long *crcPtr);
+static int		ReadPNG(Tcl_Interp *interp, PNGImage *pngPtr,
+			    Tcl_Obj *fmtObj, Tk_PhotoHandle imageHandle,
+			    int destX, int destY, int width, int height,
+			    int srcX, int srcY, Tcl_Obj *metadataOutObj);
 static int		ReadPLTE(Tcl_Interp *interp, PNGImage *pngPtr,
 			    int chunkSz, unsigned long crc);
 static int		ReadTRNS(Tcl_Interp *interp, PNGImage *pngPtr,
 			    int chunkSz, unsigned long crc);
 static int		SkipChunk(Tcl_Interp *interp, PNGImage *pngPtr,
 			    int chunkSz, unsigned long crc);
+static int		StartProgressiveDecode(Tcl_Interp *interp,
+			    PNGImage *pngPtr, Tk_PhotoHandle imageHandle,
+			    int destX, int destY, int width, int height,
+			    int srcX, int srcY);
 static int		StringMatchPNG(Tcl_Interp *interp, Tcl_Obj *pObjData,
 			    Tcl_Obj *fmtObj, Tcl_Obj *metadataInObj,
 			    int *widthPtr, int *heightPtr,
@@ -326,6 +443,8 @@ InitPNGImage(
 
     pngPtr->channel = chan;
     pngPtr->alpha = 1.0;
+    pngPtr->level = TCL_ZLIB_COMPRESS_DEFAULT;
+    pngPtr->filterType = PNG_FILTER_ADAPTIVE;
 
     /*
      * If decoding from a -data string object, increment its reference count
@@ -588,6 +707,16 @@ ReadByteArray(
      */
 
     if (pngPtr->strDataLen < destSz) {
+	if (pngPtr->objDataPtr == NULL) {
+	    /*
+	     * A mapped file: report it as the channel reader would.
+	     */
+
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "unexpected end of file", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "EOF", (char *)NULL);
+	    return TCL_ERROR;
+	}
 	Tcl_SetObjResult(interp, Tcl_NewStringObj(
 		"unexpected end of image data", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "EARLY_END", (char *)NULL);
@@ -1287,7 +1416,7 @@ ReadIHDR(
      * If reading from string, reset position and try base64 decode.
      */
 
-    if (mismatch && pngPtr->strDataBuf) {
+    if (mismatch && pngPtr->objDataPtr) {
 	pngPtr->strDataBuf = Tcl_GetByteArrayFromObj(pngPtr->objDataPtr,
 		&pngPtr->strDataLen);
 	pngPtr->base64Data = pngPtr->strDataBuf;
@@ -1815,12 +1944,6 @@ UnfilterLine(
     unsigned char *lastLine =
 	    Tcl_GetByteArrayFromObj(pngPtr->lastLineObj, (Tcl_Size *)NULL);
 
-#define	PNG_FILTER_NONE		0
-#define	PNG_FILTER_SUB		1
-#define	PNG_FILTER_UP		2
-#define	PNG_FILTER_AVG		3
-#define	PNG_FILTER_PAETH	4
-
     switch (*thisLine) {
     case PNG_FILTER_NONE:	/* Nothing to do */
 	break;
@@ -1940,6 +2063,7 @@ DecodeLine(
     unsigned char pixBits = 0;	/* Extracted bits for current channel */
     int shifts = 0;		/* Number of channels extracted from byte */
     int offset = 0;		/* Current offset into pixelPtr */
+    int firstCol;		/* First pixel column of the line */
     int colStep = 1;		/* Column increment each pass */
     int pixStep = 0;		/* extra pixelPtr increment each pass */
     unsigned char lastPixel[6];
@@ -1986,6 +2110,8 @@ DecodeLine(
 	}
     }
 
+    firstCol = colNum;
+
     /*
      * Calculate offset into pixelPtr for the first pixel of the line.
      */
@@ -2100,6 +2226,19 @@ DecodeLine(
 	offset += pixStep;
     }
 
+    /*
+     * Apply overall image alpha if specified. Doing it as each line is
+     * decoded keeps the pixels touched in the cache, and means that the
+     * rows shown by a progressive decode are already final.
+     */
+
+    if ((pngPtr->alpha != 1.0) && (firstCol < pngPtr->block.width)) {
+	ApplyAlpha(pngPtr, pixelPtr + pngPtr->currentLine * pngPtr->block.pitch
+		+ firstCol * pngPtr->block.pixelSize,
+		(pngPtr->block.width - firstCol + colStep - 1) / colStep,
+		colStep * pngPtr->block.pixelSize);
+    }
+
     if (pngPtr->interlace) {
 	/* Skip lines */
 
@@ -2174,8 +2313,10 @@ DecodeLine(
  * ReadIDAT --
  *
  *	This function reads the IDAT (pixel data) chunk from the PNG file to
- *	build the image. It will continue reading until all IDAT chunks have
- *	been processed or an error occurs.
+ *	build the image. It will continue reading until all of the chunk has
+ *	been processed, an error occurs or, if a deadline is given, the time
+ *	runs out. In the last case, decoding stops between two scan lines and
+ *	the paused flag is set; calling this function again resumes it.
  *
  * Results:
  *	TCL_OK, or TCL_ERROR if an I/O error occurs or an IDAT chunk is
@@ -2192,23 +2333,27 @@ static int
 ReadIDAT(
     Tcl_Interp *interp,
     PNGImage *pngPtr,
-    int chunkSz,
-    unsigned long crc)
+    const Tcl_Time *deadline)	/* When to suspend decoding, or NULL to
+				 * decode the whole chunk. */
 {
     /*
      * Process IDAT contents until there is no more in this chunk.
      */
 
-    while (chunkSz && !Tcl_ZlibStreamEof(pngPtr->stream)) {
+    while (pngPtr->paused
+	    || (pngPtr->chunkSz && !Tcl_ZlibStreamEof(pngPtr->stream))) {
 	Tcl_Size len1, len2;
 
 	/*
-	 * Read another block of input into the zlib stream if data remains.
+	 * Read another block of input into the zlib stream if data remains,
+	 * unless resuming with scan lines that were already inflated.
 	 */
 
-	if (chunkSz) {
+	if (pngPtr->paused) {
+	    pngPtr->paused = false;
+	} else if (pngPtr->chunkSz) {
 	    Tcl_Obj *inputObj = NULL;
-	    int blockSz = PNG_MIN(chunkSz, PNG_BLOCK_SZ);
+	    int blockSz = PNG_MIN(pngPtr->chunkSz, PNG_BLOCK_SZ);
 	    unsigned char *inputPtr = NULL;
 
 	    /*
@@ -2232,12 +2377,12 @@ ReadIDAT(
 	     */
 
 	    if (ReadData(interp, pngPtr, inputPtr, blockSz,
-		    &crc) == TCL_ERROR) {
+		    &pngPtr->crc) == TCL_ERROR) {
 		Tcl_DecrRefCount(inputObj);
 		return TCL_ERROR;
 	    }
 
-	    chunkSz -= blockSz;
+	    pngPtr->chunkSz -= blockSz;
 
 	    Tcl_ZlibStreamPut(pngPtr->stream, inputObj, TCL_ZLIB_NO_FLUSH);
 	    Tcl_DecrRefCount(inputObj);
@@ -2289,6 +2434,16 @@ ReadIDAT(
 	     */
 
 	    if (pngPtr->currentLine < pngPtr->block.height) {
+		if (deadline != NULL) {
+		    Tcl_Time now;
+
+		    Tcl_GetTime(&now);
+		    if ((now.sec > deadline->sec) || ((now.sec == deadline->sec)
+			    && (now.usec >= deadline->usec))) {
+			pngPtr->paused = true;
+			return TCL_OK;
+		    }
+		}
 		goto getNextLine;
 	    }
 
@@ -2307,66 +2462,60 @@ ReadIDAT(
      * enforced by most PNG readers.
      */
 
-    if (chunkSz != 0) {
+    if (pngPtr->chunkSz != 0) {
 	Tcl_SetObjResult(interp, Tcl_NewStringObj(
 		"compressed data after stream finalize in PNG data", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "EXTRA_DATA", (char *)NULL);
 	return TCL_ERROR;
     }
 
-    return CheckCRC(interp, pngPtr, crc);
+    return CheckCRC(interp, pngPtr, pngPtr->crc);
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
  * ApplyAlpha --
  *
- *	Applies an overall alpha value to a complete image that has been read.
- *	This alpha value is specified using the -format option to [image
- *	create photo].
+ *	Applies an overall alpha value to pixels that have been decoded. This
+ *	alpha value is specified using the -format option to [image create
+ *	photo].
  *
  * Results:
  *	N/A
  *
  * Side effects:
- *	The access position in f may change.
+ *	The alpha channel of the pixels is scaled.
  *
  *----------------------------------------------------------------------
  */
 
 static void
 ApplyAlpha(
-    PNGImage *pngPtr)
+    PNGImage *pngPtr,
+    unsigned char *pixelPtr,	/* First pixel to adjust. */
+    int count,			/* Number of pixels to adjust. */
+    int pixStride)		/* Distance in bytes between two pixels. */
 {
-    if (pngPtr->alpha != 1.0) {
-	unsigned char *p = pngPtr->block.pixelPtr;
-	unsigned char *endPtr = p + pngPtr->blockLen;
-	int offset = pngPtr->block.offset[3];
+    unsigned char *p = pixelPtr + pngPtr->block.offset[3];
 
-	p += offset;
-
-	if (16 == pngPtr->bitDepth) {
-	    unsigned int channel;
-
-	    while (p < endPtr) {
-		channel = (unsigned int)
-			(((p[0] << 8) | p[1]) * pngPtr->alpha);
+    if (16 == pngPtr->bitDepth) {
+	unsigned int channel;
 
-		*p++ = (unsigned char) (channel >> 8);
-		*p++ = (unsigned char) (channel & 0xff);
+	for ( ; count > 0 ; count--, p += pixStride) {
+	    channel = (unsigned int)
+		    (((p[0] << 8) | p[1]) * pngPtr->alpha);
 
-		p += offset;
-	    }
-	} else {
-	    while (p < endPtr) {
-		p[0] = (unsigned char) (pngPtr->alpha * p[0]);
-		p += 1 + offset;
-	    }
+	    p[0] = (unsigned char) (channel >> 8);
+	    p[1] = (unsigned char) (channel & 0xff);
+	}
+    } else {
+	for ( ; count > 0 ; count--, p += pixStride) {
+	    p[0] = (unsigned char) (pngPtr->alpha * p[0]);
 	}
     }
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2374,9 +2523,11 @@ ApplyAlpha(
  *
  *	This function parses the -format string that can be specified to the
  *	[image create photo] command to extract options for postprocessing of
- *	loaded images. Currently, this just allows specifying and applying an
+ *	loaded images. Currently, this allows specifying and applying an
  *	overall alpha value to the loaded image (for example, to make it
- *	entirely 50% as transparent as the actual image file).
+ *	entirely 50% as transparent as the actual image file), and asking for
+ *	the image to be decoded progressively. When writing, it gives the
+ *	compression level and the row filter to use.
  *
  * Results:
  *	TCL_OK, or TCL_ERROR if the format specification is invalid.
@@ -2396,10 +2547,17 @@ ParseFormat(
     Tcl_Obj **objv = NULL;
     Tcl_Size objc = 0;
     static const char *const fmtOptions[] = {
-	"-alpha", NULL
+	"-alpha", "-filter", "-level", "-progressive", NULL
     };
     enum fmtOptionsEnum {
-	OPT_ALPHA
+	OPT_ALPHA, OPT_FILTER, OPT_LEVEL, OPT_PROGRESSIVE
+    };
+    static const char *const filterNames[] = {
+	"adaptive", "average", "none", "paeth", "sub", "up", NULL
+    };
+    static const int filterTypes[] = {
+	PNG_FILTER_ADAPTIVE, PNG_FILTER_AVG, PNG_FILTER_NONE,
+	PNG_FILTER_PAETH, PNG_FILTER_SUB, PNG_FILTER_UP
     };
 
     /*
@@ -2450,6 +2608,40 @@ ParseFormat(
 		return TCL_ERROR;
 	    }
 	    break;
+	case OPT_FILTER: {
+	    int filterIndex;
+
+	    if (Tcl_GetIndexFromObjStruct(interp, objv[0], filterNames,
+		    sizeof(char *), "filter", 0, &filterIndex) == TCL_ERROR) {
+		return TCL_ERROR;
+	    }
+	    pngPtr->filterType = filterTypes[filterIndex];
+	    break;
+	}
+	case OPT_LEVEL:
+	    if (Tcl_GetIntFromObj(interp, objv[0],
+		    &pngPtr->level) == TCL_ERROR) {
+		return TCL_ERROR;
+	    }
+
+	    if ((pngPtr->level < 0) || (pngPtr->level > 9)) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"-level value must be between 0 and 9", TCL_INDEX_NONE));
+		Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "BAD_LEVEL",
+			(char *)NULL);
+		return TCL_ERROR;
+	    }
+	    break;
+	case OPT_PROGRESSIVE: {
+	    int progressive;
+
+	    if (Tcl_GetBooleanFromObj(interp, objv[0],
+		    &progressive) == TCL_ERROR) {
+		return TCL_ERROR;
+	    }
+	    pngPtr->progressive = (progressive != 0);
+	    break;
+	}
 	}
     }
 
@@ -2706,17 +2898,79 @@ DecodePNG(
 	pngPtr->phaseSize = pngPtr->lineSize;
     }
 
+    /*
+     * Remember where we are, so that a progressive decode can carry on from
+     * here after we return.
+     */
+
+    pngPtr->chunkSz = chunkSz;
+    pngPtr->chunkType = chunkType;
+    pngPtr->crc = crc;
+
+    if (pngPtr->progressive) {
+	return StartProgressiveDecode(interp, pngPtr, imageHandle, destX,
+		destY, width, height, srcX, srcY);
+    }
+
+    if (ReadImageData(interp, pngPtr, NULL) == TCL_ERROR) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Copy the decoded image block into the Tk photo image.
+     */
+
+    pngPtr->block.pixelPtr += srcX * pngPtr->block.pixelSize + srcY * pngPtr->block.pitch;
+    result = Tk_PhotoPutBlock(interp, imageHandle, &pngPtr->block, destX, destY,
+	    width, height, TK_PHOTO_COMPOSITE_SET);
+    pngPtr->block.pixelPtr -= srcX * pngPtr->block.pixelSize + srcY * pngPtr->block.pitch;
+
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadImageData --
+ *
+ *	This function reads the IDAT (data) chunks of a PNG image and then
+ *	the remaining chunks up to and including the IEND chunk, starting
+ *	with the chunk whose header has been read into the PNGImage
+ *	structure. If a deadline is given and the time runs out before the
+ *	pixel data has all been decoded, the paused flag is set and calling
+ *	this function again continues where it stopped.
+ *
+ * Results:
+ *	TCL_OK, or TCL_ERROR if an I/O error occurs or any problems are
+ *	detected in the PNG file.
+ *
+ * Side effects:
+ *	The access position in f advances. Decoded pixels are stored in the
+ *	image block.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadImageData(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    PNGImage *pngPtr,		/* PNG image information record. */
+    const Tcl_Time *deadline)	/* When to suspend decoding, or NULL. */
+{
     /*
      * All of the IDAT (data) chunks must be consecutive.
      */
 
-    while (CHUNK_IDAT == chunkType) {
-	if (ReadIDAT(interp, pngPtr, chunkSz, crc) == TCL_ERROR) {
+    while (CHUNK_IDAT == pngPtr->chunkType) {
+	if (ReadIDAT(interp, pngPtr, deadline) == TCL_ERROR) {
 	    return TCL_ERROR;
 	}
+	if (pngPtr->paused) {
+	    return TCL_OK;
+	}
 
-	if (ReadChunkHeader(interp, pngPtr, &chunkSz, &chunkType,
-		&crc) == TCL_ERROR) {
+	if (ReadChunkHeader(interp, pngPtr, &pngPtr->chunkSz,
+		&pngPtr->chunkType, &pngPtr->crc) == TCL_ERROR) {
 	    return TCL_ERROR;
 	}
     }
@@ -2738,13 +2992,14 @@ DecodePNG(
      * Now skip the remaining chunks which we're also not interested in.
      */
 
-    while (CHUNK_IEND != chunkType) {
-	if (SkipChunk(interp, pngPtr, chunkSz, crc) == TCL_ERROR) {
+    while (CHUNK_IEND != pngPtr->chunkType) {
+	if (SkipChunk(interp, pngPtr, pngPtr->chunkSz,
+		pngPtr->crc) == TCL_ERROR) {
 	    return TCL_ERROR;
 	}
 
-	if (ReadChunkHeader(interp, pngPtr, &chunkSz, &chunkType,
-		&crc) == TCL_ERROR) {
+	if (ReadChunkHeader(interp, pngPtr, &pngPtr->chunkSz,
+		&pngPtr->chunkType, &pngPtr->crc) == TCL_ERROR) {
 	    return TCL_ERROR;
 	}
     }
@@ -2753,7 +3008,7 @@ DecodePNG(
      * Got the IEND (end of image) chunk. Do some final checks...
      */
 
-    if (chunkSz) {
+    if (pngPtr->chunkSz) {
 	Tcl_SetObjResult(interp, Tcl_NewStringObj(
 		"IEND chunk contents must be empty", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "BAD_IEND", (char *)NULL);
@@ -2764,7 +3019,7 @@ DecodePNG(
      * Check the CRC on the IEND chunk.
      */
 
-    if (CheckCRC(interp, pngPtr, crc) == TCL_ERROR) {
+    if (CheckCRC(interp, pngPtr, pngPtr->crc) == TCL_ERROR) {
 	return TCL_ERROR;
     }
 
@@ -2782,130 +3037,499 @@ DecodePNG(
     }
 #endif
 
-    /*
-     * Apply overall image alpha if specified.
-     */
-
-    ApplyAlpha(pngPtr);
-
-    /*
-     * Copy the decoded image block into the Tk photo image.
-     */
-
-    pngPtr->block.pixelPtr += srcX * pngPtr->block.pixelSize + srcY * pngPtr->block.pitch;
-    result = Tk_PhotoPutBlock(interp, imageHandle, &pngPtr->block, destX, destY,
-	    width, height, TK_PHOTO_COMPOSITE_SET);
-    pngPtr->block.pixelPtr -= srcX * pngPtr->block.pixelSize + srcY * pngPtr->block.pitch;
-
-    return result;
+    return TCL_OK;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * FileMatchPNG --
+ * StartProgressiveDecode --
  *
- *	This function is invoked by the photo image type to see if a file
- *	contains image data in PNG format.
+ *	This function hands the decoding of the pixel data of a PNG image
+ *	over to an idle handler, which decodes it in slices of limited
+ *	duration so that the application stays responsive while a large image
+ *	is being loaded. The rows of a non-interlaced image are shown as they
+ *	are decoded; an interlaced image is shown after each Adam7 pass, at
+ *	increasing resolution.
  *
  * Results:
- *	The return value is 1 if the first characters in file f look like PNG
- *	data, and 0 otherwise.
+ *	TCL_OK, or TCL_ERROR if the rest of the image file could not be read.
  *
  * Side effects:
- *	The access position in f may change.
+ *	The decoder state is moved out of the PNGImage structure, which
+ *	afterwards owns no resources. The rest of the image is copied into a
+ *	private byte array, since the channel is closed (or the file unmapped)
+ *	when the reader returns, and a -data value may be changed by scripts
+ *	while the decode goes on.
  *
  *----------------------------------------------------------------------
  */
 
 static int
-FileMatchPNG(
+StartProgressiveDecode(
     Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
-    Tcl_Channel chan,		/* The image file, open for reading. */
-    TCL_UNUSED(const char *),	/* The name of the image file. */
-    TCL_UNUSED(Tcl_Obj *),	/* User-specified format object, or NULL. */
-    TCL_UNUSED(Tcl_Obj *),	/* metadata input, may be NULL */
-    int *widthPtr, int *heightPtr,
-				/* The dimensions of the image are returned
-				 * here if the file is a valid raw GIF file. */
-    TCL_UNUSED(Tcl_Obj *))	/* metadata return dict, may be NULL */
+    PNGImage *pngPtr,		/* PNG image information record. */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY)		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
 {
-    PNGImage png;
-    int match = 0;
+    PNGProgress *progPtr;
 
-    InitPNGImage(NULL, &png, chan, NULL, TCL_ZLIB_STREAM_INFLATE);
+    if (pngPtr->channel) {
+	Tcl_Obj *dataObj = Tcl_NewObj();
 
-    if (ReadIHDR(interp, &png) == TCL_OK) {
-	*widthPtr = png.block.width;
-	*heightPtr = png.block.height;
-	match = 1;
+	Tcl_IncrRefCount(dataObj);
+	if (Tcl_ReadChars(pngPtr->channel, dataObj, TCL_INDEX_NONE,
+		0) == TCL_IO_FAILURE) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel read failed: %s", Tcl_PosixError(interp)));
+	    Tcl_DecrRefCount(dataObj);
+	    return TCL_ERROR;
+	}
+	pngPtr->channel = NULL;
+	pngPtr->objDataPtr = dataObj;
+	pngPtr->strDataBuf =
+		Tcl_GetByteArrayFromObj(dataObj, &pngPtr->strDataLen);
+    } else {
+	/*
+	 * The data is a mapped file, which is also gone when the reader
+	 * returns, or the -data value. The latter is shared with scripts, and
+	 * using it as anything but a byte array frees the bytes strDataBuf
+	 * points into, so the unread part is copied in either case.
+	 */
+
+	Tcl_Obj *dataObj = Tcl_NewByteArrayObj(pngPtr->strDataBuf,
+		pngPtr->strDataLen);
+
+	Tcl_IncrRefCount(dataObj);
+	if (pngPtr->objDataPtr != NULL) {
+	    Tcl_DecrRefCount(pngPtr->objDataPtr);
+	}
+	pngPtr->objDataPtr = dataObj;
+	pngPtr->strDataBuf = Tcl_GetByteArrayFromObj(pngPtr->objDataPtr,
+		&pngPtr->strDataLen);
     }
 
-    CleanupPNGImage(&png);
+    progPtr = (PNGProgress *)Tcl_Alloc(sizeof(PNGProgress));
+    progPtr->png = *pngPtr;
+    progPtr->interp = interp;
+    progPtr->imageHandle = imageHandle;
+    progPtr->destX = destX;
+    progPtr->destY = destY;
+    progPtr->width = width;
+    progPtr->height = height;
+    progPtr->srcX = srcX;
+    progPtr->srcY = srcY;
+    progPtr->rowsShown = 0;
+    progPtr->passesShown = 0;
+    Tcl_Preserve(interp);
 
-    return match;
+    /*
+     * The caller still looks at the physical size, so only forget about the
+     * resources which now belong to the progressive decode.
+     */
+
+    pngPtr->objDataPtr = NULL;
+    pngPtr->stream = NULL;
+    pngPtr->block.pixelPtr = NULL;
+    pngPtr->thisLineObj = NULL;
+    pngPtr->lastLineObj = NULL;
+
+    TkPhotoSetPendingLoad(imageHandle, CancelProgressiveDecode, progPtr);
+    Tcl_DoWhenIdle(ProgressiveDecodeProc, progPtr);
+    return TCL_OK;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * FileReadPNG --
+ * ProgressiveDecodeProc --
  *
- *	This function is called by the photo image type to read PNG format
- *	data from a file and write it into a given photo image.
+ *	Idle handler that decodes the next slice of a PNG image being loaded
+ *	progressively, and puts the pixels completed by it into the photo
+ *	image.
  *
  * Results:
- *	A standard TCL completion code. If TCL_ERROR is returned then an error
- *	message is left in the interp's result.
+ *	None.
  *
  * Side effects:
- *	The access position in file f is changed, and new data is added to the
- *	image given by imageHandle.
+ *	The photo image is updated. The handler reschedules itself until the
+ *	image is complete; errors in the image data are reported as background
+ *	errors.
  *
  *----------------------------------------------------------------------
  */
 
-static int
-FileReadPNG(
-    Tcl_Interp* interp,		/* Interpreter to use for reporting errors. */
-    Tcl_Channel chan,		/* The image file, open for reading. */
-    TCL_UNUSED(const char*),	/* The name of the image file. */
-    Tcl_Obj *fmtObj,		/* User-specified format object, or NULL. */
-    TCL_UNUSED(Tcl_Obj*),	/* metadata input, may be NULL */
-    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
-    int destX, int destY,	/* Coordinates of top-left pixel in photo
-				 * image to be written to. */
-    int width, int height,	/* Dimensions of block of photo image to be
-				 * written to. */
-    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
-				 * image being read. */
-    Tcl_Obj* metadataOutObj)	/* metadata return dict, may be NULL */
+static void
+ProgressiveDecodeProc(
+    void *clientData)		/* The progressive decode. */
 {
-    PNGImage png;
-    int result = TCL_ERROR;
-
-    result = InitPNGImage(interp, &png, chan, NULL, TCL_ZLIB_STREAM_INFLATE);
-
-    if (TCL_OK == result) {
-	result = DecodePNG(interp, &png, fmtObj, imageHandle, destX, destY, width, height, srcX, srcY);
+    PNGProgress *progPtr = (PNGProgress *)clientData;
+    PNGImage *pngPtr = &progPtr->png;
+    Tcl_Interp *interp = progPtr->interp;
+    Tcl_Time deadline;
+    int result, firstRow = 0, lastRow = 0;
+
+    Tcl_GetTime(&deadline);
+    deadline.usec += PNG_SLICE_USEC;
+    if (deadline.usec >= 1000000) {
+	deadline.sec++;
+	deadline.usec -= 1000000;
+    }
+
+    result = ReadImageData(interp, pngPtr, &deadline);
+    if (result == TCL_OK) {
+	if (!pngPtr->paused) {
+	    firstRow = pngPtr->interlace ? 0 : progPtr->rowsShown;
+	    lastRow = pngPtr->block.height;
+	} else if (!pngPtr->interlace) {
+	    firstRow = progPtr->rowsShown;
+	    lastRow = pngPtr->currentLine;
+	    progPtr->rowsShown = lastRow;
+	} else if (pngPtr->phase - 1 > progPtr->passesShown) {
+	    progPtr->passesShown = pngPtr->phase - 1;
+	    FillInterlacePreview(pngPtr, progPtr->passesShown);
+	    lastRow = pngPtr->block.height;
+	}
+	result = PutDecodedRows(interp, progPtr, firstRow, lastRow);
     }
 
-    if (TCL_OK == result && metadataOutObj != NULL && png.DPI != -1) {
-	result = Tcl_DictObjPut(NULL, metadataOutObj,
-		Tcl_NewStringObj("DPI",-1),
-		Tcl_NewDoubleObj(png.DPI));
+    if ((result == TCL_OK) && pngPtr->paused) {
+	Tcl_DoWhenIdle(ProgressiveDecodeProc, progPtr);
+	return;
     }
 
-    if (TCL_OK == result && metadataOutObj != NULL && png.aspect != -1) {
-	result = Tcl_DictObjPut(NULL, metadataOutObj,
-		Tcl_NewStringObj("aspect",-1),
-		Tcl_NewDoubleObj(png.aspect));
+    TkPhotoPendingLoadDone(progPtr->imageHandle, progPtr);
+    if ((result != TCL_OK) && !Tcl_InterpDeleted(interp)) {
+	Tcl_AddErrorInfo(interp, "\n    (decoding PNG image in background)");
+	Tcl_BackgroundException(interp, result);
     }
-
-    CleanupPNGImage(&png);
-    return result;
+    CancelProgressiveDecode(progPtr);
 }
-
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CancelProgressiveDecode --
+ *
+ *	Stops a progressive decode and releases its resources. This is called
+ *	by the photo image when the image is deleted or new data is loaded
+ *	into it, and when the decode is over.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CancelProgressiveDecode(
+    void *clientData)		/* The progressive decode. */
+{
+    PNGProgress *progPtr = (PNGProgress *)clientData;
+
+    Tcl_CancelIdleCall(ProgressiveDecodeProc, progPtr);
+    CleanupPNGImage(&progPtr->png);
+    Tcl_Release(progPtr->interp);
+    Tcl_Free(progPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FillInterlacePreview --
+ *
+ *	Fills the pixels of an interlaced image which are still to be decoded
+ *	with copies of the decoded pixels, so that the image can be shown at
+ *	the resolution of the Adam7 passes completed so far. Later passes
+ *	overwrite all of the copies.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The image block is modified.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FillInterlacePreview(
+    PNGImage *pngPtr,		/* PNG image information record. */
+    int passes)			/* Number of completed passes (1..6). */
+{
+    /*
+     * Size of the blocks of pixels of which only the top-left one has been
+     * decoded after each pass.
+     */
+
+    static const int blockWidth[6] = {8, 4, 4, 2, 2, 1};
+    static const int blockHeight[6] = {8, 8, 4, 4, 2, 2};
+    int xMask = ~(blockWidth[passes - 1] - 1);
+    int yMask = ~(blockHeight[passes - 1] - 1);
+    int pixelSize = pngPtr->block.pixelSize;
+    int x, y;
+
+    for (y = 0 ; y < pngPtr->block.height ; y++) {
+	unsigned char *rowPtr = pngPtr->block.pixelPtr
+		+ y * pngPtr->block.pitch;
+	unsigned char *srcRowPtr = pngPtr->block.pixelPtr
+		+ (y & yMask) * pngPtr->block.pitch;
+
+	for (x = 0 ; x < pngPtr->block.width ; x++) {
+	    if ((rowPtr != srcRowPtr) || ((x & xMask) != x)) {
+		memcpy(rowPtr + x * pixelSize,
+			srcRowPtr + (x & xMask) * pixelSize, pixelSize);
+	    }
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PutDecodedRows --
+ *
+ *	Copies a band of rows of a progressively decoded image into the part
+ *	of the photo image that the image is being read into.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	The photo image is modified.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PutDecodedRows(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    PNGProgress *progPtr,	/* The progressive decode. */
+    int firstRow, int lastRow)	/* Rows of the PNG image to put, the last one
+				 * excluded. */
+{
+    Tk_PhotoImageBlock block = progPtr->png.block;
+
+    if (firstRow < progPtr->srcY) {
+	firstRow = progPtr->srcY;
+    }
+    if (lastRow > progPtr->srcY + progPtr->height) {
+	lastRow = progPtr->srcY + progPtr->height;
+    }
+    if (firstRow >= lastRow) {
+	return TCL_OK;
+    }
+    block.pixelPtr += progPtr->srcX * block.pixelSize
+	    + firstRow * block.pitch;
+    block.height = lastRow - firstRow;
+    return Tk_PhotoPutBlock(interp, progPtr->imageHandle, &block,
+	    progPtr->destX, progPtr->destY + firstRow - progPtr->srcY,
+	    progPtr->width, lastRow - firstRow, TK_PHOTO_COMPOSITE_SET);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FileMatchPNG --
+ *
+ *	This function is invoked by the photo image type to see if a file
+ *	contains image data in PNG format.
+ *
+ * Results:
+ *	The return value is 1 if the first characters in file f look like PNG
+ *	data, and 0 otherwise.
+ *
+ * Side effects:
+ *	The access position in f may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+FileMatchPNG(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Channel chan,		/* The image file, open for reading. */
+    TCL_UNUSED(const char *),	/* The name of the image file. */
+    TCL_UNUSED(Tcl_Obj *),	/* User-specified format object, or NULL. */
+    TCL_UNUSED(Tcl_Obj *),	/* metadata input, may be NULL */
+    int *widthPtr, int *heightPtr,
+				/* The dimensions of the image are returned
+				 * here if the file is a valid raw GIF file. */
+    TCL_UNUSED(Tcl_Obj *))	/* metadata return dict, may be NULL */
+{
+    PNGImage png;
+    int match = 0;
+
+    InitPNGImage(NULL, &png, chan, NULL, TCL_ZLIB_STREAM_INFLATE);
+
+    if (ReadIHDR(interp, &png) == TCL_OK) {
+	*widthPtr = png.block.width;
+	*heightPtr = png.block.height;
+	match = 1;
+    }
+
+    CleanupPNGImage(&png);
+
+    return match;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadPNG --
+ *
+ *	Decodes a PNG image into a photo image and reports its physical size
+ *	in the metadata, for each of the ways of reading one.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	New data is added to the image given by imageHandle. The PNGImage is
+ *	cleaned up.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadPNG(
+    Tcl_Interp* interp,		/* Interpreter to use for reporting errors. */
+    PNGImage *pngPtr,		/* PNG image information record, set up to
+				 * read the data. */
+    Tcl_Obj *fmtObj,		/* User-specified format object, or NULL. */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj* metadataOutObj)	/* metadata return dict, may be NULL */
+{
+    int result;
+
+    result = DecodePNG(interp, pngPtr, fmtObj, imageHandle, destX, destY,
+	    width, height, srcX, srcY);
+
+    if (TCL_OK == result && metadataOutObj != NULL && pngPtr->DPI != -1) {
+	result = Tcl_DictObjPut(NULL, metadataOutObj,
+		Tcl_NewStringObj("DPI",-1),
+		Tcl_NewDoubleObj(pngPtr->DPI));
+    }
+
+    if (TCL_OK == result && metadataOutObj != NULL && pngPtr->aspect != -1) {
+	result = Tcl_DictObjPut(NULL, metadataOutObj,
+		Tcl_NewStringObj("aspect",-1),
+		Tcl_NewDoubleObj(pngPtr->aspect));
+    }
+
+    CleanupPNGImage(pngPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FileReadPNG --
+ *
+ *	This function is called by the photo image type to read PNG format
+ *	data from a file and write it into a given photo image.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	The access position in file f is changed, and new data is added to the
+ *	image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+FileReadPNG(
+    Tcl_Interp* interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Channel chan,		/* The image file, open for reading. */
+    TCL_UNUSED(const char*),	/* The name of the image file. */
+    Tcl_Obj *fmtObj,		/* User-specified format object, or NULL. */
+    TCL_UNUSED(Tcl_Obj*),	/* metadata input, may be NULL */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj* metadataOutObj)	/* metadata return dict, may be NULL */
+{
+    PNGImage png;
+
+    if (InitPNGImage(interp, &png, chan, NULL,
+	    TCL_ZLIB_STREAM_INFLATE) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    return ReadPNG(interp, &png, fmtObj, imageHandle, destX, destY, width,
+	    height, srcX, srcY, metadataOutObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkReadMappedPNG --
+ *
+ *	This function is called by the photo image type to read a large PNG
+ *	file that it has mapped into memory, in place of FileReadPNG. The
+ *	data is decoded where it lies rather than copied in through a
+ *	channel.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	New data is added to the image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkReadMappedPNG(
+    Tcl_Interp* interp,		/* Interpreter to use for reporting errors. */
+    const unsigned char *data,	/* The contents of the image file. */
+    Tcl_Size length,		/* Number of bytes in data. */
+    TCL_UNUSED(const char*),	/* The name of the image file. */
+    Tcl_Obj *fmtObj,		/* User-specified format object, or NULL. */
+    TCL_UNUSED(Tcl_Obj*),	/* metadata input, may be NULL */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj* metadataOutObj)	/* metadata return dict, may be NULL */
+{
+    PNGImage png;
+
+    if (InitPNGImage(interp, &png, NULL, NULL,
+	    TCL_ZLIB_STREAM_INFLATE) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    png.strDataBuf = (unsigned char *) data;
+    png.strDataLen = length;
+    return ReadPNG(interp, &png, fmtObj, imageHandle, destX, destY, width,
+	    height, srcX, srcY, metadataOutObj);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2985,29 +3609,13 @@ StringReadPNG(
     Tcl_Obj *metadataOutObj)	/* metadata return dict, may be NULL */
 {
     PNGImage png;
-    int result = TCL_ERROR;
-
-    result = InitPNGImage(interp, &png, NULL, pObjData,
-	    TCL_ZLIB_STREAM_INFLATE);
-
-    if (TCL_OK == result) {
-	result = DecodePNG(interp, &png, fmtObj, imageHandle, destX, destY, width, height, srcX, srcY);
-    }
-
-    if (TCL_OK == result && metadataOutObj != NULL && png.DPI != -1) {
-	result = Tcl_DictObjPut(NULL, metadataOutObj,
-		Tcl_NewStringObj("DPI",-1),
-		Tcl_NewDoubleObj(png.DPI));
-    }
 
-    if (TCL_OK == result && metadataOutObj != NULL && png.aspect != -1) {
-	result = Tcl_DictObjPut(NULL, metadataOutObj,
-		Tcl_NewStringObj("aspect",-1),
-		Tcl_NewDoubleObj(png.aspect));
+    if (InitPNGImage(interp, &png, NULL, pObjData,
+	    TCL_ZLIB_STREAM_INFLATE) != TCL_OK) {
+	return TCL_ERROR;
     }
-
-    CleanupPNGImage(&png);
-    return result;
+    return ReadPNG(interp, &png, fmtObj, imageHandle, destX, destY, width,
+	    height, srcX, srcY, metadataOutObj);
 }
 
 /*
@@ -3319,128 +3927,494 @@ WriteIHDR(
 /*
  *----------------------------------------------------------------------
  *
- * WriteIDAT --
+ * ExtractLine --
  *
- *	Writes the IDAT (data) chunk to the PNG image, containing the pixel
- *	channel data. Currently, image lines are not filtered and writing
- *	interlaced pixels is not supported.
+ *	Copies a row of pixels from a Tk image block into a buffer, in the
+ *	channel layout of the PNG image being written.
  *
  * Results:
- *	TCL_OK, or TCL_ERROR if the write fails.
+ *	None.
  *
  * Side effects:
- *	None
+ *	The buffer is filled in.
  *
  *----------------------------------------------------------------------
  */
 
-static int
-WriteIDAT(
-    Tcl_Interp *interp,
-    PNGImage *pngPtr,
-    Tk_PhotoImageBlock *blockPtr)
+static void
+ExtractLine(
+    PNGEncodeJob *jobPtr,	/* The image being encoded. */
+    int rowNum,			/* Row of the image block to copy. */
+    unsigned char *destPtr)	/* Where to put the row. */
 {
-    int rowNum, flush = TCL_ZLIB_NO_FLUSH, result;
-    Tcl_Obj *outputObj;
-    unsigned char *outputBytes;
-    Tcl_Size outputSize;
+    Tk_PhotoImageBlock *blockPtr = jobPtr->blockPtr;
+    int colorType = jobPtr->pngPtr->colorType;
+    unsigned char *srcPtr = blockPtr->pixelPtr + rowNum * blockPtr->pitch;
+    int colNum;
 
-    /*
-     * Filter and compress each row one at a time.
-     */
+    if (jobPtr->contiguous) {
+	memcpy(destPtr, srcPtr, jobPtr->lineSize - 1);
+	return;
+    }
 
-    for (rowNum=0 ; rowNum < blockPtr->height ; rowNum++) {
-	int colNum;
-	unsigned char *srcPtr, *destPtr;
+    for (colNum = 0 ; colNum < blockPtr->width ; colNum++) {
+	/*
+	 * Copy red or gray channel.
+	 */
 
-	srcPtr = blockPtr->pixelPtr + (rowNum * blockPtr->pitch);
-	destPtr = Tcl_SetByteArrayLength(pngPtr->thisLineObj,
-		pngPtr->lineSize);
+	*destPtr++ = srcPtr[blockPtr->offset[0]];
 
 	/*
-	 * TODO: use Paeth filtering.
+	 * If not grayscale, copy the green and blue channels.
 	 */
 
-	*destPtr++ = PNG_FILTER_NONE;
+	if (colorType & PNG_COLOR_USED) {
+	    *destPtr++ = srcPtr[blockPtr->offset[1]];
+	    *destPtr++ = srcPtr[blockPtr->offset[2]];
+	}
 
 	/*
-	 * Copy each pixel into the destination buffer after the filter type
-	 * before filtering.
+	 * Copy the alpha channel, if used.
 	 */
 
-	for (colNum = 0 ; colNum < blockPtr->width ; colNum++) {
-	    /*
-	     * Copy red or gray channel.
-	     */
+	if (colorType & PNG_COLOR_ALPHA) {
+	    *destPtr++ = srcPtr[blockPtr->offset[3]];
+	}
 
-	    *destPtr++ = srcPtr[blockPtr->offset[0]];
+	/*
+	 * Point to the start of the next pixel.
+	 */
 
-	    /*
-	     * If not grayscale, copy the green and blue channels.
-	     */
+	srcPtr += blockPtr->pixelSize;
+    }
+}
 
-	    if (pngPtr->colorType & PNG_COLOR_USED) {
-		*destPtr++ = srcPtr[blockPtr->offset[1]];
-		*destPtr++ = srcPtr[blockPtr->offset[2]];
-	    }
+/*
+ *----------------------------------------------------------------------
+ *
+ * FilterLine --
+ *
+ *	Applies a PNG filter to a line of pixels. With PNG_FILTER_ADAPTIVE,
+ *	every filter type is tried and the one whose output has the smallest
+ *	sum of absolute values (taking the bytes as signed) is kept; this is
+ *	the heuristic recommended by the PNG specification, and generally
+ *	makes the line compress best.
+ *
+ * Results:
+ *	Pointer to the filtered line, starting with the filter type byte.
+ *	This is one of the lines in the filtered array.
+ *
+ * Side effects:
+ *	The lines in filtered are overwritten.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	    /*
-	     * Copy the alpha channel, if used.
-	     */
+static unsigned char *
+FilterLine(
+    const unsigned char *thisLine,
+				/* Pixels of the line to filter. */
+    const unsigned char *lastLine,
+				/* Pixels of the line above; zeroes for the
+				 * first line. */
+    int lineLen,		/* Number of bytes of pixels in a line. */
+    int bpp,			/* Number of bytes per pixel. */
+    int filterType,		/* Filter to apply, or PNG_FILTER_ADAPTIVE. */
+    unsigned char *filtered[5])	/* Buffers of lineLen+1 bytes for the output
+				 * of each filter type. */
+{
+    int first = filterType, last = filterType, best = filterType;
+    int type, i;
+    unsigned long sum, bestSum = ULONG_MAX;
 
-	    if (pngPtr->colorType & PNG_COLOR_ALPHA) {
-		*destPtr++ = srcPtr[blockPtr->offset[3]];
-	    }
+    if (filterType == PNG_FILTER_ADAPTIVE) {
+	first = PNG_FILTER_NONE;
+	last = PNG_FILTER_PAETH;
+    }
 
-	    /*
-	     * Point to the start of the next pixel.
-	     */
+    for (type = first ; type <= last ; type++) {
+	unsigned char *out = filtered[type];
+
+	*out++ = (unsigned char) type;
+	switch (type) {
+	case PNG_FILTER_NONE:
+	    memcpy(out, thisLine, lineLen);
+	    break;
+	case PNG_FILTER_SUB:
+	    for (i = 0 ; i < bpp ; i++) {
+		out[i] = thisLine[i];
+	    }
+	    for ( ; i < lineLen ; i++) {
+		out[i] = (unsigned char) (thisLine[i] - thisLine[i - bpp]);
+	    }
+	    break;
+	case PNG_FILTER_UP:
+	    for (i = 0 ; i < lineLen ; i++) {
+		out[i] = (unsigned char) (thisLine[i] - lastLine[i]);
+	    }
+	    break;
+	case PNG_FILTER_AVG:
+	    for (i = 0 ; i < bpp ; i++) {
+		out[i] = (unsigned char) (thisLine[i] - lastLine[i] / 2);
+	    }
+	    for ( ; i < lineLen ; i++) {
+		out[i] = (unsigned char) (thisLine[i]
+			- ((int) thisLine[i - bpp] + (int) lastLine[i]) / 2);
+	    }
+	    break;
+	case PNG_FILTER_PAETH:
+	    for (i = 0 ; i < bpp ; i++) {
+		out[i] = (unsigned char) (thisLine[i] - lastLine[i]);
+	    }
+	    for ( ; i < lineLen ; i++) {
+		out[i] = (unsigned char) (thisLine[i] - Paeth(thisLine[i - bpp],
+			lastLine[i], lastLine[i - bpp]));
+	    }
+	    break;
+	}
 
-	    srcPtr += blockPtr->pixelSize;
+	if (first == last) {
+	    break;
 	}
 
 	/*
-	 * Compress the line of pixels into the destination. If this is the
-	 * last line, finalize the compressor at the same time. Note that this
-	 * can't be just a flush; that leads to a file that some PNG readers
-	 * choke on. [Bug 2984787]
+	 * Score the line, giving up as soon as it cannot be the best.
 	 */
 
-	if (rowNum + 1 == blockPtr->height) {
-	    flush = TCL_ZLIB_FINALIZE;
+	sum = 0;
+	for (i = 0 ; (i < lineLen) && (sum < bestSum) ; i++) {
+	    sum += abs((signed char) out[i]);
 	}
-	if (Tcl_ZlibStreamPut(pngPtr->stream, pngPtr->thisLineObj,
-		flush) != TCL_OK) {
-	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-		    "deflate() returned error", TCL_INDEX_NONE));
-	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "DEFLATE", (char *)NULL);
-	    return TCL_ERROR;
+	if (sum < bestSum) {
+	    bestSum = sum;
+	    best = type;
 	}
+    }
+
+    return filtered[best];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EncodeBand --
+ *
+ *	Filters and compresses one band of rows of an image being written.
+ *	This may run in a worker thread, so it only uses its own zlib stream
+ *	and Tcl_Objs, and hands back the compressed data in memory allocated
+ *	with Tcl_Alloc.
+ *
+ * Results:
+ *	None. The band's bytes are NULL on failure.
+ *
+ * Side effects:
+ *	The band structure is filled in.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+EncodeBand(
+    void *clientData,		/* The image being encoded. */
+    int index)			/* Number of the band to encode. */
+{
+    PNGEncodeJob *jobPtr = (PNGEncodeJob *)clientData;
+    PNGBand *bandPtr = &jobPtr->bands[index];
+    int lineLen = jobPtr->lineSize - 1;
+    int firstRow = index * jobPtr->rowsPerBand;
+    int lastRow = firstRow + jobPtr->rowsPerBand;
+    int rowNum, type, flush;
+    unsigned char *buffer, *thisLine, *lastLine, *filtered[5];
+    unsigned char *outputBytes;
+    Tcl_Size outputSize;
+    Tcl_ZlibStream stream;
+    Tcl_Obj *lineObj, *outputObj;
+
+    bandPtr->bytes = NULL;
+    bandPtr->size = 0;
+    bandPtr->adler = Tcl_ZlibAdler32(0, NULL, 0);
+    if (lastRow > jobPtr->blockPtr->height) {
+	lastRow = jobPtr->blockPtr->height;
+    }
+
+    /*
+     * Room for this line and the last one, plus the output of each filter.
+     */
+
+    buffer = (unsigned char *)Tcl_AttemptAlloc(2 * lineLen
+	    + 5 * jobPtr->lineSize);
+    if (buffer == NULL) {
+	return;
+    }
+    thisLine = buffer;
+    lastLine = buffer + lineLen;
+    for (type = 0 ; type < 5 ; type++) {
+	filtered[type] = buffer + 2 * lineLen + type * jobPtr->lineSize;
+    }
+    if (Tcl_ZlibStreamInit(NULL, TCL_ZLIB_STREAM_DEFLATE, TCL_ZLIB_FORMAT_RAW,
+	    jobPtr->pngPtr->level, NULL, &stream) != TCL_OK) {
+	Tcl_Free(buffer);
+	return;
+    }
+
+    /*
+     * The first line of the band is filtered against the line above it,
+     * exactly as if the image was encoded in one go.
+     */
+
+    if (firstRow > 0) {
+	ExtractLine(jobPtr, firstRow - 1, lastLine);
+    } else {
+	memset(lastLine, 0, lineLen);
+    }
+
+    lineObj = Tcl_NewObj();
+    Tcl_IncrRefCount(lineObj);
+    flush = TCL_ZLIB_NO_FLUSH;
+    for (rowNum = firstRow ; (rowNum < lastRow) || (flush == TCL_ZLIB_NO_FLUSH)
+	    ; rowNum++) {
+	unsigned char *linePtr;
 
 	/*
-	 * Swap line buffers to keep the last around for filtering next.
+	 * The last band finalizes the stream; the others end with a full
+	 * flush, so that the next band can follow without needing anything
+	 * from this one. Note that the end of the image can't be just a
+	 * flush; that leads to a file that some PNG readers choke on. [Bug
+	 * 2984787]
 	 */
 
-	{
-	    Tcl_Obj *temp = pngPtr->lastLineObj;
+	if (rowNum + 1 >= lastRow) {
+	    flush = (index + 1 == jobPtr->numBands)
+		    ? TCL_ZLIB_FINALIZE : TCL_ZLIB_FULLFLUSH;
+	}
+	if (rowNum < lastRow) {
+	    ExtractLine(jobPtr, rowNum, thisLine);
+	    linePtr = FilterLine(thisLine, lastLine, lineLen,
+		    jobPtr->pngPtr->bytesPerPixel, jobPtr->pngPtr->filterType,
+		    filtered);
+	    memcpy(Tcl_SetByteArrayLength(lineObj, jobPtr->lineSize),
+		    linePtr, jobPtr->lineSize);
+	    bandPtr->adler = Tcl_ZlibAdler32(bandPtr->adler, linePtr,
+		    jobPtr->lineSize);
+	    bandPtr->size += jobPtr->lineSize;
+
+	    /*
+	     * Swap line buffers to keep the last around for filtering next.
+	     */
 
-	    pngPtr->lastLineObj = pngPtr->thisLineObj;
-	    pngPtr->thisLineObj = temp;
+	    linePtr = lastLine;
+	    lastLine = thisLine;
+	    thisLine = linePtr;
+	} else {
+	    Tcl_SetByteArrayLength(lineObj, 0);
+	}
+	if (Tcl_ZlibStreamPut(stream, lineObj, flush) != TCL_OK) {
+	    goto done;
 	}
     }
 
     /*
-     * Now get the compressed data and write it as one big IDAT chunk.
+     * Collect the compressed data. The size field holds the length of the
+     * uncompressed data until now, which the Adler-32 checksums of the
+     * bands need to be combined.
      */
 
     outputObj = Tcl_NewObj();
-    (void) Tcl_ZlibStreamGet(pngPtr->stream, outputObj, TCL_INDEX_NONE);
-    outputBytes = Tcl_GetByteArrayFromObj(outputObj, &outputSize);
-    result = WriteChunk(interp, pngPtr, CHUNK_IDAT, outputBytes, outputSize);
+    Tcl_IncrRefCount(outputObj);
+    if (Tcl_ZlibStreamGet(stream, outputObj, TCL_INDEX_NONE) == TCL_OK) {
+	outputBytes = Tcl_GetByteArrayFromObj(outputObj, &outputSize);
+	bandPtr->bytes = (unsigned char *)Tcl_AttemptAlloc(
+		outputSize ? outputSize : 1);
+	if (bandPtr->bytes != NULL) {
+	    memcpy(bandPtr->bytes, outputBytes, outputSize);
+	    bandPtr->length = bandPtr->size;
+	    bandPtr->size = outputSize;
+	}
+    }
     Tcl_DecrRefCount(outputObj);
+
+  done:
+    Tcl_DecrRefCount(lineObj);
+    Tcl_ZlibStreamClose(stream);
+    Tcl_Free(buffer);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CombineAdler32 --
+ *
+ *	Computes the Adler-32 checksum of two pieces of data put one after the
+ *	other, from the checksums of the pieces. This is the same computation
+ *	as adler32_combine() in zlib, which Tcl does not make available.
+ *
+ * Results:
+ *	The combined checksum.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+CombineAdler32(
+    unsigned long adler1,	/* Checksum of the first piece. */
+    unsigned long adler2,	/* Checksum of the second piece. */
+    Tcl_Size len2)		/* Length of the second piece. */
+{
+    const unsigned long base = 65521;
+    unsigned long rem = (unsigned long) (len2 % base);
+    unsigned long sum1 = adler1 & 0xffff;
+    unsigned long sum2 = (rem * sum1) % base;
+
+    sum1 += (adler2 & 0xffff) + base - 1;
+    sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + base - rem;
+    if (sum1 >= base) {
+	sum1 -= base;
+    }
+    if (sum1 >= base) {
+	sum1 -= base;
+    }
+    if (sum2 >= (base << 1)) {
+	sum2 -= (base << 1);
+    }
+    if (sum2 >= base) {
+	sum2 -= base;
+    }
+    return sum1 | (sum2 << 16);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriteIDAT --
+ *
+ *	Writes the IDAT (data) chunk to the PNG image, containing the image
+ *	pixel data. The rows are filtered, choosing a filter for each of them
+ *	unless the -filter option says otherwise, and compressed in bands
+ *	which are encoded in parallel for large images. The bands are joined
+ *	into a single zlib stream.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	The IDAT chunk is written.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+WriteIDAT(
+    Tcl_Interp *interp,
+    PNGImage *pngPtr,
+    Tk_PhotoImageBlock *blockPtr)
+{
+    PNGEncodeJob job;
+    int i, result = TCL_ERROR, level = pngPtr->level;
+    unsigned char *outputBytes = NULL, *p;
+    Tcl_Size outputSize = 6;
+    unsigned long adler = Tcl_ZlibAdler32(0, NULL, 0);
+
+    job.pngPtr = pngPtr;
+    job.blockPtr = blockPtr;
+    job.lineSize = pngPtr->lineSize;
+    job.rowsPerBand = PNG_BAND_SZ / pngPtr->lineSize;
+    if (job.rowsPerBand < 1) {
+	job.rowsPerBand = 1;
+    }
+    job.numBands = (blockPtr->height + job.rowsPerBand - 1) / job.rowsPerBand;
+    if (job.numBands < 1) {
+	job.numBands = 1;
+    }
+
+    /*
+     * Rows can be copied as they are if the block has exactly the channels
+     * that are written, in the right order.
+     */
+
+    job.contiguous = (blockPtr->pixelSize == pngPtr->bytesPerPixel)
+	    && (blockPtr->offset[0] == 0);
+    if (pngPtr->colorType & PNG_COLOR_USED) {
+	job.contiguous = job.contiguous && (blockPtr->offset[1] == 1)
+		&& (blockPtr->offset[2] == 2);
+    }
+    if (pngPtr->colorType & PNG_COLOR_ALPHA) {
+	job.contiguous = job.contiguous
+		&& (blockPtr->offset[3] == pngPtr->bytesPerPixel - 1);
+    }
+
+    job.bands = (PNGBand *)Tcl_AttemptAlloc(job.numBands * sizeof(PNGBand));
+    if (job.bands == NULL) {
+	goto memoryError;
+    }
+    TkRunParallel(job.numBands, EncodeBand, &job);
+
+    for (i = 0 ; i < job.numBands ; i++) {
+	if (job.bands[i].bytes == NULL) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "deflate() returned error", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PNG", "DEFLATE", (char *)NULL);
+	    goto done;
+	}
+	outputSize += job.bands[i].size;
+	adler = CombineAdler32(adler, job.bands[i].adler, job.bands[i].length);
+    }
+
+    /*
+     * Put the bands together in a zlib stream: a two byte header giving the
+     * compression method and level, the compressed data, and the checksum
+     * of the uncompressed data.
+     */
+
+    outputBytes = (unsigned char *)Tcl_AttemptAlloc(outputSize);
+    if (outputBytes == NULL) {
+	goto memoryError;
+    }
+    p = outputBytes;
+    *p++ = 0x78;
+    *p = (level == TCL_ZLIB_COMPRESS_DEFAULT) ? 2 << 6
+	    : (level < 2) ? 0 : (level < 6) ? 1 << 6 : (level == 6) ? 2 << 6
+	    : 3 << 6;
+    *p += 31 - (0x7800 + *p) % 31;
+    p++;
+    for (i = 0 ; i < job.numBands ; i++) {
+	memcpy(p, job.bands[i].bytes, job.bands[i].size);
+	p += job.bands[i].size;
+    }
+    *p++ = (unsigned char) (adler >> 24);
+    *p++ = (unsigned char) (adler >> 16);
+    *p++ = (unsigned char) (adler >> 8);
+    *p++ = (unsigned char) adler;
+
+    /*
+     * Now write the compressed data as one big IDAT chunk.
+     */
+
+    result = WriteChunk(interp, pngPtr, CHUNK_IDAT, outputBytes, outputSize);
+    goto done;
+
+  memoryError:
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "memory allocation failed", TCL_INDEX_NONE));
+    Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
+
+  done:
+    if (job.bands != NULL) {
+	for (i = 0 ; i < job.numBands ; i++) {
+	    if (job.bands[i].bytes != NULL) {
+		Tcl_Free(job.bands[i].bytes);
+	    }
+	}
+	Tcl_Free(job.bands);
+    }
+    if (outputBytes != NULL) {
+	Tcl_Free(outputBytes);
+    }
     return result;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3668,11 +4642,6 @@ EncodePNG(
 	return TCL_ERROR;
     }
 
-    pngPtr->lastLineObj = Tcl_NewObj();
-    Tcl_IncrRefCount(pngPtr->lastLineObj);
-    pngPtr->thisLineObj = Tcl_NewObj();
-    Tcl_IncrRefCount(pngPtr->thisLineObj);
-
     /*
      * Write out the PNG Signature that all PNGs begin with.
      */
@@ -3737,7 +4706,7 @@ static int
 FileWritePNG(
     Tcl_Interp *interp,
     const char *filename,
-    TCL_UNUSED(Tcl_Obj *),
+    Tcl_Obj *fmtObj,
     Tcl_Obj *metadataInObj,
     Tk_PhotoImageBlock *blockPtr)
 {
@@ -3764,6 +4733,9 @@ FileWritePNG(
 	    TCL_ZLIB_STREAM_DEFLATE) == TCL_ERROR) {
 	goto cleanup;
     }
+    if (ParseFormat(interp, fmtObj, &png) == TCL_ERROR) {
+	goto cleanup;
+    }
 
     if (Tcl_SetChannelOption(interp, chan, "-translation", "binary")
 	    != TCL_OK) {
@@ -3803,7 +4775,7 @@ FileWritePNG(
 static int
 StringWritePNG(
     Tcl_Interp *interp,
-    TCL_UNUSED(Tcl_Obj *),
+    Tcl_Obj *fmtObj,
     Tcl_Obj *metadataInObj,
     Tk_PhotoImageBlock *blockPtr)
 {
@@ -3819,6 +4791,9 @@ StringWritePNG(
 	    TCL_ZLIB_STREAM_DEFLATE) == TCL_ERROR) {
 	goto cleanup;
     }
+    if (ParseFormat(interp, fmtObj, &png) == TCL_ERROR) {
+	goto cleanup;
+    }
 
     /*
      * Write the raw PNG data into the prepared Tcl_Obj buffer. Set the result
@@ -73,9 +73,18 @@ Tk_PhotoImageFormat tkImgFmtPPM = {
 
 static int		ReadPPMFileHeader(Tcl_Channel chan, int *widthPtr,
 			    int *heightPtr, int *maxIntensityPtr);
-static int		ReadPPMStringHeader(Tcl_Obj *dataObj, int *widthPtr,
+static int		ReadPPMData(Tcl_Interp *interp,
+			    const unsigned char *data, Tcl_Size length,
+			    const char *fileName, Tk_PhotoHandle imageHandle,
+			    int destX, int destY, int width, int height,
+			    int srcX, int srcY);
+static int		TruncatedPPM(Tcl_Interp *interp,
+			    const char *fileName);
+static int		ReadPPMStringHeader(const unsigned char *dataBuffer,
+			    Tcl_Size dataSize, int *widthPtr,
 			    int *heightPtr, int *maxIntensityPtr,
-			    unsigned char **dataBufferPtr, int *dataSizePtr);
+			    const unsigned char **dataBufferPtr,
+			    Tcl_Size *dataSizePtr);
 
 /*
  *----------------------------------------------------------------------
@@ -453,8 +462,11 @@ StringMatchPPM(
     TCL_UNUSED(Tcl_Interp *))		/* unused */
 {
     int dummy;
+    Tcl_Size dataSize;
+    const unsigned char *dataBuffer =
+	    Tcl_GetByteArrayFromObj(dataObj, &dataSize);
 
-    return ReadPPMStringHeader(dataObj, widthPtr, heightPtr,
+    return ReadPPMStringHeader(dataBuffer, dataSize, widthPtr, heightPtr,
 	    &dummy, NULL, NULL);
 }
 
@@ -488,36 +500,134 @@ StringReadPPM(
 				 * written to. */
     int srcX, int srcY)		/* Coordinates of top-left pixel to be used in
 				 * image being read. */
+{
+    Tcl_Size length;
+    const unsigned char *data = Tcl_GetByteArrayFromObj(dataObj, &length);
+
+    return ReadPPMData(interp, data, length, NULL, imageHandle, destX,
+	    destY, width, height, srcX, srcY);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkReadMappedPPM --
+ *
+ *	This function is called by the photo image type to read a large PPM
+ *	file that it has mapped into memory, in place of FileReadPPM. Images
+ *	with 8-bit samples go into the photo image straight from the mapped
+ *	file.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	New data is added to the image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkReadMappedPPM(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    const unsigned char *data,	/* The contents of the image file. */
+    Tcl_Size length,		/* Number of bytes in data. */
+    const char *fileName,	/* The name of the image file. */
+    TCL_UNUSED(Tcl_Obj *),	/* User-specified format string, or NULL. */
+    TCL_UNUSED(Tcl_Obj *),	/* metadata input, may be NULL */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    TCL_UNUSED(Tcl_Obj *))	/* metadata return dict, may be NULL */
+{
+    return ReadPPMData(interp, data, length, fileName, imageHandle, destX,
+	    destY, width, height, srcX, srcY);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadPPMData --
+ *
+ *	Reads PPM format data held in memory, from a string or a mapped file,
+ *	and writes it into a given photo image.
+ *
+ * Results:
+ *	A standard TCL completion code. If TCL_ERROR is returned then an error
+ *	message is left in the interp's result.
+ *
+ * Side effects:
+ *	New data is added to the image given by imageHandle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadPPMData(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    const unsigned char *data,	/* The image data. */
+    Tcl_Size length,		/* Number of bytes in data. */
+    const char *fileName,	/* The name of the image file, or NULL if the
+				 * data is a string. */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY)		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
 {
     int fileWidth, fileHeight, maxIntensity;
-    int nLines, nBytes, h, type, count, dataSize, bytesPerChannel = 1;
-    unsigned char *pixelPtr, *dataBuffer;
+    int nLines, nBytes, h, type, count, bytesPerChannel = 1;
+    Tcl_Size dataSize;
+    const unsigned char *dataBuffer;
+    unsigned char *pixelPtr;
     Tk_PhotoImageBlock block;
 
-    type = ReadPPMStringHeader(dataObj, &fileWidth, &fileHeight,
+    type = ReadPPMStringHeader(data, length, &fileWidth, &fileHeight,
 	    &maxIntensity, &dataBuffer, &dataSize);
     if (type == 0) {
-	Tcl_SetObjResult(interp, Tcl_NewStringObj(
-		"couldn't read raw PPM header from string", TCL_INDEX_NONE));
+	if (fileName != NULL) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "couldn't read raw PPM header from file \"%s\"", fileName));
+	} else {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "couldn't read raw PPM header from string", TCL_INDEX_NONE));
+	}
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "NO_HEADER", (char *)NULL);
 	return TCL_ERROR;
     }
     if ((fileWidth <= 0) || (fileHeight <= 0)) {
-	Tcl_SetObjResult(interp, Tcl_NewStringObj(
-		"PPM image data has dimension(s) <= 0", TCL_INDEX_NONE));
+	if (fileName != NULL) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "PPM image file \"%s\" has dimension(s) <= 0", fileName));
+	} else {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "PPM image data has dimension(s) <= 0", TCL_INDEX_NONE));
+	}
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "DIMENSIONS", (char *)NULL);
 	return TCL_ERROR;
     }
     if ((maxIntensity <= 0) || (maxIntensity > 0xffff)) {
-	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
-		"PPM image data has bad maximum intensity value %d",
-		maxIntensity));
+	if (fileName != NULL) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "PPM image file \"%s\" has bad maximum intensity value %d",
+		    fileName, maxIntensity));
+	} else {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "PPM image data has bad maximum intensity value %d",
+		    maxIntensity));
+	}
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "INTENSITY", (char *)NULL);
 	return TCL_ERROR;
     } else if (maxIntensity > 0x00ff) {
 	bytesPerChannel = 2;
     }
-
     if ((srcX + width) > fileWidth) {
 	width = fileWidth - srcX;
     }
@@ -545,8 +655,11 @@ StringReadPPM(
     block.pitch = block.pixelSize * fileWidth;
 
     if (srcY > 0) {
-	dataBuffer += srcY * block.pitch;
-	dataSize -= srcY * block.pitch;
+	if ((Tcl_Size) srcY * block.pitch > dataSize) {
+	    return TruncatedPPM(interp, fileName);
+	}
+	dataBuffer += (Tcl_Size) srcY * block.pitch;
+	dataSize -= (Tcl_Size) srcY * block.pitch;
     }
 
     if (maxIntensity == 0x00ff) {
@@ -554,13 +667,10 @@ StringReadPPM(
 	 * We have all the data in memory, so write everything in one go.
 	 */
 
-	if (block.pitch*height > dataSize) {
-	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-		    "truncated PPM data", TCL_INDEX_NONE));
-	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "TRUNCATED", (char *)NULL);
-	    return TCL_ERROR;
+	if ((Tcl_Size) block.pitch * height > dataSize) {
+	    return TruncatedPPM(interp, fileName);
 	}
-	block.pixelPtr = dataBuffer + srcX * block.pixelSize;
+	block.pixelPtr = (unsigned char *) dataBuffer + srcX * block.pixelSize;
 	block.height = height;
 	return Tk_PhotoPutBlock(interp, imageHandle, &block, destX, destY,
 		width, height, TK_PHOTO_COMPOSITE_SET);
@@ -591,10 +701,7 @@ StringReadPPM(
 	}
 	if (dataSize < nBytes) {
 	    Tcl_Free(pixelPtr);
-	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-		    "truncated PPM data", TCL_INDEX_NONE));
-	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "TRUNCATED", (char *)NULL);
-	    return TCL_ERROR;
+	    return TruncatedPPM(interp, fileName);
 	}
 	if (maxIntensity < 0x00ff) {
 	    for (p=pixelPtr,count=nBytes ; count>0 ; count--,p++,dataBuffer++) {
@@ -623,6 +730,42 @@ StringReadPPM(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TruncatedPPM --
+ *
+ *	Reports that PPM data held in memory ends before the image does, in
+ *	the same words as the channel reader for files.
+ *
+ * Results:
+ *	TCL_ERROR, with the message in the interp's result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TruncatedPPM(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    const char *fileName)	/* The name of the image file, or NULL if the
+				 * data is a string. */
+{
+    if (fileName != NULL) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"error reading PPM image file \"%s\": not enough data",
+		fileName));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "EOF", (char *)NULL);
+    } else {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"truncated PPM data", TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "PPM", "TRUNCATED", (char *)NULL);
+    }
+    return TCL_ERROR;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -751,22 +894,21 @@ ReadPPMFileHeader(
 
 static int
 ReadPPMStringHeader(
-    Tcl_Obj *dataPtr,		/* Object to read the header from. */
+    const unsigned char *dataBuffer,
+				/* Data to read the header from. */
+    Tcl_Size dataSize,		/* Number of bytes in dataBuffer. */
     int *widthPtr, int *heightPtr,
 				/* The dimensions of the image are returned
 				 * here. */
     int *maxIntensityPtr,	/* The maximum intensity value for the image
 				 * is stored here. */
-    unsigned char **dataBufferPtr,
-    int *dataSizePtr)
+    const unsigned char **dataBufferPtr,
+    Tcl_Size *dataSizePtr)
 {
 #define BUFFER_SIZE 1000
     char buffer[BUFFER_SIZE], c;
     int i, numFields, type = 0;
-    Tcl_Size dataSize;
-    unsigned char *dataBuffer;
 
-    dataBuffer = Tcl_GetByteArrayFromObj(dataPtr, &dataSize);
     if (!dataBuffer) {
 	return 0;
     }
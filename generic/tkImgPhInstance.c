@@ -49,6 +49,7 @@ static void		BlendComplexAlpha(XImage *bgImg, PhotoInstance *iPtr,
 static int		IsValidPalette(PhotoInstance *instancePtr,
 			    const char *palette);
 static int		CountBits(unsigned mask);
+static int		MaskShift(unsigned long mask);
 static void		GetColorTable(PhotoInstance *instancePtr);
 static void		FreeColorTable(ColorTable *colorPtr, int force);
 static void		AllocateColors(ColorTable *colorPtr);
@@ -307,6 +308,9 @@ TkImgPhotoGet(
     instancePtr->width = 0;
     instancePtr->height = 0;
     instancePtr->imagePtr = 0;
+#ifdef HAVE_XSHM
+    instancePtr->shmSegment = NULL;
+#endif
     instancePtr->nextPtr = modelPtr->instancePtr;
     modelPtr->instancePtr = instancePtr;
 
@@ -416,6 +420,416 @@ TkImgPhotoGet(
     return instancePtr;
 }
 
+/*
+ * Row kernels for TrueColor visuals with 8-bit components (see
+ * DIRECT_PIXELS). The convert kernel turns model pixels (RGBA, 4 bytes per
+ * pixel) into 32-bit pixel values; the blend kernel composites them
+ * source-over onto pixel values in place, exactly as BlendComplexAlpha does
+ * one pixel at a time. Besides the plain C versions there are SSE2 and AVX2
+ * ones where the compiler can build them; the best one the CPU supports is
+ * picked on first use. All of them produce identical results.
+ */
+
+typedef void (PixelRowProc)(const unsigned char *src, unsigned *dst,
+	Tcl_Size count, int redShift, int greenShift, int blueShift);
+
+typedef struct {
+    const char *name;		/* Name used by TkDebugPhotoKernel. */
+    PixelRowProc *convertProc;	/* Converts RGBA to pixel values, ignoring
+				 * alpha. */
+    PixelRowProc *blendProc;	/* Composites RGBA onto pixel values. */
+} PixelKernels;
+
+#if defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define TK_PHOTO_SSE2 1
+#   include <emmintrin.h>
+#   if defined(__clang__) || (defined(__GNUC__) && !defined(__INTEL_COMPILER) \
+	    && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))))
+#	define TK_PHOTO_AVX2 1
+#	include <immintrin.h>
+#	define TK_AVX2_FUNC __attribute__((target("avx2")))
+#   endif
+#endif
+
+static void
+ConvertRowScalar(
+    const unsigned char *src,	/* RGBA source pixels. */
+    unsigned *dst,		/* Where to store the pixel values. */
+    Tcl_Size count,		/* Number of pixels. */
+    int redShift, int greenShift, int blueShift)
+{
+    Tcl_Size i;
+
+    for (i = 0; i < count; i++, src += 4) {
+	dst[i] = ((unsigned) src[0] << redShift)
+		| ((unsigned) src[1] << greenShift)
+		| ((unsigned) src[2] << blueShift);
+    }
+}
+
+static void
+BlendRowScalar(
+    const unsigned char *src,	/* RGBA source pixels. */
+    unsigned *dst,		/* Pixel values to draw over. */
+    Tcl_Size count,		/* Number of pixels. */
+    int redShift, int greenShift, int blueShift)
+{
+    Tcl_Size i;
+
+    for (i = 0; i < count; i++, src += 4) {
+	unsigned alpha = src[3], unalpha, pixel, r, g, b;
+
+	if (alpha == 0) {
+	    continue;
+	}
+	r = src[0];
+	g = src[1];
+	b = src[2];
+	if (alpha != 255) {
+	    pixel = dst[i];
+	    unalpha = 255 - alpha;
+	    r = (((pixel >> redShift) & 0xFF) * unalpha + r * alpha) / 255;
+	    g = (((pixel >> greenShift) & 0xFF) * unalpha + g * alpha) / 255;
+	    b = (((pixel >> blueShift) & 0xFF) * unalpha + b * alpha) / 255;
+	}
+	dst[i] = (r << redShift) | (g << greenShift) | (b << blueShift);
+    }
+}
+
+#ifdef TK_PHOTO_SSE2
+/*
+ * The vector versions keep one pixel per 32-bit lane. Component products
+ * fit in the low 16 bits of a lane, so _mm_mullo_epi16 can be used, and
+ * x / 255 is computed as (x + 1 + (x >> 8)) >> 8, which is exact for the
+ * range involved.
+ */
+
+static inline __m128i
+BlendComponentSSE2(
+    __m128i src, int srcShift, __m128i dst, __m128i dstShift,
+    __m128i alpha, __m128i unalpha)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    __m128i s = _mm_and_si128(_mm_srli_epi32(src, srcShift), ff);
+    __m128i d = _mm_and_si128(_mm_srl_epi32(dst, dstShift), ff);
+    __m128i x = _mm_add_epi32(_mm_mullo_epi16(d, unalpha),
+	    _mm_mullo_epi16(s, alpha));
+
+    x = _mm_add_epi32(x, _mm_add_epi32(_mm_srli_epi32(x, 8),
+	    _mm_set1_epi32(1)));
+    return _mm_sll_epi32(_mm_srli_epi32(x, 8), dstShift);
+}
+
+static void
+ConvertRowSSE2(
+    const unsigned char *src,
+    unsigned *dst,
+    Tcl_Size count,
+    int redShift, int greenShift, int blueShift)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    const __m128i rs = _mm_cvtsi32_si128(redShift);
+    const __m128i gs = _mm_cvtsi32_si128(greenShift);
+    const __m128i bs = _mm_cvtsi32_si128(blueShift);
+    Tcl_Size i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+	__m128i v = _mm_loadu_si128((const __m128i *) (src + 4 * i));
+	__m128i r = _mm_sll_epi32(_mm_and_si128(v, ff), rs);
+	__m128i g = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(v, 8), ff),
+		gs);
+	__m128i b = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(v, 16), ff),
+		bs);
+
+	_mm_storeu_si128((__m128i *) (dst + i),
+		_mm_or_si128(_mm_or_si128(r, g), b));
+    }
+    ConvertRowScalar(src + 4 * i, dst + i, count - i,
+	    redShift, greenShift, blueShift);
+}
+
+static void
+BlendRowSSE2(
+    const unsigned char *src,
+    unsigned *dst,
+    Tcl_Size count,
+    int redShift, int greenShift, int blueShift)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    const __m128i rs = _mm_cvtsi32_si128(redShift);
+    const __m128i gs = _mm_cvtsi32_si128(greenShift);
+    const __m128i bs = _mm_cvtsi32_si128(blueShift);
+    Tcl_Size i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+	__m128i s = _mm_loadu_si128((const __m128i *) (src + 4 * i));
+	__m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+	__m128i alpha = _mm_srli_epi32(s, 24);
+	__m128i unalpha = _mm_sub_epi32(ff, alpha);
+	__m128i keep = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+	__m128i out;
+
+	if (_mm_movemask_epi8(keep) == 0xFFFF) {
+	    continue;
+	}
+	out = _mm_or_si128(_mm_or_si128(
+		BlendComponentSSE2(s, 0, d, rs, alpha, unalpha),
+		BlendComponentSSE2(s, 8, d, gs, alpha, unalpha)),
+		BlendComponentSSE2(s, 16, d, bs, alpha, unalpha));
+	out = _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, out));
+	_mm_storeu_si128((__m128i *) (dst + i), out);
+    }
+    BlendRowScalar(src + 4 * i, dst + i, count - i,
+	    redShift, greenShift, blueShift);
+}
+#endif /* TK_PHOTO_SSE2 */
+
+#ifdef TK_PHOTO_AVX2
+TK_AVX2_FUNC static inline __m256i
+BlendComponentAVX2(
+    __m256i src, int srcShift, __m256i dst, __m128i dstShift,
+    __m256i alpha, __m256i unalpha)
+{
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    __m256i s = _mm256_and_si256(_mm256_srli_epi32(src, srcShift), ff);
+    __m256i d = _mm256_and_si256(_mm256_srl_epi32(dst, dstShift), ff);
+    __m256i x = _mm256_add_epi32(_mm256_mullo_epi16(d, unalpha),
+	    _mm256_mullo_epi16(s, alpha));
+
+    x = _mm256_add_epi32(x, _mm256_add_epi32(_mm256_srli_epi32(x, 8),
+	    _mm256_set1_epi32(1)));
+    return _mm256_sll_epi32(_mm256_srli_epi32(x, 8), dstShift);
+}
+
+TK_AVX2_FUNC static void
+ConvertRowAVX2(
+    const unsigned char *src,
+    unsigned *dst,
+    Tcl_Size count,
+    int redShift, int greenShift, int blueShift)
+{
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    const __m128i rs = _mm_cvtsi32_si128(redShift);
+    const __m128i gs = _mm_cvtsi32_si128(greenShift);
+    const __m128i bs = _mm_cvtsi32_si128(blueShift);
+    Tcl_Size i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+	__m256i v = _mm256_loadu_si256((const __m256i *) (src + 4 * i));
+	__m256i r = _mm256_sll_epi32(_mm256_and_si256(v, ff), rs);
+	__m256i g = _mm256_sll_epi32(
+		_mm256_and_si256(_mm256_srli_epi32(v, 8), ff), gs);
+	__m256i b = _mm256_sll_epi32(
+		_mm256_and_si256(_mm256_srli_epi32(v, 16), ff), bs);
+
+	_mm256_storeu_si256((__m256i *) (dst + i),
+		_mm256_or_si256(_mm256_or_si256(r, g), b));
+    }
+    ConvertRowSSE2(src + 4 * i, dst + i, count - i,
+	    redShift, greenShift, blueShift);
+}
+
+TK_AVX2_FUNC static void
+BlendRowAVX2(
+    const unsigned char *src,
+    unsigned *dst,
+    Tcl_Size count,
+    int redShift, int greenShift, int blueShift)
+{
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    const __m128i rs = _mm_cvtsi32_si128(redShift);
+    const __m128i gs = _mm_cvtsi32_si128(greenShift);
+    const __m128i bs = _mm_cvtsi32_si128(blueShift);
+    Tcl_Size i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+	__m256i s = _mm256_loadu_si256((const __m256i *) (src + 4 * i));
+	__m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+	__m256i alpha = _mm256_srli_epi32(s, 24);
+	__m256i unalpha = _mm256_sub_epi32(ff, alpha);
+	__m256i keep = _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256());
+	__m256i out;
+
+	if (_mm256_movemask_epi8(keep) == -1) {
+	    continue;
+	}
+	out = _mm256_or_si256(_mm256_or_si256(
+		BlendComponentAVX2(s, 0, d, rs, alpha, unalpha),
+		BlendComponentAVX2(s, 8, d, gs, alpha, unalpha)),
+		BlendComponentAVX2(s, 16, d, bs, alpha, unalpha));
+	out = _mm256_blendv_epi8(out, d, keep);
+	_mm256_storeu_si256((__m256i *) (dst + i), out);
+    }
+    BlendRowSSE2(src + 4 * i, dst + i, count - i,
+	    redShift, greenShift, blueShift);
+}
+#endif /* TK_PHOTO_AVX2 */
+
+static const PixelKernels pixelKernels[] = {
+#ifdef TK_PHOTO_AVX2
+    {"avx2", ConvertRowAVX2, BlendRowAVX2},
+#endif
+#ifdef TK_PHOTO_SSE2
+    {"sse2", ConvertRowSSE2, BlendRowSSE2},
+#endif
+    {"scalar", ConvertRowScalar, BlendRowScalar}
+};
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetPixelKernels --
+ *
+ *	Looks up a set of row kernels by name, or picks the fastest one the
+ *	CPU supports.
+ *
+ * Results:
+ *	The kernels, or NULL if the named ones do not exist or cannot run
+ *	on this CPU.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const PixelKernels *
+GetPixelKernels(
+    const char *name)		/* Kernel name, or NULL for the best. */
+{
+    static const PixelKernels *bestPtr = NULL;
+    size_t i;
+
+    if ((name == NULL) && (bestPtr != NULL)) {
+	return bestPtr;
+    }
+    for (i = 0; i < sizeof(pixelKernels) / sizeof(pixelKernels[0]); i++) {
+#ifdef TK_PHOTO_AVX2
+	if (pixelKernels[i].convertProc == ConvertRowAVX2) {
+	    __builtin_cpu_init();
+	    if (!__builtin_cpu_supports("avx2")) {
+		continue;
+	    }
+	}
+#endif
+	if (name == NULL) {
+	    bestPtr = &pixelKernels[i];
+	    return bestPtr;
+	}
+	if (strcmp(name, pixelKernels[i].name) == 0) {
+	    return &pixelKernels[i];
+	}
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkDebugPhotoKernel --
+ *
+ *	Runs one of the photo row kernels repeatedly over generated pixels,
+ *	for timing and for checking that all kernels agree. Used by the
+ *	"testphotokernel" command.
+ *
+ * Results:
+ *	A standard Tcl result. On success the interpreter result is a list
+ *	of the kernel name, the elapsed time in microseconds and a checksum
+ *	of the output pixels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkDebugPhotoKernel(
+    Tcl_Interp *interp,		/* For the result and error messages. */
+    const char *kernel,		/* Kernel name, or NULL or "" for the one
+				 * normally used. */
+    const char *operation,	/* "convert" or "blend". */
+    Tcl_Size count,		/* Number of pixels per run. */
+    int iterations,		/* Number of runs. */
+    int redShift, int greenShift, int blueShift)
+{
+    const PixelKernels *kernelsPtr;
+    PixelRowProc *proc;
+    unsigned char *src;
+    unsigned *dst, seed = 1, sum = 2166136261U;
+    Tcl_Time start, stop;
+    Tcl_Size i;
+    Tcl_Obj *result[3];
+
+    kernelsPtr = GetPixelKernels((kernel && *kernel) ? kernel : NULL);
+    if (kernelsPtr == NULL) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"unknown or unsupported kernel \"%s\"", kernel));
+	Tcl_SetErrorCode(interp, "TK", "LOOKUP", "KERNEL", kernel, (char *)NULL);
+	return TCL_ERROR;
+    }
+    if (strcmp(operation, "convert") == 0) {
+	proc = kernelsPtr->convertProc;
+    } else if (strcmp(operation, "blend") == 0) {
+	proc = kernelsPtr->blendProc;
+    } else {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"bad operation \"%s\": must be blend or convert", operation));
+	Tcl_SetErrorCode(interp, "TK", "VALUE", "KERNEL", (char *)NULL);
+	return TCL_ERROR;
+    }
+    if ((count < 0) || (iterations < 0) || (redShift < 0) || (redShift > 24)
+	    || (greenShift < 0) || (greenShift > 24)
+	    || (blueShift < 0) || (blueShift > 24)) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"bad pixel count, iteration count or shift", -1));
+	Tcl_SetErrorCode(interp, "TK", "VALUE", "KERNEL", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    /*
+     * Every fourth source pixel is fully transparent and every fourth one
+     * fully opaque, so that all branches of the blend are exercised.
+     */
+
+    src = (unsigned char *)Tcl_Alloc(4 * count + 1);
+    dst = (unsigned *)Tcl_Alloc(sizeof(unsigned) * count + 1);
+    for (i = 0; i < 4 * count; i++) {
+	seed = seed * 1103515245U + 12345U;
+	src[i] = (unsigned char) (seed >> 16);
+    }
+    for (i = 0; i < count; i++) {
+	seed = seed * 1103515245U + 12345U;
+	dst[i] = seed;
+	if ((i & 3) == 1) {
+	    src[4 * i + 3] = 0;
+	} else if ((i & 3) == 3) {
+	    src[4 * i + 3] = 255;
+	}
+    }
+
+    Tcl_GetTime(&start);
+    for (i = 0; i < iterations; i++) {
+	proc(src, dst, count, redShift, greenShift, blueShift);
+    }
+    Tcl_GetTime(&stop);
+
+    for (i = 0; i < count; i++) {
+	sum = (sum ^ dst[i]) * 16777619U;
+    }
+    Tcl_Free(src);
+    Tcl_Free(dst);
+
+    result[0] = Tcl_NewStringObj(kernelsPtr->name, -1);
+    result[1] = Tcl_NewWideIntObj(
+	    ((Tcl_WideInt) stop.sec - start.sec) * 1000000
+	    + (stop.usec - start.usec));
+    result[2] = Tcl_NewWideIntObj(sum);
+    Tcl_SetObjResult(interp, Tcl_NewListObj(3, result));
+    return TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -488,29 +902,44 @@ BlendComplexAlpha(
 
     /*
      * We have to get the mask and shift info from the visual on non-Win32 so
-     * that the macros Get*Value(), RGB() and RGB15() work correctly. This
-     * might be cached for better performance.
+     * that the macros Get*Value(), RGB() and RGB15() work correctly. The
+     * shifts are cached in the color table.
      */
 
 #ifndef _WIN32
     unsigned long red_mask, green_mask, blue_mask;
     unsigned long red_shift, green_shift, blue_shift;
     Visual *visual = iPtr->visualInfo.visual;
+    ColorTable *colorPtr = iPtr->colorTablePtr;
 
     red_mask = visual->red_mask;
     green_mask = visual->green_mask;
     blue_mask = visual->blue_mask;
-    red_shift = 0;
-    green_shift = 0;
-    blue_shift = 0;
-    while ((0x0001 & (red_mask >> red_shift)) == 0) {
-	red_shift++;
-    }
-    while ((0x0001 & (green_mask >> green_shift)) == 0) {
-	green_shift++;
-    }
-    while ((0x0001 & (blue_mask >> blue_shift)) == 0) {
-	blue_shift++;
+    red_shift = colorPtr->redShift;
+    green_shift = colorPtr->greenShift;
+    blue_shift = colorPtr->blueShift;
+
+    /*
+     * With 8-bit components in 32-bit pixels stored in our byte order, whole
+     * rows can be blended by the row kernel.
+     */
+
+    if ((colorPtr->flags & DIRECT_PIXELS) && (bgImg->bits_per_pixel == 32)
+#ifdef WORDS_BIGENDIAN
+	    && (bgImg->byte_order == MSBFirst)
+#else
+	    && (bgImg->byte_order == LSBFirst)
+#endif
+	    ) {
+	PixelRowProc *blendProc = GetPixelKernels(NULL)->blendProc;
+
+	for (y = 0; y < height; y++) {
+	    line = (y + yOffset) * iPtr->modelPtr->width;
+	    blendProc(alphaAr + (line + xOffset) * 4,
+		    (unsigned *) (bgImg->data + y * bgImg->bytes_per_line),
+		    width, (int) red_shift, (int) green_shift, (int) blue_shift);
+	}
+	return;
     }
 #endif /* !_WIN32 */
 
@@ -730,11 +1159,13 @@ TkImgPhotoDisplay(
 	    && (visInfo.c_class == DirectColor || visInfo.c_class == TrueColor)) {
 	Tk_ErrorHandler handler;
 	XImage *bgImg = NULL;
+	Tcl_WideInt perfStart;
 
 #ifdef HAVE_XRENDER
 	/*
-	 * Try the server-side XRender composite first (TkpPutRGBAImage); it
-	 * avoids the XGetImage read-back and the per-pixel CPU blend below.
+	 * Try the server-side XRender composite first
+	 * (TkpCompositeRGBAImage); it avoids the XGetImage read-back and the
+	 * per-pixel CPU blend below.
 	 * Fall through to the software blend when the server lacks RENDER or
 	 * the drawable has no usable picture format.
 	 */
@@ -752,14 +1183,14 @@ TkImgPhotoDisplay(
 		(unsigned int) (4 * instancePtr->width));
 
 	if (photo != NULL) {
-	    int result = TkpPutRGBAImage(display, drawable, instancePtr->gc,
-		    photo, imageX, imageY, drawableX, drawableY,
-		    (unsigned int) width, (unsigned int) height);
+	    int result = TkpCompositeRGBAImage(display, drawable,
+		    visInfo.depth, visInfo.screen, photo, imageX, imageY,
+		    drawableX, drawableY, (unsigned int) width,
+		    (unsigned int) height);
 
 	    photo->data = NULL;
 	    XDestroyImage(photo);
 	    if (result == Success) {
-		(void) XFlush(display);
 		return;
 	    }
 	}
@@ -773,11 +1204,14 @@ TkImgPhotoDisplay(
 	handler = Tk_CreateErrorHandler(display, -1, -1, -1, NULL, NULL);
 
 	/*
-	 * Pull the current background from the display to blend with
+	 * Pull the current background from the display to blend with. This is
+	 * a round trip, which is why the XRender path is preferred.
 	 */
 
+	perfStart = TkPerfStart();
 	bgImg = XGetImage(display, drawable, drawableX, drawableY,
 		(unsigned int)width, (unsigned int)height, AllPlanes, ZPixmap);
+	TkPerfStop(TK_PERF_ROUNDTRIP, perfStart);
 	if (bgImg == NULL) {
 	    Tk_DeleteErrorHandler(handler);
 	    /* We failed to get the image, so draw without blending alpha.
@@ -816,7 +1250,6 @@ TkImgPhotoDisplay(
 	XSetClipMask(display, instancePtr->gc, None);
 	XSetClipOrigin(display, instancePtr->gc, 0, 0);
     }
-    (void)XFlush(display);
 #endif
 }
 
@@ -1123,6 +1556,37 @@ CountBits(
     return n;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MaskShift --
+ *
+ *	This function finds the position of the lowest 1 bit in `mask'.
+ *
+ * Results:
+ *	The bit position, or 0 if the mask is empty.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MaskShift(
+    unsigned long mask)		/* Mask of a color component. */
+{
+    int n;
+
+    if (mask == 0) {
+	return 0;
+    }
+    for (n = 0; !(mask & 1); mask >>= 1) {
+	n++;
+    }
+    return n;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1200,6 +1664,9 @@ GetColorTable(
 	colorPtr->liveRefCount = 0;
 	colorPtr->numColors = 0;
 	colorPtr->visualInfo = instancePtr->visualInfo;
+	colorPtr->redShift = MaskShift(colorPtr->visualInfo.red_mask);
+	colorPtr->greenShift = MaskShift(colorPtr->visualInfo.green_mask);
+	colorPtr->blueShift = MaskShift(colorPtr->visualInfo.blue_mask);
 	colorPtr->pixelMap = NULL;
 	Tcl_SetHashValue(entry, colorPtr);
     }
@@ -1541,6 +2008,32 @@ AllocateColors(
 	}
     }
 
+    /*
+     * On the usual 8 bits per component TrueColor visuals, the tables just
+     * shift each intensity into place. Flag that case, so that pixel values
+     * can be built from the shifts alone.
+     */
+
+    if (!mono && !(colorPtr->flags & MAP_COLORS)
+	    && ((colorPtr->visualInfo.c_class == DirectColor)
+	    || (colorPtr->visualInfo.c_class == TrueColor))
+	    && ((colorPtr->visualInfo.red_mask >> colorPtr->redShift) == 0xFF)
+	    && ((colorPtr->visualInfo.green_mask >> colorPtr->greenShift) == 0xFF)
+	    && ((colorPtr->visualInfo.blue_mask >> colorPtr->blueShift) == 0xFF)) {
+	for (i = 0; i < 256; ++i) {
+	    if ((colorPtr->redValues[i] != ((unsigned) i << colorPtr->redShift))
+		    || (colorPtr->greenValues[i]
+			    != ((unsigned) i << colorPtr->greenShift))
+		    || (colorPtr->blueValues[i]
+			    != ((unsigned) i << colorPtr->blueShift))) {
+		break;
+	    }
+	}
+	if (i == 256) {
+	    colorPtr->flags |= DIRECT_PIXELS;
+	}
+    }
+
     Tcl_Free(colors);
 }
 
@@ -1713,6 +2206,11 @@ TkImgDisposeInstance(
     if (instancePtr->imagePtr != NULL) {
 	XDestroyImage(instancePtr->imagePtr);
     }
+#ifdef HAVE_XSHM
+    if (instancePtr->shmSegment != NULL) {
+	TkpShmFreeSegment(instancePtr->display, instancePtr->shmSegment);
+    }
+#endif
     if (instancePtr->error != NULL) {
 	Tcl_Free(instancePtr->error);
     }
@@ -1762,10 +2260,15 @@ TkImgDitherInstance(
     XImage *imagePtr;
     int nLines, bigEndian, i, c, x, y, xEnd;
     bool doDithering = true;
+    PixelRowProc *convertProc = NULL;
     int bitsPerPixel, bytesPerLine, lineLength;
     unsigned char *srcLinePtr;
     schar *errLinePtr;
     unsigned firstBit, word, mask;
+    Tcl_WideInt perfStart = TkPerfStart();
+#ifdef HAVE_XSHM
+    XImage *shmImagePtr = NULL;
+#endif
 
     /*
      * Turn dithering off in certain cases where it is not needed (TrueColor,
@@ -1802,20 +2305,61 @@ TkImgDitherInstance(
 	return;			/* We must be really tight on memory. */
     }
     bitsPerPixel = imagePtr->bits_per_pixel;
-    bytesPerLine = ((bitsPerPixel * width + 31) >> 3) & ~3;
-    imagePtr->width = width;
-    imagePtr->height = nLines;
-    imagePtr->bytes_per_line = bytesPerLine;
 
+#ifdef HAVE_XSHM
     /*
-     * TODO: use Tcl_AttemptAlloc() here once we have some strategy for
-     * recovering from the failure.
+     * On a local display, dither straight into a shared memory segment that
+     * the server reads from. The whole block goes across in one request, so
+     * there is no need to split it into strips of MAX_PIXELS. The segment is
+     * only usable if the server lays out pixels exactly the way we would.
      */
 
-    imagePtr->data = (char *)Tcl_Alloc(imagePtr->bytes_per_line * nLines);
+    if (bitsPerPixel > 1) {
+	shmImagePtr = TkpShmCreateImage(instancePtr->display,
+		instancePtr->visualInfo.visual, imagePtr->depth, width, height,
+		&instancePtr->shmSegment);
+	if (shmImagePtr != NULL
+		&& (shmImagePtr->bits_per_pixel != bitsPerPixel
+		|| shmImagePtr->byte_order != imagePtr->byte_order)) {
+	    shmImagePtr->data = NULL;
+	    XDestroyImage(shmImagePtr);
+	    shmImagePtr = NULL;
+	}
+    }
+    if (shmImagePtr != NULL) {
+	imagePtr = shmImagePtr;
+	nLines = height;
+	bytesPerLine = imagePtr->bytes_per_line;
+    } else
+#endif /* HAVE_XSHM */
+    {
+	bytesPerLine = ((bitsPerPixel * width + 31) >> 3) & ~3;
+	imagePtr->width = width;
+	imagePtr->height = nLines;
+	imagePtr->bytes_per_line = bytesPerLine;
+
+	/*
+	 * TODO: use Tcl_AttemptAlloc() here once we have some strategy for
+	 * recovering from the failure.
+	 */
+
+	imagePtr->data = (char *)Tcl_Alloc(imagePtr->bytes_per_line * nLines);
+    }
     bigEndian = imagePtr->bitmap_bit_order == MSBFirst;
     firstBit = bigEndian? (1 << (imagePtr->bitmap_unit - 1)): 1;
 
+#ifndef _WIN32
+    /*
+     * Undithered rows of 32-bit pixels with 8-bit components need no table
+     * lookups; convert them a whole row at a time.
+     */
+
+    if (!doDithering && (colorPtr->flags & DIRECT_PIXELS)
+	    && (bitsPerPixel == NBBY * sizeof(unsigned))) {
+	convertProc = GetPixelKernels(NULL)->convertProc;
+    }
+#endif
+
     lineLength = modelPtr->width * 3;
     srcLinePtr = modelPtr->pix32 + (yStart * modelPtr->width + xStart) * 4;
     errLinePtr = instancePtr->error + yStart * lineLength + xStart * 3;
@@ -1840,7 +2384,10 @@ TkImgDitherInstance(
 	    unsigned char *destBytePtr = dstLinePtr;
 	    unsigned *destLongPtr = (unsigned *) dstLinePtr;
 
-	    if (colorPtr->flags & COLOR_WINDOW) {
+	    if (convertProc != NULL) {
+		convertProc(srcPtr, destLongPtr, width, colorPtr->redShift,
+			colorPtr->greenShift, colorPtr->blueShift);
+	    } else if (colorPtr->flags & COLOR_WINDOW) {
 		/*
 		 * Color window. We dither the three components independently,
 		 * using Floyd-Steinberg dithering, which propagates errors
@@ -2067,6 +2614,15 @@ TkImgDitherInstance(
 	 * we have just computed.
 	 */
 
+#ifdef HAVE_XSHM
+	if (shmImagePtr != NULL) {
+	    TkpShmPutImage(instancePtr->display, instancePtr->pixels,
+		    instancePtr->gc, imagePtr, xStart, yStart,
+		    (unsigned) width, (unsigned) nLines);
+	    yStart = yEnd;
+	    continue;
+	}
+#endif /* HAVE_XSHM */
 	TkPutImage(colorPtr->pixelMap, colorPtr->numColors,
 		instancePtr->display, instancePtr->pixels,
 		instancePtr->gc, imagePtr, 0, 0, xStart, yStart,
@@ -2074,8 +2630,22 @@ TkImgDitherInstance(
 	yStart = yEnd;
     }
 
+#ifdef HAVE_XSHM
+    if (shmImagePtr != NULL) {
+	/*
+	 * The pixel data belongs to the shared segment, which is kept for the
+	 * next update; only the image header goes.
+	 */
+
+	shmImagePtr->data = NULL;
+	XDestroyImage(shmImagePtr);
+	TkPerfStop(TK_PERF_DITHER, perfStart);
+	return;
+    }
+#endif /* HAVE_XSHM */
     Tcl_Free(imagePtr->data);
     imagePtr->data = NULL;
+    TkPerfStop(TK_PERF_DITHER, perfStart);
 }
 
 /*
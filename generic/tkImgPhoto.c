@@ -35,6 +35,8 @@ struct SubcommandOptions {
     int toX2, toY2;		/* Second coordinate pair for -to option. */
     int zoomX, zoomY;		/* Values specified for -zoom option. */
     int subsampleX, subsampleY;	/* Values specified for -subsample option. */
+    int scaleX, scaleY;		/* Values specified for -scale option. */
+    int filter;			/* Value specified for -filter option. */
     Tcl_Obj *format;		/* Value specified for -format option. */
     XColor *background;		/* Value specified for -background option. */
     int compositingRule;	/* Value specified for -compositingrule
@@ -52,10 +54,12 @@ struct SubcommandOptions {
  * OPT_ALPHA:			Set if -alpha option allowed/specified.
  * OPT_BACKGROUND:		Set if -format option allowed/specified.
  * OPT_COMPOSITE:		Set if -compositingrule option allowed/spec'd.
+ * OPT_FILTER:			Set if -filter option allowed/specified.
  * OPT_FORMAT:			Set if -format option allowed/specified.
  * OPT_FROM:			Set if -from option allowed/specified.
  * OPT_GRAYSCALE:		Set if -grayscale option allowed/specified.
  * OPT_METADATA:		Set if -metadata option allowed/specified.
+ * OPT_SCALE:			Set if -scale option allowed/specified.
  * OPT_SHRINK:			Set if -shrink option allowed/specified.
  * OPT_SUBSAMPLE:		Set if -subsample option allowed/spec'd.
  * OPT_TO:			Set if -to option allowed/specified.
@@ -66,15 +70,17 @@ struct SubcommandOptions {
 #define OPT_ALPHA	1
 #define OPT_BACKGROUND	2
 #define OPT_COMPOSITE	4
-#define OPT_FORMAT	8
-#define OPT_FROM	0x10
-#define OPT_GRAYSCALE	0x20
-#define OPT_METADATA	0x40
-#define OPT_SHRINK	0x80
-#define OPT_SUBSAMPLE	0x100
-#define OPT_TO		0x200
-#define OPT_WITHALPHA	0x400
-#define OPT_ZOOM	0x800
+#define OPT_FILTER	8
+#define OPT_FORMAT	0x10
+#define OPT_FROM	0x20
+#define OPT_GRAYSCALE	0x40
+#define OPT_METADATA	0x80
+#define OPT_SCALE	0x100
+#define OPT_SHRINK	0x200
+#define OPT_SUBSAMPLE	0x400
+#define OPT_TO		0x800
+#define OPT_WITHALPHA	0x1000
+#define OPT_ZOOM	0x2000
 
 /*
  * List of option names. The order here must match the order of declarations
@@ -85,10 +91,12 @@ static const char *const optionNames[] = {
     "-alpha",
     "-background",
     "-compositingrule",
+    "-filter",
     "-format",
     "-from",
     "-grayscale",
     "-metadata",
+    "-scale",
     "-shrink",
     "-subsample",
     "-to",
@@ -135,6 +143,26 @@ Tk_ImageType tkPhotoImageType = {
     NULL
 };
 
+/*
+ * A format that can also read an image directly from memory, which is used
+ * for large files: see ReadPhotoFile.
+ */
+
+typedef struct MappedReader {
+    const void *formatPtr;	/* The registered format record. */
+    TkPhotoMappedReadProc *readProc;
+				/* Reads the image from memory. */
+    struct MappedReader *nextPtr;
+				/* Next in the list of such formats. */
+} MappedReader;
+
+/*
+ * Files smaller than this are read through a channel even when the format
+ * can read from memory, since mapping them would cost more than it saves.
+ */
+
+#define PHOTO_MAP_MIN_SIZE	65536
+
 typedef struct {
     Tk_PhotoImageFormat *formatList;
 				/* Pointer to the first in the list of known
@@ -142,6 +170,8 @@ typedef struct {
     Tk_PhotoImageFormatVersion3 *formatListVersion3;
 				/* Pointer to the first in the list of known
 				 * photo image formats in Version3 format.*/
+    MappedReader *mappedReaders;
+				/* Formats which can read from memory. */
     bool initialized;		/* Set to true if we've initialized the
 				 * structure. */
 } ThreadSpecificData;
@@ -190,6 +220,10 @@ static int		ParseSubcommandOptions(
 			    struct SubcommandOptions *optPtr,
 			    Tcl_Interp *interp, int allowedOptions,
 			    Tcl_Size *indexPtr, Tcl_Size objc, Tcl_Obj *const objv[]);
+static int		PhotoCopyScaled(Tcl_Interp *interp,
+			    PhotoModel *modelPtr, Tk_PhotoImageBlock *blockPtr,
+			    struct SubcommandOptions *optPtr);
+static void		CancelPendingLoad(PhotoModel *modelPtr);
 static void		ImgPhotoCmdDeletedProc(void *clientData);
 static int		ImgPhotoConfigureModel(Tcl_Interp *interp,
 			    PhotoModel *modelPtr, Tcl_Size objc,
@@ -207,6 +241,18 @@ static int		MatchFileFormat(Tcl_Interp *interp, Tcl_Channel chan,
 			    Tk_PhotoImageFormat **imageFormatPtr,
 			    Tk_PhotoImageFormatVersion3 **imageFormatVersion3Ptr,
 			    int *widthPtr, int *heightPtr);
+static TkPhotoMappedReadProc *GetMappedReadProc(
+			    const Tk_PhotoImageFormat *imageFormat,
+			    const Tk_PhotoImageFormatVersion3 *imageFormatVersion3);
+static int		ReadPhotoFile(Tcl_Interp *interp, Tcl_Channel chan,
+			    Tcl_Obj *fileObj, Tcl_Obj *formatObj,
+			    Tcl_Obj *metadataInObj,
+			    const Tk_PhotoImageFormat *imageFormat,
+			    const Tk_PhotoImageFormatVersion3 *imageFormatVersion3,
+			    TkPhotoMappedReadProc *mappedReadProc,
+			    Tk_PhotoHandle imageHandle, int destX, int destY,
+			    int width, int height, int srcX, int srcY,
+			    Tcl_Obj *metadataOutObj);
 static int		MatchStringFormat(Tcl_Interp *interp, Tcl_Obj *data,
 			    Tcl_Obj *formatString,
 			    Tcl_Obj *metadataInObj,
@@ -253,6 +299,12 @@ PhotoFormatThreadExitProc(
 	Tcl_Free((void *)freePtrVersion3->name);
 	Tcl_Free(freePtrVersion3);
     }
+    while (tsdPtr->mappedReaders != NULL) {
+	MappedReader *readerPtr = tsdPtr->mappedReaders;
+
+	tsdPtr->mappedReaders = readerPtr->nextPtr;
+	Tcl_Free(readerPtr);
+    }
 }
 
 /*
@@ -327,6 +379,64 @@ Tk_CreatePhotoImageFormatVersion3(
     copyPtr->nextPtr = tsdPtr->formatListVersion3;
     tsdPtr->formatListVersion3 = copyPtr;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPhotoSetMappedReadProc --
+ *
+ *	Gives the most recently registered photo image format with the given
+ *	name a function to read images from memory, which is used instead of
+ *	the format's file read function for large files. This is how the
+ *	built-in formats read files without copying them; other formats
+ *	cannot have one, since the format records are public and can't grow.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The function is recorded for the format, if there is one with that
+ *	name. Formats registered later under the same name don't get it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkPhotoSetMappedReadProc(
+    const char *formatName,	/* Name of a registered format. */
+    TkPhotoMappedReadProc *proc)/* Function to read that format from
+				 * memory. */
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    Tk_PhotoImageFormatVersion3 *formatVersion3Ptr;
+    Tk_PhotoImageFormat *formatPtr;
+    MappedReader *readerPtr;
+    const void *foundPtr = NULL;
+
+    for (formatVersion3Ptr = tsdPtr->formatListVersion3;
+	    formatVersion3Ptr != NULL && foundPtr == NULL;
+	    formatVersion3Ptr = formatVersion3Ptr->nextPtr) {
+	if (strcmp(formatName, formatVersion3Ptr->name) == 0) {
+	    foundPtr = formatVersion3Ptr;
+	}
+    }
+    for (formatPtr = tsdPtr->formatList;
+	    formatPtr != NULL && foundPtr == NULL;
+	    formatPtr = formatPtr->nextPtr) {
+	if (strcmp(formatName, formatPtr->name) == 0) {
+	    foundPtr = formatPtr;
+	}
+    }
+    if (foundPtr == NULL) {
+	return;
+    }
+    readerPtr = (MappedReader *)Tcl_Alloc(sizeof(MappedReader));
+    readerPtr->formatPtr = foundPtr;
+    readerPtr->readProc = proc;
+    readerPtr->nextPtr = tsdPtr->mappedReaders;
+    tsdPtr->mappedReaders = readerPtr;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -594,14 +704,32 @@ ImgPhotoCmd(
 	options.subsampleX = options.subsampleY = 1;
 	options.name = NULL;
 	options.compositingRule = TK_PHOTO_COMPOSITE_OVERLAY;
+	options.filter = 0;		/* bicubic */
 	if (ParseSubcommandOptions(&options, interp,
 		OPT_FROM | OPT_TO | OPT_ZOOM | OPT_SUBSAMPLE | OPT_SHRINK |
-		OPT_COMPOSITE, &index, objc, objv) != TCL_OK) {
+		OPT_COMPOSITE | OPT_SCALE | OPT_FILTER, &index, objc,
+		objv) != TCL_OK) {
 	    return TCL_ERROR;
 	}
 	if (options.name == NULL || index < objc) {
 	    Tcl_WrongNumArgs(interp, 2, objv,
-		    "source-image ?-compositingrule rule? ?-from x1 y1 x2 y2? ?-to x1 y1 x2 y2? ?-zoom x y? ?-subsample x y?");
+		    "source-image ?-compositingrule rule? ?-from x1 y1 x2 y2? ?-to x1 y1 x2 y2? ?-zoom x y? ?-subsample x y? ?-scale width height? ?-filter filter?");
+	    return TCL_ERROR;
+	}
+	if ((options.options & OPT_SCALE)
+		&& (options.options & (OPT_ZOOM | OPT_SUBSAMPLE))) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "the -scale option cannot be combined with -zoom or -subsample",
+		    -1));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO", "BAD_OPTION",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+	if ((options.options & OPT_FILTER) && !(options.options & OPT_SCALE)) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "the -filter option requires -scale", -1));
+	    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO", "BAD_OPTION",
+		    (char *)NULL);
 	    return TCL_ERROR;
 	}
 
@@ -639,6 +767,13 @@ ImgPhotoCmd(
 	    options.compositingRule |= SOURCE_IS_SIMPLE_ALPHA_PHOTO;
 	}
 
+	/*
+	 * A load still going on in the background would overwrite the copied
+	 * pixels later on, so it is superseded.
+	 */
+
+	CancelPendingLoad(modelPtr);
+
 	/*
 	 * Fill in default values for unspecified parameters.
 	 */
@@ -647,6 +782,33 @@ ImgPhotoCmd(
 	    options.fromX2 = block.width;
 	    options.fromY2 = block.height;
 	}
+	if (options.options & OPT_SCALE) {
+	    /*
+	     * A zero -scale dimension keeps the aspect ratio of the source
+	     * region, but is at least 1 so that a thin region doesn't vanish.
+	     */
+
+	    width = options.fromX2 - options.fromX;
+	    height = options.fromY2 - options.fromY;
+	    if (options.scaleX == 0) {
+		options.scaleX = (height > 0) ? (int) ((double) width
+			* options.scaleY / height + 0.5) : 0;
+		if ((options.scaleX == 0) && (width > 0)) {
+		    options.scaleX = 1;
+		}
+	    } else if (options.scaleY == 0) {
+		options.scaleY = (width > 0) ? (int) ((double) height
+			* options.scaleX / width + 0.5) : 0;
+		if ((options.scaleY == 0) && (height > 0)) {
+		    options.scaleY = 1;
+		}
+	    }
+	    if (!(options.options & OPT_TO) || (options.toX2 < 0)) {
+		options.toX2 = options.toX + options.scaleX;
+		options.toY2 = options.toY + options.scaleY;
+	    }
+	    return PhotoCopyScaled(interp, modelPtr, &block, &options);
+	}
 	if (!(options.options & OPT_TO) || (options.toX2 < 0)) {
 	    width = options.fromX2 - options.fromX;
 	    if (options.subsampleX > 0) {
@@ -953,6 +1115,13 @@ ImgPhotoCmd(
 	if (imageHeight > options.toY2 - options.toY) {
 	    imageHeight = options.toY2 - options.toY;
 	}
+
+	/*
+	 * Any load still going on in the background is superseded, as it
+	 * would overwrite the new pixels.
+	 */
+
+	CancelPendingLoad(modelPtr);
 	format = options.format;
 	data = objv[2];
 	if (imageFormat != NULL) {
@@ -985,8 +1154,6 @@ ImgPhotoCmd(
 	return TCL_OK;
     }
     case PHOTO_READ: {
-	Tcl_Obj *format;
-
 	/*
 	 * photo read command - first parse the options specified.
 	 */
@@ -1081,22 +1248,15 @@ ImgPhotoCmd(
 
 	/*
 	 * Call the handler's file read function to read the data into the
-	 * image.
+	 * image. Any load still going on in the background is superseded.
 	 */
 
-	format = options.format;
-	if (imageFormat != NULL) {
-	    result = imageFormat->fileReadProc(interp, chan,
-		    Tcl_GetString(options.name),
-		    format, (Tk_PhotoHandle) modelPtr, options.toX,
-		    options.toY, width, height, options.fromX, options.fromY);
-	} else {
-	    result = imageFormatVersion3->fileReadProc(interp, chan,
-		    Tcl_GetString(options.name),
-		    format, options.metadata, (Tk_PhotoHandle) modelPtr,
-		    options.toX, options.toY, width, height, options.fromX,
-		    options.fromY, NULL);
-	}
+	CancelPendingLoad(modelPtr);
+	result = ReadPhotoFile(interp, chan, options.name, options.format,
+		options.metadata, imageFormat, imageFormatVersion3,
+		GetMappedReadProc(imageFormat, imageFormatVersion3),
+		(Tk_PhotoHandle) modelPtr, options.toX, options.toY, width,
+		height, options.fromX, options.fromY, NULL);
 readCleanup:
 	if (chan != NULL) {
 	    Tcl_Close(NULL, chan);
@@ -1572,6 +1732,12 @@ ParseSubcommandOptions(
 				 * TK_PHOTO_COMPOSITE_* constants. */
 	NULL
     };
+    static const char *const filterNames[] = {
+	"bicubic", "bilinear", "lanczos",
+				/* Note that these must match the order of
+				 * resampleFilters. */
+	NULL
+    };
     Tcl_Size index, length, argIndex;
     int c, bit, currentBit;
     int values[4], numValues, maxValues;
@@ -1627,8 +1793,9 @@ ParseSubcommandOptions(
 	}
 
 	/*
-	 * For the -from, -to, -zoom and -subsample options, parse the values
-	 * given. Report an error if too few or too many values are given.
+	 * For the -from, -to, -zoom, -subsample and -scale options, parse the
+	 * values given. Report an error if too few or too many values are
+	 * given.
 	 */
 
 	if (bit == OPT_BACKGROUND) {
@@ -1683,7 +1850,21 @@ ParseSubcommandOptions(
 		return TCL_ERROR;
 	    }
 	    *optIndexPtr = index;
-	} else if (bit == OPT_TO || bit == OPT_FROM
+	} else if (bit == OPT_FILTER) {
+	    /*
+	     * The -filter option takes the name of a resampling filter.
+	     */
+
+	    if (index + 1 >= objc) {
+		goto oneValueRequired;
+	    }
+	    index++;
+	    if (Tcl_GetIndexFromObj(interp, objv[index], filterNames,
+		    "filter", 0, &optPtr->filter) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    *optIndexPtr = index;
+	} else if (bit == OPT_TO || bit == OPT_FROM || bit == OPT_SCALE
 		|| bit == OPT_SUBSAMPLE || bit == OPT_ZOOM) {
 	    const char *val;
 
@@ -1746,6 +1927,15 @@ ParseSubcommandOptions(
 		    optPtr->fromY2 = MAX(values[1], values[3]);
 		}
 		break;
+	    case OPT_SCALE:
+		if ((values[0] < 0) || (values[1] < 0)
+			|| ((values[0] == 0) && (values[1] == 0))) {
+		    needed = "non-negative and not both zero";
+		    goto numberOutOfRange;
+		}
+		optPtr->scaleX = values[0];
+		optPtr->scaleY = values[1];
+		break;
 	    case OPT_SUBSAMPLE:
 		optPtr->subsampleX = values[0];
 		optPtr->subsampleY = values[1];
@@ -1834,162 +2024,628 @@ ParseSubcommandOptions(
 /*
  *----------------------------------------------------------------------
  *
- * ImgPhotoConfigureModel --
- *
- *	This function is called when a photo image is created or reconfigured.
- *	It processes configuration options and resets any instances of the
- *	image.
- *
- * Results:
- *	A standard Tcl return value. If TCL_ERROR is returned then an error
- *	message is left in the modelPtr->interp's result.
+ * Photo resampling --
  *
- * Side effects:
- *	Existing instances of the image will be redisplayed to match the new
- *	configuration options.
+ *	The "copy -scale" subcommand resamples a block with a separable
+ *	filter: each source row is filtered horizontally into a temporary
+ *	buffer of premultiplied floating point pixels, then each destination
+ *	row is filtered vertically out of that buffer. When shrinking, the
+ *	filter is stretched to cover all the source pixels that fall into one
+ *	destination pixel. Rows are independent, so both passes are split
+ *	into bands that run in parallel on large images.
  *
  *----------------------------------------------------------------------
  */
 
-static int
-ImgPhotoConfigureModel(
-    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
-    PhotoModel *modelPtr,	/* Pointer to data structure describing
-				 * overall photo image to (re)configure. */
-    Tcl_Size objc,			/* Number of entries in objv. */
-    Tcl_Obj *const objv[],	/* Pairs of configuration options for image. */
-    int flags)			/* Flags to pass to Tk_ConfigureWidget, such
-				 * as TK_CONFIG_ARGV_ONLY. */
-{
-    PhotoInstance *instancePtr;
-    Tcl_Obj *oldFileObj;
-    const char *oldPaletteString;
-    Tcl_Obj *oldData, *data = NULL, *oldFormat, *format = NULL,
-	    *metadataInObj = NULL, *metadataOutObj = NULL;
-    Tcl_Obj *tempdata, *tempformat;
-    Tcl_Size i, length;
-    int result, imageWidth, imageHeight;
-    double oldGamma;
-    Tcl_Channel chan;
-    Tk_PhotoImageFormat *imageFormat;
-    Tk_PhotoImageFormatVersion3 *imageFormatVersion3;
+#define RESAMPLE_PI		3.14159265358979323846
+#define RESAMPLE_BAND_ROWS	32	/* Rows per parallel task. */
+#define RESAMPLE_PARALLEL_MIN	(256 * 256)
+				/* Below this many destination pixels (or
+				 * intermediate ones) everything runs in the
+				 * calling thread. */
 
-    for (i = 0; i < objc; i++) {
-	const char *arg = Tcl_GetStringFromObj(objv[i], &length);
-	if ((length > 1) && (arg[0] == '-')) {
-	    if ((arg[1] == 'd') &&
-		    !strncmp(arg, "-data", length)) {
-		if (++i < objc) {
-		    data = objv[i];
-		} else {
-		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-			    "value for \"-data\" missing", TCL_INDEX_NONE));
-		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
-			    "MISSING_VALUE", (char *)NULL);
-		    return TCL_ERROR;
-		}
-	    } else if ((arg[1] == 'f') &&
-		    !strncmp(arg, "-format", length)) {
-		if (++i < objc) {
-		    format = objv[i];
-		} else {
-		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-			    "value for \"-format\" missing", TCL_INDEX_NONE));
-		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
-			    "MISSING_VALUE", (char *)NULL);
-		    return TCL_ERROR;
-		}
-	    } else if ((arg[1] == 'm') &&
-		!strncmp(arg, "-metadata", length)) {
-		if (++i < objc) {
-		    metadataInObj = objv[i];
-		} else {
-		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
-			"value for \"-metadata\" missing", TCL_INDEX_NONE));
-		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
-			"MISSING_VALUE", (char *)NULL);
-		    return TCL_ERROR;
-		}
-	    }
-	}
-    }
+static double
+BilinearFilter(
+    double x)
+{
+    x = fabs(x);
+    return (x < 1.0) ? 1.0 - x : 0.0;
+}
 
+static double
+BicubicFilter(
+    double x)
+{
     /*
-     * Save the current values for fileString and dataString, so we can tell
-     * if the user specifies them anew. IMPORTANT: if the format changes we
-     * have to interpret "-file" and "-data" again as well! It might be that
-     * the format string influences how "-data" or "-file" is interpreted.
+     * Keys' cubic convolution kernel with a = -0.5 (Catmull-Rom).
      */
 
-    oldFileObj = modelPtr->fileObj;
-    if (oldFileObj == NULL) {
-	oldData = modelPtr->dataObj;
-	if (oldData != NULL) {
-	    Tcl_IncrRefCount(oldData);
-	}
-    } else {
-	oldData = NULL;
-    }
-    oldFormat = modelPtr->format;
-    if (oldFormat != NULL) {
-	Tcl_IncrRefCount(oldFormat);
+    x = fabs(x);
+    if (x < 1.0) {
+	return (1.5 * x - 2.5) * x * x + 1.0;
+    } else if (x < 2.0) {
+	return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
     }
-    oldPaletteString = modelPtr->palette;
-    oldGamma = modelPtr->gamma;
+    return 0.0;
+}
 
+static double
+LanczosFilter(
+    double x)
+{
     /*
-     * Process the configuration options specified.
+     * Lanczos-windowed sinc with three lobes.
      */
 
-    if (Tk_ConfigureWidget(interp, Tk_MainWindow(interp), configSpecs,
-	    objc, objv, modelPtr, flags) != TCL_OK) {
-	goto errorExit;
+    x = fabs(x);
+    if (x < 1e-8) {
+	return 1.0;
+    } else if (x < 3.0) {
+	double px = RESAMPLE_PI * x;
+
+	return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
     }
+    return 0.0;
+}
 
-    /*
-     * Regard the empty string for -file, -data, -format or -metadata as the null value.
-     */
+static const struct {
+    double (*proc)(double x);	/* The filter function. */
+    double support;		/* Half-width of the filter at scale 1. */
+} resampleFilters[] = {
+    {BicubicFilter, 2.0},	/* Must match the order of filterNames. */
+    {BilinearFilter, 1.0},
+    {LanczosFilter, 3.0}
+};
 
-    if ((modelPtr->fileObj != NULL) && (Tcl_GetString(modelPtr->fileObj)[0] == 0)) {
-	Tcl_DecrRefCount(modelPtr->fileObj);
-	modelPtr->fileObj = NULL;
+/*
+ * Filter weights along one axis: destination pixel i is the weighted sum of
+ * count[i] source pixels starting at first[i], with the weights
+ * weights[i * maxTaps ...].
+ */
+
+typedef struct {
+    int *first;			/* First source pixel for each destination
+				 * pixel. */
+    int *count;			/* Number of source pixels used. */
+    float *weights;		/* Normalized weights. */
+    int maxTaps;		/* Stride of weights. */
+} ResampleAxis;
+
+/*
+ * Everything the passes need; shared by the parallel tasks.
+ */
+
+typedef struct {
+    const Tk_PhotoImageBlock *srcPtr;
+				/* Block being resampled. */
+    unsigned char *dst;		/* Result, 4 bytes per pixel RGBA. */
+    float *tmp;			/* Horizontally filtered source rows,
+				 * premultiplied RGBA. */
+    int dstWidth, dstHeight;	/* Size of the result. */
+    ResampleAxis xAxis, yAxis;	/* Weights for the two passes. */
+} ResampleJob;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ComputeResampleAxis --
+ *
+ *	Works out the filter weights for resampling srcSize pixels to
+ *	dstSize pixels.
+ *
+ * Results:
+ *	TCL_OK, or TCL_ERROR if memory ran out.
+ *
+ * Side effects:
+ *	Allocates the arrays of *axisPtr; FreeResampleAxis releases them.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ComputeResampleAxis(
+    int srcSize, int dstSize,	/* Sizes before and after resampling. */
+    int filter,			/* Index into resampleFilters. */
+    ResampleAxis *axisPtr)	/* Filled in with the weights. */
+{
+    double scale = (double) srcSize / dstSize;
+    double stretch = (scale > 1.0) ? scale : 1.0;
+    double support = resampleFilters[filter].support * stretch;
+    double (*proc)(double) = resampleFilters[filter].proc;
+    int i, j;
+
+    axisPtr->maxTaps = (int) ceil(support) * 2 + 1;
+    axisPtr->first = (int *)Tcl_AttemptAlloc(sizeof(int) * dstSize);
+    axisPtr->count = (int *)Tcl_AttemptAlloc(sizeof(int) * dstSize);
+    axisPtr->weights = (float *)Tcl_AttemptAlloc(
+	    sizeof(float) * (size_t) dstSize * axisPtr->maxTaps);
+    if (!axisPtr->first || !axisPtr->count || !axisPtr->weights) {
+	return TCL_ERROR;
     }
-    if (data) {
-	/*
-	 * Force into ByteArray format, which most (all) image handlers will
-	 * use anyway. Empty length means ignore the -data option.
-	 */
-	Tcl_Size bytesize;
 
-	(void) Tcl_GetByteArrayFromObj(data, &bytesize);
-	if (bytesize) {
-	    Tcl_IncrRefCount(data);
-	} else {
-	    data = NULL;
+    for (i = 0; i < dstSize; i++) {
+	double center = (i + 0.5) * scale;
+	double total = 0.0, w[64], *wPtr = w;
+	float *out = axisPtr->weights + (size_t) i * axisPtr->maxTaps;
+	int left = (int) floor(center - support + 0.5);
+	int right = (int) floor(center + support + 0.5);
+
+	if (left < 0) {
+	    left = 0;
 	}
-	if (modelPtr->dataObj) {
-	    Tcl_DecrRefCount(modelPtr->dataObj);
+	if (right > srcSize) {
+	    right = srcSize;
 	}
-	modelPtr->dataObj = data;
-    }
-    if (format) {
-	/*
-	 * Stringify to ignore -format "". It may come in as a list or other
-	 * object.
-	 */
-
-	(void) Tcl_GetString(format);
-	if (format->length) {
-	    Tcl_IncrRefCount(format);
-	} else {
-	    format = NULL;
+	if (right - left > axisPtr->maxTaps) {
+	    right = left + axisPtr->maxTaps;
 	}
-	if (modelPtr->format) {
-	    Tcl_DecrRefCount(modelPtr->format);
+	if (right - left > 64) {
+	    wPtr = (double *)Tcl_Alloc(sizeof(double) * (right - left));
 	}
-	modelPtr->format = format;
-    }
-    if (metadataInObj) {
+	for (j = left; j < right; j++) {
+	    wPtr[j - left] = proc((j + 0.5 - center) / stretch);
+	    total += wPtr[j - left];
+	}
+	for (j = left; j < right; j++) {
+	    out[j - left] = (float) ((total != 0.0)
+		    ? wPtr[j - left] / total : 0.0);
+	}
+	if (wPtr != w) {
+	    Tcl_Free(wPtr);
+	}
+	axisPtr->first[i] = left;
+	axisPtr->count[i] = right - left;
+    }
+    return TCL_OK;
+}
+
+static void
+FreeResampleAxis(
+    ResampleAxis *axisPtr)
+{
+    if (axisPtr->first) {
+	Tcl_Free(axisPtr->first);
+    }
+    if (axisPtr->count) {
+	Tcl_Free(axisPtr->count);
+    }
+    if (axisPtr->weights) {
+	Tcl_Free(axisPtr->weights);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResampleHorizontal, ResampleVertical --
+ *
+ *	The two passes of the resampler, each handling one band of
+ *	RESAMPLE_BAND_ROWS rows. ResampleHorizontal filters source rows into
+ *	the premultiplied temporary buffer; ResampleVertical filters that
+ *	into destination rows and converts back to 8-bit straight alpha.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Fill in part of the temporary buffer or the result.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResampleHorizontal(
+    void *clientData,		/* The ResampleJob. */
+    int band)			/* Which band of source rows to do. */
+{
+    ResampleJob *jobPtr = (ResampleJob *)clientData;
+    const Tk_PhotoImageBlock *srcPtr = jobPtr->srcPtr;
+    const ResampleAxis *axisPtr = &jobPtr->xAxis;
+    int y, x, j, yEnd = (band + 1) * RESAMPLE_BAND_ROWS;
+    int r = srcPtr->offset[0], g = srcPtr->offset[1];
+    int b = srcPtr->offset[2], a = srcPtr->offset[3];
+    int hasAlpha = (a >= 0) && (a < srcPtr->pixelSize) && (a != r);
+
+    if (yEnd > srcPtr->height) {
+	yEnd = srcPtr->height;
+    }
+    for (y = band * RESAMPLE_BAND_ROWS; y < yEnd; y++) {
+	const unsigned char *row = srcPtr->pixelPtr + (size_t) y * srcPtr->pitch;
+	float *out = jobPtr->tmp + (size_t) y * jobPtr->dstWidth * 4;
+
+	for (x = 0; x < jobPtr->dstWidth; x++, out += 4) {
+	    const float *w = axisPtr->weights + (size_t) x * axisPtr->maxTaps;
+	    const unsigned char *p = row
+		    + (size_t) axisPtr->first[x] * srcPtr->pixelSize;
+	    float sr = 0.0f, sg = 0.0f, sb = 0.0f, sa = 0.0f;
+
+	    for (j = 0; j < axisPtr->count[x]; j++, p += srcPtr->pixelSize) {
+		float wa = w[j] * (hasAlpha ? p[a] / 255.0f : 1.0f);
+
+		sr += p[r] * wa;
+		sg += p[g] * wa;
+		sb += p[b] * wa;
+		sa += wa;
+	    }
+	    out[0] = sr;
+	    out[1] = sg;
+	    out[2] = sb;
+	    out[3] = sa;
+	}
+    }
+}
+
+static inline unsigned char
+ClampPixel(
+    float value)
+{
+    return (value <= 0.0f) ? 0
+	    : (value >= 255.0f) ? 255 : (unsigned char) (value + 0.5f);
+}
+
+static void
+ResampleVertical(
+    void *clientData,		/* The ResampleJob. */
+    int band)			/* Which band of destination rows to do. */
+{
+    ResampleJob *jobPtr = (ResampleJob *)clientData;
+    const ResampleAxis *axisPtr = &jobPtr->yAxis;
+    size_t rowLength = (size_t) jobPtr->dstWidth * 4;
+    int y, x, j, yEnd = (band + 1) * RESAMPLE_BAND_ROWS;
+
+    if (yEnd > jobPtr->dstHeight) {
+	yEnd = jobPtr->dstHeight;
+    }
+    for (y = band * RESAMPLE_BAND_ROWS; y < yEnd; y++) {
+	const float *w = axisPtr->weights + (size_t) y * axisPtr->maxTaps;
+	const float *in = jobPtr->tmp + axisPtr->first[y] * rowLength;
+	unsigned char *out = jobPtr->dst + y * rowLength;
+
+	for (x = 0; x < jobPtr->dstWidth; x++, in += 4, out += 4) {
+	    const float *p = in;
+	    float sr = 0.0f, sg = 0.0f, sb = 0.0f, sa = 0.0f;
+
+	    for (j = 0; j < axisPtr->count[y]; j++, p += rowLength) {
+		sr += p[0] * w[j];
+		sg += p[1] * w[j];
+		sb += p[2] * w[j];
+		sa += p[3] * w[j];
+	    }
+	    if (sa <= 0.5f / 255.0f) {
+		out[0] = out[1] = out[2] = out[3] = 0;
+	    } else {
+		out[0] = ClampPixel(sr / sa);
+		out[1] = ClampPixel(sg / sa);
+		out[2] = ClampPixel(sb / sa);
+		out[3] = ClampPixel(sa * 255.0f);
+	    }
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResamplePhotoBlock --
+ *
+ *	Resamples a block of pixels to a new size with one of the filters
+ *	of "copy -filter".
+ *
+ * Results:
+ *	A newly allocated RGBA buffer of dstWidth * dstHeight pixels, to be
+ *	freed with Tcl_Free, or NULL if memory ran out.
+ *
+ * Side effects:
+ *	May run worker threads for a while.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned char *
+ResamplePhotoBlock(
+    const Tk_PhotoImageBlock *srcPtr,
+				/* Pixels to resample; width and height must
+				 * be positive. */
+    int dstWidth, int dstHeight,/* Size of the result. */
+    int filter)			/* Index into resampleFilters. */
+{
+    ResampleJob job;
+    int srcBands = (srcPtr->height + RESAMPLE_BAND_ROWS - 1)
+	    / RESAMPLE_BAND_ROWS;
+    int dstBands = (dstHeight + RESAMPLE_BAND_ROWS - 1) / RESAMPLE_BAND_ROWS;
+    int band;
+
+    memset(&job, 0, sizeof(job));
+    job.srcPtr = srcPtr;
+    job.dstWidth = dstWidth;
+    job.dstHeight = dstHeight;
+    if (ComputeResampleAxis(srcPtr->width, dstWidth, filter,
+	    &job.xAxis) != TCL_OK
+	    || ComputeResampleAxis(srcPtr->height, dstHeight, filter,
+	    &job.yAxis) != TCL_OK) {
+	goto done;
+    }
+    job.tmp = (float *)Tcl_AttemptAlloc(
+	    sizeof(float) * 4 * (size_t) dstWidth * srcPtr->height);
+    job.dst = (unsigned char *)Tcl_AttemptAlloc(
+	    4 * (size_t) dstWidth * dstHeight);
+    if (!job.tmp || !job.dst) {
+	if (job.dst) {
+	    Tcl_Free(job.dst);
+	    job.dst = NULL;
+	}
+	goto done;
+    }
+
+    if ((size_t) dstWidth * srcPtr->height >= RESAMPLE_PARALLEL_MIN) {
+	TkRunParallel(srcBands, ResampleHorizontal, &job);
+    } else {
+	for (band = 0; band < srcBands; band++) {
+	    ResampleHorizontal(&job, band);
+	}
+    }
+    if ((size_t) dstWidth * dstHeight >= RESAMPLE_PARALLEL_MIN) {
+	TkRunParallel(dstBands, ResampleVertical, &job);
+    } else {
+	for (band = 0; band < dstBands; band++) {
+	    ResampleVertical(&job, band);
+	}
+    }
+
+  done:
+    if (job.tmp) {
+	Tcl_Free(job.tmp);
+    }
+    FreeResampleAxis(&job.xAxis);
+    FreeResampleAxis(&job.yAxis);
+    return job.dst;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PhotoCopyScaled --
+ *
+ *	Implements "imageName copy sourceImage -scale width height": the
+ *	-from region of the source is resampled to the requested size and
+ *	put at the -to position.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	The image is modified, and resized if -shrink was given.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PhotoCopyScaled(
+    Tcl_Interp *interp,		/* For error messages. */
+    PhotoModel *modelPtr,	/* Image being copied into. */
+    Tk_PhotoImageBlock *blockPtr,
+				/* Pixels of the source image; modified to
+				 * describe the -from region. */
+    struct SubcommandOptions *optPtr)
+				/* Options with defaults filled in. */
+{
+    Tk_PhotoImageBlock scaled;
+    unsigned char *pixels;
+    int result = TCL_OK, changed = 0;
+
+    blockPtr->width = optPtr->fromX2 - optPtr->fromX;
+    blockPtr->height = optPtr->fromY2 - optPtr->fromY;
+    if (blockPtr->pixelPtr && (blockPtr->width > 0)
+	    && (blockPtr->height > 0) && (optPtr->scaleX > 0)
+	    && (optPtr->scaleY > 0)) {
+	blockPtr->pixelPtr += optPtr->fromX * blockPtr->pixelSize
+		+ optPtr->fromY * blockPtr->pitch;
+	pixels = ResamplePhotoBlock(blockPtr, optPtr->scaleX, optPtr->scaleY,
+		optPtr->filter);
+	if (pixels == NULL) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    TK_PHOTO_ALLOC_FAILURE_MESSAGE, TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	scaled.pixelPtr = pixels;
+	scaled.width = optPtr->scaleX;
+	scaled.height = optPtr->scaleY;
+	scaled.pitch = 4 * optPtr->scaleX;
+	scaled.pixelSize = 4;
+	scaled.offset[0] = 0;
+	scaled.offset[1] = 1;
+	scaled.offset[2] = 2;
+	scaled.offset[3] = 3;
+
+	/*
+	 * Filtering blends neighboring pixels, so the result may have
+	 * partial alpha even where the source did not.
+	 */
+
+	result = Tk_PhotoPutBlock(interp, (Tk_PhotoHandle) modelPtr, &scaled,
+		optPtr->toX, optPtr->toY, optPtr->toX2 - optPtr->toX,
+		optPtr->toY2 - optPtr->toY,
+		optPtr->compositingRule & ~SOURCE_IS_SIMPLE_ALPHA_PHOTO);
+	Tcl_Free(pixels);
+	changed = 1;
+    }
+
+    if (optPtr->options & OPT_SHRINK) {
+	if (ImgPhotoSetSize(modelPtr, optPtr->toX2, optPtr->toY2) != TCL_OK) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    TK_PHOTO_ALLOC_FAILURE_MESSAGE, TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	changed = 1;
+    }
+    if (changed) {
+	Tk_ImageChanged(modelPtr->tkModel, 0, 0, 0, 0,
+		modelPtr->width, modelPtr->height);
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImgPhotoConfigureModel --
+ *
+ *	This function is called when a photo image is created or reconfigured.
+ *	It processes configuration options and resets any instances of the
+ *	image.
+ *
+ * Results:
+ *	A standard Tcl return value. If TCL_ERROR is returned then an error
+ *	message is left in the modelPtr->interp's result.
+ *
+ * Side effects:
+ *	Existing instances of the image will be redisplayed to match the new
+ *	configuration options.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ImgPhotoConfigureModel(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    PhotoModel *modelPtr,	/* Pointer to data structure describing
+				 * overall photo image to (re)configure. */
+    Tcl_Size objc,			/* Number of entries in objv. */
+    Tcl_Obj *const objv[],	/* Pairs of configuration options for image. */
+    int flags)			/* Flags to pass to Tk_ConfigureWidget, such
+				 * as TK_CONFIG_ARGV_ONLY. */
+{
+    PhotoInstance *instancePtr;
+    Tcl_Obj *oldFileObj;
+    const char *oldPaletteString;
+    Tcl_Obj *oldData, *data = NULL, *oldFormat, *format = NULL,
+	    *metadataInObj = NULL, *metadataOutObj = NULL;
+    Tcl_Obj *tempdata, *tempformat;
+    Tcl_Size i, length;
+    int result, imageWidth, imageHeight;
+    double oldGamma;
+    Tcl_Channel chan;
+    Tk_PhotoImageFormat *imageFormat;
+    Tk_PhotoImageFormatVersion3 *imageFormatVersion3;
+
+    for (i = 0; i < objc; i++) {
+	const char *arg = Tcl_GetStringFromObj(objv[i], &length);
+	if ((length > 1) && (arg[0] == '-')) {
+	    if ((arg[1] == 'd') &&
+		    !strncmp(arg, "-data", length)) {
+		if (++i < objc) {
+		    data = objv[i];
+		} else {
+		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			    "value for \"-data\" missing", TCL_INDEX_NONE));
+		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
+			    "MISSING_VALUE", (char *)NULL);
+		    return TCL_ERROR;
+		}
+	    } else if ((arg[1] == 'f') &&
+		    !strncmp(arg, "-format", length)) {
+		if (++i < objc) {
+		    format = objv[i];
+		} else {
+		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			    "value for \"-format\" missing", TCL_INDEX_NONE));
+		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
+			    "MISSING_VALUE", (char *)NULL);
+		    return TCL_ERROR;
+		}
+	    } else if ((arg[1] == 'm') &&
+		!strncmp(arg, "-metadata", length)) {
+		if (++i < objc) {
+		    metadataInObj = objv[i];
+		} else {
+		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"value for \"-metadata\" missing", TCL_INDEX_NONE));
+		    Tcl_SetErrorCode(interp, "TK", "IMAGE", "PHOTO",
+			"MISSING_VALUE", (char *)NULL);
+		    return TCL_ERROR;
+		}
+	    }
+	}
+    }
+
+    /*
+     * Save the current values for fileString and dataString, so we can tell
+     * if the user specifies them anew. IMPORTANT: if the format changes we
+     * have to interpret "-file" and "-data" again as well! It might be that
+     * the format string influences how "-data" or "-file" is interpreted.
+     */
+
+    oldFileObj = modelPtr->fileObj;
+    if (oldFileObj == NULL) {
+	oldData = modelPtr->dataObj;
+	if (oldData != NULL) {
+	    Tcl_IncrRefCount(oldData);
+	}
+    } else {
+	oldData = NULL;
+    }
+    oldFormat = modelPtr->format;
+    if (oldFormat != NULL) {
+	Tcl_IncrRefCount(oldFormat);
+    }
+    oldPaletteString = modelPtr->palette;
+    oldGamma = modelPtr->gamma;
+
+    /*
+     * Process the configuration options specified.
+     */
+
+    if (Tk_ConfigureWidget(interp, Tk_MainWindow(interp), configSpecs,
+	    objc, objv, modelPtr, flags) != TCL_OK) {
+	goto errorExit;
+    }
+
+    /*
+     * Regard the empty string for -file, -data, -format or -metadata as the null value.
+     */
+
+    if ((modelPtr->fileObj != NULL) && (Tcl_GetString(modelPtr->fileObj)[0] == 0)) {
+	Tcl_DecrRefCount(modelPtr->fileObj);
+	modelPtr->fileObj = NULL;
+    }
+    if (data) {
+	/*
+	 * Force into ByteArray format, which most (all) image handlers will
+	 * use anyway. Empty length means ignore the -data option.
+	 */
+	Tcl_Size bytesize;
+
+	(void) Tcl_GetByteArrayFromObj(data, &bytesize);
+	if (bytesize) {
+	    Tcl_IncrRefCount(data);
+	} else {
+	    data = NULL;
+	}
+	if (modelPtr->dataObj) {
+	    Tcl_DecrRefCount(modelPtr->dataObj);
+	}
+	modelPtr->dataObj = data;
+    }
+    if (format) {
+	/*
+	 * Stringify to ignore -format "". It may come in as a list or other
+	 * object.
+	 */
+
+	(void) Tcl_GetString(format);
+	if (format->length) {
+	    Tcl_IncrRefCount(format);
+	} else {
+	    format = NULL;
+	}
+	if (modelPtr->format) {
+	    Tcl_DecrRefCount(modelPtr->format);
+	}
+	modelPtr->format = format;
+    }
+    if (metadataInObj) {
 	/*
 	 * Make -metadata a dict.
 	 * Take also empty metadatas as this may be a sign to replace
@@ -2076,19 +2732,13 @@ ImgPhotoConfigureModel(
 	    Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
 	    goto errorExit;
 	}
+	CancelPendingLoad(modelPtr);
 	tempformat = modelPtr->format;
-	if (imageFormat != NULL) {
-	    result = imageFormat->fileReadProc(interp, chan,
-		    (modelPtr->fileObj ? Tcl_GetString(modelPtr->fileObj) : NULL), tempformat,
-		    (Tk_PhotoHandle) modelPtr,
-		    0, 0, imageWidth, imageHeight, 0, 0);
-	} else {
-	    result = imageFormatVersion3->fileReadProc(interp, chan,
-		    (modelPtr->fileObj ? Tcl_GetString(modelPtr->fileObj) : NULL), tempformat, modelPtr->metadata,
-		    (Tk_PhotoHandle) modelPtr,
-		    0, 0, imageWidth, imageHeight, 0, 0,
-		    metadataOutObj);
-	}
+	result = ReadPhotoFile(interp, chan, modelPtr->fileObj, tempformat,
+		modelPtr->metadata, imageFormat, imageFormatVersion3,
+		GetMappedReadProc(imageFormat, imageFormatVersion3),
+		(Tk_PhotoHandle) modelPtr, 0, 0, imageWidth, imageHeight, 0, 0,
+		metadataOutObj);
 
 	Tcl_Close(NULL, chan);
 	if (result != TCL_OK) {
@@ -2122,6 +2772,7 @@ ImgPhotoConfigureModel(
 	    Tcl_SetErrorCode(interp, "TK", "MALLOC", (char *)NULL);
 	    goto errorExit;
 	}
+	CancelPendingLoad(modelPtr);
 	tempformat = modelPtr->format;
 	tempdata = modelPtr->dataObj;
 	if (imageFormat != NULL) {
@@ -2316,6 +2967,7 @@ ImgPhotoDelete(
     PhotoModel *modelPtr = (PhotoModel *)modelData;
     PhotoInstance *instancePtr;
 
+    CancelPendingLoad(modelPtr);
     while ((instancePtr = modelPtr->instancePtr) != NULL) {
 	if (instancePtr->refCount > 0) {
 	    Tcl_Panic("tried to delete photo image when instances still exist");
@@ -2748,6 +3400,116 @@ MatchFileFormat(
     return TCL_ERROR;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetMappedReadProc --
+ *
+ *	Finds the function given by TkPhotoSetMappedReadProc to a photo image
+ *	format, which reads images in that format from memory.
+ *
+ * Results:
+ *	The function, or NULL if the format has none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TkPhotoMappedReadProc *
+GetMappedReadProc(
+    const Tk_PhotoImageFormat *imageFormat,
+				/* The format, or NULL if it is a Version3
+				 * format. */
+    const Tk_PhotoImageFormatVersion3 *imageFormatVersion3)
+				/* The format, if imageFormat is NULL. */
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    const void *formatPtr = (imageFormat != NULL)
+	    ? (const void *) imageFormat : (const void *) imageFormatVersion3;
+    MappedReader *readerPtr;
+
+    for (readerPtr = tsdPtr->mappedReaders; readerPtr != NULL;
+	    readerPtr = readerPtr->nextPtr) {
+	if (readerPtr->formatPtr == formatPtr) {
+	    return readerPtr->readProc;
+	}
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadPhotoFile --
+ *
+ *	Reads an image file into a photo image with the format found by
+ *	MatchFileFormat. If the format can read from memory and the file is
+ *	a large plain file, the file is mapped and the format decodes it in
+ *	place; otherwise the format's file read function gets the channel.
+ *
+ * Results:
+ *	A standard Tcl result, as returned by the format.
+ *
+ * Side effects:
+ *	The photo image is changed. The position of chan may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadPhotoFile(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Channel chan,		/* The image file, open for reading. */
+    Tcl_Obj *fileObj,		/* The name of the image file. */
+    Tcl_Obj *formatObj,		/* User-specified format object, or NULL. */
+    Tcl_Obj *metadataInObj,	/* Metadata input, may be NULL. */
+    const Tk_PhotoImageFormat *imageFormat,
+				/* The format of the file, or NULL if it is a
+				 * Version3 format. */
+    const Tk_PhotoImageFormatVersion3 *imageFormatVersion3,
+				/* The format of the file, if imageFormat is
+				 * NULL. */
+    TkPhotoMappedReadProc *mappedReadProc,
+				/* Function to read the format from memory,
+				 * or NULL. */
+    Tk_PhotoHandle imageHandle,	/* The photo image to write into. */
+    int destX, int destY,	/* Coordinates of top-left pixel in photo
+				 * image to be written to. */
+    int width, int height,	/* Dimensions of block of photo image to be
+				 * written to. */
+    int srcX, int srcY,		/* Coordinates of top-left pixel to be used in
+				 * image being read. */
+    Tcl_Obj *metadataOutObj)	/* Metadata return dict, may be NULL. */
+{
+    const char *fileName = Tcl_GetString(fileObj);
+
+    if (mappedReadProc != NULL) {
+	const unsigned char *data;
+	Tcl_Size length;
+
+	data = TkMapFile(chan, PHOTO_MAP_MIN_SIZE, &length);
+	if (data != NULL) {
+	    int result = mappedReadProc(interp, data, length, fileName,
+		    formatObj, metadataInObj, imageHandle, destX, destY,
+		    width, height, srcX, srcY, metadataOutObj);
+
+	    TkUnmapFile(data, length);
+	    return result;
+	}
+    }
+
+    if (imageFormat != NULL) {
+	return imageFormat->fileReadProc(interp, chan, fileName, formatObj,
+		imageHandle, destX, destY, width, height, srcX, srcY);
+    }
+    return imageFormatVersion3->fileReadProc(interp, chan, fileName,
+	    formatObj, metadataInObj, imageHandle, destX, destY, width, height,
+	    srcX, srcY, metadataOutObj);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3864,7 +4626,8 @@ Tk_DitherPhoto(
  *
  * Side effects:
  *	The valid region for the image is set to the null region. The generic
- *	image code is notified that the image has changed.
+ *	image code is notified that the image has changed. A load still going
+ *	on in the background is cancelled.
  *
  *----------------------------------------------------------------------
  */
@@ -3876,6 +4639,7 @@ Tk_PhotoBlank(
     PhotoModel *modelPtr = (PhotoModel *) handle;
     PhotoInstance *instancePtr;
 
+    CancelPendingLoad(modelPtr);
     modelPtr->ditherX = modelPtr->ditherY = 0;
     modelPtr->flags = 0;
 
@@ -3902,12 +4666,89 @@ Tk_PhotoBlank(
 	TkImgResetDither(instancePtr);
     }
 
-    /*
-     * Tell the core image code that this image has changed.
-     */
+    /*
+     * Tell the core image code that this image has changed.
+     */
+
+    Tk_ImageChanged(modelPtr->tkModel, 0, 0, modelPtr->width,
+	    modelPtr->height, modelPtr->width, modelPtr->height);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPhotoSetPendingLoad, TkPhotoPendingLoadDone --
+ *
+ *	These functions are used by image formats which go on decoding an
+ *	image after their read function has returned. TkPhotoSetPendingLoad
+ *	registers a function that the photo image calls to abandon such a
+ *	load when the image is deleted, blanked or has other data read into
+ *	it; TkPhotoPendingLoadDone unregisters it once the load is over.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A load that was pending before TkPhotoSetPendingLoad is called is
+ *	cancelled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkPhotoSetPendingLoad(
+    Tk_PhotoHandle handle,	/* Image being loaded. */
+    TkPhotoCancelProc *cancelProc,
+				/* Function to call to abandon the load. */
+    void *clientData)		/* Argument for cancelProc. */
+{
+    PhotoModel *modelPtr = (PhotoModel *) handle;
+
+    CancelPendingLoad(modelPtr);
+    modelPtr->cancelLoadProc = cancelProc;
+    modelPtr->cancelLoadData = clientData;
+}
+
+void
+TkPhotoPendingLoadDone(
+    Tk_PhotoHandle handle,	/* Image that was being loaded. */
+    void *clientData)		/* Argument given to TkPhotoSetPendingLoad. */
+{
+    PhotoModel *modelPtr = (PhotoModel *) handle;
+
+    if (modelPtr->cancelLoadData == clientData) {
+	modelPtr->cancelLoadProc = NULL;
+	modelPtr->cancelLoadData = NULL;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CancelPendingLoad --
+ *
+ *	Abandons the load registered with TkPhotoSetPendingLoad, if any.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the cancel function does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CancelPendingLoad(
+    PhotoModel *modelPtr)	/* Image whose load to cancel. */
+{
+    TkPhotoCancelProc *cancelProc = modelPtr->cancelLoadProc;
 
-    Tk_ImageChanged(modelPtr->tkModel, 0, 0, modelPtr->width,
-	    modelPtr->height, modelPtr->width, modelPtr->height);
+    if (cancelProc != NULL) {
+	modelPtr->cancelLoadProc = NULL;
+	cancelProc(modelPtr->cancelLoadData);
+	modelPtr->cancelLoadData = NULL;
+    }
 }
 
 /*
@@ -4200,79 +5041,630 @@ ImgGetPhoto(
 		int green = optPtr->background->green>>8;
 		int blue = optPtr->background->blue>>8;
 
-		for (y = blockPtr->height; y > 0; y--) {
-		    for (x = blockPtr->width; x > 0; x--) {
-			destPtr[0] += (unsigned char) (((255 - *srcPtr) *
-				(red-destPtr[0])) / 255);
-			destPtr[1] += (unsigned char) (((255 - *srcPtr) *
-				(green-destPtr[1])) / 255);
-			destPtr[2] += (unsigned char) (((255 - *srcPtr) *
-				(blue-destPtr[2])) / 255);
-			srcPtr += blockPtr->pixelSize;
-			destPtr += newPixelSize;
-		    }
-		    srcPtr += blockPtr->pitch -
-			    blockPtr->width * blockPtr->pixelSize;
-		}
-	    } else {
-		int gray = (unsigned char) (((optPtr->background->red>>8) * 11
-			+ (optPtr->background->green>>8) * 16
-			+ (optPtr->background->blue>>8) * 5 + 16) >> 5);
+		for (y = blockPtr->height; y > 0; y--) {
+		    for (x = blockPtr->width; x > 0; x--) {
+			destPtr[0] += (unsigned char) (((255 - *srcPtr) *
+				(red-destPtr[0])) / 255);
+			destPtr[1] += (unsigned char) (((255 - *srcPtr) *
+				(green-destPtr[1])) / 255);
+			destPtr[2] += (unsigned char) (((255 - *srcPtr) *
+				(blue-destPtr[2])) / 255);
+			srcPtr += blockPtr->pixelSize;
+			destPtr += newPixelSize;
+		    }
+		    srcPtr += blockPtr->pitch -
+			    blockPtr->width * blockPtr->pixelSize;
+		}
+	    } else {
+		int gray = (unsigned char) (((optPtr->background->red>>8) * 11
+			+ (optPtr->background->green>>8) * 16
+			+ (optPtr->background->blue>>8) * 5 + 16) >> 5);
+
+		for (y = blockPtr->height; y > 0; y--) {
+		    for (x = blockPtr->width; x > 0; x--) {
+			destPtr[0] += ((255 - *srcPtr) *
+				(gray-destPtr[0])) / 255;
+			srcPtr += blockPtr->pixelSize;
+			destPtr += newPixelSize;
+		    }
+		    srcPtr += blockPtr->pitch -
+			    blockPtr->width * blockPtr->pixelSize;
+		}
+	    }
+	} else {
+	    destPtr += newPixelSize-1;
+	    for (y = blockPtr->height; y > 0; y--) {
+		for (x = blockPtr->width; x > 0; x--) {
+		    *destPtr = *srcPtr;
+		    srcPtr += blockPtr->pixelSize;
+		    destPtr += newPixelSize;
+		}
+		srcPtr += blockPtr->pitch -
+			blockPtr->width * blockPtr->pixelSize;
+	    }
+	}
+	blockPtr->pixelPtr = (unsigned char *) data;
+	blockPtr->pixelSize = newPixelSize;
+	blockPtr->pitch = newPixelSize * blockPtr->width;
+	blockPtr->offset[0] = 0;
+	if (newPixelSize > 2) {
+	    blockPtr->offset[1] = 1;
+	    blockPtr->offset[2] = 2;
+	    blockPtr->offset[3]= 3;
+	} else {
+	    blockPtr->offset[1] = 0;
+	    blockPtr->offset[2] = 0;
+	    blockPtr->offset[3]= 1;
+	}
+	return data;
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tk_PhotoGetImage --
+ *
+ *	This function is called to obtain image data from a photo image. This
+ *	function fills in the Tk_PhotoImageBlock structure pointed to by
+ *	`blockPtr' with details of the address and layout of the image data in
+ *	memory.
+ *
+ * Results:
+ *	TRUE (1) indicating that image data is available, for backwards
+ *	compatibility with the old photo widget.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tk_PhotoGetImage(
+    Tk_PhotoHandle handle,	/* Handle for the photo image from which image
+				 * data is desired. */
+    Tk_PhotoImageBlock *blockPtr)
+				/* Information about the address and layout of
+				 * the image data is returned here. */
+{
+    PhotoModel *modelPtr = (PhotoModel *) handle;
+
+    blockPtr->pixelPtr = modelPtr->pix32;
+    blockPtr->width = modelPtr->width;
+    blockPtr->height = modelPtr->height;
+    blockPtr->pitch = modelPtr->width * 4;
+    blockPtr->pixelSize = 4;
+    blockPtr->offset[0] = 0;
+    blockPtr->offset[1] = 1;
+    blockPtr->offset[2] = 2;
+    blockPtr->offset[3] = 3;
+    return 1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ImgPostscriptPhoto --
+ *
+ *	This function is called to output the contents of a photo image in
+ *	Postscript by calling the Tk_PostscriptPhoto function.
+ *
+ * Results:
+ *	Returns a standard Tcl return value.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ImgPhotoPostscript(
+    void *clientData,	/* Handle for the photo image. */
+    Tcl_Interp *interp,		/* Interpreter. */
+    TCL_UNUSED(Tk_Window),		/* (unused) */
+    Tk_PostscriptInfo psInfo,	/* Postscript info. */
+    int x, int y,		/* First pixel to output. */
+    int width, int height,	/* Width and height of area. */
+    TCL_UNUSED(int))		/* (unused) */
+{
+    Tk_PhotoImageBlock block;
+
+    Tk_PhotoGetImage(clientData, &block);
+    block.pixelPtr += y * block.pitch + x * block.pixelSize;
+
+    return Tk_PostscriptPhoto(interp, &block, psInfo, width, height);
+}
+
+/*
+ * The "image load" command creates photo images and fills them from files,
+ * decoding the files in worker threads. The following structures hold the
+ * state of one such command.
+ *
+ * The built-in formats which the worker threads can decode, with the bytes
+ * that start files in each format. Files in any other format are read on the
+ * interpreter's thread with the photo "read" subcommand.
+ */
+
+typedef struct {
+    const char *name;		/* Name the format is registered under. */
+    const char *magic;		/* The first bytes of files in the format. */
+    int magicLength;		/* Number of bytes in magic. */
+    const Tk_PhotoImageFormat *formatPtr;
+				/* The format record, or NULL if the format is
+				 * a Version3 format. */
+    const Tk_PhotoImageFormatVersion3 *formatVersion3Ptr;
+				/* The format record, if formatPtr is NULL. */
+    TkPhotoMappedReadProc *mappedReadProc;
+				/* Reads the format from memory. */
+} LoaderFormat;
+
+static const LoaderFormat loaderFormats[] = {
+    {"gif", "GIF87a", 6, NULL, &tkImgFmtGIF, TkReadMappedGIF},
+    {"gif", "GIF89a", 6, NULL, &tkImgFmtGIF, TkReadMappedGIF},
+    {"png", "\211PNG\r\n\032\n", 8, NULL, &tkImgFmtPNG, TkReadMappedPNG},
+    {"ppm", "P5", 2, &tkImgFmtPPM, NULL, TkReadMappedPPM},
+    {"ppm", "P6", 2, &tkImgFmtPPM, NULL, TkReadMappedPPM}
+};
+#define NUM_LOADER_FORMATS \
+	((int) (sizeof(loaderFormats) / sizeof(loaderFormats[0])))
+#define LOADER_MAGIC_MAX	8
+
+/*
+ * Upper limit on the number of worker threads for one "image load" command.
+ */
+
+#define PHOTO_MAX_LOADERS	16
+
+/*
+ * One file to load. The worker thread which takes the job fills in status
+ * and either modelPtr or message before handing the job back to the
+ * interpreter's thread.
+ */
+
+typedef enum {
+    LOAD_DONE,			/* The file was decoded into modelPtr. */
+    LOAD_FAILED,		/* The file could not be decoded; message
+				 * says why. */
+    LOAD_FALLBACK		/* The file must be read on the interpreter's
+				 * thread. */
+} LoadStatus;
+
+typedef struct {
+    char *imageName;		/* Name of the photo image to fill. */
+    char *fileName;		/* Name of the file to read. */
+    char *pathName;		/* The normalized name of the file, which the
+				 * worker threads open. */
+    LoadStatus status;		/* The outcome of decoding the file. */
+    PhotoModel *modelPtr;	/* The decoded image, not attached to any Tk
+				 * image, if status is LOAD_DONE. */
+    char *message;		/* Error message if status is LOAD_FAILED. */
+} PhotoLoadJob;
+
+typedef struct {
+    Tcl_Interp *interp;		/* Interpreter the command was run in. */
+    Tcl_ThreadId ownerThread;	/* The interpreter's thread. */
+    Tcl_Obj *cmdObj;		/* Value of -command, or NULL. Only used in
+				 * the interpreter's thread. */
+    char *format;		/* Value of -format, or NULL. */
+    bool threaded[NUM_LOADER_FORMATS];
+				/* Which loaderFormats the worker threads may
+				 * decode. */
+    Tcl_Size numJobs;		/* Number of files. */
+    PhotoLoadJob *jobs;		/* The files. */
+    Tcl_Size numPending;	/* Jobs not yet handed back. Only used in the
+				 * interpreter's thread. */
+    Tcl_Size nextJob;		/* Next job for a worker thread to take;
+				 * protected by mutex. */
+    int refCount;		/* Number of threads using this structure;
+				 * protected by mutex. */
+    Tcl_Mutex mutex;		/* Serializes access to nextJob and
+				 * refCount. */
+} PhotoLoad;
+
+/*
+ * Event queued to the interpreter's thread when a job is finished.
+ */
+
+typedef struct {
+    Tcl_Event header;		/* Standard event header. */
+    PhotoLoad *loadPtr;		/* The command the job belongs to. */
+    PhotoLoadJob *jobPtr;	/* The finished job. */
+} PhotoLoadEvent;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeLoadedModel --
+ *
+ *	Frees a photo image decoded by a worker thread for "image load".
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeLoadedModel(
+    PhotoModel *modelPtr)	/* The image, or NULL. */
+{
+    if (modelPtr == NULL) {
+	return;
+    }
+    if (modelPtr->pix32 != NULL) {
+	Tcl_Free(modelPtr->pix32);
+    }
+    if (modelPtr->validRegion != NULL) {
+	XDestroyRegion(modelPtr->validRegion);
+    }
+    Tcl_Free(modelPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleasePhotoLoad --
+ *
+ *	Drops one thread's reference to the state of an "image load"
+ *	command, freeing it when no thread uses it any more.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleasePhotoLoad(
+    PhotoLoad *loadPtr)
+{
+    Tcl_Size i;
+    int refCount;
+
+    Tcl_MutexLock(&loadPtr->mutex);
+    refCount = --loadPtr->refCount;
+    Tcl_MutexUnlock(&loadPtr->mutex);
+    if (refCount > 0) {
+	return;
+    }
+
+    for (i = 0; i < loadPtr->numJobs; i++) {
+	PhotoLoadJob *jobPtr = &loadPtr->jobs[i];
+
+	if (jobPtr->imageName != NULL) {
+	    Tcl_Free(jobPtr->imageName);
+	    Tcl_Free(jobPtr->fileName);
+	    Tcl_Free(jobPtr->pathName);
+	}
+	FreeLoadedModel(jobPtr->modelPtr);
+	if (jobPtr->message != NULL) {
+	    Tcl_Free(jobPtr->message);
+	}
+    }
+    if (loadPtr->format != NULL) {
+	Tcl_Free(loadPtr->format);
+    }
+    Tcl_Free(loadPtr->jobs);
+    Tcl_MutexFinalize(&loadPtr->mutex);
+    Tcl_Free(loadPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DecodePhotoJob --
+ *
+ *	Decodes one file for "image load" in a worker thread. The format is
+ *	chosen from the first bytes of the file; files which are not in one
+ *	of the formats the worker threads may decode are left for the
+ *	interpreter's thread.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Sets the status of the job, and its decoded image or error message.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DecodePhotoJob(
+    PhotoLoad *loadPtr,		/* The command the job belongs to. */
+    Tcl_Interp *interp,		/* The worker thread's interpreter. */
+    Tcl_Obj *formatObj,		/* Value of -format, or NULL. */
+    PhotoLoadJob *jobPtr)	/* The job to do. */
+{
+    Tcl_Obj *pathObj = Tcl_NewStringObj(jobPtr->pathName, TCL_INDEX_NONE);
+    Tcl_Channel chan;
+    unsigned char magic[LOADER_MAGIC_MAX];
+    const LoaderFormat *loaderPtr = NULL;
+    PhotoModel *modelPtr = NULL;
+    Tcl_Size count;
+    int i, matched, width = 0, height = 0;
+
+    jobPtr->status = LOAD_FALLBACK;
+    Tcl_IncrRefCount(pathObj);
+    chan = Tcl_FSOpenFileChannel(interp, pathObj, "r", 0);
+    if (chan == NULL) {
+	goto error;
+    }
+    if (Tcl_SetChannelOption(interp, chan, "-translation", "binary")
+	    != TCL_OK) {
+	goto error;
+    }
+
+    count = Tcl_Read(chan, (char *) magic, LOADER_MAGIC_MAX);
+    for (i = 0; i < NUM_LOADER_FORMATS; i++) {
+	if (loadPtr->threaded[i] && (count >= loaderFormats[i].magicLength)
+		&& (memcmp(magic, loaderFormats[i].magic,
+		loaderFormats[i].magicLength) == 0)) {
+	    loaderPtr = &loaderFormats[i];
+	    break;
+	}
+    }
+    if (loaderPtr == NULL) {
+	goto done;
+    }
+
+    /*
+     * Leave anything the format's match function turns down to the "read"
+     * subcommand, so that the error is the one it would give.
+     */
 
-		for (y = blockPtr->height; y > 0; y--) {
-		    for (x = blockPtr->width; x > 0; x--) {
-			destPtr[0] += ((255 - *srcPtr) *
-				(gray-destPtr[0])) / 255;
-			srcPtr += blockPtr->pixelSize;
-			destPtr += newPixelSize;
-		    }
-		    srcPtr += blockPtr->pitch -
-			    blockPtr->width * blockPtr->pixelSize;
-		}
-	    }
-	} else {
-	    destPtr += newPixelSize-1;
-	    for (y = blockPtr->height; y > 0; y--) {
-		for (x = blockPtr->width; x > 0; x--) {
-		    *destPtr = *srcPtr;
-		    srcPtr += blockPtr->pixelSize;
-		    destPtr += newPixelSize;
-		}
-		srcPtr += blockPtr->pitch -
-			blockPtr->width * blockPtr->pixelSize;
-	    }
+    (void) Tcl_Seek(chan, Tcl_LongAsWide(0L), SEEK_SET);
+    if (loaderPtr->formatPtr != NULL) {
+	matched = loaderPtr->formatPtr->fileMatchProc(chan, jobPtr->fileName,
+		formatObj, &width, &height, interp);
+    } else {
+	matched = loaderPtr->formatVersion3Ptr->fileMatchProc(interp, chan,
+		jobPtr->fileName, formatObj, NULL, &width, &height, NULL);
+    }
+    if (!matched || (width < 1) || (height < 1)) {
+	goto done;
+    }
+
+    modelPtr = (PhotoModel *) Tcl_Alloc(sizeof(PhotoModel));
+    memset(modelPtr, 0, sizeof(PhotoModel));
+    modelPtr->validRegion = XCreateRegion();
+    if (ImgPhotoSetSize(modelPtr, width, height) != TCL_OK) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		TK_PHOTO_ALLOC_FAILURE_MESSAGE, TCL_INDEX_NONE));
+	goto error;
+    }
+    (void) Tcl_Seek(chan, Tcl_LongAsWide(0L), SEEK_SET);
+    if (ReadPhotoFile(interp, chan, pathObj, formatObj, NULL,
+	    loaderPtr->formatPtr, loaderPtr->formatVersion3Ptr,
+	    loaderPtr->mappedReadProc, (Tk_PhotoHandle) modelPtr, 0, 0,
+	    width, height, 0, 0, NULL) != TCL_OK) {
+	goto error;
+    }
+    jobPtr->status = LOAD_DONE;
+    jobPtr->modelPtr = modelPtr;
+    goto done;
+
+  error:
+    jobPtr->status = LOAD_FAILED;
+    jobPtr->message = (char *) Tcl_Alloc(
+	    strlen(Tcl_GetStringResult(interp)) + 1);
+    strcpy(jobPtr->message, Tcl_GetStringResult(interp));
+    Tcl_ResetResult(interp);
+    FreeLoadedModel(modelPtr);
+
+  done:
+    if (chan != NULL) {
+	Tcl_Close(NULL, chan);
+    }
+    Tcl_DecrRefCount(pathObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PhotoLoadEventProc --
+ *
+ *	Handles a job for "image load" in the interpreter's thread once a
+ *	worker thread has finished with it: the decoded image is copied into
+ *	the photo image, or the file is read with the "read" subcommand, and
+ *	then the -command callback is invoked.
+ *
+ * Results:
+ *	1 if the event was handled, 0 if it must wait for file events.
+ *
+ * Side effects:
+ *	The photo image changes, and the callback may do anything. Errors
+ *	without a callback are reported as background errors.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PhotoLoadEventProc(
+    Tcl_Event *evPtr,		/* The PhotoLoadEvent. */
+    int flags)			/* Flags passed to Tcl_ServiceEvent. */
+{
+    PhotoLoad *loadPtr = ((PhotoLoadEvent *) evPtr)->loadPtr;
+    PhotoLoadJob *jobPtr = ((PhotoLoadEvent *) evPtr)->jobPtr;
+    Tcl_Interp *interp = loadPtr->interp;
+    Tcl_Obj *messageObj = NULL;
+    Tk_PhotoHandle handle;
+
+    if (!(flags & TCL_FILE_EVENTS)) {
+	return 0;
+    }
+
+    if (Tcl_InterpDeleted(interp)) {
+	goto done;
+    }
+
+    handle = Tk_FindPhoto(interp, jobPtr->imageName);
+    if (handle == NULL) {
+	messageObj = Tcl_ObjPrintf("image \"%s\" doesn't exist",
+		jobPtr->imageName);
+    } else if (jobPtr->status == LOAD_DONE) {
+	PhotoModel *modelPtr = jobPtr->modelPtr;
+	Tk_PhotoImageBlock block;
+
+	block.pixelPtr = modelPtr->pix32;
+	block.width = modelPtr->width;
+	block.height = modelPtr->height;
+	block.pitch = modelPtr->width * 4;
+	block.pixelSize = 4;
+	block.offset[0] = 0;
+	block.offset[1] = 1;
+	block.offset[2] = 2;
+	block.offset[3] = 3;
+	if (Tk_PhotoPutBlock(interp, handle, &block, 0, 0, block.width,
+		block.height, TK_PHOTO_COMPOSITE_SET) != TCL_OK) {
+	    messageObj = Tcl_GetObjResult(interp);
+	}
+    } else if (jobPtr->status == LOAD_FAILED) {
+	messageObj = Tcl_NewStringObj(jobPtr->message, TCL_INDEX_NONE);
+    } else {
+	Tcl_Obj *cmdObj = Tcl_NewListObj(0, NULL);
+
+	Tcl_ListObjAppendElement(NULL, cmdObj,
+		Tcl_NewStringObj(jobPtr->imageName, TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, cmdObj, Tcl_NewStringObj("read", 4));
+	Tcl_ListObjAppendElement(NULL, cmdObj,
+		Tcl_NewStringObj(jobPtr->fileName, TCL_INDEX_NONE));
+	if (loadPtr->format != NULL) {
+	    Tcl_ListObjAppendElement(NULL, cmdObj,
+		    Tcl_NewStringObj("-format", 7));
+	    Tcl_ListObjAppendElement(NULL, cmdObj,
+		    Tcl_NewStringObj(loadPtr->format, TCL_INDEX_NONE));
+	}
+	Tcl_IncrRefCount(cmdObj);
+	if (Tcl_EvalObjEx(interp, cmdObj, TCL_EVAL_GLOBAL) != TCL_OK) {
+	    messageObj = Tcl_GetObjResult(interp);
+	}
+	Tcl_DecrRefCount(cmdObj);
+    }
+    if (messageObj != NULL) {
+	Tcl_IncrRefCount(messageObj);
+    }
+
+    if (loadPtr->cmdObj != NULL) {
+	Tcl_Obj *cmdObj = Tcl_DuplicateObj(loadPtr->cmdObj);
+	int code;
+
+	Tcl_IncrRefCount(cmdObj);
+	Tcl_ListObjAppendElement(NULL, cmdObj,
+		Tcl_NewStringObj(jobPtr->imageName, TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, cmdObj,
+		(messageObj != NULL) ? messageObj : Tcl_NewObj());
+	code = Tcl_EvalObjEx(interp, cmdObj, TCL_EVAL_GLOBAL);
+	if (code != TCL_OK) {
+	    Tcl_BackgroundException(interp, code);
+	}
+	Tcl_DecrRefCount(cmdObj);
+    } else if (messageObj != NULL) {
+	Tcl_SetObjResult(interp, messageObj);
+	Tcl_BackgroundException(interp, TCL_ERROR);
+    }
+    Tcl_ResetResult(interp);
+    if (messageObj != NULL) {
+	Tcl_DecrRefCount(messageObj);
+    }
+
+  done:
+    FreeLoadedModel(jobPtr->modelPtr);
+    jobPtr->modelPtr = NULL;
+    if (--loadPtr->numPending == 0) {
+	if (loadPtr->cmdObj != NULL) {
+	    Tcl_DecrRefCount(loadPtr->cmdObj);
 	}
-	blockPtr->pixelPtr = (unsigned char *) data;
-	blockPtr->pixelSize = newPixelSize;
-	blockPtr->pitch = newPixelSize * blockPtr->width;
-	blockPtr->offset[0] = 0;
-	if (newPixelSize > 2) {
-	    blockPtr->offset[1] = 1;
-	    blockPtr->offset[2] = 2;
-	    blockPtr->offset[3]= 3;
-	} else {
-	    blockPtr->offset[1] = 0;
-	    blockPtr->offset[2] = 0;
-	    blockPtr->offset[3]= 1;
+	Tcl_Release(interp);
+	ReleasePhotoLoad(loadPtr);
+    }
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RunPhotoLoad, PhotoLoadThreadProc --
+ *
+ *	Take jobs from an "image load" command and decode them until none
+ *	are left, handing each one back to the interpreter's thread as it is
+ *	finished. PhotoLoadThreadProc is the body of each worker thread.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Queues events to the interpreter's thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RunPhotoLoad(
+    PhotoLoad *loadPtr)
+{
+    Tcl_Interp *interp = Tcl_CreateInterp();
+    Tcl_Obj *formatObj = NULL;
+    PhotoLoadEvent *evPtr;
+    Tcl_Size index;
+
+    if (loadPtr->format != NULL) {
+	formatObj = Tcl_NewStringObj(loadPtr->format, TCL_INDEX_NONE);
+	Tcl_IncrRefCount(formatObj);
+    }
+    for (;;) {
+	Tcl_MutexLock(&loadPtr->mutex);
+	index = loadPtr->nextJob++;
+	Tcl_MutexUnlock(&loadPtr->mutex);
+	if (index >= loadPtr->numJobs) {
+	    break;
 	}
-	return data;
+	DecodePhotoJob(loadPtr, interp, formatObj, &loadPtr->jobs[index]);
+
+	evPtr = (PhotoLoadEvent *) Tcl_Alloc(sizeof(PhotoLoadEvent));
+	evPtr->header.proc = PhotoLoadEventProc;
+	evPtr->loadPtr = loadPtr;
+	evPtr->jobPtr = &loadPtr->jobs[index];
+	Tcl_ThreadQueueEvent(loadPtr->ownerThread, &evPtr->header,
+		TCL_QUEUE_TAIL);
+	Tcl_ThreadAlert(loadPtr->ownerThread);
     }
-    return NULL;
+    if (formatObj != NULL) {
+	Tcl_DecrRefCount(formatObj);
+    }
+    Tcl_DeleteInterp(interp);
+    ReleasePhotoLoad(loadPtr);
 }
-
+
+static Tcl_ThreadCreateType
+PhotoLoadThreadProc(
+    void *clientData)		/* The PhotoLoad. */
+{
+    RunPhotoLoad((PhotoLoad *) clientData);
+    Tcl_ExitThread(0);
+    TCL_THREAD_CREATE_RETURN;
+}
+
 /*
  *----------------------------------------------------------------------
  *
- * Tk_PhotoGetImage --
+ * LoaderFormatUsable --
  *
- *	This function is called to obtain image data from a photo image. This
- *	function fills in the Tk_PhotoImageBlock structure pointed to by
- *	`blockPtr' with details of the address and layout of the image data in
- *	memory.
+ *	Checks whether the worker threads of "image load" may decode files
+ *	in one of loaderFormats: the format registered under its name must
+ *	still be the built-in one, and a -format value must name it without
+ *	options that only the interpreter's thread can handle.
  *
  * Results:
- *	TRUE (1) indicating that image data is available, for backwards
- *	compatibility with the old photo widget.
+ *	True if the format may be decoded in worker threads.
  *
  * Side effects:
  *	None.
@@ -4280,63 +5672,239 @@ ImgGetPhoto(
  *----------------------------------------------------------------------
  */
 
-int
-Tk_PhotoGetImage(
-    Tk_PhotoHandle handle,	/* Handle for the photo image from which image
-				 * data is desired. */
-    Tk_PhotoImageBlock *blockPtr)
-				/* Information about the address and layout of
-				 * the image data is returned here. */
+static bool
+LoaderFormatUsable(
+    const LoaderFormat *loaderPtr,
+    Tcl_Obj *formatObj)		/* Value of -format, or NULL. */
 {
-    PhotoModel *modelPtr = (PhotoModel *) handle;
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    Tk_PhotoImageFormat *formatPtr;
+    Tk_PhotoImageFormatVersion3 *formatVersion3Ptr;
+    Tcl_Size objc;
+    Tcl_Obj **objv;
 
-    blockPtr->pixelPtr = modelPtr->pix32;
-    blockPtr->width = modelPtr->width;
-    blockPtr->height = modelPtr->height;
-    blockPtr->pitch = modelPtr->width * 4;
-    blockPtr->pixelSize = 4;
-    blockPtr->offset[0] = 0;
-    blockPtr->offset[1] = 1;
-    blockPtr->offset[2] = 2;
-    blockPtr->offset[3] = 3;
-    return 1;
+    if (formatObj != NULL) {
+	if ((Tcl_ListObjGetElements(NULL, formatObj, &objc, &objv) != TCL_OK)
+		|| (objc != 1) || (strncasecmp(Tcl_GetString(formatObj),
+		loaderPtr->name, strlen(loaderPtr->name)) != 0)) {
+	    return false;
+	}
+    }
+
+    /*
+     * Formats registered later come first in the lists, so the first one
+     * with the name is the one "read" would use.
+     */
+
+    if (loaderPtr->formatPtr != NULL) {
+	for (formatPtr = tsdPtr->formatList; formatPtr != NULL;
+		formatPtr = formatPtr->nextPtr) {
+	    if (strcasecmp(formatPtr->name, loaderPtr->name) == 0) {
+		return formatPtr->fileReadProc
+			== loaderPtr->formatPtr->fileReadProc;
+	    }
+	}
+    } else {
+	for (formatVersion3Ptr = tsdPtr->formatListVersion3;
+		formatVersion3Ptr != NULL;
+		formatVersion3Ptr = formatVersion3Ptr->nextPtr) {
+	    if (strcasecmp(formatVersion3Ptr->name, loaderPtr->name) == 0) {
+		return formatVersion3Ptr->fileReadProc
+			== loaderPtr->formatVersion3Ptr->fileReadProc;
+	    }
+	}
+    }
+    return false;
 }
-
+
 /*
- *--------------------------------------------------------------
+ *----------------------------------------------------------------------
  *
- * ImgPostscriptPhoto --
+ * TkPhotoLoadObjCmd --
  *
- *	This function is called to output the contents of a photo image in
- *	Postscript by calling the Tk_PostscriptPhoto function.
+ *	Implements "image load": creates photo images and fills each from a
+ *	file, decoding the files concurrently in worker threads. The images
+ *	exist, empty, when the command returns; each is filled in when the
+ *	event loop next runs after its file has been decoded.
  *
  * Results:
- *	Returns a standard Tcl return value.
+ *	A standard Tcl result; the result is the list of image names.
  *
  * Side effects:
- *	None.
+ *	Creates images and starts worker threads. If one of the images can't
+ *	be created, those created before it are deleted again.
  *
- *--------------------------------------------------------------
+ *----------------------------------------------------------------------
  */
 
-static int
-ImgPhotoPostscript(
-    void *clientData,	/* Handle for the photo image. */
-    Tcl_Interp *interp,		/* Interpreter. */
-    TCL_UNUSED(Tk_Window),		/* (unused) */
-    Tk_PostscriptInfo psInfo,	/* Postscript info. */
-    int x, int y,		/* First pixel to output. */
-    int width, int height,	/* Width and height of area. */
-    TCL_UNUSED(int))		/* (unused) */
+int
+TkPhotoLoadObjCmd(
+    void *clientData,		/* Main window associated with interpreter. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    Tk_PhotoImageBlock block;
+    static const char *const loadOptions[] = {
+	"-command", "-format", NULL
+    };
+    enum loadOptionsEnum {
+	LOAD_COMMAND, LOAD_FORMAT
+    };
+    Tcl_Obj *cmdObj = NULL, *formatObj = NULL, *createObjv[4];
+    PhotoLoad *loadPtr;
+    Tcl_ThreadId threadId;
+    Tcl_Size i, first;
+    int index, numThreads, started;
 
-    Tk_PhotoGetImage(clientData, &block);
-    block.pixelPtr += y * block.pitch + x * block.pixelSize;
+    for (first = 2; first < objc; first += 2) {
+	const char *arg = Tcl_GetString(objv[first]);
 
-    return Tk_PostscriptPhoto(interp, &block, psInfo, width, height);
+	if ((arg[0] != '-') || (first + 1 >= objc)) {
+	    break;
+	}
+	if (Tcl_GetIndexFromObjStruct(interp, objv[first], loadOptions,
+		sizeof(char *), "option", 0, &index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (index == LOAD_COMMAND) {
+	    cmdObj = objv[first + 1];
+	} else {
+	    formatObj = objv[first + 1];
+	}
+    }
+    if ((first >= objc) || ((objc - first) % 2 != 0)) {
+	Tcl_WrongNumArgs(interp, 2, objv,
+		"?-option value ...? name fileName ?name fileName ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_IsSafe(interp)) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"can't get image from a file in a safe interpreter",
+		TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "SAFE", "PHOTO_FILE", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    loadPtr = (PhotoLoad *) Tcl_Alloc(sizeof(PhotoLoad));
+    memset(loadPtr, 0, sizeof(PhotoLoad));
+    loadPtr->numJobs = (objc - first) / 2;
+    loadPtr->jobs = (PhotoLoadJob *)
+	    Tcl_Alloc(loadPtr->numJobs * sizeof(PhotoLoadJob));
+    memset(loadPtr->jobs, 0, loadPtr->numJobs * sizeof(PhotoLoadJob));
+    for (i = 0; i < loadPtr->numJobs; i++) {
+	PhotoLoadJob *jobPtr = &loadPtr->jobs[i];
+	Tcl_Obj *pathObj = Tcl_FSGetNormalizedPath(interp,
+		objv[first + 2 * i + 1]);
+	const char *string;
+
+	if (pathObj == NULL) {
+	    goto error;
+	}
+	string = Tcl_GetString(objv[first + 2 * i]);
+	jobPtr->imageName = (char *) Tcl_Alloc(strlen(string) + 1);
+	strcpy(jobPtr->imageName, string);
+	string = Tcl_GetString(objv[first + 2 * i + 1]);
+	jobPtr->fileName = (char *) Tcl_Alloc(strlen(string) + 1);
+	strcpy(jobPtr->fileName, string);
+	string = Tcl_GetString(pathObj);
+	jobPtr->pathName = (char *) Tcl_Alloc(strlen(string) + 1);
+	strcpy(jobPtr->pathName, string);
+    }
+
+    /*
+     * Create the images, so that they can be used at once.
+     */
+
+    createObjv[0] = objv[0];
+    createObjv[1] = Tcl_NewStringObj("create", 6);
+    createObjv[2] = Tcl_NewStringObj("photo", 5);
+    Tcl_IncrRefCount(createObjv[1]);
+    Tcl_IncrRefCount(createObjv[2]);
+    for (i = 0; i < loadPtr->numJobs; i++) {
+	createObjv[3] = objv[first + 2 * i];
+	if (Tk_ImageObjCmd(clientData, interp, 4, createObjv) != TCL_OK) {
+	    break;
+	}
+    }
+    Tcl_DecrRefCount(createObjv[1]);
+    Tcl_DecrRefCount(createObjv[2]);
+    if (i < loadPtr->numJobs) {
+	/*
+	 * Don't leave the images that were created before the failure
+	 * behind: nothing would ever fill them in.
+	 */
+
+	while (i-- > 0) {
+	    Tk_DeleteImage(interp, Tcl_GetString(objv[first + 2 * i]));
+	}
+	goto error;
+    }
+
+    loadPtr->interp = interp;
+    loadPtr->ownerThread = Tcl_GetCurrentThread();
+    if (cmdObj != NULL) {
+	loadPtr->cmdObj = cmdObj;
+	Tcl_IncrRefCount(cmdObj);
+    }
+    if (formatObj != NULL) {
+	const char *string = Tcl_GetString(formatObj);
+
+	loadPtr->format = (char *) Tcl_Alloc(strlen(string) + 1);
+	strcpy(loadPtr->format, string);
+    }
+    for (index = 0; index < NUM_LOADER_FORMATS; index++) {
+	loadPtr->threaded[index] =
+		LoaderFormatUsable(&loaderFormats[index], formatObj);
+    }
+    loadPtr->numPending = loadPtr->numJobs;
+    Tcl_Preserve(interp);
+
+    /*
+     * Start the worker threads. Each holds a reference to the PhotoLoad, as
+     * does this thread until every job has been handed back.
+     */
+
+    numThreads = TkGetProcessorCount();
+    if (numThreads > loadPtr->numJobs) {
+	numThreads = (int) loadPtr->numJobs;
+    }
+    if (numThreads > PHOTO_MAX_LOADERS) {
+	numThreads = PHOTO_MAX_LOADERS;
+    }
+    loadPtr->refCount = numThreads + 1;
+    started = 0;
+    for (index = 0; index < numThreads; index++) {
+	if (Tcl_CreateThread(&threadId, PhotoLoadThreadProc, loadPtr,
+		TCL_THREAD_STACK_DEFAULT, TCL_THREAD_NOFLAGS) == TCL_OK) {
+	    started++;
+	}
+    }
+    if (started < numThreads) {
+	Tcl_MutexLock(&loadPtr->mutex);
+	loadPtr->refCount -= numThreads - started;
+	if (started == 0) {
+	    loadPtr->refCount++;
+	}
+	Tcl_MutexUnlock(&loadPtr->mutex);
+	if (started == 0) {
+	    RunPhotoLoad(loadPtr);
+	}
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(0, NULL));
+    for (i = 0; i < loadPtr->numJobs; i++) {
+	Tcl_ListObjAppendElement(NULL, Tcl_GetObjResult(interp),
+		objv[first + 2 * i]);
+    }
+    return TCL_OK;
+
+  error:
+    loadPtr->refCount = 1;
+    ReleasePhotoLoad(loadPtr);
+    return TCL_ERROR;
 }
-
+
 /*
  * Local Variables:
  * mode: c
@@ -106,6 +106,11 @@ struct ColorTable {
 				/* Maps 8-bit intensities to quantized
 				 * intensities. The first index is 0 for red,
 				 * 1 for green, 2 for blue. */
+    unsigned char redShift;	/* Position of the lowest bit of the red
+				 * field in a pixel value. Only meaningful for
+				 * TrueColor and DirectColor visuals. */
+    unsigned char greenShift;	/* Ditto for green. */
+    unsigned char blueShift;	/* Ditto for blue. */
 };
 
 /*
@@ -119,6 +124,10 @@ struct ColorTable {
  *				been invoked yet.
  * MAP_COLORS:			1 means pixel values should be mapped through
  *				pixelMap.
+ * DIRECT_PIXELS:		1 means each component is an 8-bit field of
+ *				the pixel value that redValues, greenValues
+ *				and blueValues fill in unchanged, so pixels
+ *				can be built with the shifts alone.
  */
 
 #ifdef COLOR_WINDOW
@@ -129,6 +138,7 @@ struct ColorTable {
 #define COLOR_WINDOW		2
 #define DISPOSE_PENDING		4
 #define MAP_COLORS		8
+#define DIRECT_PIXELS		16
 
 /*
  * Definition of the data associated with each photo image model.
@@ -161,6 +171,11 @@ struct PhotoModel {
 				 * image have valid image data. */
     PhotoInstance *instancePtr;	/* First in the list of instances associated
 				 * with this model. */
+    TkPhotoCancelProc *cancelLoadProc;
+				/* Called to abandon a load that an image
+				 * format is still completing in the
+				 * background, or NULL if there is none. */
+    void *cancelLoadData;	/* Argument for cancelLoadProc. */
 };
 
 /*
@@ -213,6 +228,10 @@ struct PhotoInstance {
 				 * windows are using. */
     GC gc;			/* Graphics context for writing images to the
 				 * pixmap. */
+#ifdef HAVE_XSHM
+    TkShmSegment *shmSegment;	/* Shared memory used to upload dithered
+				 * pixels to the pixmap, or NULL. */
+#endif
 };
 
 /*
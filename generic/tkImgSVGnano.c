@@ -36,8 +36,74 @@ typedef struct {
 } RastOpts;
 
 /*
- * Per interp cache of last NSVGimage which was matched to
- * be immediately rasterized after the match. This helps to
+ * A bitmap rasterized from a parsed SVG document at one size.
+ */
+
+typedef struct SVGRaster {
+    int width, height;		/* Size of the bitmap. */
+    double scale;		/* Scale it was rasterized at. */
+    unsigned char *pixels;	/* RGBA pixels, width*4 bytes per row. */
+    struct SVGRaster *nextPtr;	/* Next bitmap of the same document, less
+				 * recently used. */
+} SVGRaster;
+
+/*
+ * A parsed SVG document, kept so that reading the same data again, at the
+ * same or another size, does not parse it again. Documents are found by a
+ * hash of their source data and the -dpi they were parsed with.
+ */
+
+typedef struct SVGDocument {
+    Tcl_HashEntry *hPtr;	/* Entry in the document table. */
+    char *data;			/* Copy of the source data. */
+    Tcl_Size length;		/* Length of data. */
+    double dpi;			/* Value of -dpi it was parsed with. */
+    NSVGimage *nsvgImage;	/* The parsed document. */
+    SVGRaster *rasters;		/* Bitmaps rasterized from it, most recently
+				 * used first. */
+    size_t size;		/* Bytes held by the document and its
+				 * bitmaps. */
+    struct SVGDocument *prevPtr, *nextPtr;
+				/* Neighbours in the list of documents, most
+				 * recently used first. */
+} SVGDocument;
+
+/*
+ * Limits on the caches: the total bytes held by all documents of an
+ * interpreter, and the number of bitmaps kept per document. A bitmap bigger
+ * than a quarter of the total is not kept at all.
+ */
+
+#define SVG_CACHE_MAX_BYTES	(16 * 1024 * 1024)
+#define SVG_MAX_RASTERS		4
+
+/*
+ * Images of at least SVG_PARALLEL_MIN pixels are rasterized in horizontal
+ * bands by several threads. Each band scans all the edges of the document,
+ * so bands are not made smaller than SVG_BAND_MIN_ROWS rows.
+ */
+
+#define SVG_PARALLEL_MIN	(512 * 512)
+#define SVG_BAND_MIN_ROWS	64
+#define SVG_MAX_BANDS		16
+
+/*
+ * The work of rasterizing an image in bands.
+ */
+
+typedef struct {
+    NSVGimage *nsvgImage;	/* Document to rasterize. */
+    float scale;		/* Scale to rasterize it at. */
+    unsigned char *pixels;	/* RGBA result, width*4 bytes per row. */
+    int width, height;		/* Size of the result. */
+    int numBands;		/* Number of bands it is split into. */
+    bool failed[SVG_MAX_BANDS];	/* Set for each band which could not get a
+				 * rasterizer. */
+} SVGBandJob;
+
+/*
+ * Per interp cache of parsed SVG documents, and of the last document which
+ * was matched to be immediately rasterized after the match. This helps to
  * eliminate double parsing of the SVG file/string.
  */
 
@@ -48,8 +114,13 @@ typedef struct {
      */
     void *dataOrChan;
     Tcl_DString formatString;
-    NSVGimage *nsvgImage;
+    SVGDocument *documentPtr;
     RastOpts ropts;
+    Tcl_HashTable documents;	/* Parsed documents, keyed by a hash of
+				 * their data and dpi. */
+    SVGDocument *firstPtr, *lastPtr;
+				/* Most and least recently used documents. */
+    size_t size;		/* Bytes held by all documents. */
 } NSVGcache;
 
 static const void *	MemMem(const void *haystack, size_t haysize,
@@ -67,21 +138,31 @@ static int		StringReadSVG(Tcl_Interp *interp, Tcl_Obj *dataObj,
 			    Tcl_Obj *format, Tk_PhotoHandle imageHandle,
 			    int destX, int destY, int width, int height,
 			    int srcX, int srcY);
-static NSVGimage *	ParseSVGWithOptions(Tcl_Interp *interp,
+static SVGDocument *	ParseSVGWithOptions(Tcl_Interp *interp,
 			    const char *input, Tcl_Size length, Tcl_Obj *format,
 			    RastOpts *ropts);
+static SVGDocument *	GetSVGDocument(Tcl_Interp *interp, const char *input,
+			    Tcl_Size length, double dpi);
+static void		RasterizeBand(void *clientData, int band);
+static int		RasterizeDocument(NSVGimage *nsvgImage,
+			    double scale, unsigned char *pixels, int w, int h,
+			    int numBands);
 static int		RasterizeSVG(Tcl_Interp *interp,
-			    Tk_PhotoHandle imageHandle, NSVGimage *nsvgImage,
+			    Tk_PhotoHandle imageHandle, SVGDocument *documentPtr,
 			    int destX, int destY, int width, int height,
 			    int srcX, int srcY, RastOpts *ropts);
 static double		GetScaleFromParameters(NSVGimage *nsvgImage,
 			    RastOpts *ropts, int *widthPtr, int *heightPtr);
 static NSVGcache *	GetCachePtr(Tcl_Interp *interp);
 static bool		CacheSVG(Tcl_Interp *interp, void *dataOrChan,
-			    Tcl_Obj *formatObj, NSVGimage *nsvgImage,
+			    Tcl_Obj *formatObj, SVGDocument *documentPtr,
 			    RastOpts *ropts);
-static NSVGimage *	GetCachedSVG(Tcl_Interp *interp, void *dataOrChan,
+static SVGDocument *	GetCachedSVG(Tcl_Interp *interp, void *dataOrChan,
 			    Tcl_Obj *formatObj, RastOpts *ropts);
+static void		TrimCache(NSVGcache *cachePtr,
+			    SVGDocument *keepPtr);
+static void		FreeSVGDocument(NSVGcache *cachePtr,
+			    SVGDocument *documentPtr);
 static void		CleanCache(Tcl_Interp *interp);
 static void		FreeCache(void *clientData, Tcl_Interp *interp);
 
@@ -170,7 +251,7 @@ FileMatchSVG(
     Tcl_Obj *dataObj = Tcl_NewObj();
     const char *data;
     RastOpts ropts;
-    NSVGimage *nsvgImage;
+    SVGDocument *documentPtr;
 
     CleanCache(interp);
     if (Tcl_ReadChars(chan, dataObj, 4096, 0) == TCL_IO_FAILURE) {
@@ -191,17 +272,16 @@ FileMatchSVG(
 	return 0;
     }
     data = Tcl_GetStringFromObj(dataObj, &length);
-    nsvgImage = ParseSVGWithOptions(interp, data, length, formatObj, &ropts);
+    documentPtr = ParseSVGWithOptions(interp, data, length, formatObj,
+	    &ropts);
     Tcl_DecrRefCount(dataObj);
-    if (nsvgImage != NULL) {
-	GetScaleFromParameters(nsvgImage, &ropts, widthPtr, heightPtr);
+    if (documentPtr != NULL) {
+	GetScaleFromParameters(documentPtr->nsvgImage, &ropts, widthPtr,
+		heightPtr);
 	if ((*widthPtr <= 0.0) || (*heightPtr <= 0.0)) {
-	    nsvgDelete(nsvgImage);
 	    return 0;
 	}
-	if (!CacheSVG(interp, chan, formatObj, nsvgImage, &ropts)) {
-	    nsvgDelete(nsvgImage);
-	}
+	CacheSVG(interp, chan, formatObj, documentPtr, &ropts);
 	return 1;
     }
     return 0;
@@ -240,9 +320,9 @@ FileReadSVG(
     Tcl_Size length;
     const char *data;
     RastOpts ropts;
-    NSVGimage *nsvgImage = GetCachedSVG(interp, chan, formatObj, &ropts);
+    SVGDocument *documentPtr = GetCachedSVG(interp, chan, formatObj, &ropts);
 
-    if (nsvgImage == NULL) {
+    if (documentPtr == NULL) {
 	Tcl_Obj *dataObj = Tcl_NewObj();
 
 	if (Tcl_ReadChars(chan, dataObj, TCL_INDEX_NONE, 0) == TCL_IO_FAILURE) {
@@ -253,14 +333,14 @@ FileReadSVG(
 	    return TCL_ERROR;
 	}
 	data = Tcl_GetStringFromObj(dataObj, &length);
-	nsvgImage = ParseSVGWithOptions(interp, data, length, formatObj,
+	documentPtr = ParseSVGWithOptions(interp, data, length, formatObj,
 			    &ropts);
 	Tcl_DecrRefCount(dataObj);
-	if (nsvgImage == NULL) {
+	if (documentPtr == NULL) {
 	    return TCL_ERROR;
 	}
     }
-    return RasterizeSVG(interp, imageHandle, nsvgImage, destX, destY,
+    return RasterizeSVG(interp, imageHandle, documentPtr, destX, destY,
 		width, height, srcX, srcY, &ropts);
 }
 
@@ -292,7 +372,7 @@ StringMatchSVG(
     Tcl_Size length, testLength;
     const char *data;
     RastOpts ropts;
-    NSVGimage *nsvgImage;
+    SVGDocument *documentPtr;
 
     CleanCache(interp);
     data = Tcl_GetStringFromObj(dataObj, &length);
@@ -302,16 +382,15 @@ StringMatchSVG(
 	(MemMem(data, testLength, "<svg", 4) == NULL)) {
 	return 0;
     }
-    nsvgImage = ParseSVGWithOptions(interp, data, length, formatObj, &ropts);
-    if (nsvgImage != NULL) {
-	GetScaleFromParameters(nsvgImage, &ropts, widthPtr, heightPtr);
+    documentPtr = ParseSVGWithOptions(interp, data, length, formatObj,
+	    &ropts);
+    if (documentPtr != NULL) {
+	GetScaleFromParameters(documentPtr->nsvgImage, &ropts, widthPtr,
+		heightPtr);
 	if ((*widthPtr <= 0.0) || (*heightPtr <= 0.0)) {
-	    nsvgDelete(nsvgImage);
 	    return 0;
 	}
-	if (!CacheSVG(interp, dataObj, formatObj, nsvgImage, &ropts)) {
-	    nsvgDelete(nsvgImage);
-	}
+	CacheSVG(interp, dataObj, formatObj, documentPtr, &ropts);
 	return 1;
     }
     return 0;
@@ -348,17 +427,18 @@ StringReadSVG(
     Tcl_Size length;
     const char *data;
     RastOpts ropts;
-    NSVGimage *nsvgImage = GetCachedSVG(interp, dataObj, formatObj, &ropts);
+    SVGDocument *documentPtr = GetCachedSVG(interp, dataObj, formatObj,
+	    &ropts);
 
-    if (nsvgImage == NULL) {
+    if (documentPtr == NULL) {
 	data = Tcl_GetStringFromObj(dataObj, &length);
-	nsvgImage = ParseSVGWithOptions(interp, data, length, formatObj,
+	documentPtr = ParseSVGWithOptions(interp, data, length, formatObj,
 			    &ropts);
     }
-    if (nsvgImage == NULL) {
+    if (documentPtr == NULL) {
 	return TCL_ERROR;
     }
-    return RasterizeSVG(interp, imageHandle, nsvgImage, destX, destY,
+    return RasterizeSVG(interp, imageHandle, documentPtr, destX, destY,
 		width, height, srcX, srcY, &ropts);
 }
 
@@ -370,14 +450,16 @@ StringReadSVG(
  *	This function is called to parse the given input string as SVG.
  *
  * Results:
- *	Return a newly create NSVGimage on success, and NULL otherwise.
+ *	Return the parsed document on success, and NULL otherwise. The
+ *	document belongs to the interpreter's cache.
  *
  * Side effects:
+ *	The document may be added to the cache.
  *
  *----------------------------------------------------------------------
  */
 
-static NSVGimage *
+static SVGDocument *
 ParseSVGWithOptions(
     Tcl_Interp *interp,
     const char *input,
@@ -388,8 +470,6 @@ ParseSVGWithOptions(
     Tcl_Obj **objv = NULL;
     Tcl_Size objc = 0;
     double dpi = 96.0;
-    char *inputCopy = NULL;
-    NSVGimage *nsvgImage;
     bool parameterScaleSeen = false;
     static const char *const fmtOptions[] = {
 	"-dpi", "-scale", "-scaletoheight", "-scaletowidth", NULL
@@ -398,20 +478,6 @@ ParseSVGWithOptions(
 	OPT_DPI, OPT_SCALE, OPT_SCALE_TO_HEIGHT, OPT_SCALE_TO_WIDTH
     };
 
-    /*
-     * The parser destroys the original input string,
-     * therefore first duplicate.
-     */
-
-    inputCopy = (char *)Tcl_AttemptAlloc(length+1);
-    if (inputCopy == NULL) {
-	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot alloc data buffer", TCL_INDEX_NONE));
-	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "OUT_OF_MEMORY", (char *)NULL);
-	goto error;
-    }
-    memcpy(inputCopy, input, length);
-    inputCopy[length] = '\0';
-
     /*
      * Process elements of format specification as a list.
      */
@@ -421,7 +487,7 @@ ParseSVGWithOptions(
     ropts->scaleToWidth = 0;
     if ((formatObj != NULL) &&
 	    Tcl_ListObjGetElements(interp, formatObj, &objc, &objv) != TCL_OK) {
-	goto error;
+	return NULL;
     }
     for (; objc > 0 ; objc--, objv++) {
 	int optIndex;
@@ -436,14 +502,12 @@ ParseSVGWithOptions(
 
 	if (Tcl_GetIndexFromObjStruct(interp, objv[0], fmtOptions,
 		sizeof(char *), "option", 0, &optIndex) == TCL_ERROR) {
-	    goto error;
+	    return NULL;
 	}
 
 	if (objc < 2) {
-	    Tcl_Free(inputCopy);
-	    inputCopy = NULL;
 	    Tcl_WrongNumArgs(interp, 1, objv, "value");
-	    goto error;
+	    return NULL;
 	}
 
 	objc--;
@@ -461,7 +525,7 @@ ParseSVGWithOptions(
 			"only one of -scale, -scaletoheight, -scaletowidth may be given", TCL_INDEX_NONE));
 		Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "BAD_SCALE",
 			(char *)NULL);
-		goto error;
+		return NULL;
 	    }
 	    parameterScaleSeen = true;
 	    break;
@@ -475,72 +539,292 @@ ParseSVGWithOptions(
 	switch ((enum fmtOptionsEnum) optIndex) {
 	case OPT_DPI:
 	    if (Tcl_GetDoubleFromObj(interp, objv[0], &dpi) == TCL_ERROR) {
-		goto error;
+		return NULL;
 	    }
 	    if (dpi < 0.0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"-dpi value must be positive", TCL_INDEX_NONE));
 		Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "BAD_DPI",
 			(char *)NULL);
-		goto error;
+		return NULL;
 	    }
 	    break;
 	case OPT_SCALE:
 	    if (Tcl_GetDoubleFromObj(interp, objv[0], &ropts->scale) ==
 		TCL_ERROR) {
-		goto error;
+		return NULL;
 	    }
 	    if (ropts->scale <= 0.0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"-scale value must be positive", TCL_INDEX_NONE));
 		Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "BAD_SCALE",
 			(char *)NULL);
-		goto error;
+		return NULL;
 	    }
 	    break;
 	case OPT_SCALE_TO_HEIGHT:
 	    if (Tcl_GetIntFromObj(interp, objv[0], &ropts->scaleToHeight) ==
 		TCL_ERROR) {
-		goto error;
+		return NULL;
 	    }
 	    if (ropts->scaleToHeight <= 0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"-scaletoheight value must be positive", TCL_INDEX_NONE));
 		Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "BAD_SCALE",
 			(char *)NULL);
-		goto error;
+		return NULL;
 	    }
 	    break;
 	case OPT_SCALE_TO_WIDTH:
 	    if (Tcl_GetIntFromObj(interp, objv[0], &ropts->scaleToWidth) ==
 		TCL_ERROR) {
-		goto error;
+		return NULL;
 	    }
 	    if (ropts->scaleToWidth <= 0) {
 		Tcl_SetObjResult(interp, Tcl_NewStringObj(
 			"-scaletowidth value must be positive", TCL_INDEX_NONE));
 		Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "BAD_SCALE",
 			(char *)NULL);
-		goto error;
+		return NULL;
 	    }
 	    break;
 	}
     }
 
+    return GetSVGDocument(interp, input, length, dpi);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetSVGDocument --
+ *
+ *	Finds the parsed document for the given input string and dpi in the
+ *	interpreter's cache, parsing the string and adding it to the cache
+ *	if it is not there.
+ *
+ * Results:
+ *	Return the document on success, and NULL otherwise.
+ *
+ * Side effects:
+ *	The document becomes the most recently used one. Adding a document
+ *	may remove less recently used ones from the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SVGDocument *
+GetSVGDocument(
+    Tcl_Interp *interp,
+    const char *input,
+    Tcl_Size length,
+    double dpi)
+{
+    NSVGcache *cachePtr = GetCachePtr(interp);
+    unsigned int key[2];
+    Tcl_WideUInt hash = 14695981039346656037ULL;
+    unsigned char dpiBytes[sizeof(double)];
+    Tcl_HashEntry *hPtr;
+    SVGDocument *documentPtr;
+    NSVGimage *nsvgImage;
+    char *inputCopy;
+    Tcl_Size i;
+    int isNew;
+
+    /*
+     * FNV-1a hash of the data and the dpi.
+     */
+
+    for (i = 0; i < length; i++) {
+	hash = (hash ^ (unsigned char) input[i]) * 1099511628211ULL;
+    }
+    memcpy(dpiBytes, &dpi, sizeof(double));
+    for (i = 0; i < (Tcl_Size) sizeof(double); i++) {
+	hash = (hash ^ dpiBytes[i]) * 1099511628211ULL;
+    }
+    key[0] = (unsigned int) hash;
+    key[1] = (unsigned int) (hash >> 32);
+
+    hPtr = Tcl_FindHashEntry(&cachePtr->documents, (char *) key);
+    if (hPtr != NULL) {
+	documentPtr = (SVGDocument *) Tcl_GetHashValue(hPtr);
+	if ((documentPtr->length == length) && (documentPtr->dpi == dpi)
+		&& (memcmp(documentPtr->data, input, length) == 0)) {
+	    if (documentPtr != cachePtr->firstPtr) {
+		documentPtr->prevPtr->nextPtr = documentPtr->nextPtr;
+		if (documentPtr->nextPtr != NULL) {
+		    documentPtr->nextPtr->prevPtr = documentPtr->prevPtr;
+		} else {
+		    cachePtr->lastPtr = documentPtr->prevPtr;
+		}
+		documentPtr->prevPtr = NULL;
+		documentPtr->nextPtr = cachePtr->firstPtr;
+		cachePtr->firstPtr->prevPtr = documentPtr;
+		cachePtr->firstPtr = documentPtr;
+	    }
+	    return documentPtr;
+	}
+
+	/*
+	 * Different data with the same hash: the new data replaces it.
+	 */
+
+	FreeSVGDocument(cachePtr, documentPtr);
+    }
+
+    /*
+     * The parser destroys the original input string,
+     * therefore first duplicate.
+     */
+
+    inputCopy = (char *)Tcl_AttemptAlloc(length+1);
+    if (inputCopy == NULL) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot alloc data buffer", TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "OUT_OF_MEMORY", (char *)NULL);
+	return NULL;
+    }
+    memcpy(inputCopy, input, length);
+    inputCopy[length] = '\0';
     nsvgImage = nsvgParse(inputCopy, "px", (float) dpi);
     if (nsvgImage == NULL) {
+	Tcl_Free(inputCopy);
 	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot parse SVG image", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "PARSE_ERROR", (char *)NULL);
-	goto error;
+	return NULL;
     }
-    Tcl_Free(inputCopy);
-    return nsvgImage;
 
-error:
-    if (inputCopy != NULL) {
-	Tcl_Free(inputCopy);
+    /*
+     * Keep the source data to tell hash collisions apart. The parser has
+     * written over inputCopy, so copy it again.
+     */
+
+    memcpy(inputCopy, input, length);
+    documentPtr = (SVGDocument *)Tcl_Alloc(sizeof(SVGDocument));
+    documentPtr->data = inputCopy;
+    documentPtr->length = length;
+    documentPtr->dpi = dpi;
+    documentPtr->nsvgImage = nsvgImage;
+    documentPtr->rasters = NULL;
+    documentPtr->size = sizeof(SVGDocument) + 2 * (size_t) length;
+    documentPtr->hPtr = Tcl_CreateHashEntry(&cachePtr->documents,
+	    (char *) key, &isNew);
+    Tcl_SetHashValue(documentPtr->hPtr, documentPtr);
+    documentPtr->prevPtr = NULL;
+    documentPtr->nextPtr = cachePtr->firstPtr;
+    if (cachePtr->firstPtr != NULL) {
+	cachePtr->firstPtr->prevPtr = documentPtr;
+    } else {
+	cachePtr->lastPtr = documentPtr;
     }
-    return NULL;
+    cachePtr->firstPtr = documentPtr;
+    cachePtr->size += documentPtr->size;
+    TrimCache(cachePtr, documentPtr);
+    return documentPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RasterizeBand --
+ *
+ *	Rasterizes one band of rows of an SVG image. Called by TkRunParallel,
+ *	possibly in another thread; the parsed document is only read.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The rows of the band are filled with premultiplied pixels, or the
+ *	band is marked as failed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RasterizeBand(
+    void *clientData,		/* The SVGBandJob. */
+    int band)			/* Which band to rasterize. */
+{
+    SVGBandJob *jobPtr = (SVGBandJob *)clientData;
+    NSVGrasterizer *rast = nsvgCreateRasterizer();
+    int y0 = (int) ((Tcl_WideInt) band * jobPtr->height / jobPtr->numBands);
+    int y1 = (int) ((Tcl_WideInt) (band + 1) * jobPtr->height
+	    / jobPtr->numBands);
+
+    if (rast == NULL) {
+	jobPtr->failed[band] = true;
+	return;
+    }
+    nsvgRasterizeRows(rast, jobPtr->nsvgImage, 0, 0, jobPtr->scale,
+	    jobPtr->pixels, jobPtr->width, jobPtr->height, jobPtr->width * 4,
+	    y0, y1);
+    nsvgDeleteRasterizer(rast);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RasterizeDocument --
+ *
+ *	Rasterizes a parsed SVG document into a buffer of w*h RGBA pixels.
+ *	With numBands 0 this is done in one piece, otherwise the rows are
+ *	split into that many bands which are rasterized concurrently. The
+ *	result is the same either way.
+ *
+ * Results:
+ *	TCL_OK, or TCL_ERROR if a rasterizer could not be created.
+ *
+ * Side effects:
+ *	May run worker threads for a while.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RasterizeDocument(
+    NSVGimage *nsvgImage,	/* Document to rasterize. */
+    double scale,		/* Scale to rasterize it at. */
+    unsigned char *pixels,	/* Where to put the pixels. */
+    int w, int h,		/* Size of the image. */
+    int numBands)		/* Number of bands, at most SVG_MAX_BANDS, or
+				 * 0 to rasterize in one piece. */
+{
+    SVGBandJob job;
+    NSVGrasterizer *rast;
+    int band;
+
+    if (numBands <= 0) {
+	rast = nsvgCreateRasterizer();
+	if (rast == NULL) {
+	    return TCL_ERROR;
+	}
+	nsvgRasterize(rast, nsvgImage, 0, 0, (float) scale, pixels, w, h,
+		w * 4);
+	nsvgDeleteRasterizer(rast);
+	return TCL_OK;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.nsvgImage = nsvgImage;
+    job.scale = (float) scale;
+    job.pixels = pixels;
+    job.width = w;
+    job.height = h;
+    job.numBands = (numBands > SVG_MAX_BANDS) ? SVG_MAX_BANDS : numBands;
+    TkRunParallel(job.numBands, RasterizeBand, &job);
+    for (band = 0; band < job.numBands; band++) {
+	if (job.failed[band]) {
+	    return TCL_ERROR;
+	}
+    }
+
+    /*
+     * Undoing the premultiplied alpha looks at neighbouring rows, so it is
+     * done once all the bands are there.
+     */
+
+    nsvgUnpremultiplyAlpha(pixels, w, h, w * 4);
+    return TCL_OK;
 }
 
 /*
@@ -548,8 +832,9 @@ error:
  *
  * RasterizeSVG --
  *
- *	This function is called to rasterize the given nsvgImage and
- *	fill the imageHandle with data.
+ *	This function is called to rasterize the given document and fill
+ *	the imageHandle with data. A bitmap of the same size rasterized
+ *	before is reused.
  *
  * Results:
  *	A standard TCL completion code. If TCL_ERROR is returned then an error
@@ -557,7 +842,7 @@ error:
  *
  *
  * Side effects:
- *	On error the given nsvgImage will be deleted.
+ *	The bitmap may be added to the cache.
  *
  *----------------------------------------------------------------------
  */
@@ -566,28 +851,38 @@ static int
 RasterizeSVG(
     Tcl_Interp *interp,
     Tk_PhotoHandle imageHandle,
-    NSVGimage *nsvgImage,
+    SVGDocument *documentPtr,
     int destX, int destY,
     int width, int height,
     TCL_UNUSED(int),
     TCL_UNUSED(int),
     RastOpts *ropts)
 {
-    int w, h, c;
-    NSVGrasterizer *rast;
+    int w, h, c, numBands;
     unsigned char *imgData;
     Tk_PhotoImageBlock svgblock;
     double scale;
     Tcl_WideUInt wh;
+    SVGRaster *rasterPtr, **rasterPtrPtr;
+    NSVGcache *cachePtr = GetCachePtr(interp);
 
-    scale = GetScaleFromParameters(nsvgImage, ropts, &w, &h);
+    scale = GetScaleFromParameters(documentPtr->nsvgImage, ropts, &w, &h);
 
-    rast = nsvgCreateRasterizer();
-    if (rast == NULL) {
-	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot initialize rasterizer", TCL_INDEX_NONE));
-	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "RASTERIZER_ERROR",
-		(char *)NULL);
-	goto cleanAST;
+    /*
+     * Look for a bitmap of this size, and make it the most recently used.
+     */
+
+    for (rasterPtrPtr = &documentPtr->rasters; *rasterPtrPtr != NULL;
+	    rasterPtrPtr = &(*rasterPtrPtr)->nextPtr) {
+	rasterPtr = *rasterPtrPtr;
+	if ((rasterPtr->width == w) && (rasterPtr->height == h)
+		&& (rasterPtr->scale == scale)) {
+	    *rasterPtrPtr = rasterPtr->nextPtr;
+	    rasterPtr->nextPtr = documentPtr->rasters;
+	    documentPtr->rasters = rasterPtr;
+	    imgData = rasterPtr->pixels;
+	    goto putBlock;
+	}
     }
 
     /* Tk Ticket [822330269b] Check potential int overflow in following Tcl_Alloc */
@@ -595,17 +890,75 @@ RasterizeSVG(
     if ( w < 0 || h < 0 || wh > INT_MAX / 4) {
 	Tcl_SetObjResult(interp, Tcl_NewStringObj("image size overflow", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "IMAGE_SIZE_OVERFLOW", (char *)NULL);
-	goto cleanRAST;
+	return TCL_ERROR;
     }
 
     imgData = (unsigned char *)Tcl_AttemptAlloc(wh * 4);
     if (imgData == NULL) {
 	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot alloc image buffer", TCL_INDEX_NONE));
 	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "OUT_OF_MEMORY", (char *)NULL);
-	goto cleanRAST;
+	return TCL_ERROR;
+    }
+
+    numBands = 0;
+    if (wh >= SVG_PARALLEL_MIN && TkGetProcessorCount() > 1) {
+	numBands = TkGetProcessorCount();
+	if (numBands > h / SVG_BAND_MIN_ROWS) {
+	    numBands = h / SVG_BAND_MIN_ROWS;
+	}
+	if (numBands > SVG_MAX_BANDS) {
+	    numBands = SVG_MAX_BANDS;
+	}
+	if (numBands < 2) {
+	    numBands = 0;
+	}
     }
-    nsvgRasterize(rast, nsvgImage, 0, 0,
-	    (float) scale, imgData, w, h, w * 4);
+    if (RasterizeDocument(documentPtr->nsvgImage, scale, imgData, w, h,
+	    numBands) != TCL_OK) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot initialize rasterizer", TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "IMAGE", "SVG", "RASTERIZER_ERROR",
+		(char *)NULL);
+	Tcl_Free(imgData);
+	return TCL_ERROR;
+    }
+
+    /*
+     * Keep the bitmap unless it is too big, dropping the least recently
+     * used bitmap of the document if it has too many.
+     */
+
+    if (wh * 4 <= SVG_CACHE_MAX_BYTES / 4) {
+	rasterPtr = (SVGRaster *)Tcl_Alloc(sizeof(SVGRaster));
+	rasterPtr->width = w;
+	rasterPtr->height = h;
+	rasterPtr->scale = scale;
+	rasterPtr->pixels = imgData;
+	rasterPtr->nextPtr = documentPtr->rasters;
+	documentPtr->rasters = rasterPtr;
+	documentPtr->size += sizeof(SVGRaster) + wh * 4;
+	cachePtr->size += sizeof(SVGRaster) + wh * 4;
+	for (c = 1; rasterPtr->nextPtr != NULL; c++) {
+	    if (c == SVG_MAX_RASTERS) {
+		SVGRaster *oldPtr = rasterPtr->nextPtr;
+		size_t oldSize = sizeof(SVGRaster)
+			+ (size_t) oldPtr->width * oldPtr->height * 4;
+
+		rasterPtr->nextPtr = oldPtr->nextPtr;
+		documentPtr->size -= oldSize;
+		cachePtr->size -= oldSize;
+		Tcl_Free(oldPtr->pixels);
+		Tcl_Free(oldPtr);
+		break;
+	    }
+	    rasterPtr = rasterPtr->nextPtr;
+	}
+	TrimCache(cachePtr, documentPtr);
+	rasterPtr = documentPtr->rasters;
+    } else {
+	rasterPtr = NULL;
+    }
+
+  putBlock:
     /* transfer the data to a photo block */
     svgblock.pixelPtr = imgData;
     svgblock.width = w;
@@ -615,28 +968,19 @@ RasterizeSVG(
     for (c = 0; c <= 3; c++) {
 	svgblock.offset[c] = c;
     }
-    if (Tk_PhotoExpand(interp, imageHandle,
-		destX + width, destY + height) != TCL_OK) {
-	goto cleanRAST;
+    if ((Tk_PhotoExpand(interp, imageHandle,
+		destX + width, destY + height) != TCL_OK)
+	    || (Tk_PhotoPutBlock(interp, imageHandle, &svgblock, destX, destY,
+		width, height, TK_PHOTO_COMPOSITE_SET) != TCL_OK)) {
+	if (rasterPtr == NULL) {
+	    Tcl_Free(imgData);
+	}
+	return TCL_ERROR;
     }
-    if (Tk_PhotoPutBlock(interp, imageHandle, &svgblock, destX, destY,
-		width, height, TK_PHOTO_COMPOSITE_SET) != TCL_OK) {
-	goto cleanimg;
+    if (rasterPtr == NULL) {
+	Tcl_Free(imgData);
     }
-    Tcl_Free(imgData);
-    nsvgDeleteRasterizer(rast);
-    nsvgDelete(nsvgImage);
     return TCL_OK;
-
-cleanimg:
-    Tcl_Free(imgData);
-
-cleanRAST:
-    nsvgDeleteRasterizer(rast);
-
-cleanAST:
-    nsvgDelete(nsvgImage);
-    return TCL_ERROR;
 }
 
 /*
@@ -725,7 +1069,11 @@ GetCachePtr(
 	cachePtr = (NSVGcache *)Tcl_Alloc(sizeof(NSVGcache));
 	cachePtr->dataOrChan = NULL;
 	Tcl_DStringInit(&cachePtr->formatString);
-	cachePtr->nsvgImage = NULL;
+	cachePtr->documentPtr = NULL;
+	Tcl_InitHashTable(&cachePtr->documents, 2);
+	cachePtr->firstPtr = NULL;
+	cachePtr->lastPtr = NULL;
+	cachePtr->size = 0;
 	Tcl_SetAssocData(interp, "tksvgnano", FreeCache, cachePtr);
     }
     return cachePtr;
@@ -751,7 +1099,7 @@ CacheSVG(
     Tcl_Interp *interp,
     void *dataOrChan,
     Tcl_Obj *formatObj,
-    NSVGimage *nsvgImage,
+    SVGDocument *documentPtr,
     RastOpts *ropts)
 {
     Tcl_Size length;
@@ -764,7 +1112,7 @@ CacheSVG(
 	    data = Tcl_GetStringFromObj(formatObj, &length);
 	    Tcl_DStringAppend(&cachePtr->formatString, data, length);
 	}
-	cachePtr->nsvgImage = nsvgImage;
+	cachePtr->documentPtr = documentPtr;
 	cachePtr->ropts = *ropts;
 	return true;
     }
@@ -776,10 +1124,10 @@ CacheSVG(
  *
  * GetCachedSVG --
  *
- *	Try to get the NSVGimage from the internal cache.
+ *	Try to get the document matched last from the internal cache.
  *
  * Results:
- *	Return the found NSVGimage on success, and NULL otherwise.
+ *	Return the found document on success, and NULL otherwise.
  *
  * Side effects:
  *	Calls the CleanCache() function.
@@ -787,7 +1135,7 @@ CacheSVG(
  *----------------------------------------------------------------------
  */
 
-static NSVGimage *
+static SVGDocument *
 GetCachedSVG(
     Tcl_Interp *interp,
     void *dataOrChan,
@@ -797,25 +1145,106 @@ GetCachedSVG(
     Tcl_Size length;
     const char *data;
     NSVGcache *cachePtr = GetCachePtr(interp);
-    NSVGimage *nsvgImage = NULL;
+    SVGDocument *documentPtr = NULL;
 
-    if ((cachePtr != NULL) && (cachePtr->nsvgImage != NULL) &&
+    if ((cachePtr != NULL) && (cachePtr->documentPtr != NULL) &&
 	(cachePtr->dataOrChan == dataOrChan)) {
 	if (formatObj != NULL) {
 	    data = Tcl_GetStringFromObj(formatObj, &length);
 	    if (strcmp(data, Tcl_DStringValue(&cachePtr->formatString)) == 0) {
-		nsvgImage = cachePtr->nsvgImage;
+		documentPtr = cachePtr->documentPtr;
 		*ropts = cachePtr->ropts;
-		cachePtr->nsvgImage = NULL;
+		cachePtr->documentPtr = NULL;
 	    }
 	} else if (Tcl_DStringLength(&cachePtr->formatString) == 0) {
-	    nsvgImage = cachePtr->nsvgImage;
+	    documentPtr = cachePtr->documentPtr;
 	    *ropts = cachePtr->ropts;
-	    cachePtr->nsvgImage = NULL;
+	    cachePtr->documentPtr = NULL;
 	}
     }
     CleanCache(interp);
-    return nsvgImage;
+    return documentPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TrimCache --
+ *
+ *	Removes the least recently used documents from the cache until it
+ *	is within its size limit.
+ *
+ * Results:
+ *
+ * Side effects:
+ *	Documents other than keepPtr may be deleted.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TrimCache(
+    NSVGcache *cachePtr,
+    SVGDocument *keepPtr)
+{
+    SVGDocument *documentPtr = cachePtr->lastPtr;
+
+    while ((cachePtr->size > SVG_CACHE_MAX_BYTES) && (documentPtr != NULL)) {
+	SVGDocument *prevPtr = documentPtr->prevPtr;
+
+	if (documentPtr != keepPtr) {
+	    FreeSVGDocument(cachePtr, documentPtr);
+	}
+	documentPtr = prevPtr;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeSVGDocument --
+ *
+ *	Removes a document from the cache and deletes it with its bitmaps.
+ *
+ * Results:
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeSVGDocument(
+    NSVGcache *cachePtr,
+    SVGDocument *documentPtr)
+{
+    SVGRaster *rasterPtr;
+
+    if (cachePtr->documentPtr == documentPtr) {
+	cachePtr->documentPtr = NULL;
+    }
+    if (documentPtr->prevPtr != NULL) {
+	documentPtr->prevPtr->nextPtr = documentPtr->nextPtr;
+    } else {
+	cachePtr->firstPtr = documentPtr->nextPtr;
+    }
+    if (documentPtr->nextPtr != NULL) {
+	documentPtr->nextPtr->prevPtr = documentPtr->prevPtr;
+    } else {
+	cachePtr->lastPtr = documentPtr->prevPtr;
+    }
+    Tcl_DeleteHashEntry(documentPtr->hPtr);
+    cachePtr->size -= documentPtr->size;
+
+    while ((rasterPtr = documentPtr->rasters) != NULL) {
+	documentPtr->rasters = rasterPtr->nextPtr;
+	Tcl_Free(rasterPtr->pixels);
+	Tcl_Free(rasterPtr);
+    }
+    nsvgDelete(documentPtr->nsvgImage);
+    Tcl_Free(documentPtr->data);
+    Tcl_Free(documentPtr);
 }
 
 /*
@@ -823,7 +1252,7 @@ GetCachedSVG(
  *
  * CleanCache --
  *
- *	Reset the cache and delete the saved image in it.
+ *	Forget the document matched last. The document stays in the cache.
  *
  * Results:
  *
@@ -840,10 +1269,7 @@ CleanCache(Tcl_Interp *interp)
     if (cachePtr != NULL) {
 	cachePtr->dataOrChan = NULL;
 	Tcl_DStringSetLength(&cachePtr->formatString, 0);
-	if (cachePtr->nsvgImage != NULL) {
-	    nsvgDelete(cachePtr->nsvgImage);
-	    cachePtr->nsvgImage = NULL;
-	}
+	cachePtr->documentPtr = NULL;
     }
 }
 
@@ -868,9 +1294,70 @@ FreeCache(void *clientData, TCL_UNUSED(Tcl_Interp *))
     NSVGcache *cachePtr = (NSVGcache *)clientData;
 
     Tcl_DStringFree(&cachePtr->formatString);
-    if (cachePtr->nsvgImage != NULL) {
-	nsvgDelete(cachePtr->nsvgImage);
+    while (cachePtr->firstPtr != NULL) {
+	FreeSVGDocument(cachePtr, cachePtr->firstPtr);
     }
+    Tcl_DeleteHashTable(&cachePtr->documents);
     Tcl_Free(cachePtr);
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkDebugSVGRasterize --
+ *
+ *	Rasterizes SVG data at the given scale, in the given number of bands
+ *	or in one piece if bands is 0, without going through a photo image or
+ *	the bitmap cache. For checking that banded rasterization gives the
+ *	same pixels.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a byte array with the RGBA
+ *	pixels.
+ *
+ * Side effects:
+ *	The document is added to the interpreter's cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkDebugSVGRasterize(
+    Tcl_Interp *interp,		/* Interpreter to use for reporting errors. */
+    Tcl_Obj *dataObj,		/* The SVG data. */
+    double scale,		/* Scale to rasterize at. */
+    int bands)			/* Number of bands, or 0. */
+{
+    SVGDocument *documentPtr;
+    RastOpts ropts;
+    const char *data;
+    Tcl_Size length;
+    Tcl_Obj *resultObj;
+    unsigned char *pixels;
+    int w, h;
+
+    data = Tcl_GetStringFromObj(dataObj, &length);
+    documentPtr = GetSVGDocument(interp, data, length, 96.0);
+    if (documentPtr == NULL) {
+	return TCL_ERROR;
+    }
+    ropts.scale = scale;
+    ropts.scaleToHeight = 0;
+    ropts.scaleToWidth = 0;
+    GetScaleFromParameters(documentPtr->nsvgImage, &ropts, &w, &h);
+    if (w <= 0 || h <= 0 || (Tcl_WideUInt) w * h > INT_MAX / 4) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("bad image size", TCL_INDEX_NONE));
+	return TCL_ERROR;
+    }
+    resultObj = Tcl_NewByteArrayObj(NULL, 0);
+    pixels = Tcl_SetByteArrayLength(resultObj, (Tcl_Size) w * h * 4);
+    if (RasterizeDocument(documentPtr->nsvgImage, scale, pixels, w, h,
+	    bands) != TCL_OK) {
+	Tcl_DecrRefCount(resultObj);
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot initialize rasterizer", TCL_INDEX_NONE));
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, resultObj);
+    return TCL_OK;
+}
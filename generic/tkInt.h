@@ -202,6 +202,18 @@ typedef struct TkCaret {
     int height;			/* Specified height of the window. */
 } TkCaret;
 
+/*
+ * Statistics kept for the per-display resource caches and reported by
+ * "tk perf caches":
+ */
+
+typedef struct {
+    Tcl_WideInt hits;		/* Requests satisfied from the cache. */
+    Tcl_WideInt misses;		/* Requests that had to allocate. */
+    Tcl_WideInt trims;		/* Entries dropped by the retention policy. */
+    Tcl_WideInt size;		/* Entries currently kept for reuse. */
+} TkCacheStats;
+
 /*
  * One of the following structures is maintained for each display containing a
  * window managed by Tk. In part, the structure is used to store thread-
@@ -298,6 +310,14 @@ typedef struct TkDisplay {
     Tcl_HashTable colorValueTable;
 				/* Maps from integer RGB values to TkColor
 				 * structures. */
+    struct TkColor *colorNewestPtr;
+				/* Most recently released of the unused
+				 * colors kept for reuse. */
+    struct TkColor *colorOldestPtr;
+				/* Least recently released of them. */
+    Tcl_TimerToken colorTimer;	/* Timer that frees unused colors kept for
+				 * too long, or NULL. */
+    TkCacheStats colorStats;	/* Statistics for Tk_GetColor and friends. */
 
     /*
      * Used by tkCursor.c only:
@@ -371,6 +391,12 @@ typedef struct TkDisplay {
     Tcl_HashTable gcIdTable;    /* Maps from a GC to a TkGC. */
     int gcInit;			/* 0 means the tables below need
 				 * initializing. */
+    struct TkGC *gcNewestPtr;	/* Most recently released of the unused GCs
+				 * kept for reuse. */
+    struct TkGC *gcOldestPtr;	/* Least recently released of them. */
+    Tcl_TimerToken gcTimer;	/* Timer that frees unused GCs kept for too
+				 * long, or NULL. */
+    TkCacheStats gcStats;	/* Statistics for Tk_GetGC. */
 
     /*
      * Information used by tkGeometry.c only:
@@ -381,6 +407,16 @@ typedef struct TkDisplay {
 				 * Tk_Window token to a list of windows managed
 				 * by that container. */
     int geomInit;
+    struct TkArrangeQueue *arrangeQueuePtr;
+				/* Containers waiting to be laid out by their
+				 * geometry manager, or NULL. */
+    Tcl_Size arrangeCount;	/* Number of containers laid out through
+				 * TkScheduleArrange so far. */
+    Tcl_Size arrangeSettleCount;/* Number of times all the waiting containers
+				 * have been laid out. */
+    Tcl_Size lastSettleArranges;/* Number of containers laid out the last
+				 * time, counting each time it was laid
+				 * out. */
 
     /*
      * Information used by tkGrid.c, tkPack.c, tkPlace.c, tkPointer.c,
@@ -568,6 +604,13 @@ typedef struct TkDisplay {
     int iconDataSize;		/* Size of default iconphoto image data. */
     unsigned char *iconDataPtr;	/* Default iconphoto image data, if set. */
     int ximGeneration;          /* Used to invalidate XIC */
+    struct TkSharedBuffer *sharedBufferList;
+				/* Double-buffering pixmaps of toplevels with
+				 * -sharedbuffer set. Managed by tkFrame.c. */
+    struct TkPixmapPool *pixmapPoolPtr;
+				/* Double-buffering pixmaps kept for reuse.
+				 * Managed by tkUtil.c. */
+    TkCacheStats pixmapStats;	/* Statistics for pixmapPoolPtr. */
 } TkDisplay;
 
 /*
@@ -578,11 +621,22 @@ typedef struct TkDisplay {
  *	Whether to use input methods for this display
  *  TK_DISPLAY_WM_TRACING:		(default off)
  *	Whether we should do wm tracing on this display.
+ *  TK_DISPLAY_SHM_CHECKED:		(default off)
+ *	Set once the display has been probed for MIT-SHM support.
+ *  TK_DISPLAY_SHM_USABLE:		(default off)
+ *	Whether photo images may be uploaded through shared memory.
+ *  TK_DISPLAY_BATCH_REQUESTS:		(default on, unix only)
+ *	Whether the event loop defers flushing the X output buffer until it
+ *	is about to wait for input. Cleared if TK_NO_BATCH_REQUESTS is set in
+ *	the environment.
  */
 
 #define TK_DISPLAY_COLLAPSE_MOTION_EVENTS	(1 << 0)
 #define TK_DISPLAY_USE_IM			(1 << 1)
 #define TK_DISPLAY_WM_TRACING			(1 << 3)
+#define TK_DISPLAY_SHM_CHECKED			(1 << 4)
+#define TK_DISPLAY_SHM_USABLE			(1 << 5)
+#define TK_DISPLAY_BATCH_REQUESTS		(1 << 6)
 
 /*
  * One of the following structures exists for each error handler created by a
@@ -1110,6 +1164,13 @@ void Tcl_Panic(const char *, ...) __attribute__((analyzer_noreturn));
 
 #define GENERATED_FOCUS_EVENT_MAGIC	((Bool) 0x547321ac)
 
+/*
+ * Type of the function TkGifReadFrames calls for each frame of a GIF image.
+ */
+
+typedef int (TkGifFrameProc)(void *clientData, int frameNum, int left,
+	int top, Tk_PhotoImageBlock *blockPtr, Tcl_Obj *metadataObj);
+
 /*
  * Exported internals.
  */
@@ -1183,6 +1244,18 @@ MODULE_SCOPE int	TkSetGeometryContainer(Tcl_Interp *interp,
 			    Tk_Window tkwin, const char *name);
 MODULE_SCOPE void	TkFreeGeometryContainer(Tk_Window tkwin,
 			    const char *name);
+MODULE_SCOPE void	TkScheduleArrange(Tk_Window container,
+			    Tcl_IdleProc *proc, void *clientData);
+MODULE_SCOPE void	TkCancelArrange(Tk_Window container,
+			    Tcl_IdleProc *proc, void *clientData);
+MODULE_SCOPE void	TkArrangeCleanup(TkDisplay *dispPtr);
+MODULE_SCOPE Pixmap	TkGetPooledPixmap(Tk_Window tkwin, int width,
+			    int height);
+MODULE_SCOPE void	TkFreePooledPixmap(TkDisplay *dispPtr,
+			    Pixmap pixmap);
+MODULE_SCOPE void	TkPixmapPoolCleanup(TkDisplay *dispPtr);
+MODULE_SCOPE void	TkColorCleanup(TkDisplay *dispPtr);
+MODULE_SCOPE Tcl_WideInt TkCacheMilliseconds(void);
 
 MODULE_SCOPE void	TkRegisterObjTypes(void);
 MODULE_SCOPE Tcl_ObjCmdProc2 TkDeadAppObjCmd;
@@ -1196,6 +1269,23 @@ MODULE_SCOPE int	TkPostscriptImage(Tcl_Interp *interp, Tk_Window tkwin,
 			    int x, int y, int width, int height);
 MODULE_SCOPE void	TkPremultiplyRGBA(XImage *image, int src_x, int src_y,
 			    int w, int h, unsigned char *dst, int dstStride);
+typedef void (TkPhotoCancelProc)(void *clientData);
+MODULE_SCOPE void	TkPhotoSetPendingLoad(Tk_PhotoHandle handle,
+			    TkPhotoCancelProc *cancelProc, void *clientData);
+MODULE_SCOPE void	TkPhotoPendingLoadDone(Tk_PhotoHandle handle,
+			    void *clientData);
+typedef int (TkPhotoMappedReadProc)(Tcl_Interp *interp,
+	const unsigned char *data, Tcl_Size length, const char *fileName,
+	Tcl_Obj *format, Tcl_Obj *metadataIn, Tk_PhotoHandle imageHandle,
+	int destX, int destY, int width, int height, int srcX, int srcY,
+	Tcl_Obj *metadataOut);
+MODULE_SCOPE void	TkPhotoSetMappedReadProc(const char *formatName,
+			    TkPhotoMappedReadProc *proc);
+MODULE_SCOPE TkPhotoMappedReadProc TkReadMappedGIF;
+MODULE_SCOPE TkPhotoMappedReadProc TkReadMappedPNG;
+MODULE_SCOPE TkPhotoMappedReadProc TkReadMappedPPM;
+MODULE_SCOPE int	TkPhotoLoadObjCmd(void *clientData, Tcl_Interp *interp,
+			    Tcl_Size objc, Tcl_Obj *const objv[]);
 MODULE_SCOPE void       TkMapTopFrame(Tk_Window tkwin);
 MODULE_SCOPE XEvent *	TkpGetBindingXEvent(Tcl_Interp *interp);
 MODULE_SCOPE void	TkCreateExitHandler(Tcl_ExitProc *proc,
@@ -1247,7 +1337,40 @@ MODULE_SCOPE int	TkGetScaledPixelValue(Tcl_Interp *interp, Tk_Window tkwin,
 			    Tcl_Obj *valuePtr, int *size);
 MODULE_SCOPE int	TkFormatDouble(char *buffer, size_t size,
 			    const char *format, double value);
+typedef void (TkParallelProc)(void *clientData, int index);
+MODULE_SCOPE int	TkGetProcessorCount(void);
+MODULE_SCOPE void	TkRunParallel(int count, TkParallelProc *proc,
+			    void *clientData);
+MODULE_SCOPE const unsigned char *TkMapFile(Tcl_Channel chan,
+			    Tcl_WideInt minSize, Tcl_Size *lengthPtr);
+MODULE_SCOPE void	TkUnmapFile(const unsigned char *data,
+			    Tcl_Size length);
 MODULE_SCOPE bool	TkObjIsEmpty(Tcl_Obj *objPtr);
+MODULE_SCOPE Pixmap	TkGetBufferPixmap(Tk_Window tkwin, int width,
+			    int height);
+MODULE_SCOPE void	TkFreeBufferPixmap(Display *display, Pixmap pixmap);
+
+/*
+ * Counters reported by "tk perf". Instrumented code brackets its work with
+ * TkPerfStart and TkPerfStop, which only read the clock while the counters
+ * are enabled.
+ */
+
+typedef enum {
+    TK_PERF_EVENT, TK_PERF_DISPLAY, TK_PERF_GRID, TK_PERF_PACK,
+    TK_PERF_MEASURE, TK_PERF_DITHER, TK_PERF_SYNC, TK_PERF_ROUNDTRIP,
+    TK_PERF_COUNT
+} TkPerfCounter;
+
+MODULE_SCOPE int	tkPerfEnabled;
+MODULE_SCOPE Tcl_WideInt TkPerfClock(void);
+MODULE_SCOPE void	TkPerfRecord(TkPerfCounter counter,
+			    Tcl_WideInt start);
+
+#define TkPerfStart() \
+    (tkPerfEnabled ? TkPerfClock() : 0)
+#define TkPerfStop(counter, start) \
+    do { if ((start) != 0) { TkPerfRecord((counter), (start)); } } while (0)
 MODULE_SCOPE int	TkInitTkCmd(Tcl_Interp *interp,
 			    void *clientData);
 MODULE_SCOPE int	TkInitFontchooser(Tcl_Interp *interp,
@@ -542,6 +542,24 @@ EXTERN void		TkDrawAngledChars(Display *display,
 EXTERN bool		TkDebugPhotoStringMatchDef(Tcl_Interp *inter,
 				Tcl_Obj *data, Tcl_Obj *formatString,
 				int *widthPtr, int *heightPtr);
+/* 188 */
+EXTERN int		TkDebugPhotoKernel(Tcl_Interp *interp,
+				const char *kernel, const char *operation,
+				Tcl_Size count, int iterations, int redShift,
+				int greenShift, int blueShift);
+/* 189 */
+EXTERN int		TkGifReadFrames(Tcl_Interp *interp,
+				Tcl_Obj *dataObj, TkGifFrameProc *proc,
+				void *clientData);
+/* 190 */
+EXTERN int		TkDebugSVGRasterize(Tcl_Interp *interp,
+				Tcl_Obj *dataObj, double scale, int bands);
+/* 191 */
+EXTERN int		TkSetOptionsForRecords(Tcl_Interp *interp,
+				Tcl_Size numRecords, void *const recordPtrs[],
+				Tk_Window const tkwins[],
+				Tk_OptionTable optionTable, Tcl_Size objc,
+				Tcl_Obj *const objv[], int *maskPtr);
 
 typedef struct TkIntStubs {
     int magic;
@@ -735,6 +753,10 @@ typedef struct TkIntStubs {
     void (*reserved185)(void);
     void (*reserved186)(void);
     bool (*tkDebugPhotoStringMatchDef) (Tcl_Interp *inter, Tcl_Obj *data, Tcl_Obj *formatString, int *widthPtr, int *heightPtr); /* 187 */
+    int (*tkDebugPhotoKernel) (Tcl_Interp *interp, const char *kernel, const char *operation, Tcl_Size count, int iterations, int redShift, int greenShift, int blueShift); /* 188 */
+    int (*tkGifReadFrames) (Tcl_Interp *interp, Tcl_Obj *dataObj, TkGifFrameProc *proc, void *clientData); /* 189 */
+    int (*tkDebugSVGRasterize) (Tcl_Interp *interp, Tcl_Obj *dataObj, double scale, int bands); /* 190 */
+    int (*tkSetOptionsForRecords) (Tcl_Interp *interp, Tcl_Size numRecords, void *const recordPtrs[], Tk_Window const tkwins[], Tk_OptionTable optionTable, Tcl_Size objc, Tcl_Obj *const objv[], int *maskPtr); /* 191 */
 } TkIntStubs;
 
 extern const TkIntStubs *tkIntStubsPtr;
@@ -1098,6 +1120,14 @@ extern const TkIntStubs *tkIntStubsPtr;
 /* Slot 186 is reserved */
 #define TkDebugPhotoStringMatchDef \
 	(tkIntStubsPtr->tkDebugPhotoStringMatchDef) /* 187 */
+#define TkDebugPhotoKernel \
+	(tkIntStubsPtr->tkDebugPhotoKernel) /* 188 */
+#define TkGifReadFrames \
+	(tkIntStubsPtr->tkGifReadFrames) /* 189 */
+#define TkDebugSVGRasterize \
+	(tkIntStubsPtr->tkDebugSVGRasterize) /* 190 */
+#define TkSetOptionsForRecords \
+	(tkIntStubsPtr->tkSetOptionsForRecords) /* 191 */
 
 #endif /* defined(USE_TK_STUBS) */
 
@@ -15,6 +15,18 @@
 #include "tkInt.h"
 #include "default.h"
 
+/*
+ * The selection of a listbox is kept as a sorted array of disjoint,
+ * non-adjacent ranges of selected element indices, so that selecting or
+ * deleting large blocks of elements costs time proportional to the number
+ * of ranges rather than the number of elements.
+ */
+
+typedef struct {
+    Tcl_Size first;		/* Index of first selected element. */
+    Tcl_Size last;		/* Index of last selected element. */
+} SelRange;
+
 typedef struct {
     Tk_OptionTable listboxOptionTable;
 				/* Table defining configuration options
@@ -47,7 +59,10 @@ typedef struct {
     Tcl_Obj *listVarNameObj;	/* List variable name */
     Tcl_Obj *listObj;		/* Pointer to the list object being used */
     Tcl_Size nElements;		/* Holds the current count of elements */
-    Tcl_HashTable *selection;	/* Tracks selection */
+    SelRange *selRanges;	/* Tracks selection, see SelRange. */
+    Tcl_Size numSelRanges;	/* Number of ranges in selRanges. */
+    Tcl_Size selRangesSpace;	/* Number of ranges allocated in
+				 * selRanges. */
     Tcl_HashTable *itemAttrTable;
 				/* Tracks item attributes */
 
@@ -109,6 +124,17 @@ typedef struct {
 
     int maxWidth;		/* Width (in pixels) of widest string in
 				 * listbox. */
+    int *elemWidths;		/* Cached pixel width of each element, or -1
+				 * for elements not yet measured. NULL means
+				 * no widths are cached, and MAXWIDTH_IS_STALE
+				 * must then be set. */
+    Tcl_Size elemWidthsSpace;	/* Number of slots allocated in
+				 * elemWidths. */
+    Tcl_Size numAtMaxWidth;	/* Number of elements whose cached width is
+				 * equal to maxWidth. */
+    Tcl_Size measureIndex;	/* All elements before this index have their
+				 * width cached; used to measure large lists
+				 * in idle slices. */
     int xScrollUnit;		/* Number of pixels in one "unit" for
 				 * horizontal scrolling (window scrolls
 				 * horizontally in increments of this size).
@@ -169,11 +195,25 @@ typedef struct {
     int flags;			/* Various flag bits: see below for
 				 * definitions. */
     Tk_Justify justify;         /* Justification. */
+
+    /*
+     * Information used to redraw only part of the window:
+     */
+
+    Tcl_Size redrawFirst;	/* First and last elements to redraw when */
+    Tcl_Size redrawLast;	/* REDRAW_PENDING is set. A range that ends
+				 * at the last element extends to the bottom
+				 * of the window, to clear deleted lines. */
+    int drawnTopIndex;		/* Values of topIndex, xOffset and maxWidth */
+    int drawnXOffset;		/* and size of the window at the last full */
+    int drawnMaxWidth;		/* redisplay; if any has changed since, */
+    int drawnWidth;		/* everything is redrawn whatever the range. */
+    int drawnHeight;
 } Listbox;
 
 /*
- * How to encode the keys for the hash tables used to store what items are
- * selected and what the attributes are.
+ * How to encode the keys for the hash table used to store the item
+ * attributes.
  */
 
 #define KEY(i)		((char *) INT2PTR(i))
@@ -203,6 +243,12 @@ typedef struct {
  *				input focus.
  * MAXWIDTH_IS_STALE:		Stored maxWidth may be out-of-date.
  * LISTBOX_DELETED:		This listbox has been effectively destroyed.
+ * KEEP_WIDTHS:			Set by ConfigureListbox around its call to
+ *				ListboxWorldChanged when neither the font nor
+ *				the list changed, so cached element widths
+ *				are still good.
+ * MEASURE_PENDING:		Non-zero means a DoWhenIdle handler has been
+ *				queued to measure more element widths.
  */
 
 #define REDRAW_PENDING		1
@@ -211,6 +257,18 @@ typedef struct {
 #define GOT_FOCUS		8
 #define MAXWIDTH_IS_STALE	16
 #define LISTBOX_DELETED		32
+#define KEEP_WIDTHS		64
+#define MEASURE_PENDING		128
+
+/*
+ * Lists with at most LISTBOX_MEASURE_SYNC elements have their element widths
+ * measured all at once. Longer lists are measured LISTBOX_MEASURE_SLICE
+ * elements at a time from idle handlers, so that replacing the contents of a
+ * huge list does not freeze the application.
+ */
+
+#define LISTBOX_MEASURE_SYNC	5000
+#define LISTBOX_MEASURE_SLICE	2000
 
 /*
  * The following enum is used to define a type for the -state option of the
@@ -416,6 +474,7 @@ static void		ListboxEventProc(void *clientData,
 static Tcl_Size	ListboxFetchSelection(void *clientData,
 			    Tcl_Size offset, char *buffer, Tcl_Size maxBytes);
 static void		ListboxLostSelection(void *clientData);
+static void		ListboxMeasureProc(void *clientData);
 static void		GenerateListboxSelectEvent(Listbox *listPtr);
 static void		EventuallyRedrawRange(Listbox *listPtr,
 			    Tcl_Size first, Tcl_Size last);
@@ -437,12 +496,30 @@ static ItemAttr *	ListboxGetItemAttributes(Tcl_Interp *interp,
 			    Listbox *listPtr, int index);
 static void		ListboxWorldChanged(void *instanceData);
 static int		NearestListboxElement(Listbox *listPtr, int y);
+static Tcl_Size		ApplyListDelta(Listbox *listPtr,
+			    Tcl_Obj *oldListObj, int *maxIsStalePtr);
 static char *		ListboxListVarProc(void *clientData,
 			    Tcl_Interp *interp, const char *name1,
 			    const char *name2, int flags);
 static void		MigrateHashEntries(Tcl_HashTable *table,
 			    Tcl_Size first, Tcl_Size last, Tcl_Size offset);
+static Tcl_Size		SelectionAdd(Listbox *listPtr, Tcl_Size first,
+			    Tcl_Size last);
+static Tcl_Size		SelectionCount(Listbox *listPtr, Tcl_Size first,
+			    Tcl_Size last);
+static int		SelectionIncludes(Listbox *listPtr, Tcl_Size index);
+static Tcl_Size		SelectionRemove(Listbox *listPtr, Tcl_Size first,
+			    Tcl_Size last);
+static void		SelectionShift(Listbox *listPtr, Tcl_Size index,
+			    Tcl_Size offset);
 static int		GetMaxOffset(Listbox *listPtr);
+static int		DeleteElemWidths(Listbox *listPtr, Tcl_Size first,
+			    Tcl_Size last);
+static void		FreeElemWidths(Listbox *listPtr);
+static void		InsertElemWidths(Listbox *listPtr, Tcl_Size index,
+			    Tcl_Size count, Tcl_Obj *const objv[]);
+static void		MeasureElemWidths(Listbox *listPtr, Tcl_Size first,
+			    Tcl_Size last);
 
 /*
  * The structure below defines button class behavior by means of procedures
@@ -539,8 +616,6 @@ Tk_ListboxObjCmd(
 	    ListboxCmdDeletedProc);
     listPtr->optionTable	   = optionTables->listboxOptionTable;
     listPtr->itemAttrOptionTable   = optionTables->itemAttrOptionTable;
-    listPtr->selection		   = (Tcl_HashTable *)Tcl_Alloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(listPtr->selection, TCL_ONE_WORD_KEYS);
     listPtr->itemAttrTable	   = (Tcl_HashTable *)Tcl_Alloc(sizeof(Tcl_HashTable));
     Tcl_InitHashTable(listPtr->itemAttrTable, TCL_ONE_WORD_KEYS);
     listPtr->relief		   = TK_RELIEF_RAISED;
@@ -556,6 +631,7 @@ Tk_ListboxObjCmd(
     listPtr->state		   = STATE_NORMAL;
     listPtr->gray		   = None;
     listPtr->justify               = TK_JUSTIFY_LEFT;
+    listPtr->drawnWidth		   = -1;
 
     /*
      * Keep a hold of the associated tkwin until we destroy the listbox,
@@ -661,6 +737,7 @@ ListboxWidgetObjCmd(
 	if (index < 0) {
 	    index = 0;
 	}
+	EventuallyRedrawRange(listPtr, listPtr->active, listPtr->active);
 	listPtr->active = index;
 	EventuallyRedrawRange(listPtr, listPtr->active, listPtr->active);
 	result = TCL_OK;
@@ -714,7 +791,7 @@ ListboxWidgetObjCmd(
 	break;
 
     case COMMAND_CURSELECTION: {
-	int i;
+	Tcl_Size i, r;
 
 	if (objc != 2) {
 	    Tcl_WrongNumArgs(interp, 2, objv, NULL);
@@ -723,16 +800,14 @@ ListboxWidgetObjCmd(
 	}
 
 	/*
-	 * Of course, it would be more efficient to use the Tcl_HashTable
-	 * search functions (Tcl_FirstHashEntry, Tcl_NextHashEntry), but then
-	 * the result wouldn't be in sorted order. So instead we loop through
-	 * the indices in order, adding them to the result if they are
-	 * selected.
+	 * The selection ranges are sorted, so walking them yields the indices
+	 * in increasing order.
 	 */
 
 	objPtr = Tcl_NewObj();
-	for (i = 0; i < (int)listPtr->nElements; i++) {
-	    if (Tcl_FindHashEntry(listPtr->selection, KEY(i))) {
+	for (r = 0; r < listPtr->numSelRanges; r++) {
+	    for (i = listPtr->selRanges[r].first;
+		    i <= listPtr->selRanges[r].last; i++) {
 		Tcl_ListObjAppendElement(NULL, objPtr, Tcl_NewWideIntObj(i));
 	    }
 	}
@@ -1228,7 +1303,7 @@ ListboxSelectionSubCmd(
 	    return TCL_ERROR;
 	}
 	Tcl_SetObjResult(interp, Tcl_NewBooleanObj(
-		Tcl_FindHashEntry(listPtr->selection, KEY(first)) != NULL));
+		SelectionIncludes(listPtr, first)));
 	result = TCL_OK;
 	break;
     case SELECTION_SET:
@@ -1477,11 +1552,13 @@ DestroyListbox(
     }
 
     /*
-     * Free the selection hash table.
+     * Free the selection ranges.
      */
 
-    Tcl_DeleteHashTable(listPtr->selection);
-    Tcl_Free(listPtr->selection);
+    if (listPtr->selRanges != NULL) {
+	Tcl_Free(listPtr->selRanges);
+    }
+    FreeElemWidths(listPtr);
 
     /*
      * Free the item attribute hash table.
@@ -1574,9 +1651,19 @@ ConfigureListbox(
     Tk_SavedOptions savedOptions;
     Tcl_Obj *oldListObj = NULL;
     Tcl_Obj *errorResult = NULL;
+    Tcl_Obj *origListObj = listPtr->listObj;
+    Tk_Font oldFont = listPtr->tkfont;
     int oldExport, error;
     int borderWidth, highlightWidth;
 
+    /*
+     * Hold on to the current list so that it can be compared with the new
+     * one afterwards to tell whether the cached element widths survive.
+     */
+
+    if (origListObj != NULL) {
+	Tcl_IncrRefCount(origListObj);
+    }
     oldExport = (listPtr->exportSelection) && (!Tcl_IsSafe(listPtr->interp));
     if (listPtr->listVarNameObj != NULL) {
 	Tcl_UntraceVar2(interp, Tcl_GetString(listPtr->listVarNameObj), NULL,
@@ -1693,12 +1780,22 @@ ConfigureListbox(
      */
 
     Tcl_ListObjLength(listPtr->interp, listPtr->listObj, &listPtr->nElements);
+    if (listPtr->listObj != origListObj) {
+	FreeElemWidths(listPtr);
+	listPtr->flags |= MAXWIDTH_IS_STALE;
+    }
+    if (origListObj != NULL) {
+	Tcl_DecrRefCount(origListObj);
+    }
 
     if (error) {
 	Tcl_SetObjResult(interp, errorResult);
 	Tcl_DecrRefCount(errorResult);
 	return TCL_ERROR;
     }
+    if (listPtr->tkfont == oldFont) {
+	listPtr->flags |= KEEP_WIDTHS;
+    }
     ListboxWorldChanged(listPtr);
     return TCL_OK;
 }
@@ -1777,6 +1874,7 @@ ListboxWorldChanged(
     XGCValues gcValues;
     GC gc;
     unsigned long mask;
+    int widthsStale;
     Listbox *listPtr = (Listbox *)instanceData;
 
     if (listPtr->state & STATE_NORMAL) {
@@ -1823,7 +1921,10 @@ ListboxWorldChanged(
      * to be redisplayed.
      */
 
-    ListboxComputeGeometry(listPtr, 1, 1, 1);
+    widthsStale = !(listPtr->flags & KEEP_WIDTHS)
+	    || (listPtr->flags & MAXWIDTH_IS_STALE);
+    listPtr->flags &= ~KEEP_WIDTHS;
+    ListboxComputeGeometry(listPtr, widthsStale, widthsStale, 1);
     listPtr->flags |= UPDATE_V_SCROLLBAR|UPDATE_H_SCROLLBAR;
     EventuallyRedrawRange(listPtr, 0, listPtr->nElements-1);
 }
@@ -1868,11 +1969,16 @@ DisplayListbox(
     Pixmap pixmap;
     int textWidth;
     int borderWidth, selBorderWidth, highlightWidth;
+    int first, last;		/* Elements to redraw. */
+    int bandTop, bandBottom;	/* Part of the window to redraw. */
+    bool full;			/* Whether to redraw the whole window. */
+    Tcl_WideInt perfStart;
 
     listPtr->flags &= ~REDRAW_PENDING;
     if (listPtr->flags & LISTBOX_DELETED) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     if (listPtr->flags & MAXWIDTH_IS_STALE) {
 	ListboxComputeGeometry(listPtr, 0, 1, 0);
@@ -1885,6 +1991,7 @@ DisplayListbox(
 	ListboxUpdateVScrollbar(listPtr);
 	if ((listPtr->flags & LISTBOX_DELETED) || !Tk_IsMapped(tkwin)) {
 	    Tcl_Release(listPtr);
+	    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 	    return;
 	}
     }
@@ -1892,12 +1999,68 @@ DisplayListbox(
 	ListboxUpdateHScrollbar(listPtr);
 	if ((listPtr->flags & LISTBOX_DELETED) || !Tk_IsMapped(tkwin)) {
 	    Tcl_Release(listPtr);
+	    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 	    return;
 	}
     }
     listPtr->flags &= ~(REDRAW_PENDING|UPDATE_V_SCROLLBAR|UPDATE_H_SCROLLBAR);
     Tcl_Release(listPtr);
 
+    /*
+     * Work out which lines need to be redrawn. Anything that moves the
+     * lines, or a range that covers all of them, means the whole window;
+     * otherwise only the band of the requested lines is drawn and copied,
+     * and the border stays as it is. A range ending at the last element
+     * reaches to the bottom of the window, so that lines left over from
+     * deleted elements get cleared.
+     */
+
+    limit = listPtr->topIndex + listPtr->fullLines + listPtr->partialLine - 1;
+    if (limit >= (int)listPtr->nElements) {
+	limit = listPtr->nElements-1;
+    }
+    first = (int) listPtr->redrawFirst;
+    last = (int) listPtr->redrawLast;
+    full = (first <= listPtr->topIndex)
+	    && (last >= (int)listPtr->nElements - 1);
+    if ((listPtr->drawnTopIndex != listPtr->topIndex)
+	    || (listPtr->drawnXOffset != listPtr->xOffset)
+	    || (listPtr->drawnMaxWidth != listPtr->maxWidth)
+	    || (listPtr->drawnWidth != Tk_Width(tkwin))
+	    || (listPtr->drawnHeight != Tk_Height(tkwin))) {
+	full = true;
+    }
+#ifdef TK_NO_DOUBLE_BUFFERING
+    full = true;
+#endif /* TK_NO_DOUBLE_BUFFERING */
+    if (full) {
+	first = listPtr->topIndex;
+	bandTop = 0;
+	bandBottom = Tk_Height(tkwin);
+    } else {
+	if (first < listPtr->topIndex) {
+	    first = listPtr->topIndex;
+	}
+	bandTop = (first - listPtr->topIndex) * listPtr->lineHeight
+		+ listPtr->inset;
+	if (last >= (int)listPtr->nElements - 1) {
+	    bandBottom = Tk_Height(tkwin) - listPtr->inset;
+	} else {
+	    bandBottom = (last - listPtr->topIndex + 1) * listPtr->lineHeight
+		    + listPtr->inset;
+	    if (bandBottom > Tk_Height(tkwin) - listPtr->inset) {
+		bandBottom = Tk_Height(tkwin) - listPtr->inset;
+	    }
+	    if (limit > last) {
+		limit = last;
+	    }
+	}
+	if (bandTop >= bandBottom) {
+	    TkPerfStop(TK_PERF_DISPLAY, perfStart);
+	    return;
+	}
+    }
+
 #ifndef TK_NO_DOUBLE_BUFFERING
     /*
      * Redrawing is done in a temporary pixmap that is allocated here and
@@ -1907,23 +2070,24 @@ DisplayListbox(
      * screen).
      */
 
-    pixmap = Tk_GetPixmap(disp, Tk_WindowId(tkwin),
-	    Tk_Width(tkwin), Tk_Height(tkwin), Tk_Depth(tkwin));
+    pixmap = TkGetBufferPixmap(tkwin, Tk_Width(tkwin), Tk_Height(tkwin));
 #else
     pixmap = Tk_WindowId(tkwin);
 #endif /* TK_NO_DOUBLE_BUFFERING */
-    Tk_Fill3DRectangle(tkwin, pixmap, listPtr->normalBorder, 0, 0,
-	    Tk_Width(tkwin), Tk_Height(tkwin), 0, TK_RELIEF_FLAT);
+    if (full) {
+	Tk_Fill3DRectangle(tkwin, pixmap, listPtr->normalBorder, 0, 0,
+		Tk_Width(tkwin), Tk_Height(tkwin), 0, TK_RELIEF_FLAT);
+    } else {
+	Tk_Fill3DRectangle(tkwin, pixmap, listPtr->normalBorder,
+		listPtr->inset, bandTop, Tk_Width(tkwin) - 2 * listPtr->inset,
+		bandBottom - bandTop, 0, TK_RELIEF_FLAT);
+    }
 
     /*
      * Display each item in the listbox.
      */
 
     Tk_GetPixelsFromObj(NULL, listPtr->tkwin, listPtr->selBorderWidthObj, &selBorderWidth);
-    limit = listPtr->topIndex + listPtr->fullLines + listPtr->partialLine - 1;
-    if (limit >= (int)listPtr->nElements) {
-	limit = listPtr->nElements-1;
-    }
     left = right = 0;
     if (listPtr->xOffset > 0) {
 	left = selBorderWidth + 1;
@@ -1932,9 +2096,11 @@ DisplayListbox(
 	    - 2 * (listPtr->inset + selBorderWidth))) {
 	right = selBorderWidth + 1;
     }
-    prevSelected = 0;
+    prevSelected = (first > listPtr->topIndex)
+	    && (listPtr->state & STATE_NORMAL)
+	    && SelectionIncludes(listPtr, first - 1);
 
-    for (i = listPtr->topIndex; i <= limit; i++) {
+    for (i = first; i <= limit; i++) {
 	int width = Tk_Width(tkwin);	/* zeroth approx to silence warning */
 
 	x = listPtr->inset;
@@ -1956,7 +2122,7 @@ DisplayListbox(
 	 */
 
 	if (listPtr->state & STATE_NORMAL) {
-	    if (Tcl_FindHashEntry(listPtr->selection, KEY(i))) {
+	    if (SelectionIncludes(listPtr, i)) {
 		/*
 		 * Selected items are drawn differently.
 		 */
@@ -2043,7 +2209,7 @@ DisplayListbox(
 		}
 		/* Draw bottom bevel */
 		if (i + 1 == (int)listPtr->nElements ||
-			!Tcl_FindHashEntry(listPtr->selection, KEY(i + 1))) {
+			!SelectionIncludes(listPtr, i + 1)) {
 		    Tk_3DHorizontalBevel(tkwin, pixmap, selectedBg, x-left,
 			    y + listPtr->lineHeight - selBorderWidth,
 			    width+left+right, selBorderWidth, 0, 0, 0,
@@ -2153,6 +2319,23 @@ DisplayListbox(
 	}
     }
 
+#ifndef TK_NO_DOUBLE_BUFFERING
+    if (!full) {
+	/*
+	 * Only the band inside the border was drawn; text that spilled onto
+	 * the border isn't copied.
+	 */
+
+	XCopyArea(disp, pixmap, Tk_WindowId(tkwin), listPtr->textGC,
+		listPtr->inset, bandTop,
+		(unsigned) (Tk_Width(tkwin) - 2 * listPtr->inset),
+		(unsigned) (bandBottom - bandTop), listPtr->inset, bandTop);
+	TkFreeBufferPixmap(disp, pixmap);
+	TkPerfStop(TK_PERF_DISPLAY, perfStart);
+	return;
+    }
+#endif /* TK_NO_DOUBLE_BUFFERING */
+
     /*
      * Redraw the border for the listbox to make sure that it's on top of any
      * of the text of the listbox entries.
@@ -2181,8 +2364,14 @@ DisplayListbox(
 #ifndef TK_NO_DOUBLE_BUFFERING
     XCopyArea(disp, pixmap, Tk_WindowId(tkwin), listPtr->textGC, 0, 0,
 	    (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin), 0, 0);
-    Tk_FreePixmap(disp, pixmap);
+    TkFreeBufferPixmap(disp, pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
+    listPtr->drawnTopIndex = listPtr->topIndex;
+    listPtr->drawnXOffset = listPtr->xOffset;
+    listPtr->drawnMaxWidth = listPtr->maxWidth;
+    listPtr->drawnWidth = Tk_Width(tkwin);
+    listPtr->drawnHeight = Tk_Height(tkwin);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -2219,11 +2408,9 @@ ListboxComputeGeometry(
 				 * Tk_UnsetGrid to update gridding for the
 				 * window. */
 {
-    int width, height, pixelWidth, pixelHeight, i, result;
-    Tcl_Size textLength;
+    int width, height, pixelWidth, pixelHeight;
+    Tcl_Size i, space;
     Tk_FontMetrics fm;
-    Tcl_Obj *element;
-    const char *text;
     int selBorderWidth;
 
     if (fontChanged || maxIsStale) {
@@ -2231,22 +2418,48 @@ ListboxComputeGeometry(
 	if (listPtr->xScrollUnit == 0) {
 	    listPtr->xScrollUnit = 1;
 	}
+    }
+    if (fontChanged || (maxIsStale && (listPtr->elemWidths == NULL))) {
+	/*
+	 * Throw away any cached widths and measure the elements again. Short
+	 * lists are measured right away; long ones get their first slice
+	 * measured now and the rest from idle handlers, with maxWidth growing
+	 * as the slices complete.
+	 */
+
+	FreeElemWidths(listPtr);
+	space = (listPtr->nElements > 0) ? listPtr->nElements : 1;
+	listPtr->elemWidths = (int *)Tcl_Alloc(space * sizeof(int));
+	listPtr->elemWidthsSpace = space;
+	for (i = 0; i < listPtr->nElements; i++) {
+	    listPtr->elemWidths[i] = -1;
+	}
 	listPtr->maxWidth = 0;
-	for (i = 0; i < (int)listPtr->nElements; i++) {
-	    /*
-	     * Compute the pixel width of the current element.
-	     */
+	listPtr->numAtMaxWidth = 0;
+	listPtr->flags &= ~MAXWIDTH_IS_STALE;
+	if (listPtr->nElements <= LISTBOX_MEASURE_SYNC) {
+	    MeasureElemWidths(listPtr, 0, listPtr->nElements - 1);
+	    listPtr->measureIndex = listPtr->nElements;
+	} else {
+	    MeasureElemWidths(listPtr, 0, LISTBOX_MEASURE_SLICE - 1);
+	    listPtr->measureIndex = LISTBOX_MEASURE_SLICE;
+	    listPtr->flags |= MEASURE_PENDING;
+	    Tcl_DoWhenIdle(ListboxMeasureProc, listPtr);
+	}
+    } else if (maxIsStale) {
+	/*
+	 * The cached widths are good, only the maximum has to be found again.
+	 */
 
-	    result = Tcl_ListObjIndex(listPtr->interp, listPtr->listObj, i,
-		    &element);
-	    if (result != TCL_OK) {
-		continue;
-	    }
-	    text = Tcl_GetStringFromObj(element, &textLength);
-	    Tk_GetFontMetrics(listPtr->tkfont, &fm);
-	    pixelWidth = Tk_TextWidth(listPtr->tkfont, text, textLength);
+	listPtr->maxWidth = 0;
+	listPtr->numAtMaxWidth = 0;
+	for (i = 0; i < listPtr->nElements; i++) {
+	    pixelWidth = listPtr->elemWidths[i];
 	    if (pixelWidth > listPtr->maxWidth) {
 		listPtr->maxWidth = pixelWidth;
+		listPtr->numAtMaxWidth = 1;
+	    } else if (pixelWidth == listPtr->maxWidth) {
+		listPtr->numAtMaxWidth++;
 	    }
 	}
     }
@@ -2284,6 +2497,244 @@ ListboxComputeGeometry(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MeasureElemWidths --
+ *
+ *	Measure the elements between first and last (inclusive) whose width
+ *	is not cached yet, and fold them into maxWidth.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The elemWidths, maxWidth and numAtMaxWidth fields are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MeasureElemWidths(
+    Listbox *listPtr,		/* Listbox whose elements are measured. */
+    Tcl_Size first,		/* Index of first element to measure. */
+    Tcl_Size last)		/* Index of last element to measure. */
+{
+    Tcl_Size i, objc, length;
+    Tcl_Obj **objv;
+    const char *text;
+    int pixelWidth;
+
+    if (Tcl_ListObjGetElements(NULL, listPtr->listObj, &objc, &objv)
+	    != TCL_OK) {
+	return;
+    }
+    if (last >= objc) {
+	last = objc - 1;
+    }
+    for (i = first; i <= last; i++) {
+	if (listPtr->elemWidths[i] >= 0) {
+	    continue;
+	}
+	text = Tcl_GetStringFromObj(objv[i], &length);
+	pixelWidth = Tk_TextWidth(listPtr->tkfont, text, length);
+	listPtr->elemWidths[i] = pixelWidth;
+	if (pixelWidth > listPtr->maxWidth) {
+	    listPtr->maxWidth = pixelWidth;
+	    listPtr->numAtMaxWidth = 1;
+	} else if (pixelWidth == listPtr->maxWidth) {
+	    listPtr->numAtMaxWidth++;
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListboxMeasureProc --
+ *
+ *	Idle handler that measures the next slice of a long list whose
+ *	element widths are not all known yet.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Element widths are cached, and the geometry and horizontal scrollbar
+ *	are updated if maxWidth grew. Reschedules itself until every element
+ *	has been measured.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ListboxMeasureProc(
+    void *clientData)		/* Information about widget. */
+{
+    Listbox *listPtr = (Listbox *)clientData;
+    int oldMaxWidth = listPtr->maxWidth;
+    Tcl_Size last;
+
+    listPtr->flags &= ~MEASURE_PENDING;
+    if ((listPtr->flags & LISTBOX_DELETED) || (listPtr->elemWidths == NULL)) {
+	return;
+    }
+    last = listPtr->measureIndex + LISTBOX_MEASURE_SLICE - 1;
+    if (last >= listPtr->nElements) {
+	last = listPtr->nElements - 1;
+    }
+    MeasureElemWidths(listPtr, listPtr->measureIndex, last);
+    listPtr->measureIndex = last + 1;
+    if (listPtr->measureIndex < listPtr->nElements) {
+	listPtr->flags |= MEASURE_PENDING;
+	Tcl_DoWhenIdle(ListboxMeasureProc, listPtr);
+    }
+    if (listPtr->maxWidth != oldMaxWidth) {
+	ListboxComputeGeometry(listPtr, 0, 0, 0);
+	listPtr->flags |= UPDATE_H_SCROLLBAR;
+	EventuallyRedrawRange(listPtr, 0, listPtr->nElements-1);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * InsertElemWidths --
+ *
+ *	Make room in the width cache for elements about to be inserted and
+ *	record their widths. Must be called while nElements still holds the
+ *	old list length.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The elemWidths, maxWidth and numAtMaxWidth fields are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+InsertElemWidths(
+    Listbox *listPtr,		/* Listbox that gets the new elements. */
+    Tcl_Size index,		/* Elements are inserted before this one. */
+    Tcl_Size count,		/* Number of new elements. */
+    Tcl_Obj *const objv[])	/* New elements. */
+{
+    Tcl_Size i, length;
+    const char *text;
+    int pixelWidth;
+
+    if (listPtr->elemWidths == NULL) {
+	return;
+    }
+    if (listPtr->nElements + count > listPtr->elemWidthsSpace) {
+	listPtr->elemWidthsSpace = 2 * (listPtr->nElements + count);
+	listPtr->elemWidths = (int *)Tcl_Realloc(listPtr->elemWidths,
+		listPtr->elemWidthsSpace * sizeof(int));
+    }
+    memmove(listPtr->elemWidths + index + count, listPtr->elemWidths + index,
+	    (listPtr->nElements - index) * sizeof(int));
+    for (i = 0; i < count; i++) {
+	text = Tcl_GetStringFromObj(objv[i], &length);
+	pixelWidth = Tk_TextWidth(listPtr->tkfont, text, length);
+	listPtr->elemWidths[index + i] = pixelWidth;
+	if (pixelWidth > listPtr->maxWidth) {
+	    listPtr->maxWidth = pixelWidth;
+	    listPtr->numAtMaxWidth = 1;
+	} else if (pixelWidth == listPtr->maxWidth) {
+	    listPtr->numAtMaxWidth++;
+	}
+    }
+    if (index < listPtr->measureIndex) {
+	listPtr->measureIndex += count;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DeleteElemWidths --
+ *
+ *	Drop the cached widths of the elements between first and last
+ *	(inclusive), which are about to be deleted. Must be called while
+ *	nElements still holds the old list length.
+ *
+ * Results:
+ *	Returns 1 if the last of the widest elements was deleted, meaning
+ *	that maxWidth has to be recomputed from the remaining cached widths;
+ *	0 otherwise.
+ *
+ * Side effects:
+ *	The elemWidths and numAtMaxWidth fields are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+DeleteElemWidths(
+    Listbox *listPtr,		/* Listbox that loses the elements. */
+    Tcl_Size first,		/* Index of first element to delete. */
+    Tcl_Size last)		/* Index of last element to delete. */
+{
+    Tcl_Size i, count = last + 1 - first;
+    int hadMax = 0;
+
+    if (listPtr->elemWidths == NULL) {
+	return 0;
+    }
+    for (i = first; i <= last; i++) {
+	if (listPtr->elemWidths[i] == listPtr->maxWidth) {
+	    listPtr->numAtMaxWidth--;
+	    hadMax = 1;
+	}
+    }
+    memmove(listPtr->elemWidths + first, listPtr->elemWidths + last + 1,
+	    (listPtr->nElements - last - 1) * sizeof(int));
+    if (listPtr->measureIndex > last) {
+	listPtr->measureIndex -= count;
+    } else if (listPtr->measureIndex > first) {
+	listPtr->measureIndex = first;
+    }
+    return hadMax && (listPtr->numAtMaxWidth == 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeElemWidths --
+ *
+ *	Discard the cached element widths, for instance because the list
+ *	was replaced as a whole.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed and any pending idle measurement is cancelled. The
+ *	caller must arrange for the widths to be measured again, usually by
+ *	setting MAXWIDTH_IS_STALE.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeElemWidths(
+    Listbox *listPtr)		/* Listbox whose width cache is freed. */
+{
+    if (listPtr->flags & MEASURE_PENDING) {
+	Tcl_CancelIdleCall(ListboxMeasureProc, listPtr);
+	listPtr->flags &= ~MEASURE_PENDING;
+    }
+    if (listPtr->elemWidths != NULL) {
+	Tcl_Free(listPtr->elemWidths);
+	listPtr->elemWidths = NULL;
+    }
+    listPtr->elemWidthsSpace = 0;
+    listPtr->numAtMaxWidth = 0;
+    listPtr->measureIndex = 0;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2309,31 +2760,23 @@ ListboxInsertSubCmd(
     Tcl_Size objc,			/* Number of new elements to add. */
     Tcl_Obj *const objv[])	/* New elements (one per entry). */
 {
-    int oldMaxWidth, pixelWidth, result;
-    Tcl_Size i, length;
+    int oldMaxWidth, result;
     Tcl_Obj *newListObj;
-    const char *stringRep;
 
-    oldMaxWidth = listPtr->maxWidth;
-    for (i = 0; i < objc; i++) {
-	/*
-	 * Check if any of the new elements are wider than the current widest;
-	 * if so, update our notion of "widest."
-	 */
+    /*
+     * Measure the new elements into the width cache; if any of them is
+     * wider than the current widest, this updates our notion of "widest."
+     */
 
-	stringRep = Tcl_GetStringFromObj(objv[i], &length);
-	pixelWidth = Tk_TextWidth(listPtr->tkfont, stringRep, length);
-	if (pixelWidth > listPtr->maxWidth) {
-	    listPtr->maxWidth = pixelWidth;
-	}
-    }
+    oldMaxWidth = listPtr->maxWidth;
+    InsertElemWidths(listPtr, index, objc, objv);
 
     /*
      * Adjust selection and attribute information for every index after the
      * first index.
      */
 
-    MigrateHashEntries(listPtr->selection, index, listPtr->nElements-1, objc);
+    SelectionShift(listPtr, index, objc);
     MigrateHashEntries(listPtr->itemAttrTable, index, listPtr->nElements-1,
 	    objc);
 
@@ -2424,10 +2867,8 @@ ListboxDeleteSubCmd(
     int first,			/* Index of first element to delete. */
     int last)			/* Index of last element to delete. */
 {
-    int count, i, widthChanged, result, pixelWidth;
-    Tcl_Size length;
-    Tcl_Obj *newListObj, *element;
-    const char *stringRep;
+    int count, i, widthChanged, result;
+    Tcl_Obj *newListObj;
     Tcl_HashEntry *entry;
 
     /*
@@ -2447,53 +2888,36 @@ ListboxDeleteSubCmd(
     }
 
     /*
-     * Foreach deleted index we must:
-     * a) remove selection information,
-     * b) check the width of the element; if it is equal to the max, set
-     *    widthChanged to 1, because it may be the only element with that
-     *    width.
+     * Remove selection information for the deleted elements.
      */
 
-    widthChanged = 0;
-    for (i = first; i <= last; i++) {
-	/*
-	 * Remove selection information.
-	 */
+    listPtr->numSelected -= (int) SelectionRemove(listPtr, first, last);
 
-	entry = Tcl_FindHashEntry(listPtr->selection, KEY(i));
-	if (entry != NULL) {
-	    listPtr->numSelected--;
-	    Tcl_DeleteHashEntry(entry);
-	}
+    /*
+     * Remove attribute information for each deleted index.
+     */
 
+    for (i = first; i <= last; i++) {
 	entry = Tcl_FindHashEntry(listPtr->itemAttrTable, KEY(i));
 	if (entry != NULL) {
 	    Tcl_Free(Tcl_GetHashValue(entry));
 	    Tcl_DeleteHashEntry(entry);
 	}
+    }
 
-	/*
-	 * Check width of the element. We only have to check if widthChanged
-	 * has not already been set to 1, because we only need one maxWidth
-	 * element to disappear for us to have to recompute the width.
-	 */
+    /*
+     * Drop the cached widths. Only if every element as wide as maxWidth goes
+     * away does the maximum have to be recomputed, and that only needs a
+     * scan of the remaining cached widths, not a re-measure.
+     */
 
-	if (widthChanged == 0) {
-	    Tcl_ListObjIndex(listPtr->interp, listPtr->listObj, i, &element);
-	    stringRep = Tcl_GetStringFromObj(element, &length);
-	    pixelWidth = Tk_TextWidth(listPtr->tkfont, stringRep, length);
-	    if (pixelWidth == listPtr->maxWidth) {
-		widthChanged = 1;
-	    }
-	}
-    }
+    widthChanged = DeleteElemWidths(listPtr, first, last);
 
     /*
      * Adjust selection and attribute info for indices after lastIndex.
      */
 
-    MigrateHashEntries(listPtr->selection, last+1,
-	    listPtr->nElements-1, count*-1);
+    SelectionShift(listPtr, last+1, count*-1);
     MigrateHashEntries(listPtr->itemAttrTable, last+1,
 	    listPtr->nElements-1, count*-1);
 
@@ -2601,10 +3025,25 @@ ListboxEventProc(
     Listbox *listPtr = (Listbox *)clientData;
 
     if (eventPtr->type == Expose) {
-	EventuallyRedrawRange(listPtr,
-		NearestListboxElement(listPtr, eventPtr->xexpose.y),
-		NearestListboxElement(listPtr, eventPtr->xexpose.y
-		+ eventPtr->xexpose.height));
+	XExposeEvent *exposePtr = &eventPtr->xexpose;
+
+	/*
+	 * Only lines are redrawn on their own; an exposed border needs the
+	 * whole window.
+	 */
+
+	if ((exposePtr->x < listPtr->inset) || (exposePtr->y < listPtr->inset)
+		|| (exposePtr->x + exposePtr->width
+			> Tk_Width(listPtr->tkwin) - listPtr->inset)
+		|| (exposePtr->y + exposePtr->height
+			> Tk_Height(listPtr->tkwin) - listPtr->inset)) {
+	    EventuallyRedrawRange(listPtr, 0, listPtr->nElements-1);
+	} else {
+	    EventuallyRedrawRange(listPtr,
+		    NearestListboxElement(listPtr, exposePtr->y),
+		    NearestListboxElement(listPtr, exposePtr->y
+		    + exposePtr->height));
+	}
     } else if (eventPtr->type == DestroyNotify) {
 	if (!(listPtr->flags & LISTBOX_DELETED)) {
 	    listPtr->flags |= LISTBOX_DELETED;
@@ -2615,6 +3054,10 @@ ListboxEventProc(
 	    if (listPtr->flags & REDRAW_PENDING) {
 		Tcl_CancelIdleCall(DisplayListbox, clientData);
 	    }
+	    if (listPtr->flags & MEASURE_PENDING) {
+		Tcl_CancelIdleCall(ListboxMeasureProc, clientData);
+		listPtr->flags &= ~MEASURE_PENDING;
+	    }
 	    Tcl_EventuallyFree(clientData, DestroyListbox);
 	}
     } else if (eventPtr->type == ConfigureNotify) {
@@ -3014,8 +3457,8 @@ ListboxSelect(
     int select)			/* 1 means select items, 0 means deselect
 				 * them. */
 {
-    int i, firstRedisplay, oldCount, isNew;
-    Tcl_HashEntry *entry;
+    int i, oldCount;
+    Tcl_Size changed;
 
     if (last < first) {
 	i = first;
@@ -3032,39 +3475,27 @@ ListboxSelect(
 	last = listPtr->nElements - 1;
     }
     oldCount = listPtr->numSelected;
-    firstRedisplay = -1;
 
     /*
-     * For each index in the range, find it in our selection hash table. If
-     * it's not there but should be, add it. If it's there but shouldn't be,
-     * remove it.
+     * Merge the range into the selection ranges or cut it out of them,
+     * keeping track of how many elements actually changed state.
      */
 
-    for (i = first; i <= last; i++) {
-	entry = Tcl_FindHashEntry(listPtr->selection, KEY(i));
-	if (entry != NULL) {
-	    if (!select) {
-		Tcl_DeleteHashEntry(entry);
-		listPtr->numSelected--;
-		if (firstRedisplay < 0) {
-		    firstRedisplay = i;
-		}
-	    }
-	} else {
-	    if (select) {
-		entry = Tcl_CreateHashEntry(listPtr->selection, KEY(i),
-			&isNew);
-		Tcl_SetHashValue(entry, NULL);
-		listPtr->numSelected++;
-		if (firstRedisplay < 0) {
-		    firstRedisplay = i;
-		}
-	    }
-	}
+    if (select) {
+	changed = SelectionAdd(listPtr, first, last);
+	listPtr->numSelected += (int) changed;
+    } else {
+	changed = SelectionRemove(listPtr, first, last);
+	listPtr->numSelected -= (int) changed;
     }
 
-    if (firstRedisplay >= 0) {
-	EventuallyRedrawRange(listPtr, first, last);
+    if (changed > 0) {
+	/*
+	 * The neighbors too: whether they are selected decides where the
+	 * bevels around the selection go.
+	 */
+
+	EventuallyRedrawRange(listPtr, first - 1, last + 1);
     }
     if ((oldCount == 0) && (listPtr->numSelected > 0)
 	    && (listPtr->exportSelection)
@@ -3109,11 +3540,10 @@ ListboxFetchSelection(
 {
     Listbox *listPtr = (Listbox *)clientData;
     Tcl_DString selection;
-    int count, needNewline, i;
-    Tcl_Size length, stringLen;
+    int count, needNewline;
+    Tcl_Size length, stringLen, i, r;
     Tcl_Obj *curElement;
     const char *stringRep;
-    Tcl_HashEntry *entry;
 
     if ((!listPtr->exportSelection) || Tcl_IsSafe(listPtr->interp)) {
 	return -1;
@@ -3125,9 +3555,9 @@ ListboxFetchSelection(
 
     needNewline = 0;
     Tcl_DStringInit(&selection);
-    for (i = 0; i < (int)listPtr->nElements; i++) {
-	entry = Tcl_FindHashEntry(listPtr->selection, KEY(i));
-	if (entry != NULL) {
+    for (r = 0; r < listPtr->numSelRanges; r++) {
+	for (i = listPtr->selRanges[r].first;
+		i <= listPtr->selRanges[r].last; i++) {
 	    if (needNewline) {
 		Tcl_DStringAppend(&selection, "\n", 1);
 	    }
@@ -3223,7 +3653,9 @@ GenerateListboxSelectEvent(
  * EventuallyRedrawRange --
  *
  *	Ensure that a given range of elements is eventually redrawn on the
- *	display (if those elements in fact appear on the display).
+ *	display (if those elements in fact appear on the display). A range
+ *	that covers the top visible element through the last element redraws
+ *	the whole window, border included.
  *
  * Results:
  *	None.
@@ -3237,22 +3669,40 @@ GenerateListboxSelectEvent(
 static void
 EventuallyRedrawRange(
     Listbox *listPtr,	/* Information about widget. */
-    TCL_UNUSED(Tcl_Size),			/* Index of first element in list that needs
+    Tcl_Size first,		/* Index of first element in list that needs
 				 * to be redrawn. */
-    TCL_UNUSED(Tcl_Size))			/* Index of last element in list that needs to
+    Tcl_Size last)		/* Index of last element in list that needs to
 				 * be redrawn. May be less than first; these
 				 * just bracket a range. */
 {
+    if (first > last) {
+	Tcl_Size tmp = first;
+
+	first = last;
+	last = tmp;
+    }
+
     /*
-     * We don't have to register a redraw callback if one is already pending,
-     * or if the window doesn't exist, or if the window isn't mapped.
+     * We don't have to register a redraw callback if the window doesn't
+     * exist, or if the window isn't mapped. If one is already pending, just
+     * widen its range.
      */
 
-    if ((listPtr->flags & REDRAW_PENDING)
-	    || (listPtr->flags & LISTBOX_DELETED)
+    if ((listPtr->flags & LISTBOX_DELETED)
 	    || !Tk_IsMapped(listPtr->tkwin)) {
 	return;
     }
+    if (listPtr->flags & REDRAW_PENDING) {
+	if (first < listPtr->redrawFirst) {
+	    listPtr->redrawFirst = first;
+	}
+	if (last > listPtr->redrawLast) {
+	    listPtr->redrawLast = last;
+	}
+	return;
+    }
+    listPtr->redrawFirst = first;
+    listPtr->redrawLast = last;
     listPtr->flags |= REDRAW_PENDING;
     Tcl_DoWhenIdle(DisplayListbox, listPtr);
 }
@@ -3426,9 +3876,11 @@ ListboxListVarProc(
     int flags)			/* Information about what happened. */
 {
     Listbox *listPtr = (Listbox *)clientData;
-    Tcl_Obj *oldListObj, *varListObj;
+    Tcl_Obj *oldListObj = NULL, *varListObj;
     Tcl_Size oldLength, i;
     Tcl_HashEntry *entry;
+    int oldMaxWidth, maxIsStale;
+    Tcl_Size changed;
 
     /*
      * Bwah hahahaha! Puny mortal, you can't unset a -listvar'd variable!
@@ -3481,18 +3933,34 @@ ListboxListVarProc(
 	    return (char *) "invalid listvar value";
 	}
 
+	/*
+	 * The insert and delete subcommands write our own list back into the
+	 * variable; there is nothing left to do for those.
+	 */
+
+	if (varListObj == oldListObj) {
+	    return NULL;
+	}
+
 	listPtr->listObj = varListObj;
 
 	/*
-	 * Incr the obj ref count so it doesn't vanish if the var is unset.
+	 * Incr the obj ref count so it doesn't vanish if the var is unset. The
+	 * ref to our old list obj is kept until the two have been compared.
 	 */
 
 	Tcl_IncrRefCount(listPtr->listObj);
+    }
 
-	/*
-	 * Clean up the ref to our old list obj.
-	 */
+    /*
+     * Try to bring the cached element widths up to date by applying only
+     * what changed between the old and the new list.
+     */
 
+    oldLength = listPtr->nElements;
+    oldMaxWidth = listPtr->maxWidth;
+    changed = ApplyListDelta(listPtr, oldListObj, &maxIsStale);
+    if (oldListObj != NULL) {
 	Tcl_DecrRefCount(oldListObj);
     }
 
@@ -3501,20 +3969,16 @@ ListboxListVarProc(
      * attributes information for elements past the end of the new list.
      */
 
-    oldLength = listPtr->nElements;
     Tcl_ListObjLength(listPtr->interp, listPtr->listObj, &listPtr->nElements);
     if (listPtr->nElements < oldLength) {
-	for (i = listPtr->nElements; i < oldLength; i++) {
-	    /*
-	     * Clean up selection.
-	     */
+	/*
+	 * Clean up selection.
+	 */
 
-	    entry = Tcl_FindHashEntry(listPtr->selection, KEY(i));
-	    if (entry != NULL) {
-		listPtr->numSelected--;
-		Tcl_DeleteHashEntry(entry);
-	    }
+	listPtr->numSelected -= (int) SelectionRemove(listPtr,
+		listPtr->nElements, oldLength - 1);
 
+	for (i = listPtr->nElements; i < oldLength; i++) {
 	    /*
 	     * Clean up attributes.
 	     */
@@ -3537,19 +4001,118 @@ ListboxListVarProc(
 	}
     }
 
+    if (changed != TCL_INDEX_NONE) {
+	/*
+	 * The delta was applied: only the elements from the first changed
+	 * one onwards need to be redrawn.
+	 */
+
+	ListboxComputeGeometry(listPtr, 0, maxIsStale, 0);
+	if (listPtr->maxWidth != oldMaxWidth) {
+	    listPtr->flags |= UPDATE_H_SCROLLBAR;
+	}
+	EventuallyRedrawRange(listPtr, changed, listPtr->nElements-1);
+	return NULL;
+    }
+
     /*
      * The computed maxWidth may have changed as a result of this operation.
      * However, we don't want to recompute it every time this trace fires
-     * (imagine the user doing 1000 lappends to the listvar). Therefore, set
-     * the MAXWIDTH_IS_STALE flag, which will cause the width to be recomputed
-     * next time the list is redrawn.
+     * (imagine the user doing 1000 lappends to the listvar). Therefore, drop
+     * the cached widths and set the MAXWIDTH_IS_STALE flag, which will cause
+     * the widths to be measured again next time the list is redrawn.
      */
 
+    FreeElemWidths(listPtr);
     listPtr->flags |= MAXWIDTH_IS_STALE;
 
     EventuallyRedrawRange(listPtr, 0, listPtr->nElements-1);
     return NULL;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ApplyListDelta --
+ *
+ *	Called when the list variable has been given a new value, before
+ *	nElements is updated. Finds the elements common to the start and end
+ *	of the old and new lists, which covers the usual edits (append,
+ *	prepend, truncate, replacing or removing a run of elements), and
+ *	updates the cached element widths for the elements in between only.
+ *	Elements are compared by identity, which is what list editing
+ *	commands preserve for the elements they do not touch.
+ *
+ * Results:
+ *	Returns the index of the first element that changed, or
+ *	TCL_INDEX_NONE if the delta could not be applied, in which case the
+ *	caller has to treat the whole list as new.
+ *
+ * Side effects:
+ *	The elemWidths, maxWidth, numAtMaxWidth and nElements fields may be
+ *	updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+ApplyListDelta(
+    Listbox *listPtr,		/* Listbox whose list was replaced. */
+    Tcl_Obj *oldListObj,	/* The previous list, or NULL. */
+    int *maxIsStalePtr)		/* Set to 1 if the widest element was removed
+				 * and maxWidth must be recomputed. */
+{
+    Tcl_Size oldc, newc, prefix, suffix, limit;
+    Tcl_Obj **oldv, **newv;
+
+    *maxIsStalePtr = 0;
+    if ((oldListObj == NULL) || (listPtr->elemWidths == NULL)
+	    || (listPtr->flags & MAXWIDTH_IS_STALE)
+	    || (Tcl_ListObjGetElements(NULL, oldListObj, &oldc, &oldv)
+		    != TCL_OK)
+	    || (Tcl_ListObjGetElements(NULL, listPtr->listObj, &newc, &newv)
+		    != TCL_OK)
+	    || (oldc != listPtr->nElements)) {
+	return TCL_INDEX_NONE;
+    }
+
+    limit = (oldc < newc) ? oldc : newc;
+    prefix = 0;
+    if (oldv == newv) {
+	/*
+	 * Both lists are views on the same element storage.
+	 */
+
+	prefix = limit;
+    } else {
+	while ((prefix < limit) && (oldv[prefix] == newv[prefix])) {
+	    prefix++;
+	}
+    }
+    suffix = 0;
+    while ((suffix < limit - prefix)
+	    && (oldv[oldc - 1 - suffix] == newv[newc - 1 - suffix])) {
+	suffix++;
+    }
+
+    /*
+     * Nothing in common, or too much new material: measuring it all here
+     * would block, so leave it to the lazy path.
+     */
+
+    if (((prefix == 0) && (suffix == 0) && (oldc > 0))
+	    || (newc - prefix - suffix > LISTBOX_MEASURE_SYNC)) {
+	return TCL_INDEX_NONE;
+    }
+
+    if (oldc - prefix - suffix > 0) {
+	*maxIsStalePtr = DeleteElemWidths(listPtr, prefix, oldc - suffix - 1);
+	listPtr->nElements -= oldc - prefix - suffix;
+    }
+    InsertElemWidths(listPtr, prefix, newc - prefix - suffix, newv + prefix);
+    listPtr->nElements = newc;
+    return prefix;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -3616,6 +4179,340 @@ MigrateHashEntries(
     return;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelRangeSearch --
+ *
+ *	Binary search of the selection ranges of a listbox.
+ *
+ * Results:
+ *	The position of the first range whose last element is at or after
+ *	index, or listPtr->numSelRanges if there is none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+SelRangeSearch(
+    Listbox *listPtr,
+    Tcl_Size index)
+{
+    Tcl_Size low = 0, high = listPtr->numSelRanges;
+
+    while (low < high) {
+	Tcl_Size mid = low + (high - low) / 2;
+
+	if (listPtr->selRanges[mid].last < index) {
+	    low = mid + 1;
+	} else {
+	    high = mid;
+	}
+    }
+    return low;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelRangeSplice --
+ *
+ *	Replace numRemove selection ranges starting at position pos with the
+ *	numInsert ranges in insertPtr.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The selection range array may be reallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SelRangeSplice(
+    Listbox *listPtr,
+    Tcl_Size pos,
+    Tcl_Size numRemove,
+    const SelRange *insertPtr,
+    Tcl_Size numInsert)
+{
+    Tcl_Size newCount = listPtr->numSelRanges - numRemove + numInsert;
+
+    if (newCount > listPtr->selRangesSpace) {
+	Tcl_Size newSpace = listPtr->selRangesSpace ?
+		2 * listPtr->selRangesSpace : 8;
+
+	while (newSpace < newCount) {
+	    newSpace *= 2;
+	}
+	if (listPtr->selRanges == NULL) {
+	    listPtr->selRanges = (SelRange *)Tcl_Alloc(
+		    newSpace * sizeof(SelRange));
+	} else {
+	    listPtr->selRanges = (SelRange *)Tcl_Realloc(listPtr->selRanges,
+		    newSpace * sizeof(SelRange));
+	}
+	listPtr->selRangesSpace = newSpace;
+    }
+    if (numRemove != numInsert) {
+	memmove(listPtr->selRanges + pos + numInsert,
+		listPtr->selRanges + pos + numRemove,
+		(listPtr->numSelRanges - pos - numRemove) * sizeof(SelRange));
+    }
+    if (numInsert > 0) {
+	memcpy(listPtr->selRanges + pos, insertPtr,
+		numInsert * sizeof(SelRange));
+    }
+    listPtr->numSelRanges = newCount;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionIncludes --
+ *
+ *	Determine whether an element of a listbox is selected.
+ *
+ * Results:
+ *	1 if the element at index is selected, 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SelectionIncludes(
+    Listbox *listPtr,
+    Tcl_Size index)
+{
+    Tcl_Size pos = SelRangeSearch(listPtr, index);
+
+    return (pos < listPtr->numSelRanges)
+	    && (listPtr->selRanges[pos].first <= index);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionCount --
+ *
+ *	Count the selected elements between first and last, inclusive.
+ *
+ * Results:
+ *	The number of selected elements in the range.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+SelectionCount(
+    Listbox *listPtr,
+    Tcl_Size first,
+    Tcl_Size last)
+{
+    Tcl_Size pos, count = 0;
+    SelRange *rangePtr;
+
+    for (pos = SelRangeSearch(listPtr, first);
+	    pos < listPtr->numSelRanges; pos++) {
+	rangePtr = listPtr->selRanges + pos;
+	if (rangePtr->first > last) {
+	    break;
+	}
+	count += (rangePtr->last < last ? rangePtr->last : last)
+		- (rangePtr->first > first ? rangePtr->first : first) + 1;
+    }
+    return count;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionAdd --
+ *
+ *	Mark the elements between first and last, inclusive, as selected.
+ *
+ * Results:
+ *	The number of elements that were not selected before.
+ *
+ * Side effects:
+ *	The range is merged with any overlapping or adjacent ranges.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+SelectionAdd(
+    Listbox *listPtr,
+    Tcl_Size first,
+    Tcl_Size last)
+{
+    Tcl_Size lo, hi, added;
+    SelRange range;
+
+    added = last - first + 1 - SelectionCount(listPtr, first, last);
+    if (added == 0) {
+	return 0;
+    }
+
+    /*
+     * Ranges lo .. hi-1 overlap or touch the new range.
+     */
+
+    lo = SelRangeSearch(listPtr, first - 1);
+    for (hi = lo; hi < listPtr->numSelRanges
+	    && listPtr->selRanges[hi].first <= last + 1; hi++) {
+	/* Empty loop body. */
+    }
+
+    range.first = first;
+    range.last = last;
+    if (hi > lo) {
+	if (listPtr->selRanges[lo].first < first) {
+	    range.first = listPtr->selRanges[lo].first;
+	}
+	if (listPtr->selRanges[hi - 1].last > last) {
+	    range.last = listPtr->selRanges[hi - 1].last;
+	}
+    }
+    SelRangeSplice(listPtr, lo, hi - lo, &range, 1);
+    return added;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionRemove --
+ *
+ *	Mark the elements between first and last, inclusive, as not selected.
+ *
+ * Results:
+ *	The number of elements that were selected before.
+ *
+ * Side effects:
+ *	Ranges overlapping the edges of the removed range are trimmed or
+ *	split.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+SelectionRemove(
+    Listbox *listPtr,
+    Tcl_Size first,
+    Tcl_Size last)
+{
+    Tcl_Size lo, hi, removed, numKeep = 0;
+    SelRange keep[2];
+
+    removed = SelectionCount(listPtr, first, last);
+    if (removed == 0) {
+	return 0;
+    }
+
+    /*
+     * Ranges lo .. hi-1 overlap the removed range.
+     */
+
+    lo = SelRangeSearch(listPtr, first);
+    for (hi = lo; hi < listPtr->numSelRanges
+	    && listPtr->selRanges[hi].first <= last; hi++) {
+	/* Empty loop body. */
+    }
+
+    if (listPtr->selRanges[lo].first < first) {
+	keep[numKeep].first = listPtr->selRanges[lo].first;
+	keep[numKeep].last = first - 1;
+	numKeep++;
+    }
+    if (listPtr->selRanges[hi - 1].last > last) {
+	keep[numKeep].first = last + 1;
+	keep[numKeep].last = listPtr->selRanges[hi - 1].last;
+	numKeep++;
+    }
+    SelRangeSplice(listPtr, lo, hi - lo, keep, numKeep);
+    return removed;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionShift --
+ *
+ *	Renumber the selected elements at or after index by offset, after
+ *	elements have been inserted (offset > 0) or deleted (offset < 0). For
+ *	insertions, the new elements at index are not selected; for deletions,
+ *	the deleted elements must already have been removed from the
+ *	selection.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Ranges may be split by an insertion or joined by a deletion.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SelectionShift(
+    Listbox *listPtr,
+    Tcl_Size index,
+    Tcl_Size offset)
+{
+    Tcl_Size pos, i;
+    SelRange *rangePtr;
+
+    if (offset == 0) {
+	return;
+    }
+    pos = SelRangeSearch(listPtr, index);
+    if (pos >= listPtr->numSelRanges) {
+	return;
+    }
+
+    /*
+     * Split a range that straddles the insertion point.
+     */
+
+    rangePtr = listPtr->selRanges + pos;
+    if (rangePtr->first < index) {
+	SelRange split[2];
+
+	split[0].first = rangePtr->first;
+	split[0].last = index - 1;
+	split[1].first = index;
+	split[1].last = rangePtr->last;
+	SelRangeSplice(listPtr, pos, 1, split, 2);
+	pos++;
+    }
+
+    for (i = pos; i < listPtr->numSelRanges; i++) {
+	listPtr->selRanges[i].first += offset;
+	listPtr->selRanges[i].last += offset;
+    }
+
+    /*
+     * Join ranges that became adjacent after a deletion.
+     */
+
+    if ((pos > 0) && (pos < listPtr->numSelRanges)
+	    && (listPtr->selRanges[pos - 1].last + 1
+		>= listPtr->selRanges[pos].first)) {
+	listPtr->selRanges[pos - 1].last = listPtr->selRanges[pos].last;
+	SelRangeSplice(listPtr, pos, 1, NULL, 0);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
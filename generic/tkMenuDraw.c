@@ -631,12 +631,14 @@ DisplayMenu(
     int width;
     int borderWidth;
     Tk_3DBorder border;
+    Tcl_WideInt perfStart;
 
 
     menuPtr->menuFlags &= ~REDRAW_PENDING;
     if ((menuPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     Tk_GetPixelsFromObj(NULL, menuPtr->tkwin, menuPtr->borderWidthObj,
 	    &borderWidth);
@@ -742,6 +744,7 @@ DisplayMenu(
     Tk_Draw3DRectangle(menuPtr->tkwin, Tk_WindowId(tkwin),
 	    border, 0, 0, Tk_Width(tkwin), Tk_Height(tkwin), borderWidth,
 	    menuPtr->relief);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
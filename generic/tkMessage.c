@@ -664,6 +664,7 @@ DisplayMessage(
     int x, y;
     int width, borderWidth, highlightWidth, padX, padY;
     Tk_FontMetrics fm;
+    Tcl_WideInt perfStart;
 
     Tk_GetPixelsFromObj(NULL, msgPtr->tkwin, msgPtr->borderWidthObj, &borderWidth);
     Tk_GetPixelsFromObj(NULL, msgPtr->tkwin, msgPtr->highlightWidthObj, &highlightWidth);
@@ -684,6 +685,7 @@ DisplayMessage(
     if ((msgPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
     if (msgPtr->border != NULL) {
 	width += borderWidth;
     }
@@ -726,6 +728,7 @@ DisplayMessage(
 		    Tk_WindowId(tkwin));
 	}
     }
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -174,8 +174,48 @@ typedef struct StackLevel {
 				 * stack corresponding to this level (used to
 				 * restore "numUsed" fields when popping out
 				 * of a level. */
+    int signature;		/* Identifies the contents of the stacks up
+				 * to and including this level; see below. */
 } StackLevel;
 
+/*
+ * The contents of the stacks for a window only depend on its main window,
+ * on the contents of the stacks for its parent, on its class and, if some
+ * option in the database mentions it, on its name. Each distinct combination
+ * of these is given a small integer signature, and the results of
+ * Tk_GetOption are memoized by signature and option name and class. Sibling
+ * widgets of the same class that the database doesn't single out by name
+ * share a signature, so creating many of them only probes the stacks for the
+ * first one.
+ */
+
+typedef struct {
+    TkMainInfo *mainPtr;	/* Main window the stacks were built for. */
+    Tk_Uid classUid;		/* Class of the window. */
+    Tk_Uid nameUid;		/* Name of the window, or NULL if no option in
+				 * the database refers to it. */
+    int parent;			/* Signature of the parent, or 0 for a main
+				 * window. */
+    int leaf;			/* The leaf argument of SetupStacks: exact
+				 * leaf elements are only on the stacks of
+				 * windows set up as leaves. */
+} SignatureKey;
+
+typedef struct {
+    int signature;		/* Signature of the stacks that were probed. */
+    int unused;			/* Keeps the size a multiple of int. */
+    Tk_Uid nameUid;		/* Name of the option. */
+    Tk_Uid classUid;		/* Class of the option, or NULL. */
+} MatchKey;
+
+/*
+ * Upper bound on the number of memoized option values, so that an
+ * application cycling through many distinct windows doesn't make the memo
+ * grow without limit. The memo is simply emptied when it is reached.
+ */
+
+#define MAX_MATCHES 4096
+
 typedef struct {
     bool initialized;		/* 0 means the ThreadSpecific Data structure
 				 * for the current thread needs to be
@@ -204,6 +244,11 @@ typedef struct {
 				 * priority level. */
     Element defaultMatch;	/* Special "no match" Element to use as
 				 * default for searches.*/
+    Tcl_HashTable signatureTable;
+				/* Maps SignatureKeys to the signatures given
+				 * out so far. */
+    Tcl_HashTable matchTable;	/* Maps MatchKeys to the value Tk_GetOption
+				 * returned for them. */
 } ThreadSpecificData;
 static Tcl_ThreadDataKey dataKey;
 
@@ -216,6 +261,7 @@ static int		AddFromString(Tcl_Interp *interp, Tk_Window tkwin,
 static void		ClearOptionTree(ElArray *arrayPtr);
 static ElArray *	ExtendArray(ElArray *arrayPtr, Element *elPtr);
 static void		ExtendStacks(ElArray *arrayPtr, int leaf);
+static void		FlushMatches(ThreadSpecificData *tsdPtr, int all);
 static int		GetDefaultOptions(Tcl_Interp *interp,
 			    TkWindow *winPtr);
 static ElArray *	NewArray(int numEls);
@@ -270,6 +316,7 @@ Tk_AddOption(
 	OptionInit(winPtr->mainPtr);
     }
     tsdPtr->cachedWindow = NULL;/* Invalidate the cache. */
+    FlushMatches(tsdPtr, 1);
 
     /*
      * Compute the priority for the new element, including both the overall
@@ -408,9 +455,11 @@ Tk_GetOption(
     Tk_Uid nameId, classId = NULL;
     const char *masqName;
     Element *elPtr, *bestPtr;
-    int count;
+    int count, isNew;
     StackLevel *levelPtr;
     int stackDepth[NUM_STACKS];
+    MatchKey key;
+    Tcl_HashEntry *hPtr = NULL;
     ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
 	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
 
@@ -444,6 +493,9 @@ Tk_GetOption(
      * have the information we need).
      */
 
+    if (className != NULL) {
+	classId = Tk_GetUid(className);
+    }
     masqName = strchr(name, (int)'.');
     if (masqName != NULL) {
 	/*
@@ -460,11 +512,24 @@ Tk_GetOption(
 	}
     } else {
 	/*
-	 * No option masquerading here. Just use the current level to get the
-	 * stack depths.
+	 * No option masquerading here, so the result only depends on the
+	 * signature of the stacks: see if it is known already. Otherwise
+	 * just use the current level to get the stack depths.
 	 */
 
 	nameId = Tk_GetUid(name);
+	memset(&key, 0, sizeof(key));
+	key.signature = tsdPtr->levels[tsdPtr->curLevel].signature;
+	key.nameUid = nameId;
+	key.classUid = classId;
+	if (tsdPtr->matchTable.numEntries >= MAX_MATCHES) {
+	    FlushMatches(tsdPtr, 0);
+	}
+	hPtr = Tcl_CreateHashEntry(&tsdPtr->matchTable, (char *) &key,
+		&isNew);
+	if (!isNew) {
+	    return (Tk_Uid) Tcl_GetHashValue(hPtr);
+	}
 	for (count = 0; count < NUM_STACKS; count++) {
 	    stackDepth[count] = tsdPtr->stacks[count]->numUsed;
 	}
@@ -492,7 +557,6 @@ Tk_GetOption(
     }
 
     if (className != NULL) {
-	classId = Tk_GetUid(className);
 	for (elPtr = tsdPtr->stacks[EXACT_LEAF_CLASS]->els,
 		count = stackDepth[EXACT_LEAF_CLASS]; count > 0;
 		elPtr++, count--) {
@@ -588,6 +652,9 @@ Tk_GetOption(
 	}
     }
 
+    if (hPtr != NULL) {
+	Tcl_SetHashValue(hPtr, (void *) bestPtr->child.valueUid);
+    }
     return bestPtr->child.valueUid;
 }
 
@@ -672,6 +739,7 @@ Tk_OptionObjCmd(
 	    mainPtr->optionRootPtr = NULL;
 	}
 	tsdPtr->cachedWindow = NULL;
+	FlushMatches(tsdPtr, 1);
 	break;
     }
 
@@ -769,6 +837,16 @@ TkOptionDeadWindow(
 	    && (winPtr->mainPtr->optionRootPtr != NULL)) {
 	ClearOptionTree(winPtr->mainPtr->optionRootPtr);
 	winPtr->mainPtr->optionRootPtr = NULL;
+
+	/*
+	 * The TkMainInfo may be reused for another main window, so forget
+	 * the signatures that refer to it as well.
+	 */
+
+	if (tsdPtr->initialized) {
+	    tsdPtr->cachedWindow = NULL;
+	    FlushMatches(tsdPtr, 1);
+	}
     }
 }
 
@@ -1224,10 +1302,13 @@ SetupStacks(
 				 * being probed. Zero means this is an
 				 * ancestor of the desired leaf. */
 {
-    int level, i;
+    int level, i, isNew;
+    int nameMatched = 0;
     const int *iPtr;
     StackLevel *levelPtr;
     ElArray *arrayPtr;
+    SignatureKey key;
+    Tcl_HashEntry *hPtr;
     ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
 	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
 
@@ -1358,9 +1439,31 @@ SetupStacks(
 	    if (elPtr->nameUid != id) {
 		continue;
 	    }
+	    if (!(i & CLASS)) {
+		nameMatched = 1;
+	    }
 	    ExtendStacks(elPtr->child.arrayPtr, leaf);
 	}
     }
+
+    /*
+     * Step 6: look up the signature of the new stack level, giving out a new
+     * one if this combination hasn't been seen before.
+     */
+
+    memset(&key, 0, sizeof(key));
+    key.mainPtr = winPtr->mainPtr;
+    key.classUid = winPtr->classUid;
+    key.nameUid = nameMatched ? winPtr->nameUid : NULL;
+    key.parent = (tsdPtr->curLevel > 1) ? levelPtr[-1].signature : 0;
+    key.leaf = leaf;
+    hPtr = Tcl_CreateHashEntry(&tsdPtr->signatureTable, (char *) &key,
+	    &isNew);
+    if (isNew) {
+	Tcl_SetHashValue(hPtr,
+		INT2PTR(tsdPtr->signatureTable.numEntries));
+    }
+    levelPtr->signature = PTR2INT(Tcl_GetHashValue(hPtr));
     tsdPtr->cachedWindow = winPtr;
 }
 
@@ -1402,6 +1505,43 @@ ExtendStacks(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FlushMatches --
+ *
+ *	Forget all the option values memoized by Tk_GetOption and, optionally,
+ *	the stack signatures. The latter must be done whenever the option
+ *	database changes, after invalidating the stacks: which window names
+ *	are relevant may have changed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The match table, and if all is non-zero the signature table, are
+ *	emptied.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FlushMatches(
+    ThreadSpecificData *tsdPtr,	/* Thread data holding the matches. */
+    int all)			/* Non-zero means forget the signatures
+				 * too. */
+{
+    if (tsdPtr->matchTable.numEntries > 0) {
+	Tcl_DeleteHashTable(&tsdPtr->matchTable);
+	Tcl_InitHashTable(&tsdPtr->matchTable, sizeof(MatchKey) / sizeof(int));
+    }
+    if (all && (tsdPtr->signatureTable.numEntries > 0)) {
+	Tcl_DeleteHashTable(&tsdPtr->signatureTable);
+	Tcl_InitHashTable(&tsdPtr->signatureTable,
+		sizeof(SignatureKey) / sizeof(int));
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -1432,6 +1572,8 @@ OptionThreadExitProc(
 	    Tcl_Free(tsdPtr->stacks[i]);
 	}
 	Tcl_Free(tsdPtr->levels);
+	Tcl_DeleteHashTable(&tsdPtr->signatureTable);
+	Tcl_DeleteHashTable(&tsdPtr->matchTable);
 	tsdPtr->initialized = false;
     }
 }
@@ -1485,6 +1627,9 @@ OptionInit(
 	defaultMatchPtr->child.valueUid = NULL;
 	defaultMatchPtr->priority = -1;
 	defaultMatchPtr->flags = 0;
+	Tcl_InitHashTable(&tsdPtr->signatureTable,
+		sizeof(SignatureKey) / sizeof(int));
+	Tcl_InitHashTable(&tsdPtr->matchTable, sizeof(MatchKey) / sizeof(int));
 	Tcl_CreateThreadExitHandler(OptionThreadExitProc, NULL);
     }
 
@@ -69,9 +69,9 @@ typedef struct Packer {
 /*
  * Flag values for Packer structures:
  *
- * REQUESTED_REPACK:		1 means a Tcl_DoWhenIdle request has already
- *				been made to repack all the content of this
- *				window.
+ * REQUESTED_REPACK:		1 means a TkScheduleArrange request has
+ *				already been made to repack all the content of
+ *				this window.
  * FILLX:			1 means if frame allocated for window is wider
  *				than window needs, expand window to fill
  *				frame. 0 means don't make window any larger
@@ -363,7 +363,8 @@ Tk_PackObjCmd(
 	    }
 	    if (!(containerPtr->flags & REQUESTED_REPACK)) {
 		containerPtr->flags |= REQUESTED_REPACK;
-		Tcl_DoWhenIdle(ArrangePacking, containerPtr);
+		TkScheduleArrange(containerPtr->tkwin, ArrangePacking,
+			containerPtr);
 	    }
 	} else {
 	    if (containerPtr->flags & ALLOCED_CONTAINER) {
@@ -434,7 +435,7 @@ PackReqProc(
     packPtr = packPtr->containerPtr;
     if (!(packPtr->flags & REQUESTED_REPACK)) {
 	packPtr->flags |= REQUESTED_REPACK;
-	Tcl_DoWhenIdle(ArrangePacking, packPtr);
+	TkScheduleArrange(packPtr->tkwin, ArrangePacking, packPtr);
     }
 }
 
@@ -475,7 +476,7 @@ PackLostContentProc(
  *
  * ArrangePacking --
  *
- *	This function is invoked (using the Tcl_DoWhenIdle mechanism) to
+ *	This function is invoked (using the TkScheduleArrange mechanism) to
  *	re-layout a set of windows managed by the packer. It is invoked at
  *	idle time so that a series of packer requests can be merged into a
  *	single layout operation.
@@ -511,6 +512,7 @@ ArrangePacking(
     int borderTop, borderBtm;
     int borderLeft, borderRight;
     int maxWidth, maxHeight, tmp;
+    Tcl_WideInt perfStart;
 
     containerPtr->flags &= ~REQUESTED_REPACK;
 
@@ -530,6 +532,7 @@ ArrangePacking(
      * necessary.
      */
 
+    perfStart = TkPerfStart();
     if (containerPtr->abortPtr != NULL) {
 	*containerPtr->abortPtr = 1;
     }
@@ -604,7 +607,7 @@ ArrangePacking(
 	    && !(containerPtr->flags & DONT_PROPAGATE)) {
 	Tk_GeometryRequest(containerPtr->tkwin, maxWidth, maxHeight);
 	containerPtr->flags |= REQUESTED_REPACK;
-	Tcl_DoWhenIdle(ArrangePacking, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, ArrangePacking, containerPtr);
 	goto done;
     }
 
@@ -794,6 +797,7 @@ ArrangePacking(
   done:
     containerPtr->abortPtr = NULL;
     Tcl_Release(containerPtr);
+    TkPerfStop(TK_PERF_PACK, perfStart);
 }
 
 /*
@@ -1030,7 +1034,7 @@ Unlink(
     }
     if (!(containerPtr->flags & REQUESTED_REPACK)) {
 	containerPtr->flags |= REQUESTED_REPACK;
-	Tcl_DoWhenIdle(ArrangePacking, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, ArrangePacking, containerPtr);
     }
     if (containerPtr->abortPtr != NULL) {
 	*containerPtr->abortPtr = 1;
@@ -1078,9 +1082,6 @@ DestroyPacker(
 {
     Packer *packPtr = (Packer *)memPtr;
 
-    if (packPtr->flags & REQUESTED_REPACK) {
-	Tcl_CancelIdleCall(ArrangePacking, packPtr);
-    }
     Tcl_Free(packPtr);
 }
 
@@ -1114,14 +1115,15 @@ PackStructureProc(
 	if ((packPtr->contentPtr != NULL)
 		&& !(packPtr->flags & REQUESTED_REPACK)) {
 	    packPtr->flags |= REQUESTED_REPACK;
-	    Tcl_DoWhenIdle(ArrangePacking, packPtr);
+	    TkScheduleArrange(packPtr->tkwin, ArrangePacking, packPtr);
 	}
 	if ((packPtr->containerPtr != NULL)
 		&& (packPtr->doubleBw != 2*Tk_Changes(packPtr->tkwin)->border_width)) {
 	    if (!(packPtr->containerPtr->flags & REQUESTED_REPACK)) {
 		packPtr->doubleBw = 2*Tk_Changes(packPtr->tkwin)->border_width;
 		packPtr->containerPtr->flags |= REQUESTED_REPACK;
-		Tcl_DoWhenIdle(ArrangePacking, packPtr->containerPtr);
+		TkScheduleArrange(packPtr->containerPtr->tkwin, ArrangePacking,
+			packPtr->containerPtr);
 	    }
 	}
     } else if (eventPtr->type == DestroyNotify) {
@@ -1147,7 +1149,8 @@ PackStructureProc(
 	}
 
 	if (packPtr->flags & REQUESTED_REPACK) {
-	    Tcl_CancelIdleCall(ArrangePacking, packPtr);
+	    TkCancelArrange(packPtr->tkwin, ArrangePacking, packPtr);
+	    packPtr->flags &= ~REQUESTED_REPACK;
 	}
 	packPtr->tkwin = NULL;
 	Tcl_EventuallyFree(packPtr, DestroyPacker);
@@ -1160,7 +1163,7 @@ PackStructureProc(
 	if ((packPtr->contentPtr != NULL)
 		&& !(packPtr->flags & REQUESTED_REPACK)) {
 	    packPtr->flags |= REQUESTED_REPACK;
-	    Tcl_DoWhenIdle(ArrangePacking, packPtr);
+	    TkScheduleArrange(packPtr->tkwin, ArrangePacking, packPtr);
 	}
     } else if (eventPtr->type == UnmapNotify) {
 	Packer *packPtr2;
@@ -1562,7 +1565,8 @@ ConfigureContent(
 	}
 	if (!(containerPtr->flags & REQUESTED_REPACK)) {
 	    containerPtr->flags |= REQUESTED_REPACK;
-	    Tcl_DoWhenIdle(ArrangePacking, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, ArrangePacking,
+		    containerPtr);
 	}
     }
     return TCL_OK;
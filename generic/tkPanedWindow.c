@@ -1451,11 +1451,13 @@ DisplayPanedWindow(
     int first, last;
     int borderWidth;
     Tcl_Size i;
+    Tcl_WideInt perfStart;
 
     pwPtr->flags &= ~REDRAW_PENDING;
     if ((pwPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     if (pwPtr->flags & REQUESTED_RELAYOUT) {
 	ArrangePanes(clientData);
@@ -1466,8 +1468,7 @@ DisplayPanedWindow(
      * Create a pixmap for double-buffering, if necessary.
      */
 
-    pixmap = Tk_GetPixmap(Tk_Display(tkwin), Tk_WindowId(tkwin),
-	    Tk_Width(tkwin), Tk_Height(tkwin), Tk_Depth(tkwin));
+    pixmap = TkGetBufferPixmap(tkwin, Tk_Width(tkwin), Tk_Height(tkwin));
 #else
     pixmap = Tk_WindowId(tkwin);
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -1527,8 +1528,9 @@ DisplayPanedWindow(
 
     XCopyArea(Tk_Display(tkwin), pixmap, Tk_WindowId(tkwin), pwPtr->gc, 0, 0,
 	    (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin), 0, 0);
-    Tk_FreePixmap(Tk_Display(tkwin), pixmap);
+    TkFreeBufferPixmap(Tk_Display(tkwin), pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -2847,8 +2849,7 @@ DisplayProxyWindow(
      * Create a pixmap for double-buffering, if necessary.
      */
 
-    pixmap = Tk_GetPixmap(Tk_Display(tkwin), Tk_WindowId(tkwin),
-	    Tk_Width(tkwin), Tk_Height(tkwin), Tk_Depth(tkwin));
+    pixmap = TkGetBufferPixmap(tkwin, Tk_Width(tkwin), Tk_Height(tkwin));
 #else
     pixmap = Tk_WindowId(tkwin);
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -2870,7 +2871,7 @@ DisplayProxyWindow(
 
     XCopyArea(Tk_Display(tkwin), pixmap, Tk_WindowId(tkwin), pwPtr->gc, 0, 0,
 	    (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin), 0, 0);
-    Tk_FreePixmap(Tk_Display(tkwin), pixmap);
+    TkFreeBufferPixmap(Tk_Display(tkwin), pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
 }
 
@@ -128,7 +128,7 @@ typedef struct Container {
  * Flag definitions for containers:
  *
  * PARENT_RECONFIG_PENDING -	1 means that a call to RecomputePlacement is
- *				already pending via a Do_When_Idle handler.
+ *				already pending via TkScheduleArrange.
  */
 
 #define PARENT_RECONFIG_PENDING	1
@@ -426,7 +426,8 @@ FreeContent(
     Content *contentPtr)
 {
     if (contentPtr->containerPtr && (contentPtr->containerPtr->flags & PARENT_RECONFIG_PENDING)) {
-	Tcl_CancelIdleCall(RecomputePlacement, contentPtr->containerPtr);
+	TkCancelArrange(contentPtr->containerPtr->tkwin, RecomputePlacement,
+		contentPtr->containerPtr);
     }
     Tk_FreeConfigOptions(contentPtr, contentPtr->optionTable,
 	    contentPtr->tkwin);
@@ -741,7 +742,8 @@ ConfigureContent(
 
     if (!(containerPtr->flags & PARENT_RECONFIG_PENDING)) {
 	containerPtr->flags |= PARENT_RECONFIG_PENDING;
-	Tcl_DoWhenIdle(RecomputePlacement, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, RecomputePlacement,
+		containerPtr);
     }
     return TCL_OK;
 
@@ -838,8 +840,8 @@ PlaceInfoCommand(
  *
  * RecomputePlacement --
  *
- *	This function is called as a when-idle handler. It recomputes the
- *	geometries of all the content of a given container.
+ *	This function is called at idle time through TkScheduleArrange. It
+ *	recomputes the geometries of all the content of a given container.
  *
  * Results:
  *	None.
@@ -1084,7 +1086,8 @@ PlaceStructureProc(
 	if ((containerPtr->contentPtr != NULL)
 		&& !(containerPtr->flags & PARENT_RECONFIG_PENDING)) {
 	    containerPtr->flags |= PARENT_RECONFIG_PENDING;
-	    Tcl_DoWhenIdle(RecomputePlacement, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, RecomputePlacement,
+		    containerPtr);
 	}
 	return;
     case DestroyNotify:
@@ -1097,7 +1100,9 @@ PlaceStructureProc(
 	Tcl_DeleteHashEntry(Tcl_FindHashEntry(&dispPtr->containerTable,
 		containerPtr->tkwin));
 	if (containerPtr->flags & PARENT_RECONFIG_PENDING) {
-	    Tcl_CancelIdleCall(RecomputePlacement, containerPtr);
+	    TkCancelArrange(containerPtr->tkwin, RecomputePlacement,
+		    containerPtr);
+	    containerPtr->flags &= ~PARENT_RECONFIG_PENDING;
 	}
 	containerPtr->tkwin = NULL;
 	if (containerPtr->abortPtr != NULL) {
@@ -1114,7 +1119,8 @@ PlaceStructureProc(
 	if ((containerPtr->contentPtr != NULL)
 		&& !(containerPtr->flags & PARENT_RECONFIG_PENDING)) {
 	    containerPtr->flags |= PARENT_RECONFIG_PENDING;
-	    Tcl_DoWhenIdle(RecomputePlacement, containerPtr);
+	    TkScheduleArrange(containerPtr->tkwin, RecomputePlacement,
+		    containerPtr);
 	}
 	return;
     case UnmapNotify:
@@ -1209,7 +1215,8 @@ PlaceRequestProc(
     }
     if (!(containerPtr->flags & PARENT_RECONFIG_PENDING)) {
 	containerPtr->flags |= PARENT_RECONFIG_PENDING;
-	Tcl_DoWhenIdle(RecomputePlacement, containerPtr);
+	TkScheduleArrange(containerPtr->tkwin, RecomputePlacement,
+		containerPtr);
     }
 }
 
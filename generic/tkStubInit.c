@@ -399,6 +399,10 @@ static const TkIntStubs tkIntStubs = {
     0, /* 185 */
     0, /* 186 */
     TkDebugPhotoStringMatchDef, /* 187 */
+    TkDebugPhotoKernel, /* 188 */
+    TkGifReadFrames, /* 189 */
+    TkDebugSVGRasterize, /* 190 */
+    TkSetOptionsForRecords, /* 191 */
 };
 
 static const TkIntPlatStubs tkIntPlatStubs = {
@@ -152,9 +152,11 @@ typedef struct TrivialCommandHeader {
  */
 
 static Tcl_ObjCmdProc2 ImageObjCmd;
+static Tcl_ObjCmdProc2 TestarrangeObjCmd;
 static Tcl_ObjCmdProc2 TestbitmapObjCmd;
 static Tcl_ObjCmdProc2 TestborderObjCmd;
 static Tcl_ObjCmdProc2 TestcolorObjCmd;
+static Tcl_ObjCmdProc2 TestconfigrecordsObjCmd;
 static Tcl_ObjCmdProc2 TestcursorObjCmd;
 static Tcl_ObjCmdProc2 TestdeleteappsObjCmd;
 static Tcl_ObjCmdProc2 TestfontObjCmd;
@@ -166,6 +168,7 @@ static Tcl_ObjCmdProc2 TestmenubarObjCmd;
 static Tcl_ObjCmdProc2 TestmetricsObjCmd;
 #endif
 static Tcl_ObjCmdProc2 TestobjconfigObjCmd;
+static Tcl_ObjCmdProc2 TestperfObjCmd;
 static Tcl_ObjCmdProc2 TestpixelObjCmd;
 static Tk_CustomOptionSetProc CustomOptionSet;
 static Tk_CustomOptionGetProc CustomOptionGet;
@@ -181,6 +184,9 @@ static Tcl_ObjCmdProc2 TrivialConfigObjCmd;
 static void		TrivialEventProc(void *clientData,
 			    XEvent *eventPtr);
 static Tcl_ObjCmdProc2 TestPhotoStringMatchCmd;
+static Tcl_ObjCmdProc2 TestPhotoKernelCmd;
+static Tcl_ObjCmdProc2 TestGifFramesCmd;
+static Tcl_ObjCmdProc2 TestSVGRasterizeCmd;
 
 /*
  *----------------------------------------------------------------------
@@ -221,6 +227,8 @@ Tktest_Init(
     }
 
     Tcl_CreateObjCommand2(interp, "square", SquareObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand2(interp, "testarrange", TestarrangeObjCmd,
+	    Tk_MainWindow(interp), NULL);
     Tcl_CreateObjCommand2(interp, "testbitmap", TestbitmapObjCmd,
 	    Tk_MainWindow(interp), NULL);
     Tcl_CreateObjCommand2(interp, "testborder", TestborderObjCmd,
@@ -249,6 +257,16 @@ Tktest_Init(
     Tcl_CreateObjCommand2(interp, "testphotostringmatch",
 	    TestPhotoStringMatchCmd, Tk_MainWindow(interp),
 	    NULL);
+    Tcl_CreateObjCommand2(interp, "testphotokernel", TestPhotoKernelCmd,
+	    NULL, NULL);
+    Tcl_CreateObjCommand2(interp, "testgifframes", TestGifFramesCmd,
+	    NULL, NULL);
+    Tcl_CreateObjCommand2(interp, "testsvgrasterize", TestSVGRasterizeCmd,
+	    NULL, NULL);
+    Tcl_CreateObjCommand2(interp, "testconfigrecords",
+	    TestconfigrecordsObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand2(interp, "testperf", TestperfObjCmd,
+	    Tk_MainWindow(interp), NULL);
 
 #if defined(_WIN32)
     Tcl_CreateObjCommand2(interp, "testmetrics", TestmetricsObjCmd,
@@ -278,6 +296,65 @@ Tktest_Init(
     return TkplatformtestInit(interp);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestarrangeObjCmd --
+ *
+ *	This function implements the "testarrange" command, which returns
+ *	statistics about how geometry managers lay out containers through
+ *	TkScheduleArrange:
+ *
+ *	    testarrange ?window?
+ *
+ * Results:
+ *	A standard Tcl result. The result is a dictionary with the number of
+ *	arrange calls made for the display of window (the main window by
+ *	default), the number of times everything was laid out, and the number
+ *	of arrange calls made the last of those times.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TestarrangeObjCmd(
+    void *clientData,		/* Main window for application. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument strings. */
+{
+    Tk_Window tkwin = (Tk_Window)clientData;
+    TkDisplay *dispPtr;
+    Tcl_Obj *resultObj;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?window?");
+	return TCL_ERROR;
+    }
+    if (objc == 2) {
+	tkwin = Tk_NameToWindow(interp, Tcl_GetString(objv[1]), tkwin);
+	if (tkwin == NULL) {
+	    return TCL_ERROR;
+	}
+    }
+    dispPtr = ((TkWindow *) tkwin)->dispPtr;
+    resultObj = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, resultObj,
+	    Tcl_NewStringObj("arranges", TCL_INDEX_NONE),
+	    Tcl_NewWideIntObj(dispPtr->arrangeCount));
+    Tcl_DictObjPut(NULL, resultObj,
+	    Tcl_NewStringObj("settles", TCL_INDEX_NONE),
+	    Tcl_NewWideIntObj(dispPtr->arrangeSettleCount));
+    Tcl_DictObjPut(NULL, resultObj,
+	    Tcl_NewStringObj("last", TCL_INDEX_NONE),
+	    Tcl_NewWideIntObj(dispPtr->lastSettleArranges));
+    Tcl_SetObjResult(interp, resultObj);
+    return TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1189,6 +1266,92 @@ TrivialConfigObjCmd(
     Tcl_Release(clientData);
     return result;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestconfigrecordsObjCmd --
+ *
+ *	This function implements the "testconfigrecords" command, which
+ *	configures several widgets created by "testobjconfig" at once with
+ *	TkSetOptionsForRecords:
+ *
+ *	    testconfigrecords widgetList ?-option value ...?
+ *
+ *	All widgets must share the same option table.
+ *
+ * Results:
+ *	A standard Tcl result. The result is the mask of the options that
+ *	were set.
+ *
+ * Side effects:
+ *	The widgets are reconfigured, either all of them or none.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TestconfigrecordsObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Tcl_Size i, numRecords;
+    Tcl_Obj **nameObjs;
+    void **recordPtrs;
+    Tk_Window *tkwins;
+    Tk_OptionTable optionTable = NULL;
+    Tcl_CmdInfo info;
+    int mask = 0, result = TCL_ERROR;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "widgetList ?-option value ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_ListObjGetElements(interp, objv[1], &numRecords,
+	    &nameObjs) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    recordPtrs = (void **)Tcl_Alloc((numRecords + 1) * sizeof(void *));
+    tkwins = (Tk_Window *)Tcl_Alloc((numRecords + 1) * sizeof(Tk_Window));
+    for (i = 0; i < numRecords; i++) {
+	TrivialCommandHeader *headerPtr;
+
+	if (!Tcl_GetCommandInfo(interp, Tcl_GetString(nameObjs[i]), &info)
+		|| info.objProc2 != TrivialConfigObjCmd) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "\"%s\" is not a testobjconfig widget",
+		    Tcl_GetString(nameObjs[i])));
+	    goto done;
+	}
+	headerPtr = (TrivialCommandHeader *)info.objClientData2;
+	if (i == 0) {
+	    optionTable = headerPtr->optionTable;
+	} else if (headerPtr->optionTable != optionTable) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "\"%s\" has a different option table",
+		    Tcl_GetString(nameObjs[i])));
+	    goto done;
+	}
+	recordPtrs[i] = headerPtr;
+	tkwins[i] = headerPtr->tkwin;
+    }
+    if (numRecords > 0) {
+	result = TkSetOptionsForRecords(interp, numRecords, recordPtrs,
+		tkwins, optionTable, objc - 2, objv + 2, &mask);
+	if (result == TCL_OK) {
+	    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(mask));
+	}
+    } else {
+	result = TCL_OK;
+    }
+
+  done:
+    Tcl_Free(tkwins);
+    Tcl_Free(recordPtrs);
+    return result;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -2008,7 +2171,7 @@ static int
 CustomOptionSet(
     TCL_UNUSED(void *),
     Tcl_Interp *interp,
-    TCL_UNUSED(Tk_Window),
+    Tk_Window tkwin,
     Tcl_Obj **value,
     char *recordPtr,
     Tcl_Size internalOffset,
@@ -2043,7 +2206,18 @@ CustomOptionSet(
     if ((flags & TK_OPTION_NULL_OK) && objEmpty) {
 	*value = NULL;
     } else {
+	/*
+	 * A value naming the window itself is rejected, so that tests can
+	 * make a value fail for one record and not for another.
+	 */
+
 	string = Tcl_GetString(*value);
+	if ((tkwin != NULL) && (strcmp(string, Tk_PathName(tkwin)) == 0)) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "expected good value, got the window's own name \"%s\"",
+		    string));
+	    return TCL_ERROR;
+	}
 	Tcl_UtfToUpper(string);
 	if (strcmp(string, "BAD") == 0) {
 	    Tcl_SetObjResult(interp, Tcl_NewStringObj("expected good value, got \"BAD\"", TCL_INDEX_NONE));
@@ -2142,6 +2316,408 @@ TestPhotoStringMatchCmd(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestPhotoKernelCmd --
+ *
+ *	This function implements the "testphotokernel" command, a
+ *	microbenchmark for the row kernels photo images use on TrueColor
+ *	displays:
+ *
+ *	    testphotokernel kernel operation count ?iterations? ?shifts?
+ *
+ *	kernel is "scalar", "sse2", "avx2" or "" for the one normally used,
+ *	operation is "convert" or "blend", and shifts is a list of the red,
+ *	green and blue field positions (default {16 8 0}).
+ *
+ * Results:
+ *	A standard Tcl result. The result is a list of the kernel name, the
+ *	time taken in microseconds and a checksum of the output; kernels that
+ *	agree produce the same checksum.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TestPhotoKernelCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument strings. */
+{
+    Tcl_Size count, shiftc;
+    Tcl_Obj **shiftv;
+    int iterations = 1, shifts[3] = {16, 8, 0}, i;
+
+    if (objc < 4 || objc > 6) {
+	Tcl_WrongNumArgs(interp, 1, objv,
+		"kernel operation count ?iterations? ?shifts?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetSizeIntFromObj(interp, objv[3], &count) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (objc > 4 && Tcl_GetIntFromObj(interp, objv[4], &iterations) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (objc > 5) {
+	if (Tcl_ListObjGetElements(interp, objv[5], &shiftc, &shiftv)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (shiftc != 3) {
+	    Tcl_AppendResult(interp, "shifts must be a list of 3 integers",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+	for (i = 0; i < 3; i++) {
+	    if (Tcl_GetIntFromObj(interp, shiftv[i], &shifts[i]) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	}
+    }
+    return TkDebugPhotoKernel(interp, Tcl_GetString(objv[1]),
+	    Tcl_GetString(objv[2]), count, iterations,
+	    shifts[0], shifts[1], shifts[2]);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestGifFramesCmd --
+ *
+ *	This function implements the "testgifframes" command, which decodes
+ *	all the frames of a GIF image with TkGifReadFrames:
+ *
+ *	    testgifframes data ?prefix?
+ *
+ *	If prefix is given, frame n is put in a new photo image named prefixn.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a list with, for each frame, a
+ *	list of its left and top position, width, height and metadata.
+ *
+ * Side effects:
+ *	Photo images may be created.
+ *
+ *----------------------------------------------------------------------
+ */
+
+typedef struct {
+    Tcl_Interp *interp;
+    const char *prefix;		/* Prefix of the images to create, or
+				 * NULL. */
+    Tcl_Obj *resultObj;		/* List of the frames. */
+} GifFramesInfo;
+
+static int
+GifFrameProc(
+    void *clientData,
+    int frameNum,
+    int left,
+    int top,
+    Tk_PhotoImageBlock *blockPtr,
+    Tcl_Obj *metadataObj)
+{
+    GifFramesInfo *infoPtr = (GifFramesInfo *)clientData;
+    Tcl_Obj *frameObj[5];
+
+    if (infoPtr->prefix != NULL) {
+	Tk_PhotoHandle photo;
+
+	if (Tcl_EvalObjEx(infoPtr->interp, Tcl_ObjPrintf(
+		"image create photo %s%d", infoPtr->prefix, frameNum), 0)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	photo = Tk_FindPhoto(infoPtr->interp,
+		Tcl_GetString(Tcl_GetObjResult(infoPtr->interp)));
+	if (photo == NULL) {
+	    return TCL_ERROR;
+	}
+	if (Tk_PhotoPutBlock(infoPtr->interp, photo, blockPtr, 0, 0,
+		blockPtr->width, blockPtr->height, TK_PHOTO_COMPOSITE_SET)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    frameObj[0] = Tcl_NewWideIntObj(left);
+    frameObj[1] = Tcl_NewWideIntObj(top);
+    frameObj[2] = Tcl_NewWideIntObj(blockPtr->width);
+    frameObj[3] = Tcl_NewWideIntObj(blockPtr->height);
+    frameObj[4] = metadataObj;
+    Tcl_ListObjAppendElement(NULL, infoPtr->resultObj,
+	    Tcl_NewListObj(5, frameObj));
+    return TCL_OK;
+}
+
+static int
+TestGifFramesCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument strings. */
+{
+    GifFramesInfo info;
+
+    if (objc < 2 || objc > 3) {
+	Tcl_WrongNumArgs(interp, 1, objv, "data ?prefix?");
+	return TCL_ERROR;
+    }
+    info.interp = interp;
+    info.prefix = (objc > 2) ? Tcl_GetString(objv[2]) : NULL;
+    info.resultObj = Tcl_NewObj();
+    Tcl_IncrRefCount(info.resultObj);
+    if (TkGifReadFrames(interp, objv[1], GifFrameProc, &info) != TCL_OK) {
+	Tcl_DecrRefCount(info.resultObj);
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, info.resultObj);
+    Tcl_DecrRefCount(info.resultObj);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestSVGRasterizeCmd --
+ *
+ *	This function implements the "testsvgrasterize" command, which
+ *	rasterizes SVG data with TkDebugSVGRasterize:
+ *
+ *	    testsvgrasterize data scale bands
+ *
+ *	With bands 0 the image is rasterized in one piece, otherwise in that
+ *	many bands of rows.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a byte array with the RGBA
+ *	pixels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TestSVGRasterizeCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument strings. */
+{
+    double scale;
+    int bands;
+
+    if (objc != 4) {
+	Tcl_WrongNumArgs(interp, 1, objv, "data scale bands");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetDoubleFromObj(interp, objv[2], &scale) != TCL_OK
+	    || Tcl_GetIntFromObj(interp, objv[3], &bands) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    return TkDebugSVGRasterize(interp, objv[1], scale, bands);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerfDrain --
+ *
+ *	Wait until the display server has caught up with all requests and
+ *	then process every pending event, including idle handlers, so that
+ *	the work triggered by an operation is included in its timing.
+ *
+ * Results:
+ *	The number of events and idle handlers that were processed.
+ *
+ * Side effects:
+ *	Arbitrary, depending on the events that are processed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_WideInt
+PerfDrain(
+    Display *display)		/* Display to synchronize with. */
+{
+    Tcl_WideInt total = 0;
+    int count;
+
+    do {
+	XSync(display, False);
+	count = 0;
+	while (Tcl_DoOneEvent(TCL_ALL_EVENTS | TCL_DONT_WAIT)) {
+	    count++;
+	}
+	total += count;
+    } while (count > 0);
+    return total;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerfExpose --
+ *
+ *	Pretend that the server exposed a window and all its mapped
+ *	descendants that are not toplevels.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The windows schedule a full redisplay.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PerfExpose(
+    TkWindow *winPtr)		/* Root of the tree to expose. */
+{
+    TkWindow *childPtr;
+    XEvent event;
+
+    if (!Tk_IsMapped(winPtr) || winPtr->window == None) {
+	return;
+    }
+    memset(&event, 0, sizeof(event));
+    event.xexpose.type = Expose;
+    event.xexpose.serial = NextRequest(winPtr->display);
+    event.xexpose.display = winPtr->display;
+    event.xexpose.window = winPtr->window;
+    event.xexpose.width = winPtr->changes.width;
+    event.xexpose.height = winPtr->changes.height;
+    Tk_HandleEvent(&event);
+    for (childPtr = winPtr->childList; childPtr != NULL;
+	    childPtr = childPtr->nextPtr) {
+	if (!Tk_TopWinHierarchy(childPtr)) {
+	    PerfExpose(childPtr);
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestperfObjCmd --
+ *
+ *	This function implements the "testperf" command, which measures how
+ *	long toolkit operations take, including the redisplay and other idle
+ *	work they cause:
+ *
+ *	    testperf time count script
+ *	    testperf redraw window count
+ *
+ *	"time" evaluates the script count times; "redraw" exposes the window
+ *	and all its descendants count times. After each iteration the display
+ *	is synchronized and all pending events are processed before the clock
+ *	is stopped.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a dictionary with the number of
+ *	iterations (count), the total, minimum and maximum time in
+ *	microseconds (usec, min, max), the number of display requests issued
+ *	(requests) and the number of events processed (events).
+ *
+ * Side effects:
+ *	Whatever the script does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TestperfObjCmd(
+    void *clientData,		/* Main window for application. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const options[] = {
+	"redraw", "time", NULL
+    };
+    enum {
+	PERF_REDRAW, PERF_TIME
+    };
+    Tk_Window tkwin = (Tk_Window)clientData;
+    Display *display;
+    Tcl_Obj *scriptObj = NULL, *resultObj;
+    Tcl_Time start, stop;
+    Tcl_WideInt usec, total = 0, min = 0, max = 0, events = 0;
+    unsigned long firstRequest;
+    int index, i, count;
+
+    if (objc != 4) {
+	Tcl_WrongNumArgs(interp, 1, objv, "option arg count|script");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1], options,
+	    sizeof(char *), "option", 0, &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (index == PERF_TIME) {
+	if (Tcl_GetIntFromObj(interp, objv[2], &count) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	scriptObj = objv[3];
+    } else {
+	tkwin = Tk_NameToWindow(interp, Tcl_GetString(objv[2]), tkwin);
+	if (tkwin == NULL
+		|| Tcl_GetIntFromObj(interp, objv[3], &count) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    display = Tk_Display(tkwin);
+
+    PerfDrain(display);
+    firstRequest = NextRequest(display);
+    for (i = 0; i < count; i++) {
+	Tcl_GetTime(&start);
+	if (scriptObj != NULL) {
+	    if (Tcl_EvalObjEx(interp, scriptObj, 0) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    PerfExpose((TkWindow *)tkwin);
+	}
+	events += PerfDrain(display);
+	Tcl_GetTime(&stop);
+	usec = (Tcl_WideInt)(stop.sec - start.sec) * 1000000
+		+ (stop.usec - start.usec);
+	total += usec;
+	if (i == 0 || usec < min) {
+	    min = usec;
+	}
+	if (usec > max) {
+	    max = usec;
+	}
+    }
+
+    resultObj = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("count", -1),
+	    Tcl_NewWideIntObj(count < 0 ? 0 : count));
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("usec", -1),
+	    Tcl_NewWideIntObj(total));
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("min", -1),
+	    Tcl_NewWideIntObj(min));
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("max", -1),
+	    Tcl_NewWideIntObj(max));
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("requests", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt)
+	    (NextRequest(display) - firstRequest)));
+    Tcl_DictObjPut(NULL, resultObj, Tcl_NewStringObj("events", -1),
+	    Tcl_NewWideIntObj(events));
+    Tcl_SetObjResult(interp, resultObj);
+    return TCL_OK;
+}
+
 #ifndef MAC_OSX_TK
 /*
  *----------------------------------------------------------------------
@@ -4390,7 +4390,7 @@ DisplayText(
     Tcl_Interp *interp;
     int padX, padY;
     int borderWidth, highlightWidth;
-
+    Tcl_WideInt perfStart;
 
     if ((textPtr->tkwin == NULL) || (textPtr->flags & DESTROYED)) {
 	/*
@@ -4400,6 +4400,7 @@ DisplayText(
 	return;
     }
 
+    perfStart = TkPerfStart();
     interp = textPtr->interp;
     Tcl_Preserve(interp);
 
@@ -4687,9 +4688,8 @@ DisplayText(
 
     if (maxHeight > 0) {
 #ifndef TK_NO_DOUBLE_BUFFERING
-	pixmap = Tk_GetPixmap(Tk_Display(textPtr->tkwin),
-		Tk_WindowId(textPtr->tkwin), Tk_Width(textPtr->tkwin),
-		maxHeight, Tk_Depth(textPtr->tkwin));
+	pixmap = TkGetBufferPixmap(textPtr->tkwin, Tk_Width(textPtr->tkwin),
+		maxHeight);
 #else
 	pixmap = Tk_WindowId(textPtr->tkwin);
 #endif /* TK_NO_DOUBLE_BUFFERING */
@@ -4710,13 +4710,17 @@ DisplayText(
 		if ((textPtr->tkwin == NULL) || (textPtr->flags & DESTROYED)) {
 		    /*
 		     * DisplayDLine called a displayProc which invoked a binding
-		     * that caused the widget to be deleted. Don't do anything.
+		     * that caused the widget to be deleted. Don't do anything
+		     * but give back the pixmap, which may be shared.
 		     */
+#ifndef TK_NO_DOUBLE_BUFFERING
+		    TkFreeBufferPixmap(textPtr->display, pixmap);
+#endif /* TK_NO_DOUBLE_BUFFERING */
 		    goto end;
 		}
 		if (dInfoPtr->dLinesInvalidated) {
 #ifndef TK_NO_DOUBLE_BUFFERING
-		    Tk_FreePixmap(Tk_Display(textPtr->tkwin), pixmap);
+		    TkFreeBufferPixmap(Tk_Display(textPtr->tkwin), pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
 		    goto end;
 		}
@@ -4814,7 +4818,7 @@ DisplayText(
 	    }
 	}
 #ifndef TK_NO_DOUBLE_BUFFERING
-	Tk_FreePixmap(Tk_Display(textPtr->tkwin), pixmap);
+	TkFreeBufferPixmap(Tk_Display(textPtr->tkwin), pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
     }
 
@@ -4880,6 +4884,7 @@ DisplayText(
 
   end:
     Tcl_Release(interp);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
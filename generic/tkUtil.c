@@ -16,6 +16,8 @@
 
 #ifdef _WIN32
 #include "tkWinInt.h"
+#else
+#include <sys/mman.h>
 #endif
 
 /*
@@ -1473,6 +1475,732 @@ TkFormatDouble(
     return length;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkGetProcessorCount --
+ *
+ *	Returns the number of processors available to the process, for
+ *	sizing the worker threads used by TkRunParallel.
+ *
+ * Results:
+ *	The number of online processors, at least 1.
+ *
+ * Side effects:
+ *	The value is computed once and cached.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkGetProcessorCount(void)
+{
+    static int processorCount = 0;
+
+    if (processorCount == 0) {
+	int count = 1;
+
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	count = (int) info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	processorCount = (count < 1) ? 1 : count;
+    }
+    return processorCount;
+}
+
+/*
+ * State shared by the threads working through one TkRunParallel call.
+ */
+
+#define TK_MAX_WORKERS 16	/* Upper limit on threads per call. */
+
+typedef struct {
+    TkParallelProc *proc;	/* Function to call for each index. */
+    void *clientData;		/* First argument for proc. */
+    int count;			/* Number of indices. */
+    int next;			/* Next index to hand out; protected by
+				 * mutex. */
+    Tcl_Mutex mutex;		/* Serializes access to next. */
+} ParallelJob;
+
+/*
+ * The worker threads are started the first time TkRunParallel is called and
+ * kept until the process exits, waiting for the next job. There is one job
+ * at a time; a call made while another thread's job runs does its work
+ * alone. All fields are protected by parallelMutex.
+ */
+
+typedef struct {
+    Tcl_ThreadId threads[TK_MAX_WORKERS];
+				/* The worker threads. */
+    int numThreads;		/* Number of worker threads started. */
+    bool initialized;		/* Whether the workers were started. */
+    bool shutdown;		/* Set when the workers must exit. */
+    ParallelJob *jobPtr;	/* The job being worked on, or NULL. */
+    unsigned generation;	/* Incremented for each job, so that a worker
+				 * takes part in each job at most once. */
+    int active;			/* Number of workers busy with jobPtr. */
+    Tcl_Condition jobCond;	/* Signaled when a job is posted or the
+				 * workers must exit. */
+    Tcl_Condition doneCond;	/* Signaled when active drops to 0. */
+} ParallelPool;
+
+static ParallelPool parallelPool;
+TCL_DECLARE_MUTEX(parallelMutex)
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RunParallelJobs, ParallelThreadProc --
+ *
+ *	Take indices from a ParallelJob and process them until none are
+ *	left. ParallelThreadProc is the body of each worker thread: it waits
+ *	for jobs and works on each until the pool is shut down.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Calls the job's proc.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RunParallelJobs(
+    ParallelJob *jobPtr)
+{
+    int index;
+
+    for (;;) {
+	Tcl_MutexLock(&jobPtr->mutex);
+	index = jobPtr->next++;
+	Tcl_MutexUnlock(&jobPtr->mutex);
+	if (index >= jobPtr->count) {
+	    break;
+	}
+	jobPtr->proc(jobPtr->clientData, index);
+    }
+}
+
+static Tcl_ThreadCreateType
+ParallelThreadProc(
+    TCL_UNUSED(void *))
+{
+    ParallelPool *poolPtr = &parallelPool;
+    unsigned seen;
+    ParallelJob *jobPtr;
+
+    Tcl_MutexLock(&parallelMutex);
+    seen = poolPtr->generation;
+    for (;;) {
+	while (!poolPtr->shutdown && (poolPtr->generation == seen)) {
+	    Tcl_ConditionWait(&poolPtr->jobCond, &parallelMutex, NULL);
+	}
+	if (poolPtr->shutdown) {
+	    break;
+	}
+	seen = poolPtr->generation;
+	jobPtr = poolPtr->jobPtr;
+	if (jobPtr == NULL) {
+	    continue;
+	}
+	poolPtr->active++;
+	Tcl_MutexUnlock(&parallelMutex);
+	RunParallelJobs(jobPtr);
+	Tcl_MutexLock(&parallelMutex);
+	if (--poolPtr->active == 0) {
+	    Tcl_ConditionNotify(&poolPtr->doneCond);
+	}
+    }
+    Tcl_MutexUnlock(&parallelMutex);
+    Tcl_ExitThread(0);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParallelPoolExitProc --
+ *
+ *	Stops the worker threads of TkRunParallel when the process exits.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The worker threads are joined.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ParallelPoolExitProc(
+    TCL_UNUSED(void *))
+{
+    ParallelPool *poolPtr = &parallelPool;
+    int i, numThreads, result;
+
+    Tcl_MutexLock(&parallelMutex);
+    poolPtr->shutdown = true;
+    numThreads = poolPtr->numThreads;
+    Tcl_ConditionNotify(&poolPtr->jobCond);
+    Tcl_MutexUnlock(&parallelMutex);
+    for (i = 0; i < numThreads; i++) {
+	Tcl_JoinThread(poolPtr->threads[i], &result);
+    }
+    Tcl_MutexLock(&parallelMutex);
+    poolPtr->numThreads = 0;
+    poolPtr->initialized = false;
+    poolPtr->shutdown = false;
+    Tcl_ConditionFinalize(&poolPtr->jobCond);
+    Tcl_ConditionFinalize(&poolPtr->doneCond);
+    Tcl_MutexUnlock(&parallelMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkRunParallel --
+ *
+ *	Calls proc(clientData, i) for every i from 0 to count-1, spreading
+ *	the calls over worker threads and the calling thread. The calls may
+ *	happen in any order and concurrently, so proc must only touch data
+ *	that belongs to its index; in particular it must not use the Tcl or
+ *	Tk APIs other than memory allocation.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever proc does. Returns only when all calls have finished. The
+ *	worker threads are started by the first call. If none can be started,
+ *	or they are busy with a job from another thread, everything runs in
+ *	the calling thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkRunParallel(
+    int count,			/* Number of indices to process. */
+    TkParallelProc *proc,	/* Called once for each index. */
+    void *clientData)		/* First argument for proc. */
+{
+    ParallelPool *poolPtr = &parallelPool;
+    ParallelJob job;
+    int i, numThreads;
+    bool posted = false;
+
+    job.proc = proc;
+    job.clientData = clientData;
+    job.count = count;
+    job.next = 0;
+    job.mutex = NULL;
+
+    if (count > 1) {
+	Tcl_MutexLock(&parallelMutex);
+	if (!poolPtr->initialized) {
+	    /*
+	     * The calling thread works too, so start one thread fewer than
+	     * there are processors.
+	     */
+
+	    poolPtr->initialized = true;
+	    numThreads = TkGetProcessorCount() - 1;
+	    if (numThreads > TK_MAX_WORKERS) {
+		numThreads = TK_MAX_WORKERS;
+	    }
+	    for (i = 0; i < numThreads; i++) {
+		if (Tcl_CreateThread(&poolPtr->threads[poolPtr->numThreads],
+			ParallelThreadProc, NULL, TCL_THREAD_STACK_DEFAULT,
+			TCL_THREAD_JOINABLE) == TCL_OK) {
+		    poolPtr->numThreads++;
+		}
+	    }
+	    TkCreateExitHandler(ParallelPoolExitProc, NULL);
+	}
+	if ((poolPtr->numThreads > 0) && (poolPtr->jobPtr == NULL)) {
+	    poolPtr->jobPtr = &job;
+	    poolPtr->generation++;
+	    Tcl_ConditionNotify(&poolPtr->jobCond);
+	    posted = true;
+	}
+	Tcl_MutexUnlock(&parallelMutex);
+    }
+
+    RunParallelJobs(&job);
+
+    if (posted) {
+	Tcl_MutexLock(&parallelMutex);
+	while (poolPtr->active > 0) {
+	    Tcl_ConditionWait(&poolPtr->doneCond, &parallelMutex, NULL);
+	}
+	poolPtr->jobPtr = NULL;
+	Tcl_MutexUnlock(&parallelMutex);
+    }
+    Tcl_MutexFinalize(&job.mutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkMapFile --
+ *
+ *	Maps the whole of an open file into memory for reading, so that image
+ *	readers can decode it in place rather than copying it through the
+ *	channel. Only channels on plain native files at least minSize bytes
+ *	long are mapped; anything else, such as a file in a virtual
+ *	filesystem, is left to the channel code. The file is mapped through
+ *	the channel's own handle, so that it can't have been replaced since
+ *	it was opened.
+ *
+ *	On Windows a file can't be truncated while a view of it is mapped, so
+ *	mapping is always safe. Elsewhere another process may truncate the
+ *	file while it is mapped, and touching a page past its new end then
+ *	raises SIGBUS, killing the process. Files are therefore only mapped
+ *	there if the TK_MAP_IMAGE_FILES environment variable is set, by those
+ *	who know their image files aren't rewritten in place.
+ *
+ * Results:
+ *	A pointer to the first byte of the file, with its length stored in
+ *	*lengthPtr, or NULL if the file was not mapped.
+ *
+ * Side effects:
+ *	The mapping stays until TkUnmapFile is called, even if the channel is
+ *	closed first. Its contents follow later writes to the file; the
+ *	caller must not rely on them staying the same. The position of the
+ *	channel is not changed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const unsigned char *
+TkMapFile(
+    Tcl_Channel chan,		/* The file to map, open for reading. */
+    Tcl_WideInt minSize,	/* Smallest file worth mapping. */
+    Tcl_Size *lengthPtr)	/* Where to store the length of the file. */
+{
+    void *handle;
+    void *data = NULL;
+#ifdef _WIN32
+    HANDLE mapping;
+    LARGE_INTEGER size;
+#else
+    struct stat statBuf;
+    int fd;
+#endif /* _WIN32 */
+
+    if ((strcmp(Tcl_ChannelName(Tcl_GetChannelType(chan)), "file") != 0)
+	    || (Tcl_GetChannelHandle(chan, TCL_READABLE, &handle) != TCL_OK)) {
+	return NULL;
+    }
+#ifdef _WIN32
+    if ((GetFileType((HANDLE) handle) == FILE_TYPE_DISK)
+	    && GetFileSizeEx((HANDLE) handle, &size)
+	    && (size.QuadPart >= minSize) && (size.QuadPart > 0)
+	    && (size.QuadPart <= TCL_SIZE_MAX)) {
+	mapping = CreateFileMappingW((HANDLE) handle, NULL, PAGE_READONLY,
+		0, 0, NULL);
+	if (mapping != NULL) {
+	    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	    CloseHandle(mapping);
+	}
+	*lengthPtr = (Tcl_Size) size.QuadPart;
+    }
+#else
+    if (getenv("TK_MAP_IMAGE_FILES") == NULL) {
+	return NULL;
+    }
+    fd = (int) PTR2INT(handle);
+    if ((fstat(fd, &statBuf) == 0) && S_ISREG(statBuf.st_mode)
+	    && (statBuf.st_size >= minSize) && (statBuf.st_size > 0)
+	    && ((Tcl_WideInt) statBuf.st_size <= TCL_SIZE_MAX)) {
+	data = mmap(NULL, (size_t) statBuf.st_size, PROT_READ, MAP_PRIVATE,
+		fd, 0);
+	if (data == MAP_FAILED) {
+	    data = NULL;
+	}
+	*lengthPtr = (Tcl_Size) statBuf.st_size;
+    }
+#endif /* _WIN32 */
+    return (const unsigned char *) data;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkUnmapFile --
+ *
+ *	Releases a mapping made by TkMapFile.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The memory at data can no longer be used.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkUnmapFile(
+    const unsigned char *data,	/* Value returned by TkMapFile. */
+    Tcl_Size length)		/* Length stored by TkMapFile. */
+{
+#ifdef _WIN32
+    (void) length;
+    UnmapViewOfFile(data);
+#else
+    munmap((void *) data, (size_t) length);
+#endif /* _WIN32 */
+}
+
+/*
+ * The following structures implement the per-display pool of scratch
+ * pixmaps used by the double-buffering code. Idle pixmaps are kept in
+ * buckets keyed by screen, depth and size class, and on a list ordered by
+ * last use so that the oldest can be dropped when the pool grows too large
+ * or has been idle for too long.
+ */
+
+#define POOL_GRAIN	64	/* Pixmap sizes are rounded up to a multiple
+				 * of this many pixels. */
+#define POOL_MAX_BYTES	(32 * 1024 * 1024)
+				/* Upper limit on the estimated size of the
+				 * idle pixmaps kept by one display. */
+#define POOL_IDLE_MS	5000	/* Idle pixmaps older than this are freed. */
+
+typedef struct {
+    int screen;
+    int depth;
+    int width;
+    int height;
+} PoolKey;
+
+typedef struct PoolPixmap {
+    Pixmap pixmap;		/* The pooled pixmap. */
+    Tcl_HashEntry *bucketPtr;	/* Entry in bucketTable for the size class
+				 * of this pixmap. */
+    size_t bytes;		/* Estimated server memory used. */
+    Tcl_WideInt lastUsed;	/* Time (ms) the pixmap was last released. */
+    struct PoolPixmap *nextPtr;	/* Next idle pixmap in the same bucket. */
+    struct PoolPixmap *prevPtr;	/* Previous idle pixmap in the same bucket. */
+    struct PoolPixmap *newerPtr;/* Next more recently released pixmap. */
+    struct PoolPixmap *olderPtr;/* Next less recently released pixmap. */
+} PoolPixmap;
+
+typedef struct TkPixmapPool {
+    Tcl_HashTable bucketTable;	/* Maps PoolKey to the first idle PoolPixmap
+				 * of that size class (or NULL). */
+    Tcl_HashTable lentTable;	/* Maps Pixmap to the PoolPixmap of each
+				 * pixmap currently handed out. */
+    PoolPixmap *newestPtr;	/* Most recently released idle pixmap. */
+    PoolPixmap *oldestPtr;	/* Least recently released idle pixmap. */
+    size_t idleBytes;		/* Total of bytes over all idle pixmaps. */
+    Tcl_TimerToken timer;	/* Pending call to PoolTrimProc, or NULL. */
+} TkPixmapPool;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkCacheMilliseconds --
+ *
+ *	Returns the current time in milliseconds, for the retention policies
+ *	of the per-display resource caches.
+ *
+ * Results:
+ *	The time.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_WideInt
+TkCacheMilliseconds(void)
+{
+    Tcl_Time now;
+
+    Tcl_GetTime(&now);
+    return (Tcl_WideInt) now.sec * 1000 + now.usec / 1000;
+}
+
+static void
+PoolUnlink(
+    TkDisplay *dispPtr,
+    PoolPixmap *ppPtr)
+{
+    TkPixmapPool *poolPtr = dispPtr->pixmapPoolPtr;
+
+    if (ppPtr->prevPtr) {
+	ppPtr->prevPtr->nextPtr = ppPtr->nextPtr;
+    } else {
+	Tcl_SetHashValue(ppPtr->bucketPtr, ppPtr->nextPtr);
+    }
+    if (ppPtr->nextPtr) {
+	ppPtr->nextPtr->prevPtr = ppPtr->prevPtr;
+    }
+    if (ppPtr->newerPtr) {
+	ppPtr->newerPtr->olderPtr = ppPtr->olderPtr;
+    } else {
+	poolPtr->newestPtr = ppPtr->olderPtr;
+    }
+    if (ppPtr->olderPtr) {
+	ppPtr->olderPtr->newerPtr = ppPtr->newerPtr;
+    } else {
+	poolPtr->oldestPtr = ppPtr->newerPtr;
+    }
+    ppPtr->nextPtr = ppPtr->prevPtr = ppPtr->newerPtr = ppPtr->olderPtr = NULL;
+    poolPtr->idleBytes -= ppPtr->bytes;
+    dispPtr->pixmapStats.size--;
+}
+
+static void
+PoolDiscardOldest(
+    TkDisplay *dispPtr)
+{
+    PoolPixmap *ppPtr = dispPtr->pixmapPoolPtr->oldestPtr;
+
+    PoolUnlink(dispPtr, ppPtr);
+    Tk_FreePixmap(dispPtr->display, ppPtr->pixmap);
+    Tcl_Free(ppPtr);
+    dispPtr->pixmapStats.trims++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PoolTrimProc --
+ *
+ *	Timer callback that frees the pooled pixmaps of a display which have
+ *	not been used for POOL_IDLE_MS.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Pixmaps may be freed; the timer is rescheduled while idle pixmaps
+ *	remain.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PoolTrimProc(
+    void *clientData)		/* TkDisplay whose pool to trim. */
+{
+    TkDisplay *dispPtr = (TkDisplay *)clientData;
+    TkPixmapPool *poolPtr = dispPtr->pixmapPoolPtr;
+    Tcl_WideInt now = TkCacheMilliseconds();
+
+    poolPtr->timer = NULL;
+    while (poolPtr->oldestPtr
+	    && now - poolPtr->oldestPtr->lastUsed >= POOL_IDLE_MS) {
+	PoolDiscardOldest(dispPtr);
+    }
+    if (poolPtr->oldestPtr) {
+	Tcl_WideInt delay = POOL_IDLE_MS - (now - poolPtr->oldestPtr->lastUsed);
+
+	poolPtr->timer = Tcl_CreateTimerHandler((int) delay, PoolTrimProc,
+		dispPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkGetPooledPixmap --
+ *
+ *	Returns a scratch pixmap suitable for drawing into for tkwin, taking
+ *	one from the display's pool when a pixmap of the same screen, depth
+ *	and size class is idle. The pixmap may be larger than requested.
+ *
+ * Results:
+ *	The pixmap, which must be released with TkFreePooledPixmap.
+ *
+ * Side effects:
+ *	A new pixmap is allocated if the pool has none to offer. The hit and
+ *	miss counters of the display are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Pixmap
+TkGetPooledPixmap(
+    Tk_Window tkwin,		/* Window the pixmap will be copied to. */
+    int width, int height)	/* Minimum size of the pixmap. */
+{
+    TkDisplay *dispPtr = ((TkWindow *)tkwin)->dispPtr;
+    TkPixmapPool *poolPtr = dispPtr->pixmapPoolPtr;
+    PoolKey key;
+    PoolPixmap *ppPtr;
+    Tcl_HashEntry *hPtr;
+    int isNew;
+
+    if (poolPtr == NULL) {
+	poolPtr = (TkPixmapPool *)Tcl_Alloc(sizeof(TkPixmapPool));
+	Tcl_InitHashTable(&poolPtr->bucketTable, sizeof(PoolKey)/sizeof(int));
+	Tcl_InitHashTable(&poolPtr->lentTable, TCL_ONE_WORD_KEYS);
+	poolPtr->newestPtr = poolPtr->oldestPtr = NULL;
+	poolPtr->idleBytes = 0;
+	poolPtr->timer = NULL;
+	dispPtr->pixmapPoolPtr = poolPtr;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.screen = Tk_ScreenNumber(tkwin);
+    key.depth = Tk_Depth(tkwin);
+    key.width = (width < 1) ? POOL_GRAIN
+	    : (width + POOL_GRAIN - 1) / POOL_GRAIN * POOL_GRAIN;
+    key.height = (height < 1) ? POOL_GRAIN
+	    : (height + POOL_GRAIN - 1) / POOL_GRAIN * POOL_GRAIN;
+
+    hPtr = Tcl_CreateHashEntry(&poolPtr->bucketTable, &key, &isNew);
+    if (isNew) {
+	Tcl_SetHashValue(hPtr, NULL);
+    }
+    ppPtr = (PoolPixmap *)Tcl_GetHashValue(hPtr);
+    if (ppPtr != NULL) {
+	PoolUnlink(dispPtr, ppPtr);
+	dispPtr->pixmapStats.hits++;
+    } else {
+	ppPtr = (PoolPixmap *)Tcl_Alloc(sizeof(PoolPixmap));
+	memset(ppPtr, 0, sizeof(PoolPixmap));
+	ppPtr->pixmap = Tk_GetPixmap(Tk_Display(tkwin), Tk_WindowId(tkwin),
+		key.width, key.height, key.depth);
+	ppPtr->bucketPtr = hPtr;
+	ppPtr->bytes = (size_t) key.width * key.height * ((key.depth + 7) / 8);
+	dispPtr->pixmapStats.misses++;
+    }
+
+    hPtr = Tcl_CreateHashEntry(&poolPtr->lentTable, (char *) ppPtr->pixmap,
+	    &isNew);
+    Tcl_SetHashValue(hPtr, ppPtr);
+    return ppPtr->pixmap;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkFreePooledPixmap --
+ *
+ *	Releases a pixmap obtained from TkGetPooledPixmap. The pixmap is kept
+ *	for reuse unless that would grow the pool beyond POOL_MAX_BYTES, in
+ *	which case the least recently used pixmaps are freed first. Pixmaps
+ *	that did not come from the pool are freed immediately.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The pixmap may be freed. A timer is scheduled to trim idle pixmaps.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkFreePooledPixmap(
+    TkDisplay *dispPtr,		/* Display the pixmap belongs to. */
+    Pixmap pixmap)		/* Pixmap to release. */
+{
+    TkPixmapPool *poolPtr = dispPtr->pixmapPoolPtr;
+    Tcl_HashEntry *hPtr = NULL;
+    PoolPixmap *ppPtr;
+
+    if (poolPtr != NULL) {
+	hPtr = Tcl_FindHashEntry(&poolPtr->lentTable, (char *) pixmap);
+    }
+    if (hPtr == NULL) {
+	Tk_FreePixmap(dispPtr->display, pixmap);
+	return;
+    }
+    ppPtr = (PoolPixmap *)Tcl_GetHashValue(hPtr);
+    Tcl_DeleteHashEntry(hPtr);
+    if (ppPtr->bytes > POOL_MAX_BYTES) {
+	Tk_FreePixmap(dispPtr->display, pixmap);
+	Tcl_Free(ppPtr);
+	dispPtr->pixmapStats.trims++;
+	return;
+    }
+    while (poolPtr->oldestPtr
+	    && poolPtr->idleBytes + ppPtr->bytes > POOL_MAX_BYTES) {
+	PoolDiscardOldest(dispPtr);
+    }
+
+    ppPtr->lastUsed = TkCacheMilliseconds();
+    ppPtr->prevPtr = NULL;
+    ppPtr->nextPtr = (PoolPixmap *)Tcl_GetHashValue(ppPtr->bucketPtr);
+    if (ppPtr->nextPtr) {
+	ppPtr->nextPtr->prevPtr = ppPtr;
+    }
+    Tcl_SetHashValue(ppPtr->bucketPtr, ppPtr);
+    ppPtr->newerPtr = NULL;
+    ppPtr->olderPtr = poolPtr->newestPtr;
+    if (poolPtr->newestPtr) {
+	poolPtr->newestPtr->newerPtr = ppPtr;
+    } else {
+	poolPtr->oldestPtr = ppPtr;
+    }
+    poolPtr->newestPtr = ppPtr;
+    poolPtr->idleBytes += ppPtr->bytes;
+    dispPtr->pixmapStats.size++;
+
+    if (poolPtr->timer == NULL) {
+	poolPtr->timer = Tcl_CreateTimerHandler(POOL_IDLE_MS, PoolTrimProc,
+		dispPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPixmapPoolCleanup --
+ *
+ *	Frees the pixmap pool of a display that is being closed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	All idle pixmaps are freed along with the pool's bookkeeping.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkPixmapPoolCleanup(
+    TkDisplay *dispPtr)		/* Display being closed. */
+{
+    TkPixmapPool *poolPtr = dispPtr->pixmapPoolPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (poolPtr == NULL) {
+	return;
+    }
+    if (poolPtr->timer != NULL) {
+	Tcl_DeleteTimerHandler(poolPtr->timer);
+    }
+    while (poolPtr->oldestPtr) {
+	PoolDiscardOldest(dispPtr);
+    }
+    for (hPtr = Tcl_FirstHashEntry(&poolPtr->lentTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	Tcl_Free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_DeleteHashTable(&poolPtr->lentTable);
+    Tcl_DeleteHashTable(&poolPtr->bucketTable);
+    Tcl_Free(poolPtr);
+    dispPtr->pixmapPoolPtr = NULL;
+}
+
 /*
  * Local Variables:
  * mode: c
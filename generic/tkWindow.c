@@ -275,7 +275,10 @@ TkCloseDisplay(
 	}
     }
 
+    TkColorCleanup(dispPtr);
     TkGCCleanup(dispPtr);
+    TkArrangeCleanup(dispPtr);
+    TkPixmapPoolCleanup(dispPtr);
 
     TkpCloseDisplay(dispPtr);
 
@@ -354,6 +357,14 @@ CreateTopLevelWindow(
 	Tk_CreatePhotoImageFormatVersion3(&tkImgFmtPNG);
 	Tk_CreatePhotoImageFormat(&tkImgFmtPPM);
 	Tk_CreatePhotoImageFormat(&tkImgFmtSVGnano);
+
+	/*
+	 * Let the built-in formats read large files from memory.
+	 */
+
+	TkPhotoSetMappedReadProc("gif", TkReadMappedGIF);
+	TkPhotoSetMappedReadProc("png", TkReadMappedPNG);
+	TkPhotoSetMappedReadProc("ppm", TkReadMappedPPM);
     }
 
     if ((parent != NULL) && (screenName != NULL) && (screenName[0] == '\0')) {
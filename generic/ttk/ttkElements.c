@@ -2077,6 +2077,28 @@ static const Ttk_ElementSpec ClientElementSpec = {
     ClientElementDraw
 };
 
+/*----------------------------------------------------------------------
+ * RegisterSizeCacheable --
+ *	Register an element whose size depends only on its options, state
+ *	and the screen's scaling, and let the theme engine memoize it.
+ */
+
+static void
+RegisterSizeCacheable(
+    Tcl_Interp *interp,
+    Ttk_Theme theme,
+    const char *name,
+    const Ttk_ElementSpec *specPtr,
+    void *clientData)
+{
+    Ttk_ElementClass *eclass =
+	Ttk_RegisterElement(interp, theme, name, specPtr, clientData);
+
+    if (eclass) {
+	TtkSetElementCachePolicy(eclass, TTK_ELEMENT_SIZE_CACHEABLE, NULL);
+    }
+}
+
 /*----------------------------------------------------------------------
  * TtkElements_Init --
  *	Register default element implementations.
@@ -2109,52 +2131,52 @@ TtkElements_Init(Tcl_Interp *interp)
 #else
     (void) eclass;
 #endif
-    Ttk_RegisterElement(interp, theme, "border", &BorderElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "field", &FieldElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "focus", &FocusElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "padding", &PaddingElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "trough", &TroughElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "thumb", &ThumbElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "slider", &SliderElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "pbar", &PbarElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "border", &BorderElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "field", &FieldElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "focus", &FocusElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "padding", &PaddingElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "trough", &TroughElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "thumb", &ThumbElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "slider", &SliderElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "pbar", &PbarElementSpec, NULL);
 
     Ttk_RegisterElement(interp, theme, "indicator", &ttkNullElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "Checkbutton.indicator",
+    RegisterSizeCacheable(interp, theme, "Checkbutton.indicator",
 	    &IndicatorElementSpec, (void *)&checkbutton_spec);
-    Ttk_RegisterElement(interp, theme, "Radiobutton.indicator",
+    RegisterSizeCacheable(interp, theme, "Radiobutton.indicator",
 	    &IndicatorElementSpec, (void *)&radiobutton_spec);
-    Ttk_RegisterElement(interp, theme, "Menubutton.indicator",
+    RegisterSizeCacheable(interp, theme, "Menubutton.indicator",
 	    &MenuIndicatorElementSpec, INT2PTR(CHEVRON_DOWN));
 
-    Ttk_RegisterElement(interp, theme, "uparrow",
+    RegisterSizeCacheable(interp, theme, "uparrow",
 	    &ArrowElementSpec, INT2PTR(CHEVRON_UP));
-    Ttk_RegisterElement(interp, theme, "downarrow",
+    RegisterSizeCacheable(interp, theme, "downarrow",
 	    &ArrowElementSpec, INT2PTR(CHEVRON_DOWN));
-    Ttk_RegisterElement(interp, theme, "leftarrow",
+    RegisterSizeCacheable(interp, theme, "leftarrow",
 	    &ArrowElementSpec, INT2PTR(CHEVRON_LEFT));
-    Ttk_RegisterElement(interp, theme, "rightarrow",
+    RegisterSizeCacheable(interp, theme, "rightarrow",
 	    &ArrowElementSpec, INT2PTR(CHEVRON_RIGHT));
-    Ttk_RegisterElement(interp, theme, "arrow",
+    RegisterSizeCacheable(interp, theme, "arrow",
 	    &ArrowElementSpec, INT2PTR(CHEVRON_UP));
 
-    Ttk_RegisterElement(interp, theme, "Spinbox.uparrow",
+    RegisterSizeCacheable(interp, theme, "Spinbox.uparrow",
 	    &BoxArrowElementSpec, INT2PTR(CHEVRON_UP));
-    Ttk_RegisterElement(interp, theme, "Spinbox.downarrow",
+    RegisterSizeCacheable(interp, theme, "Spinbox.downarrow",
 	    &BoxArrowElementSpec, INT2PTR(CHEVRON_DOWN));
-    Ttk_RegisterElement(interp, theme, "Combobox.downarrow",
+    RegisterSizeCacheable(interp, theme, "Combobox.downarrow",
 	    &BoxArrowElementSpec, INT2PTR(CHEVRON_DOWN));
 
-    Ttk_RegisterElement(interp, theme, "separator",
+    RegisterSizeCacheable(interp, theme, "separator",
 	    &SeparatorElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "hseparator",
+    RegisterSizeCacheable(interp, theme, "hseparator",
 	    &HorizontalSeparatorElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "vseparator",
+    RegisterSizeCacheable(interp, theme, "vseparator",
 	    &VerticalSeparatorElementSpec, NULL);
 
-    Ttk_RegisterElement(interp, theme, "sizegrip", &SizegripElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "sizegrip", &SizegripElementSpec, NULL);
 
     Ttk_RegisterElement(interp, theme, "tab", &TabElementSpec, NULL);
-    Ttk_RegisterElement(interp, theme, "client", &ClientElementSpec, NULL);
+    RegisterSizeCacheable(interp, theme, "client", &ClientElementSpec, NULL);
 
     /*
      * Register "default" as a user-loadable theme (for now):
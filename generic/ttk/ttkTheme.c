@@ -126,8 +126,25 @@ struct Ttk_ElementClass_ {
     Tcl_HashTable optMapCache;	/* Map: Tk_OptionTable * -> OptionMap */
     unsigned cacheFlags;	/* Render-cache policy (TTK_ELEMENT_* flags) */
     Ttk_ElementCacheProc *cacheProc;	/* Cache-info query, or NULL */
+    Tcl_HashTable sizeCache;	/* Map: size key -> CachedSize */
 };
 
+/*
+ * CachedSize --
+ *	Memoized result of an element's size proc, for elements that opted
+ *	in with TTK_ELEMENT_SIZE_CACHEABLE.  See Ttk_ElementSize.
+ */
+typedef struct {
+    int width, height;
+    Ttk_Padding padding;
+} CachedSize;
+
+/*
+ * Upper bound on the number of sizes remembered per element class; the
+ * cache is simply emptied when it fills up.
+ */
+#define SIZE_CACHE_MAX 256
+
 /* TTKGetOptionSpec --
  *	Look up a Tk_OptionSpec by name from a Tk_OptionTable,
  *	and verify that it's compatible with the specified Tk_OptionType,
@@ -257,6 +274,7 @@ NewElementClass(const char *name, const Ttk_ElementSpec *specPtr, void *clientDa
     /* Render-cache policy: off until the element opts in. */
     elementClass->cacheFlags = 0;
     elementClass->cacheProc = NULL;
+    Tcl_InitHashTable(&elementClass->sizeCache, TCL_STRING_KEYS);
 
     return elementClass;
 }
@@ -291,6 +309,22 @@ int Ttk_ElementClassStable(Ttk_ElementClass *eclass)
     return (eclass->cacheFlags & TTK_ELEMENT_STABLE) != 0;
 }
 
+/* ClearSizeCache --
+ *	Forget all memoized sizes of an element class.
+ */
+static void ClearSizeCache(Ttk_ElementClass *elementClass)
+{
+    Tcl_HashSearch search;
+    Tcl_HashEntry *entryPtr;
+
+    entryPtr = Tcl_FirstHashEntry(&elementClass->sizeCache, &search);
+    while (entryPtr != NULL) {
+	Tcl_Free(Tcl_GetHashValue(entryPtr));
+	Tcl_DeleteHashEntry(entryPtr);
+	entryPtr = Tcl_NextHashEntry(&search);
+    }
+}
+
 /*
  * FreeElementClass --
  *	Release resources associated with an element class record.
@@ -321,6 +355,12 @@ static void FreeElementClass(Ttk_ElementClass *elementClass)
     }
     Tcl_DeleteHashTable(&elementClass->optMapCache);
 
+    /*
+     * Free size cache:
+     */
+    ClearSizeCache(elementClass);
+    Tcl_DeleteHashTable(&elementClass->sizeCache);
+
     Tcl_Free(elementClass->elementRecord);
     Tcl_Free(elementClass);
 }
@@ -548,13 +588,37 @@ static void ThemeChangedProc(void *clientData)
     pkgPtr->themeChangePending = 0;
 }
 
+/* InvalidateSizeCaches --
+ *	Forget the memoized element sizes of every theme.  Called whenever
+ *	style settings, layouts or the current theme change.
+ */
+static void InvalidateSizeCaches(StylePackageData *pkgPtr)
+{
+    Tcl_HashSearch themeSearch, search;
+    Tcl_HashEntry *themeEntry, *entryPtr;
+
+    themeEntry = Tcl_FirstHashEntry(&pkgPtr->themeTable, &themeSearch);
+    while (themeEntry != NULL) {
+	Theme *themePtr = (Theme *)Tcl_GetHashValue(themeEntry);
+	entryPtr = Tcl_FirstHashEntry(&themePtr->elementTable, &search);
+	while (entryPtr != NULL) {
+	    ClearSizeCache((Ttk_ElementClass *)Tcl_GetHashValue(entryPtr));
+	    entryPtr = Tcl_NextHashEntry(&search);
+	}
+	themeEntry = Tcl_NextHashEntry(&themeSearch);
+    }
+}
+
 /*
  * ThemeChanged --
  *	Schedule a call to ThemeChanged if one is not already pending.
+ *	Memoized element sizes are discarded right away, since widgets
+ *	may recompute their geometry before the idle call runs.
  */
 static void ThemeChanged(StylePackageData *pkgPtr)
 {
     TtkSetBlinkCursorTimes(pkgPtr->interp);
+    InvalidateSizeCaches(pkgPtr);
 
     if (!pkgPtr->themeChangePending) {
 	Tcl_DoWhenIdle(ThemeChangedProc, pkgPtr);
@@ -1115,9 +1179,59 @@ Tcl_Obj *Ttk_QueryStyle(
     return Ttk_StyleDefault(style, optionName);
 }
 
+/*
+ * SizeCacheKey --
+ *	Build the key under which the size of a TTK_ELEMENT_SIZE_CACHEABLE
+ *	element is memoized: the style, the state, the screen metrics that
+ *	scaled pixel values depend on, and the values of those element
+ *	options that the widget record supplies.  Everything else comes from
+ *	the style tables, which only change along with a ThemeChanged call.
+ */
+static void
+SizeCacheKey(
+    Ttk_ElementClass *eclass,
+    Ttk_Style style,
+    void *widgetRecord,
+    Tk_OptionTable optionTable,
+    Tk_Window tkwin,
+    Ttk_State state,
+    Tcl_DString *keyPtr)
+{
+    OptionMap optionMap = GetOptionMap(eclass, optionTable);
+    Screen *screenPtr = Tk_Screen(tkwin);
+    char buf[TCL_INTEGER_SPACE * 4 + 32];
+    int i;
+
+    snprintf(buf, sizeof(buf), "%p %x %d %d %p", (void *)style, state,
+	    WidthOfScreen(screenPtr), WidthMMOfScreen(screenPtr),
+	    (void *)screenPtr);
+    Tcl_DStringAppend(keyPtr, buf, -1);
+    for (i = 0; i < eclass->nResources; ++i) {
+	Tcl_Obj *widgetValue = 0;
+
+	if (optionMap[i]) {
+	    widgetValue = *(Tcl_Obj **)
+		((char *)widgetRecord + optionMap[i]->objOffset);
+	}
+	if (widgetValue) {
+	    Tcl_Size length;
+	    const char *string = Tcl_GetStringFromObj(widgetValue, &length);
+
+	    snprintf(buf, sizeof(buf), " %" TCL_SIZE_MODIFIER "d:", length);
+	    Tcl_DStringAppend(keyPtr, buf, -1);
+	    Tcl_DStringAppend(keyPtr, string, length);
+	} else {
+	    Tcl_DStringAppend(keyPtr, " -", 2);
+	}
+    }
+}
+
 /*
  * Ttk_ElementSize --
  *	Compute the requested size of the given element.
+ *	Results for elements that declared TTK_ELEMENT_SIZE_CACHEABLE are
+ *	memoized per element class, which spares re-resolving their options
+ *	and calling the size proc on every layout pass.
  */
 
 void
@@ -1132,17 +1246,57 @@ Ttk_ElementSize(
     int *heightPtr,			/* Reqested height */
     Ttk_Padding *paddingPtr)		/* Requested inner border */
 {
+    Tcl_DString key;
+    Tcl_HashEntry *entryPtr;
+    CachedSize *cached;
+    int isNew;
+
     paddingPtr->left = paddingPtr->right = paddingPtr->top = paddingPtr->bottom
 	= *widthPtr = *heightPtr = 0;
 
-    if (!InitializeElementRecord(
+    if (!(eclass->cacheFlags & TTK_ELEMENT_SIZE_CACHEABLE)) {
+	if (!InitializeElementRecord(
+		eclass, style, recordPtr, optionTable, tkwin,  state))
+	{
+	    return;
+	}
+	eclass->specPtr->size(
+	    eclass->clientData, eclass->elementRecord,
+	    tkwin, state, widthPtr, heightPtr, paddingPtr);
+	return;
+    }
+
+    Tcl_DStringInit(&key);
+    SizeCacheKey(eclass, style, recordPtr, optionTable, tkwin, state, &key);
+    entryPtr = Tcl_FindHashEntry(&eclass->sizeCache, Tcl_DStringValue(&key));
+    if (entryPtr) {
+	cached = (CachedSize *)Tcl_GetHashValue(entryPtr);
+	*widthPtr = cached->width;
+	*heightPtr = cached->height;
+	*paddingPtr = cached->padding;
+	Tcl_DStringFree(&key);
+	return;
+    }
+
+    if (InitializeElementRecord(
 	    eclass, style, recordPtr, optionTable, tkwin,  state))
     {
-	return;
+	eclass->specPtr->size(
+	    eclass->clientData, eclass->elementRecord,
+	    tkwin, state, widthPtr, heightPtr, paddingPtr);
+
+	if (eclass->sizeCache.numEntries >= SIZE_CACHE_MAX) {
+	    ClearSizeCache(eclass);
+	}
+	cached = (CachedSize *)Tcl_Alloc(sizeof(CachedSize));
+	cached->width = *widthPtr;
+	cached->height = *heightPtr;
+	cached->padding = *paddingPtr;
+	entryPtr = Tcl_CreateHashEntry(
+	    &eclass->sizeCache, Tcl_DStringValue(&key), &isNew);
+	Tcl_SetHashValue(entryPtr, cached);
     }
-    eclass->specPtr->size(
-	eclass->clientData, eclass->elementRecord,
-	tkwin, state, widthPtr, heightPtr, paddingPtr);
+    Tcl_DStringFree(&key);
 }
 
 /*
@@ -37,6 +37,15 @@ MODULE_SCOPE void Ttk_DrawElement(
 #define TTK_ELEMENT_CACHEABLE	0x1	/* opts into per-node render caching */
 #define TTK_ELEMENT_STABLE	0x2	/* deterministic draw; see above */
 
+/*
+ * A SIZE_CACHEABLE element's size proc depends only on its option values,
+ * the state and the screen's pixel metrics -- not on images, named fonts or
+ * other state that can change behind the theme engine's back.  Its requested
+ * size and padding are memoized by Ttk_ElementSize until the next style or
+ * theme change.
+ */
+#define TTK_ELEMENT_SIZE_CACHEABLE 0x4
+
 /*
  * Cache info an element reports for the current (tkwin, state): whether it is
  * fully opaque, and a content epoch that bumps when its own pixels change.
@@ -296,6 +296,36 @@ static const Tk_OptionSpec DisplayOptionSpecs[] = {
 
 static const Tk_OptionSpec *TagOptionSpecs = &DisplayOptionSpecs[2];
 
+/*------------------------------------------------------------------------
+ * +++ Search indexes.
+ *
+ * A column with -searchindex enabled keeps a sorted array of its nonempty
+ * cell values. It is built lazily by the first [$tv search] that can use it
+ * and discarded whenever cell values change or items are added or deleted.
+ * Case-sensitive -exact and literal-prefix -glob searches then only need
+ * to compare the cells in a binary-searched range.
+ */
+typedef struct {
+    Tcl_Obj	*valueObj;	/* Cell value (holds a reference) */
+    const char	*string;	/* String rep of valueObj */
+    Tcl_Size	length;		/* Length of string, in bytes */
+    TreeItem	*item;		/* Item owning the cell */
+} SearchIndexEntry;
+
+typedef struct {
+    Tcl_Size	nEntries;
+    SearchIndexEntry *entries;	/* Sorted bytewise by string */
+} SearchIndex;
+
+static void FreeSearchIndex(SearchIndex *index) {
+    Tcl_Size i;
+    for (i = 0; i < index->nEntries; ++i) {
+	Tcl_DecrRefCount(index->entries[i].valueObj);
+    }
+    Tcl_Free(index->entries);
+    Tcl_Free(index);
+}
+
 /*------------------------------------------------------------------------
  * +++ Columns.
  *
@@ -308,6 +338,7 @@ typedef struct {
     int		minWidth;	/* Minimum column width, in pixels */
     int		stretch;	/* Should column stretch while resizing? */
     int		separator;	/* Should this column have a separator? */
+    int		searchIndexed;	/* Maintain a search index? */
     Tcl_Obj	*idObj;		/* Column identifier, from -columns option */
 
     Tcl_Obj	*anchorObj;	/* -anchor for cell data <<NOTE-ANCHOR>> */
@@ -324,6 +355,8 @@ typedef struct {
     Tcl_Obj	*data;
     int		selected;
     Ttk_TagSet	tagset;
+
+    SearchIndex	*searchIndex;	/* Lazily built, NULL if stale */
 } TreeColumn;
 
 static void InitColumn(TreeColumn *column) {
@@ -331,6 +364,7 @@ static void InitColumn(TreeColumn *column) {
     column->minWidth = atoi(DEF_MINWIDTH);
     column->stretch = 1;
     column->separator = 0;
+    column->searchIndexed = 0;
     column->idObj = NULL;
     column->anchorObj = NULL;
 
@@ -343,6 +377,7 @@ static void InitColumn(TreeColumn *column) {
 
     column->data = 0;
     column->tagset = NULL;
+    column->searchIndex = NULL;
 }
 
 static void FreeColumn(TreeColumn *column) {
@@ -354,6 +389,7 @@ static void FreeColumn(TreeColumn *column) {
     if (column->headingAnchorObj) { Tcl_DecrRefCount(column->headingAnchorObj); }
     if (column->headingStateObj) { Tcl_DecrRefCount(column->headingStateObj); }
     if (column->headingCommandObj) { Tcl_DecrRefCount(column->headingCommandObj); }
+    if (column->searchIndex) { FreeSearchIndex(column->searchIndex); }
 
     /* Don't touch column->data, it's scratch storage */
 }
@@ -365,6 +401,9 @@ static const Tk_OptionSpec ColumnOptionSpecs[] = {
     {TK_OPTION_INT, "-minwidth", "minWidth", "MinWidth",
 	DEF_MINWIDTH, TCL_INDEX_NONE, offsetof(TreeColumn,minWidth),
 	0,0,0 },
+    {TK_OPTION_BOOLEAN, "-searchindex", "searchIndex", "SearchIndex",
+	"0", TCL_INDEX_NONE, offsetof(TreeColumn,searchIndexed),
+	0,0,0 },
     {TK_OPTION_BOOLEAN, "-separator", "separator", "Separator",
 	"0", TCL_INDEX_NONE, offsetof(TreeColumn,separator),
 	0,0,0 },
@@ -835,6 +874,26 @@ static int TreeviewInitColumns(Tcl_Interp *interp, Treeview *tv) {
     return TCL_OK;
 }
 
+/* + InvalidateSearchIndex --
+ *	Discard the search index of column, or of all columns if NULL,
+ *	after the cell values it was built from have changed.
+ */
+static void InvalidateSearchIndex(Treeview *tv, TreeColumn *column) {
+    Tcl_Size i;
+
+    if (column) {
+	if (column->searchIndex) {
+	    FreeSearchIndex(column->searchIndex);
+	    column->searchIndex = NULL;
+	}
+	return;
+    }
+    InvalidateSearchIndex(tv, &tv->tree.column0);
+    for (i = 0; i < tv->tree.nColumns; ++i) {
+	InvalidateSearchIndex(tv, tv->tree.columns + i);
+    }
+}
+
 /* + TreeviewInitDisplayColumns --
  *	Initializes the 'displayColumns' array.
  *
@@ -1504,6 +1563,7 @@ static int ConfigureItem(
     int mask;
     Ttk_ImageSpec *newImageSpec = NULL;
     Ttk_TagSet newTagSet = NULL;
+    Tcl_Obj *textObj = item->textObj, *valuesObj = item->valuesObj;
 
     if (Tk_SetOptions(interp, item, tv->tree.itemOptionTable, objc, objv,
 	    tv->core.tkwin, &savedOptions, &mask) != TCL_OK) {
@@ -1587,6 +1647,15 @@ static int ConfigureItem(
 	if (item->imagespec) { TtkFreeImageSpec(item->imagespec); }
 	item->imagespec = newImageSpec;
     }
+    if (item->textObj != textObj) {
+	InvalidateSearchIndex(tv, &tv->tree.column0);
+    }
+    if (item->valuesObj != valuesObj) {
+	Tcl_Size i;
+	for (i = 0; i < tv->tree.nColumns; ++i) {
+	    InvalidateSearchIndex(tv, tv->tree.columns + i);
+	}
+    }
     tv->tree.rowPosNeedsUpdate = true;
     TtkRedisplayWidget(&tv->core);
     return TCL_OK;
@@ -1630,6 +1699,9 @@ static int ConfigureColumn(
     if (mask & GEOMETRY_CHANGED) {
 	TtkResizeWidget(&tv->core);
     }
+    if (!column->searchIndexed) {
+	InvalidateSearchIndex(tv, column);
+    }
     TtkRedisplayWidget(&tv->core);
 
     Tk_FreeSavedOptions(&savedOptions);
@@ -3909,6 +3981,7 @@ static int TreeviewSetCommand(
 		columnNumber = column - tv->tree.columns;
 		Tcl_ListObjReplace(interp, item->valuesObj, columnNumber, 1, 1, &objv[i+1]);
 	    }
+	    InvalidateSearchIndex(tv, column);
 	}
 	TtkRedisplayWidget(&tv->core);
     }
@@ -4277,6 +4350,7 @@ static int TreeviewInsertCommand(
     Tcl_SetHashValue(entryPtr, newItem);
     newItem->entryPtr = entryPtr;
     InsertItem(parent, sibling, newItem);
+    InvalidateSearchIndex(tv, NULL);
     tv->tree.rowPosNeedsUpdate = true;
     TtkRedisplayWidget(&tv->core);
 
@@ -4463,6 +4537,7 @@ static int TreeviewDeleteCommand(
 	}
 	delq = DeleteItems(items[i], delq);
     }
+    InvalidateSearchIndex(tv, NULL);
 
     /* Free items: */
     while (delq) {
@@ -5678,6 +5753,546 @@ typedef enum {
     TYPE_INTEGER, TYPE_REAL, TYPE_COMMAND
 } sortModes_t;
 
+/*
+ * Options for [$tv search].
+ */
+enum {
+    SEARCH_ALL, SEARCH_ASCII, SEARCH_BACKWARDS, SEARCH_CELL, SEARCH_COLUMNS,
+    SEARCH_DICTIONARY, SEARCH_EXACT, SEARCH_FORWARDS, SEARCH_GLOB,
+    SEARCH_HIDDEN, SEARCH_INTEGER, SEARCH_NOCASE, SEARCH_NOT, SEARCH_REAL,
+    SEARCH_RECURSE, SEARCH_RECURSIVE, SEARCH_REGEXP, SEARCH_START,
+    SEARCH_STOP, SEARCH_UNICODE, SEARCH_WITHIN, SEARCH_WRAP
+};
+
+/*
+ * SearchSpec --
+ *	Compiled pattern and result state shared by the search helpers.
+ */
+typedef struct {
+    int matchType;		/* SEARCH_EXACT, SEARCH_GLOB or SEARCH_REGEXP */
+    sortModes_t dataType;
+    bool nocase;		/* -nocase */
+    bool notb;			/* -not */
+    bool all;			/* -all */
+    bool type;			/* Return items (true) or cells (false) */
+    const char *pattern;	/* Pattern string, for string comparisons */
+    Tcl_Size plen;		/* Length of pattern, in bytes */
+    Tcl_WideInt intVal;		/* Pattern value for -integer */
+    double doubleVal;		/* Pattern value for -real */
+    Tcl_RegExp regexp;		/* Compiled pattern for -regexp */
+    Tcl_Obj *emptyObj;		/* Value of cells with no data */
+    int *intArray;		/* Map: search column -> data column */
+    Tcl_Size lastCol;		/* Number of entries in intArray */
+    Tcl_Obj *resultObj;		/* List of matching items or cells */
+    int matches;		/* Number of matches in resultObj */
+} SearchSpec;
+
+/* + GetCellValue --
+ *	Return the value of data column dataColumn of item, or NULL if none.
+ */
+static Tcl_Obj *GetCellValue(TreeItem *item, Tcl_Size dataColumn) {
+    Tcl_Obj *valObj = NULL;
+
+    if (dataColumn == 0) {
+	return item->textObj;
+    }
+    if (item->valuesObj) {
+	Tcl_ListObjIndex(NULL, item->valuesObj, dataColumn - 1, &valObj);
+    }
+    return valObj;
+}
+
+/* + SearchMatchValue --
+ *	Compare valObj to the search pattern. Stores 1 in *matchPtr if it
+ *	matches, 0 if not. Returns TCL_ERROR for non-numeric values in
+ *	-integer and -real searches.
+ */
+static int SearchMatchValue(
+    Tcl_Interp *interp,
+    SearchSpec *spec,
+    Tcl_Obj *valObj,
+    int *matchPtr)
+{
+    int match = 0;
+    Tcl_Size len;
+
+    /* Do ASCII/Unicode compare */
+    if (spec->dataType <= TYPE_DICTIONARY) {
+	if (spec->matchType == SEARCH_EXACT) {
+	    const char *string = Tcl_GetStringFromObj(valObj, &len);
+	    Tcl_Size numChars = (len <= spec->plen ? len : spec->plen);
+
+	    if (len == 0 && spec->plen > 0) {
+		match = 0; /* Empty cell should not match non empty pattern */
+	    } else if (!spec->nocase) {
+		match = !Tcl_UtfNcmp(string, spec->pattern, numChars);
+	    } else {
+		match = !Tcl_UtfNcasecmp(string, spec->pattern, numChars);
+	    }
+
+	} else if (spec->matchType == SEARCH_GLOB) {
+	    match = Tcl_StringCaseMatch(Tcl_GetString(valObj),
+		    spec->pattern, spec->nocase ? TCL_MATCH_NOCASE : 0);
+
+	} else if (spec->matchType == SEARCH_REGEXP) {
+	    match = Tcl_RegExpExecObj(interp, spec->regexp, valObj, 0, 0, 0);
+	    if (match < 0) {
+		return TCL_ERROR;
+	    }
+	}
+
+    /* Do wide integer compare */
+    } else if (spec->dataType == TYPE_INTEGER) {
+	Tcl_WideInt val;
+
+	if (Tcl_GetWideIntFromObj(interp, valObj, &val) == TCL_OK) {
+	    match = (spec->intVal == val);
+	} else if (Tcl_GetStringFromObj(valObj, &len) && len > 0) {
+	    return TCL_ERROR;
+	} /* Ignore empty values */
+
+    /* Do double value compare */
+    } else if (spec->dataType == TYPE_REAL) {
+	double val;
+
+	if (Tcl_GetDoubleFromObj(interp, valObj, &val) == TCL_OK) {
+	    match = (spec->doubleVal == val);
+	} else if (Tcl_GetStringFromObj(valObj, &len) && len > 0) {
+	    return TCL_ERROR;
+	} /* Ignore empty values */
+    }
+
+    *matchPtr = match;
+    return TCL_OK;
+}
+
+/* + AppendSearchMatch --
+ *	Add item, or the cell of item in dataColumn, to the search result.
+ */
+static int AppendSearchMatch(
+    Tcl_Interp *interp,
+    Treeview *tv,
+    SearchSpec *spec,
+    TreeItem *item,
+    int dataColumn)
+{
+    if (spec->type) {
+	if (Tcl_ListObjAppendElement(interp, spec->resultObj,
+		item->idObj) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else {
+	Tcl_Obj *elem[2];
+	elem[0] = item->idObj;
+	if (dataColumn == 0) {
+	    elem[1] = tv->tree.column0.idObj;
+	} else {
+	    elem[1] = tv->tree.columns[dataColumn-1].idObj;
+	}
+	if (Tcl_ListObjAppendElement(interp, spec->resultObj,
+		Tcl_NewListObj(2, elem)) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    spec->matches++;
+    return TCL_OK;
+}
+
+/* + SearchItemCells --
+ *	Compare the cells of item in search columns start up to (excluding)
+ *	end to the pattern and record matches. Stores in *matchPtr whether
+ *	the last cell examined matched.
+ */
+static int SearchItemCells(
+    Tcl_Interp *interp,
+    Treeview *tv,
+    SearchSpec *spec,
+    TreeItem *item,
+    Tcl_Size start,
+    Tcl_Size end,
+    Tcl_Size incr,
+    int *matchPtr)
+{
+    Tcl_Obj *valObj;
+    Tcl_Size i;
+    int match = 0;
+
+    for (i = start; i != end && i >= 0 && i < spec->lastCol; i += incr) {
+	if (spec->intArray[i] == 0) {
+	    valObj = item->textObj;
+	} else if (item->valuesObj == NULL) {
+	    valObj = spec->emptyObj;
+	} else if (Tcl_ListObjIndex(interp, item->valuesObj,
+		spec->intArray[i]-1, &valObj) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (!valObj) {
+	    valObj = spec->emptyObj;
+	}
+	if (SearchMatchValue(interp, spec, valObj, &match) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	/* If match, add item or cell id to result list */
+	if (match == !spec->notb) {
+	    match = 1;
+	    if (AppendSearchMatch(interp, tv, spec, item,
+		    spec->intArray[i]) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (spec->type || !spec->all) {
+		break;
+	    }
+	} else {
+	    match = 0;
+	}
+    }
+    *matchPtr = match;
+    return TCL_OK;
+}
+
+/* + SearchScopeIncludes --
+ *	Returns true if a search of parent's children with the given -hidden
+ *	and -recurse settings would visit item.
+ */
+static bool SearchScopeIncludes(
+    TreeItem *parent, TreeItem *item, bool hidden, bool recurse)
+{
+    if (item->hidden && !hidden) {
+	return false;
+    }
+    if (!recurse) {
+	return item->parent == parent;
+    }
+    for (item = item->parent; item && item != parent; item = item->parent) {
+	if (!hidden && (item->hidden || !(item->state & TTK_STATE_OPEN))) {
+	    return false;
+	}
+    }
+    return item == parent;
+}
+
+/* + SearchWithin --
+ *	Search only the items in itemsObj, typically the result of a
+ *	previous search, so that successive searches refine a result set.
+ */
+static int SearchWithin(
+    Tcl_Interp *interp,
+    Treeview *tv,
+    SearchSpec *spec,
+    TreeItem *parent,
+    Tcl_Obj *itemsObj,
+    Tcl_Size firstCol,
+    bool forwards,
+    bool hidden,
+    bool recurse)
+{
+    Tcl_Obj **itemv;
+    Tcl_Size k, nItems, start, end, incr;
+    TreeItem *item;
+    int match;
+
+    if (Tcl_ListObjGetElements(interp, itemsObj, &nItems, &itemv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    for (k = 0; k < nItems; ++k) {
+	if (!(item = FindItem(interp, tv, itemv[forwards ? k : nItems-1-k]))) {
+	    return TCL_ERROR;
+	}
+	if (!SearchScopeIncludes(parent, item, hidden, recurse)) {
+	    continue;
+	}
+	if (forwards) {
+	    start = firstCol;
+	    end = spec->lastCol;
+	    incr = 1;
+	} else {
+	    start = spec->lastCol-1;
+	    end = firstCol-1;
+	    incr = -1;
+	}
+	if (SearchItemCells(interp, tv, spec, item, start, end, incr,
+		&match) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (match && !spec->all) {
+	    break;
+	}
+    }
+    return TCL_OK;
+}
+
+/* + CompareBytes --
+ *	Bytewise comparison of counted strings, used to order search indexes.
+ */
+static int CompareBytes(
+    const char *s1, Tcl_Size len1, const char *s2, Tcl_Size len2)
+{
+    int result = memcmp(s1, s2, (size_t)(len1 < len2 ? len1 : len2));
+    if (result == 0) {
+	result = (len1 > len2) - (len1 < len2);
+    }
+    return result;
+}
+
+static int CompareSearchIndexEntries(const void *first, const void *second)
+{
+    const SearchIndexEntry *e1 = (const SearchIndexEntry *)first;
+    const SearchIndexEntry *e2 = (const SearchIndexEntry *)second;
+    return CompareBytes(e1->string, e1->length, e2->string, e2->length);
+}
+
+/* + GetSearchIndex --
+ *	Return the search index for data column dataColumn, building it
+ *	first if needed. Detached items are indexed too; callers must
+ *	check that matching items are within the search scope.
+ */
+static SearchIndex *GetSearchIndex(Treeview *tv, int dataColumn)
+{
+    TreeColumn *column = dataColumn == 0
+	    ? &tv->tree.column0 : tv->tree.columns + dataColumn - 1;
+    SearchIndex *index = column->searchIndex;
+    Tcl_HashSearch search;
+    Tcl_HashEntry *entryPtr;
+
+    if (index) {
+	return index;
+    }
+    index = (SearchIndex *)Tcl_Alloc(sizeof(SearchIndex));
+    index->nEntries = 0;
+    index->entries = (SearchIndexEntry *)Tcl_Alloc(
+	    sizeof(SearchIndexEntry) * (tv->tree.items.numEntries + 1));
+
+    for (entryPtr = Tcl_FirstHashEntry(&tv->tree.items, &search);
+	    entryPtr; entryPtr = Tcl_NextHashEntry(&search)) {
+	TreeItem *item = (TreeItem *)Tcl_GetHashValue(entryPtr);
+	Tcl_Obj *valObj = GetCellValue(item, dataColumn);
+	SearchIndexEntry *entry;
+
+	if (item == tv->tree.root || !valObj) {
+	    continue;
+	}
+	entry = index->entries + index->nEntries;
+	entry->string = Tcl_GetStringFromObj(valObj, &entry->length);
+	if (entry->length == 0) {
+	    continue;
+	}
+	entry->valueObj = valObj;
+	Tcl_IncrRefCount(valObj);
+	entry->item = item;
+	index->nEntries++;
+    }
+    qsort(index->entries, (size_t)index->nEntries,
+	    sizeof(SearchIndexEntry), CompareSearchIndexEntries);
+
+    column->searchIndex = index;
+    return index;
+}
+
+/* + SearchIndexLowerBound --
+ *	Return the position of the first index entry not less than key.
+ */
+static Tcl_Size SearchIndexLowerBound(
+    SearchIndex *index, const char *key, Tcl_Size keyLen)
+{
+    Tcl_Size low = 0, high = index->nEntries;
+
+    while (low < high) {
+	Tcl_Size mid = low + (high - low) / 2;
+	SearchIndexEntry *entry = index->entries + mid;
+	if (CompareBytes(entry->string, entry->length, key, keyLen) < 0) {
+	    low = mid + 1;
+	} else {
+	    high = mid;
+	}
+    }
+    return low;
+}
+
+/*
+ * Indexed search candidates are sorted into tree order before they are
+ * appended to the result.
+ */
+typedef struct {
+    int itemPos;		/* Preorder position of item */
+    Tcl_Size col;		/* Position in SearchSpec.intArray */
+    TreeItem *item;
+} SearchHit;
+
+static int CompareSearchHits(const void *first, const void *second)
+{
+    const SearchHit *h1 = (const SearchHit *)first;
+    const SearchHit *h2 = (const SearchHit *)second;
+
+    if (h1->itemPos != h2->itemPos) {
+	return (h1->itemPos > h2->itemPos) - (h1->itemPos < h2->itemPos);
+    }
+    return (h1->col > h2->col) - (h1->col < h2->col);
+}
+
+/* + SearchIndexKey --
+ *	Determine the literal prefix that every match must start with, if
+ *	the search can be answered from the search indexes. Returns the
+ *	length of the prefix in bytes, or 0 if the indexes cannot be used.
+ */
+static Tcl_Size SearchIndexKey(
+    Treeview *tv,
+    SearchSpec *spec,
+    TreeItem *parent,
+    Tcl_Size firstCol)
+{
+    Tcl_Size i, keyLen = 0;
+
+    if (!spec->all || spec->notb || spec->nocase
+	    || spec->dataType > TYPE_DICTIONARY) {
+	return 0;
+    }
+    if (spec->matchType == SEARCH_EXACT) {
+	keyLen = spec->plen;
+    } else if (spec->matchType == SEARCH_GLOB) {
+	keyLen = (Tcl_Size)strcspn(spec->pattern, "*?[\\");
+    }
+    if (keyLen == 0) {
+	return 0;
+    }
+
+    /* All searched columns must be indexed */
+    for (i = firstCol; i < spec->lastCol; ++i) {
+	int dataColumn = spec->intArray[i];
+	TreeColumn *column = dataColumn == 0
+		? &tv->tree.column0 : tv->tree.columns + dataColumn - 1;
+	if (!column->searchIndexed) {
+	    return 0;
+	}
+    }
+
+    /* Item positions are only maintained for items attached to the tree */
+    while (parent != tv->tree.root) {
+	if (!(parent = parent->parent)) {
+	    return 0;
+	}
+    }
+    return keyLen;
+}
+
+/* + SearchIndexed --
+ *	Forward -all search of all cells using the search indexes.
+ *	Gives the same result as a full traversal of parent's children.
+ */
+static int SearchIndexed(
+    Tcl_Interp *interp,
+    Treeview *tv,
+    SearchSpec *spec,
+    TreeItem *parent,
+    Tcl_Size firstCol,
+    Tcl_Size keyLen,
+    bool hidden,
+    bool recurse)
+{
+    SearchHit *hits = NULL;
+    Tcl_Size i, j, k, nHits = 0, maxHits = 0;
+    int result = TCL_ERROR;
+
+    if (tv->tree.rowPosNeedsUpdate) {
+	UpdatePositionTree(tv);
+    }
+
+    for (i = firstCol; i < spec->lastCol; ++i) {
+	int dataColumn = spec->intArray[i];
+	SearchIndex *index;
+	Tcl_Size first, last;
+
+	/* Each data column needs to be looked up only once */
+	for (j = firstCol; j < i; ++j) {
+	    if (spec->intArray[j] == dataColumn) {
+		break;
+	    }
+	}
+	if (j < i) {
+	    continue;
+	}
+	index = GetSearchIndex(tv, dataColumn);
+
+	/*
+	 * Candidates are all cells starting with the key and, for -exact,
+	 * all cells which are a prefix of the key.
+	 */
+	first = SearchIndexLowerBound(index, spec->pattern, keyLen);
+	last = first;
+	while (last < index->nEntries
+		&& index->entries[last].length >= keyLen
+		&& !memcmp(index->entries[last].string, spec->pattern,
+			(size_t)keyLen)) {
+	    ++last;
+	}
+	k = (spec->matchType == SEARCH_EXACT) ? 1 : keyLen;
+
+	for (; k <= keyLen; ++k) {
+	    Tcl_Size n, from = first, to = last;
+
+	    if (k < keyLen) {
+		from = to = SearchIndexLowerBound(index, spec->pattern, k);
+		while (to < index->nEntries
+			&& index->entries[to].length == k
+			&& !memcmp(index->entries[to].string, spec->pattern,
+				(size_t)k)) {
+		    ++to;
+		}
+	    }
+	    for (n = from; n < to; ++n) {
+		SearchIndexEntry *entry = index->entries + n;
+		int match;
+
+		if (!SearchScopeIncludes(parent, entry->item, hidden, recurse)) {
+		    continue;
+		}
+		if (SearchMatchValue(interp, spec, entry->valueObj,
+			&match) != TCL_OK) {
+		    goto done;
+		}
+		if (!match) {
+		    continue;
+		}
+		for (j = i; j < spec->lastCol; ++j) {
+		    if (spec->intArray[j] != dataColumn) {
+			continue;
+		    }
+		    if (nHits == maxHits) {
+			maxHits = maxHits ? 2 * maxHits : 64;
+			hits = (SearchHit *)(hits
+				? Tcl_Realloc(hits, sizeof(SearchHit) * maxHits)
+				: Tcl_Alloc(sizeof(SearchHit) * maxHits));
+		    }
+		    hits[nHits].itemPos = entry->item->itemPos;
+		    hits[nHits].col = j;
+		    hits[nHits].item = entry->item;
+		    ++nHits;
+		}
+	    }
+	}
+    }
+
+    if (nHits > 1) {
+	qsort(hits, (size_t)nHits, sizeof(SearchHit), CompareSearchHits);
+    }
+    for (i = 0; i < nHits; ++i) {
+	if (spec->type && i > 0 && hits[i].item == hits[i-1].item) {
+	    continue;
+	}
+	if (AppendSearchMatch(interp, tv, spec, hits[i].item,
+		spec->intArray[hits[i].col]) != TCL_OK) {
+	    goto done;
+	}
+    }
+    result = TCL_OK;
+
+done:
+    if (hits) {
+	Tcl_Free(hits);
+    }
+    return result;
+}
+
 /* + $tv search item ?-option value...? pattern
  */
 static int TreeviewSearchCommand(
@@ -5691,35 +6306,37 @@ static int TreeviewSearchCommand(
     TreeItem *parent, *startItem = NULL, *stopItem = NULL, *item;
     TreeColumn *startColumn = NULL, *stopColumn = NULL;
 
-    const char *pattern = NULL;
-    Tcl_Size i, plen, firstCol, lastCol, initCol, finalCol;
-    Tcl_Obj *patObj, *resultObj = NULL, *columnsObj = NULL, *valObj;
-    Tcl_Obj *emptyObj = NULL, *startObj = NULL, *stopObj = NULL;
-    Tcl_WideInt intVal;
-    double doubleVal;
+    Tcl_Size i, firstCol, lastCol, initCol, finalCol, keyLen;
+    Tcl_Obj *patObj, *columnsObj = NULL, *valObj;
+    Tcl_Obj *startObj = NULL, *stopObj = NULL, *withinObj = NULL;
     int index;
-    bool all = false, forwards = true, hidden = false, nocase = false, notb = false, recurse = false;
-    int *intArray = NULL, matches = 0;
-    bool wrap = false, type = true;
-    Tcl_RegExp regexp = NULL;
+    bool forwards = true, hidden = false, recurse = false;
+    int *intArray = NULL;
+    bool wrap = false;
+    SearchSpec spec;
 
-    enum {
-	SEARCH_ALL, SEARCH_ASCII, SEARCH_BACKWARDS, SEARCH_CELL, SEARCH_COLUMNS,
-	SEARCH_DICTIONARY, SEARCH_EXACT, SEARCH_FORWARDS, SEARCH_GLOB,
-	SEARCH_HIDDEN, SEARCH_INTEGER, SEARCH_NOCASE, SEARCH_NOT, SEARCH_REAL,
-	SEARCH_RECURSE, SEARCH_RECURSIVE, SEARCH_REGEXP, SEARCH_START,
-	SEARCH_STOP, SEARCH_UNICODE, SEARCH_WRAP
-    };
     static const char *const searchStrings[] = {
 	"-all", "-ascii", "-backwards", "-cell", "-columns", "-dictionary",
 	"-exact", "-forwards", "-glob", "-hidden", "-integer", "-nocase",
 	"-not", "-real", "-recurse", "-recursive", "-regexp", "-start",
-	"-stop", "-unicode", "-wraparound", NULL
+	"-stop", "-unicode", "-within", "-wraparound", NULL
     };
-    int matchType = SEARCH_EXACT;
-    sortModes_t dataType = TYPE_ASCII;
 
-    if (objc < 4 || objc > 25) {
+    spec.matchType = SEARCH_EXACT;
+    spec.dataType = TYPE_ASCII;
+    spec.nocase = spec.notb = spec.all = false;
+    spec.type = true;
+    spec.pattern = NULL;
+    spec.plen = 0;
+    spec.intVal = 0;
+    spec.doubleVal = 0.0;
+    spec.regexp = NULL;
+    spec.emptyObj = spec.resultObj = NULL;
+    spec.intArray = NULL;
+    spec.lastCol = 0;
+    spec.matches = 0;
+
+    if (objc < 4 || objc > 27) {
 	Tcl_WrongNumArgs(interp, 2, objv, "parent ?-options ...? pattern");
 	return TCL_ERROR;
     }
@@ -5737,17 +6354,17 @@ static int TreeviewSearchCommand(
 
 	switch (index) {
 	    case SEARCH_ALL:
-		all = true;
+		spec.all = true;
 		break;
 	    case SEARCH_ASCII:
 	    case SEARCH_UNICODE:
-		dataType = TYPE_ASCII;
+		spec.dataType = TYPE_ASCII;
 		break;
 	    case SEARCH_BACKWARDS:
 		forwards = false;
 		break;
 	    case SEARCH_CELL:
-		type = false;
+		spec.type = false;
 		break;
 	    case SEARCH_COLUMNS:
 		if (i == objc - 2) {
@@ -5758,39 +6375,39 @@ static int TreeviewSearchCommand(
 		columnsObj = objv[++i];
 		break;
 	    case SEARCH_DICTIONARY:
-		dataType = TYPE_DICTIONARY;
-		nocase = true;
+		spec.dataType = TYPE_DICTIONARY;
+		spec.nocase = true;
 		break;
 	    case SEARCH_EXACT:
-		matchType = SEARCH_EXACT;
+		spec.matchType = SEARCH_EXACT;
 		break;
 	    case SEARCH_FORWARDS:
 		forwards = true;
 		break;
 	    case SEARCH_GLOB:
-		matchType = SEARCH_GLOB;
+		spec.matchType = SEARCH_GLOB;
 		break;
 	    case SEARCH_HIDDEN:
 		hidden = true;
 		break;
 	    case SEARCH_INTEGER:
-		dataType = TYPE_INTEGER;
+		spec.dataType = TYPE_INTEGER;
 		break;
 	    case SEARCH_NOCASE:
-		nocase = true;
+		spec.nocase = true;
 		break;
 	    case SEARCH_NOT:
-		notb = true;
+		spec.notb = true;
 		break;
 	    case SEARCH_REAL:
-		dataType = TYPE_REAL;
+		spec.dataType = TYPE_REAL;
 		break;
 	    case SEARCH_RECURSE:
 	    case SEARCH_RECURSIVE:
 		recurse = true;
 		break;
 	    case SEARCH_REGEXP:
-		matchType = SEARCH_REGEXP;
+		spec.matchType = SEARCH_REGEXP;
 		break;
 	    case SEARCH_START:
 		if (i == objc - 2) {
@@ -5808,19 +6425,34 @@ static int TreeviewSearchCommand(
 		}
 		stopObj = objv[++i];
 		break;
+	    case SEARCH_WITHIN:
+		if (i == objc - 2) {
+		    Tcl_SetObjResult(interp, Tcl_ObjPrintf("no item list specified"));
+		    Tcl_SetErrorCode(interp, "TTK", "TREE", "ITEM", (char *)NULL);
+		    return TCL_ERROR;
+		}
+		withinObj = objv[++i];
+		break;
 	    case SEARCH_WRAP:
 		wrap = true;
 		break;
 	}
     }
 
+    if (withinObj && (startObj || stopObj || wrap)) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"-within cannot be combined with -start, -stop or -wraparound"));
+	Tcl_SetErrorCode(interp, "TTK", "TREE", "SEARCH", (char *)NULL);
+	return TCL_ERROR;
+    }
+
     /* Abort if no items to search */
     if (parent->children == NULL) {
 	return TCL_OK;
     }
 
     /* Get start and stop items or cells */
-    if (type) {
+    if (spec.type) {
 	if (startObj && !(startItem = FindItem(interp, tv, startObj))) {
 	    return TCL_ERROR;
 	}
@@ -5893,28 +6525,28 @@ static int TreeviewSearchCommand(
 
     /* Get native form of pattern */
     patObj = objv[objc-1];
-    if (dataType <= TYPE_DICTIONARY) {
-	if (!(pattern = Tcl_GetStringFromObj(patObj, &plen))) {
+    if (spec.dataType <= TYPE_DICTIONARY) {
+	if (!(spec.pattern = Tcl_GetStringFromObj(patObj, &spec.plen))) {
 	    return TCL_ERROR;
 	}
-    } else if (dataType == TYPE_INTEGER) {
-	if (Tcl_GetWideIntFromObj(interp, patObj, &intVal) != TCL_OK) {
+    } else if (spec.dataType == TYPE_INTEGER) {
+	if (Tcl_GetWideIntFromObj(interp, patObj, &spec.intVal) != TCL_OK) {
 	    return TCL_ERROR;
 	}
-    } else if (dataType == TYPE_REAL) {
-	if (Tcl_GetDoubleFromObj(interp, patObj, &doubleVal) != TCL_OK) {
+    } else if (spec.dataType == TYPE_REAL) {
+	if (Tcl_GetDoubleFromObj(interp, patObj, &spec.doubleVal) != TCL_OK) {
 	    return TCL_ERROR;
 	}
     }
 
     /* Compile Regexp */
-    if (matchType == SEARCH_REGEXP) {
-	regexp = Tcl_GetRegExpFromObj(interp, patObj, TCL_REG_ADVANCED |
-		TCL_REG_NOSUB | (nocase ? TCL_REG_NOCASE : 0));
-	if (!regexp) {
-	    regexp = Tcl_GetRegExpFromObj(interp, patObj, TCL_REG_ADVANCED |
-		(nocase ? TCL_REG_NOCASE : 0));
-	    if (!regexp) {
+    if (spec.matchType == SEARCH_REGEXP) {
+	spec.regexp = Tcl_GetRegExpFromObj(interp, patObj, TCL_REG_ADVANCED |
+		TCL_REG_NOSUB | (spec.nocase ? TCL_REG_NOCASE : 0));
+	if (!spec.regexp) {
+	    spec.regexp = Tcl_GetRegExpFromObj(interp, patObj, TCL_REG_ADVANCED |
+		(spec.nocase ? TCL_REG_NOCASE : 0));
+	    if (!spec.regexp) {
 		return TCL_ERROR;
 	    }
 	}
@@ -5984,13 +6616,31 @@ static int TreeviewSearchCommand(
 	    }
 	}
     }
+    spec.intArray = intArray;
+    spec.lastCol = lastCol;
 
     /* Create list of matching ids */
-    if (!(resultObj = Tcl_NewListObj(0,0)) ||
-	!(emptyObj = Tcl_NewStringObj("",0))) {
+    if (!(spec.resultObj = Tcl_NewListObj(0,0)) ||
+	!(spec.emptyObj = Tcl_NewStringObj("",0))) {
 	goto abort;
     }
 
+    /* Refine a previous result, or use the search indexes if possible */
+    if (withinObj) {
+	if (SearchWithin(interp, tv, &spec, parent, withinObj, firstCol,
+		forwards, hidden, recurse) != TCL_OK) {
+	    goto abort;
+	}
+	item = NULL;
+    } else if (forwards && !startObj && !stopObj
+	    && (keyLen = SearchIndexKey(tv, &spec, parent, firstCol)) > 0) {
+	if (SearchIndexed(interp, tv, &spec, parent, firstCol, keyLen,
+		hidden, recurse) != TCL_OK) {
+	    goto abort;
+	}
+	item = NULL;
+    }
+
     /* Loop over items, compare values to pattern, and add matches to result */
     while (item) {
 	int match = 0;
@@ -6023,101 +6673,14 @@ static int TreeviewSearchCommand(
 
 	/* Skip hidden items unless allowed */
 	if (!(item->hidden) || (item->hidden && hidden)) {
-	    Tcl_Size len;
-
-	    /* Loop over cell values and compare to pattern */
-	    for (i = start; i != end && i >= 0 && i < lastCol; i += incr) {
-		if (intArray[i] == 0) {
-		    valObj = item->textObj;
-		} else if (item->valuesObj == NULL) {
-		    valObj = emptyObj;
-		} else if (Tcl_ListObjIndex(interp, item->valuesObj, intArray[i]-1,
-			&valObj) != TCL_OK) {
-		    goto abort;
-		}
-		if (!valObj) {
-		    valObj = emptyObj;
-		}
-
-		/* Do ASCII/Unicode compare */
-		if (dataType <= TYPE_DICTIONARY) {
-		    if (matchType == SEARCH_EXACT) {
-			const char *string = Tcl_GetStringFromObj(valObj, &len);
-			Tcl_Size numChars = (len <= plen ? len : plen);
-
-			if (len == 0 && plen > 0) {
-			    match = 0; /* Empty cell should not match non empty pattern */
-			} else if (!nocase) {
-			    match = !Tcl_UtfNcmp(string, pattern, numChars);
-			} else {
-			    match = !Tcl_UtfNcasecmp(string, pattern, numChars);
-			}
-
-		    } else if (matchType == SEARCH_GLOB) {
-			match = Tcl_StringCaseMatch(Tcl_GetString(valObj),
-				pattern, nocase ? TCL_MATCH_NOCASE : 0);
-
-		    } else if (matchType == SEARCH_REGEXP) {
-			match = Tcl_RegExpExecObj(interp, regexp, valObj, 0, 0, 0);
-			if (match < 0) {
-			    goto abort;
-			}
-		    }
-
-		/* Do wide integer compare */
-		} else if (dataType == TYPE_INTEGER) {
-		    Tcl_WideInt val;
-
-		    if (Tcl_GetWideIntFromObj(interp, valObj, &val) == TCL_OK) {
-			match = (intVal == val);
-		    } else if (Tcl_GetStringFromObj(valObj, &len) && len > 0) {
-			goto abort;
-		    } /* Ignore empty values */
-
-		/* Do double value compare */
-		} else if (dataType == TYPE_REAL) {
-		    double val;
-
-		    if (Tcl_GetDoubleFromObj(interp, valObj, &val) == TCL_OK) {
-			match = (doubleVal == val);
-		    } else if (Tcl_GetStringFromObj(valObj, &len) && len > 0) {
-			goto abort;
-		    } /* Ignore empty values */
-		}
-
-		/* If match, add item or cell id to result list */
-		if (match == !notb) {
-		    match = 1;
-		    if (type) {
-			if (Tcl_ListObjAppendElement(interp, resultObj,
-				item->idObj) != TCL_OK) {
-			    goto abort;
-			}
-		    } else {
-			Tcl_Obj *elem[2];
-			elem[0] = item->idObj;
-			if (intArray[i] == 0) {
-			    elem[1] = tv->tree.column0.idObj;
-			} else {
-			    elem[1] = tv->tree.columns[intArray[i]-1].idObj;
-			}
-			if (Tcl_ListObjAppendElement(interp, resultObj,
-				Tcl_NewListObj(2, elem)) != TCL_OK) {
-			    goto abort;
-			}
-		    }
-		    matches++;
-		    if (type || !all) {
-			break;
-		    }
-		} else {
-		    match = 0;
-		}
+	    if (SearchItemCells(interp, tv, &spec, item, start, end, incr,
+		    &match) != TCL_OK) {
+		goto abort;
 	    }
 	}
 
 	/* Exit loop if match found and not all or at stop index (inclusive) */
-	if ((match && !all) || (item == stopItem)) {
+	if ((match && !spec.all) || (item == stopItem)) {
 	   break;
 	}
 
@@ -6135,7 +6698,7 @@ static int TreeviewSearchCommand(
 
 		/* Set item and column to new stop */
 		if (!stopItem) {
-		    if (type || initCol == firstCol) {
+		    if (spec.type || initCol == firstCol) {
 			stopItem = GetPrevItem(parent, startItem, hidden, recurse);
 		    } else {
 			stopItem = startItem; /* Inclusive */
@@ -6157,7 +6720,7 @@ static int TreeviewSearchCommand(
 
 		/* Set item and column to new stop */
 		if (!stopItem) {
-		    if (type || initCol == lastCol) {
+		    if (spec.type || initCol == lastCol) {
 			stopItem = GetNextItem(parent, startItem, hidden, recurse);
 			finalCol = initCol-1; /* Exclusive */
 		    } else {
@@ -6174,23 +6737,23 @@ static int TreeviewSearchCommand(
     if (intArray) {
 	Tcl_Free(intArray);
     }
-    if (emptyObj) {
-	Tcl_BounceRefCount(emptyObj);
+    if (spec.emptyObj) {
+	Tcl_BounceRefCount(spec.emptyObj);
     }
 
     /* Return list for all values or if not all, only the id object. */
-    if (all) {
-	Tcl_SetObjResult(interp, resultObj);
-    } else if (matches == 1) {
-	if (type && Tcl_ListObjIndex(interp, resultObj, 0, &valObj) == TCL_OK && valObj) {
+    if (spec.all) {
+	Tcl_SetObjResult(interp, spec.resultObj);
+    } else if (spec.matches == 1) {
+	if (spec.type && Tcl_ListObjIndex(interp, spec.resultObj, 0, &valObj) == TCL_OK && valObj) {
 	    Tcl_SetObjResult(interp, valObj);
-	    Tcl_BounceRefCount(resultObj);
+	    Tcl_BounceRefCount(spec.resultObj);
 	} else {
-	    Tcl_SetObjResult(interp, resultObj);
+	    Tcl_SetObjResult(interp, spec.resultObj);
 	}
      } else {
-	if (resultObj) {
-	    Tcl_BounceRefCount(resultObj);
+	if (spec.resultObj) {
+	    Tcl_BounceRefCount(spec.resultObj);
 	}
     }
     return TCL_OK;
@@ -6199,11 +6762,11 @@ abort:
     if (intArray) {
 	Tcl_Free(intArray);
     }
-    if (emptyObj) {
-	Tcl_BounceRefCount(emptyObj);
+    if (spec.emptyObj) {
+	Tcl_BounceRefCount(spec.emptyObj);
     }
-    if (resultObj) {
-	Tcl_BounceRefCount(resultObj);
+    if (spec.resultObj) {
+	Tcl_BounceRefCount(spec.resultObj);
     }
     return TCL_ERROR;
 }
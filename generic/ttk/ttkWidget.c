@@ -55,8 +55,7 @@ static void SizeChanged(WidgetCore *corePtr)
  */
 static Drawable BeginDrawing(Tk_Window tkwin)
 {
-    return Tk_GetPixmap(Tk_Display(tkwin), Tk_WindowId(tkwin),
-	    Tk_Width(tkwin), Tk_Height(tkwin), Tk_Depth(tkwin));
+    return TkGetBufferPixmap(tkwin, Tk_Width(tkwin), Tk_Height(tkwin));
 }
 
 /* EndDrawing --
@@ -75,7 +74,7 @@ static void EndDrawing(Tk_Window tkwin, Drawable d)
 	    0, 0, (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin),
 	    0, 0);
 
-    Tk_FreePixmap(Tk_Display(tkwin), d);
+    TkFreeBufferPixmap(Tk_Display(tkwin), d);
     Tk_FreeGC(Tk_Display(tkwin), gc);
 }
 #else
@@ -97,10 +96,12 @@ static void DrawWidget(void *recordPtr)
 
     corePtr->flags &= ~REDISPLAY_PENDING;
     if (Tk_IsMapped(corePtr->tkwin)) {
+	Tcl_WideInt perfStart = TkPerfStart();
 	Drawable d = BeginDrawing(corePtr->tkwin);
 	corePtr->widgetSpec->layoutProc(recordPtr);
 	corePtr->widgetSpec->displayProc(recordPtr, d);
 	EndDrawing(corePtr->tkwin, d);
+	TkPerfStop(TK_PERF_DISPLAY, perfStart);
     }
 }
 
@@ -188,11 +188,13 @@ TkpDisplayButton(
     DrawParams* dpPtr = &macButtonPtr->drawParams;
     int needhighlight = 0;
     int highlightWidth;
+    Tcl_WideInt perfStart;
 
     butPtr->flags &= ~REDRAW_PENDING;
     if ((butPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
     pixmap = (Pixmap) Tk_WindowId(tkwin);
 
     Tk_GetPixelsFromObj(NULL, tkwin, butPtr->highlightWidthObj, &highlightWidth);
@@ -248,6 +250,7 @@ TkpDisplayButton(
 	    TkMacOSXDrawSolidBorder(tkwin, gc, 0, highlightWidth);
 	}
     }
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
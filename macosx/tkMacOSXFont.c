@@ -976,8 +976,12 @@ Tk_MeasureChars(
     int *lengthPtr)		/* Filled with x-location just after the
 				 * terminating character. */
 {
-    return Tk_MeasureCharsInContext(tkfont, source, numBytes, 0, numBytes,
-	    maxLength, flags, lengthPtr);
+    Tcl_WideInt perfStart = TkPerfStart();
+    int result = Tk_MeasureCharsInContext(tkfont, source, numBytes, 0,
+	    numBytes, maxLength, flags, lengthPtr);
+
+    TkPerfStop(TK_PERF_MEASURE, perfStart);
+    return result;
 }
 
 /*
@@ -171,11 +171,13 @@ TkpDisplayMenuButton(
     Pixmap pixmap;
     DrawParams *dpPtr = &mbPtr->drawParams;
     int highlightWidth;
+    Tcl_WideInt perfStart;
 
     butPtr->flags &= ~REDRAW_PENDING;
     if ((butPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     pixmap = (Pixmap) Tk_WindowId(tkwin);
 
@@ -198,6 +200,7 @@ TkpDisplayMenuButton(
 	    TkMacOSXDrawSolidBorder(tkwin, gc, 0, highlightWidth);
 	}
     }
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -249,6 +249,7 @@ TkpDisplayScrollbar(
     TkWindow *winPtr = (TkWindow *) tkwin;
     TkMacOSXDrawingContext dc;
     int borderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     scrollPtr->flags &= ~REDRAW_PENDING;
 
@@ -263,6 +264,7 @@ TkpDisplayScrollbar(
 	    || !TkMacOSXSetupDrawingContext((Drawable)macWin, NULL, &dc)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     /*
      * Transform NSView coordinates to CoreGraphics coordinates.
@@ -326,6 +328,7 @@ TkpDisplayScrollbar(
     }
     TkMacOSXRestoreDrawingContext(&dc);
     scrollPtr->flags &= ~REDRAW_PENDING;
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -164,6 +164,7 @@ testConstraint nonUnixUserInteraction [expr {
 testConstraint deprecated [expr {![::tk::build-info no-deprecate]}]
 
 # constraints for testing facilities defined in the tktest executable
+testConstraint testarrange     [llength [info commands testarrange]]
 testConstraint testbitmap      [llength [info commands testbitmap]]
 testConstraint testborder      [llength [info commands testborder]]
 testConstraint testcbind       [llength [info commands testcbind]]
@@ -0,0 +1,242 @@
+# widgets.tcl --
+#
+# This file measures the cost of creating, configuring, mapping, redrawing
+# and destroying each of the core and ttk widget classes. It must be run
+# with tktest, which provides the "testperf" command, for example under
+# Xvfb:
+#
+#	xvfb-run ./tktest ../tests/perf/widgets.tcl -count 200
+#
+# Each measurement is written as one JSON object per line, so that results
+# from different builds can be compared by a script.
+#
+# Copyright © 2026 the Tk developers.
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+package require tk
+
+namespace eval ::perf {
+    # Number of widgets handled in each phase, and number of full redraws.
+    variable count 100
+    variable redraws 10
+    variable classes {}
+    variable output stdout
+
+    # Arguments used when creating widgets of a class, and two sets of
+    # options that are alternately applied in the "configure" phase.
+    variable specs {
+	button		{-text Button}
+			{-text Press -borderwidth 3} {-text Button -borderwidth 1}
+	checkbutton	{-text Check}
+			{-text Checked -padx 4} {-text Check -padx 1}
+	radiobutton	{-text Radio}
+			{-text Radio2 -padx 4} {-text Radio -padx 1}
+	label		{-text Label}
+			{-text "Long label" -borderwidth 2} {-text Label -borderwidth 0}
+	labelframe	{-text Group}
+			{-text Group2 -borderwidth 3} {-text Group -borderwidth 1}
+	frame		{-width 40 -height 20}
+			{-width 50 -relief raised} {-width 40 -relief flat}
+	entry		{-width 10}
+			{-width 12 -justify right} {-width 10 -justify left}
+	spinbox		{-from 0 -to 10}
+			{-width 8 -wrap 1} {-width 6 -wrap 0}
+	listbox		{-height 3}
+			{-height 4 -selectmode extended} {-height 3 -selectmode browse}
+	text		{-width 10 -height 2}
+			{-width 12 -wrap word} {-width 10 -wrap char}
+	canvas		{-width 40 -height 20}
+			{-width 50 -background gray} {-width 40 -background white}
+	scale		{-from 0 -to 100}
+			{-length 80 -orient horizontal} {-length 60 -orient vertical}
+	scrollbar	{}
+			{-width 14 -orient horizontal} {-width 10 -orient vertical}
+	message		{-text Message}
+			{-text "Longer message" -aspect 200} {-text Message -aspect 150}
+	menubutton	{-text Menu}
+			{-text Menu2 -indicatoron 1} {-text Menu -indicatoron 0}
+	panedwindow	{-width 40 -height 20}
+			{-sashwidth 4 -orient vertical} {-sashwidth 2 -orient horizontal}
+	ttk::button	{-text Button}
+			{-text Press -width 8} {-text Button -width 6}
+	ttk::checkbutton {-text Check}
+			{-text Checked -width 8} {-text Check -width 6}
+	ttk::radiobutton {-text Radio}
+			{-text Radio2 -width 8} {-text Radio -width 6}
+	ttk::label	{-text Label}
+			{-text "Long label" -padding 2} {-text Label -padding 0}
+	ttk::labelframe	{-text Group}
+			{-text Group2 -padding 3} {-text Group -padding 1}
+	ttk::frame	{-width 40 -height 20}
+			{-width 50 -padding 2} {-width 40 -padding 0}
+	ttk::entry	{-width 10}
+			{-width 12 -justify right} {-width 10 -justify left}
+	ttk::spinbox	{-from 0 -to 10}
+			{-width 8 -wrap 1} {-width 6 -wrap 0}
+	ttk::combobox	{-values {a b c}}
+			{-width 12 -justify right} {-width 10 -justify left}
+	ttk::treeview	{-height 3}
+			{-height 4 -show tree} {-height 3 -show headings}
+	ttk::notebook	{-width 40 -height 20}
+			{-width 50 -padding 2} {-width 40 -padding 0}
+	ttk::progressbar {-value 30}
+			{-length 80 -value 60} {-length 60 -value 30}
+	ttk::scale	{-from 0 -to 100}
+			{-length 80 -orient horizontal} {-length 60 -orient vertical}
+	ttk::scrollbar	{}
+			{-orient horizontal} {-orient vertical}
+	ttk::separator	{}
+			{-orient vertical} {-orient horizontal}
+	ttk::menubutton	{-text Menu}
+			{-text Menu2 -width 8} {-text Menu -width 6}
+	ttk::panedwindow {-width 40 -height 20}
+			{-width 50 -orient vertical} {-width 40 -orient horizontal}
+	ttk::sizegrip	{}
+			{-cursor watch} {-cursor {}}
+    }
+}
+
+# ::perf::Json --
+#
+#	Format a dictionary as a JSON object. Values that are integers are
+#	written as numbers, everything else as strings.
+
+proc ::perf::Json {dict} {
+    set fields {}
+    dict for {key value} $dict {
+	if {[string is entier -strict $value]} {
+	    lappend fields "\"$key\":$value"
+	} else {
+	    set value [string map {\\ \\\\ \" \\\" \n \\n \t \\t} $value]
+	    lappend fields "\"$key\":\"$value\""
+	}
+    }
+    return "\{[join $fields ,]\}"
+}
+
+# ::perf::Phase --
+#
+#	Run one "testperf" measurement and write its result, together with
+#	the "tk perf" counters collected while it ran.
+
+proc ::perf::Phase {class phase args} {
+    variable output
+
+    tk perf reset
+    set result [testperf {*}$args]
+    dict for {name counter} [tk perf counters] {
+	dict set result ${name}_calls [dict get $counter calls]
+	dict set result ${name}_usec [dict get $counter usec]
+    }
+    puts $output [Json [dict merge [dict create \
+	    tk [info patchlevel] windowingsystem [tk windowingsystem] \
+	    class $class phase $phase] $result]]
+    flush $output
+}
+
+# ::perf::Measure --
+#
+#	Run all phases for one widget class. The widgets are created in the
+#	toplevel .perf, which is shown so that mapping and redrawing really
+#	reach the display.
+
+proc ::perf::Measure {class createArgs config1 config2} {
+    variable count
+    variable redraws
+    variable i
+
+    toplevel .perf
+    wm geometry .perf 640x480+0+0
+    grid propagate .perf 0
+    update
+
+    set i 0
+    Phase $class create time $count [list apply {{class args} {
+	$class .perf.w[incr ::perf::i] {*}$args
+    }} $class {*}$createArgs]
+
+    set i 0
+    Phase $class configure time $count [list apply {{c1 c2} {
+	set n [incr ::perf::i]
+	.perf.w$n configure {*}[expr {$n % 2 ? $c1 : $c2}]
+    }} $config1 $config2]
+
+    set i 0
+    Phase $class map time $count {
+	set n [incr ::perf::i]
+	grid .perf.w$n -row [expr {$n / 10}] -column [expr {$n % 10}]
+    }
+
+    Phase $class redraw redraw .perf $redraws
+
+    set i 0
+    Phase $class destroy time $count {
+	destroy .perf.w[incr ::perf::i]
+    }
+
+    destroy .perf
+}
+
+# ::perf::Main --
+#
+#	Parse the command line and measure the requested widget classes.
+
+proc ::perf::Main {argv} {
+    variable specs
+    variable count
+    variable redraws
+    variable classes
+    variable output
+
+    if {[info commands testperf] eq ""} {
+	return -code error "this script must be run with tktest"
+    }
+    if {[llength $argv] % 2} {
+	return -code error "usage: widgets.tcl ?-count n? ?-redraws n?\
+		?-classes list? ?-output file?"
+    }
+    foreach {option value} $argv {
+	switch -- $option {
+	    -count {set count $value}
+	    -redraws {set redraws $value}
+	    -classes {set classes $value}
+	    -output {set output [open $value w]}
+	    default {
+		return -code error "unknown option \"$option\""
+	    }
+	}
+    }
+    if {![llength $classes]} {
+	set classes [dict keys $specs]
+    }
+
+    wm withdraw .
+    tk perf enable 1
+    foreach class $classes {
+	if {![dict exists $specs $class]} {
+	    return -code error "unknown widget class \"$class\""
+	}
+	Measure $class {*}[dict get $specs $class]
+    }
+    if {$output ne "stdout"} {
+	close $output
+    }
+}
+
+# The specs list each class with its three fields over two lines; fold
+# them into a dictionary of lists.
+set ::perf::specs [apply {{specs} {
+    set result {}
+    foreach {class createArgs config1 config2} $specs {
+	dict set result $class [list $createArgs $config1 $config2]
+    }
+    return $result
+}} $::perf::specs]
+
+if {[catch {::perf::Main $argv} msg]} {
+    puts stderr $msg
+    exit 1
+}
+exit 0
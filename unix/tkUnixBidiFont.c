@@ -2183,8 +2183,12 @@ Tk_MeasureChars(
 	int flags,
 	int *lengthPtr)
 {
-       return Tk_MeasureCharsInContext(tkfont, source, numBytes, 0, numBytes,
-		maxLength, flags, lengthPtr);
+    Tcl_WideInt perfStart = TkPerfStart();
+    int result = Tk_MeasureCharsInContext(tkfont, source, numBytes, 0,
+	    numBytes, maxLength, flags, lengthPtr);
+
+    TkPerfStop(TK_PERF_MEASURE, perfStart);
+    return result;
 }
 
 /*
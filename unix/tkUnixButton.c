@@ -450,11 +450,13 @@ TkpDisplayButton(
 				/* image information that will be used to
 				 * restrict disabled pixmap as well */
     int padX, padY, borderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     butPtr->flags &= ~REDRAW_PENDING;
     if ((butPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     border = butPtr->normalBorder;
     if ((butPtr->state == STATE_DISABLED) && (butPtr->disabledFg != NULL)) {
@@ -886,6 +888,7 @@ TkpDisplayButton(
 	    butPtr->copyGC, 0, 0, (unsigned) Tk_Width(tkwin),
 	    (unsigned) Tk_Height(tkwin), 0, 0);
     Tk_FreePixmap(butPtr->display, pixmap);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
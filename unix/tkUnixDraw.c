@@ -21,7 +21,31 @@
 #define TK_XRENDER_MIN_AREA (64 * 64)
 				/* Use XRender only at or above this many
 				 * pixels; below it the software blend is
-				 * faster (see TkpPutRGBAImage). */
+				 * faster (see TkpCompositeRGBAImage). */
+#endif
+
+#ifdef HAVE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+
+#define TK_XSHM_MIN_AREA (64 * 64)
+				/* Upload through shared memory only at or
+				 * above this many pixels; smaller blocks are
+				 * cheaper to send with XPutImage, which does
+				 * not wait for the server. */
+
+/*
+ * A shared memory segment attached to the X server, reused for successive
+ * uploads by one photo instance. It only ever grows.
+ */
+
+struct TkShmSegment {
+    XShmSegmentInfo info;	/* Segment as known to Xlib and the server;
+				 * info.shmaddr is NULL when nothing is
+				 * attached. */
+    size_t size;		/* Size of the segment in bytes. */
+};
 #endif
 
 /*
@@ -247,14 +271,16 @@ TkpDrawFrameEx(
 /*
  *----------------------------------------------------------------------
  *
- * TkpPutRGBAImage --
+ * TkpCompositeRGBAImage --
  *
  *	Composite an RGBA image (4 bytes/pixel, NOT premultiplied) onto a
  *	drawable with XRenderComposite (Porter-Duff
  *	source-over).  Called by TkImgPhotoDisplay for partial-alpha photos
  *	in place of the software BlendComplexAlpha path, which reads the
  *	destination back with XGetImage and blends per pixel on the CPU.
- *	Works for both window and pixmap drawables.
+ *	Works for both window and pixmap drawables.  The caller supplies the
+ *	drawable's depth and screen, which it knows from the photo instance's
+ *	visual, so no round trip to the server is needed.
  *
  * Results:
  *	Success, or BadDrawable when the composite could not be performed
@@ -268,19 +294,18 @@ TkpDrawFrameEx(
  */
 
 int
-TkpPutRGBAImage(
+TkpCompositeRGBAImage(
     Display *display,
-    Drawable drawable,
-    GC gc,			/* Unused: the composite is unclipped, like
-				 * the macOS and Windows implementations. */
+    Drawable drawable,		/* Drawable to composite onto; unclipped, like
+				 * the macOS and Windows TkpPutRGBAImage. */
+    int depth,			/* Depth of drawable. */
+    int screen,			/* Screen of drawable. */
     XImage *image,		/* Source image; RGBA, not premultiplied. */
     int src_x, int src_y,	/* Top-left of the sub-rect within image. */
     int dest_x, int dest_y,	/* Top-left within drawable. */
     unsigned int width, unsigned int height)
 {
-    Window root;
-    int x, y, eventBase, errorBase, screen = -1, i;
-    unsigned int gw, gh, bw, depth;
+    int eventBase, errorBase;
     XRenderPictFormat *srcFmt, *dstFmt = NULL;
     Pixmap srcPix;
     GC srcGC;
@@ -288,18 +313,17 @@ TkpPutRGBAImage(
     XImage *argb;
     char *buf;
     int w = (int) width, h = (int) height;
-    (void) gc;
 
     if (w <= 0 || h <= 0) {
 	return Success;
     }
 
     /*
-     * Below this area the fixed per-call cost (XGetGeometry round trip,
-     * scratch pixmap/picture churn) outweighs the read-back and CPU blend
-     * it replaces, so small composites are better off on the caller's
-     * software path.  Measured crossover on a software-RENDER server
-     * (Xwayland/pixman) is ~100x100; accelerated servers cross lower.
+     * Below this area the fixed per-call cost (scratch pixmap/picture
+     * churn) outweighs the read-back and CPU blend it replaces, so small
+     * composites are better off on the caller's software path. Measured
+     * crossover on a software-RENDER server (Xwayland/pixman) is ~100x100;
+     * accelerated servers cross lower.
      */
 
     if ((unsigned long) w * h < TK_XRENDER_MIN_AREA) {
@@ -309,28 +333,12 @@ TkpPutRGBAImage(
 	return BadDrawable;
     }
 
-    /*
-     * One round trip: only a Drawable is passed in, so ask the server for
-     * its depth (and its root window, to identify the screen).
-     */
-
-    if (!XGetGeometry(display, drawable, &root, &x, &y, &gw, &gh, &bw,
-	    &depth)) {
-	return BadDrawable;
-    }
-    for (i = 0; i < ScreenCount(display); i++) {
-	if (RootWindow(display, i) == root) {
-	    screen = i;
-	    break;
-	}
-    }
-
     if (depth == 32) {
 	dstFmt = XRenderFindStandardFormat(display, PictStandardARGB32);
     } else if (depth == 24) {
 	dstFmt = XRenderFindStandardFormat(display, PictStandardRGB24);
-    } else if (screen >= 0
-	    && depth == (unsigned) DefaultDepth(display, screen)) {
+    } else if (screen >= 0 && screen < ScreenCount(display)
+	    && depth == DefaultDepth(display, screen)) {
 	dstFmt = XRenderFindVisualFormat(display,
 		DefaultVisual(display, screen));
     }
@@ -377,6 +385,275 @@ TkpPutRGBAImage(
     return Success;
 }
 #endif /* HAVE_XRENDER */
+
+#ifdef HAVE_XSHM
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmErrorProc --
+ *
+ *	Error handler used while attaching a segment to the server. Records
+ *	that the attach failed (e.g. the server is not on this host after
+ *	all) and swallows the error.
+ *
+ * Results:
+ *	Always 0, meaning the error has been handled.
+ *
+ * Side effects:
+ *	Sets the integer pointed to by clientData.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ShmErrorProc(
+    void *clientData,
+    TCL_UNUSED(XErrorEvent *))
+{
+    *(int *) clientData = 1;
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmDisplayUsable --
+ *
+ *	Decides, once per display, whether shared memory uploads should be
+ *	tried at all. The server must be reached through a local transport
+ *	and must support MIT-SHM; setting the environment variable TK_NO_XSHM
+ *	disables the path.
+ *
+ * Results:
+ *	1 if shared memory may be used on this display, 0 otherwise.
+ *
+ * Side effects:
+ *	Caches the result in the display's flags.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ShmDisplayUsable(
+    Display *display)
+{
+    TkDisplay *dispPtr = TkGetDisplay(display);
+    const char *name;
+
+    if (dispPtr == NULL) {
+	return 0;
+    }
+    if (!(dispPtr->flags & TK_DISPLAY_SHM_CHECKED)) {
+	dispPtr->flags |= TK_DISPLAY_SHM_CHECKED;
+	name = DisplayString(display);
+	if (getenv("TK_NO_XSHM") == NULL && name != NULL
+		&& (name[0] == ':' || strncmp(name, "unix:", 5) == 0)
+		&& XShmQueryExtension(display)) {
+	    dispPtr->flags |= TK_DISPLAY_SHM_USABLE;
+	}
+    }
+    return (dispPtr->flags & TK_DISPLAY_SHM_USABLE) != 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmDetach --
+ *
+ *	Detaches a segment from the server and from this process.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The segment is released; its memory goes away once the server has
+ *	detached as well.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ShmDetach(
+    Display *display,
+    TkShmSegment *segPtr)
+{
+    if (segPtr->info.shmaddr != NULL) {
+	XShmDetach(display, &segPtr->info);
+	shmdt(segPtr->info.shmaddr);
+	segPtr->info.shmaddr = NULL;
+	segPtr->size = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkpShmCreateImage --
+ *
+ *	Creates a ZPixmap image whose pixel data lives in shared memory, ready
+ *	to be filled in by the caller and sent with TkpShmPutImage. The
+ *	segment is kept in *segmentPtrPtr and reused by later calls; it is
+ *	replaced by a larger one when the image does not fit.
+ *
+ * Results:
+ *	The image, or NULL if shared memory cannot be used for it (remote or
+ *	unsupported display, block too small, or the segment could not be
+ *	created or attached). The caller must set the image's data field to
+ *	NULL before destroying it.
+ *
+ * Side effects:
+ *	May create and attach a shared memory segment. A failed attach
+ *	disables shared memory for the whole display.
+ *
+ *----------------------------------------------------------------------
+ */
+
+XImage *
+TkpShmCreateImage(
+    Display *display,
+    Visual *visual,
+    int depth,
+    int width, int height,
+    TkShmSegment **segmentPtrPtr)
+{
+    TkShmSegment *segPtr = *segmentPtrPtr;
+    XImage *image;
+    size_t size;
+    Tk_ErrorHandler handler;
+    int failed = 0;
+
+    if (width <= 0 || height <= 0
+	    || (unsigned long) width * height < TK_XSHM_MIN_AREA
+	    || !ShmDisplayUsable(display)) {
+	return NULL;
+    }
+    if (segPtr == NULL) {
+	segPtr = (TkShmSegment *)Tcl_Alloc(sizeof(TkShmSegment));
+	memset(segPtr, 0, sizeof(TkShmSegment));
+	segPtr->info.shmid = -1;
+	*segmentPtrPtr = segPtr;
+    }
+
+    image = XShmCreateImage(display, visual, (unsigned) depth, ZPixmap,
+	    NULL, &segPtr->info, (unsigned) width, (unsigned) height);
+    if (image == NULL) {
+	return NULL;
+    }
+    size = (size_t) image->bytes_per_line * height;
+    if (size <= segPtr->size) {
+	image->data = segPtr->info.shmaddr;
+	return image;
+    }
+
+    /*
+     * Grow the segment, with some slack so that an image being filled in
+     * by successively larger blocks does not replace it every time.
+     */
+
+    ShmDetach(display, segPtr);
+    size += size / 4;
+    segPtr->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (segPtr->info.shmid < 0) {
+	goto error;
+    }
+    segPtr->info.shmaddr = (char *) shmat(segPtr->info.shmid, NULL, 0);
+    if (segPtr->info.shmaddr == (char *) -1) {
+	segPtr->info.shmaddr = NULL;
+	shmctl(segPtr->info.shmid, IPC_RMID, NULL);
+	goto error;
+    }
+    segPtr->info.readOnly = True;
+
+    /*
+     * The attach is the first point at which the server itself touches the
+     * segment, so wait for it to succeed. Marking the segment for removal
+     * right afterwards means it cannot leak even if we die.
+     */
+
+    handler = Tk_CreateErrorHandler(display, -1, -1, -1, ShmErrorProc,
+	    &failed);
+    XShmAttach(display, &segPtr->info);
+    XSync(display, False);
+    Tk_DeleteErrorHandler(handler);
+    shmctl(segPtr->info.shmid, IPC_RMID, NULL);
+    if (failed) {
+	shmdt(segPtr->info.shmaddr);
+	segPtr->info.shmaddr = NULL;
+	TkGetDisplay(display)->flags &= ~TK_DISPLAY_SHM_USABLE;
+	goto error;
+    }
+    segPtr->size = size;
+    image->data = segPtr->info.shmaddr;
+    return image;
+
+  error:
+    segPtr->info.shmid = -1;
+    image->data = NULL;
+    XDestroyImage(image);
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkpShmPutImage --
+ *
+ *	Copies an image created by TkpShmCreateImage to a drawable.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Draws onto the drawable. Waits for the server to finish reading the
+ *	segment, so the caller may overwrite it as soon as this returns.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkpShmPutImage(
+    Display *display,
+    Drawable drawable,
+    GC gc,
+    XImage *image,
+    int dest_x, int dest_y,
+    unsigned int width, unsigned int height)
+{
+    Tcl_WideInt perfStart;
+
+    XShmPutImage(display, drawable, gc, image, 0, 0, dest_x, dest_y,
+	    width, height, False);
+    perfStart = TkPerfStart();
+    XSync(display, False);
+    TkPerfStop(TK_PERF_ROUNDTRIP, perfStart);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkpShmFreeSegment --
+ *
+ *	Releases a segment created by TkpShmCreateImage.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The segment is detached and its memory freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkpShmFreeSegment(
+    Display *display,
+    TkShmSegment *segmentPtr)
+{
+    ShmDetach(display, segmentPtr);
+    Tcl_Free(segmentPtr);
+}
+#endif /* HAVE_XSHM */
 
 /*
  * Local Variables:
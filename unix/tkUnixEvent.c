@@ -166,6 +166,9 @@ TkpOpenDisplay(
     dispPtr = (TkDisplay *)Tcl_Alloc(sizeof(TkDisplay));
     memset(dispPtr, 0, sizeof(TkDisplay));
     dispPtr->display = display;
+    if (getenv("TK_NO_BATCH_REQUESTS") == NULL) {
+	dispPtr->flags |= TK_DISPLAY_BATCH_REQUESTS;
+    }
 #ifdef TK_USE_INPUT_METHODS
     XSetLocaleModifiers("");
     OpenIM(dispPtr);
@@ -292,7 +295,9 @@ TkClipCleanup(
  * Side effects:
  *	If data is queued on a display inside Xlib, then the maximum block
  *	time will be set to 0 to ensure that the notifier returns control to
- *	Tcl even if there is no more data on the X connection.
+ *	Tcl even if there is no more data on the X connection. Otherwise the
+ *	display's output buffer is flushed, since the notifier may block.
+ *	Displays that do not batch requests are always flushed.
  *
  *----------------------------------------------------------------------
  */
@@ -313,15 +318,20 @@ DisplaySetupProc(
     for (dispPtr = TkGetDisplayList(); dispPtr != NULL;
 	    dispPtr = dispPtr->nextPtr) {
 	/*
-	 * Flush the display. If data is pending on the X queue, set the block
-	 * time to zero. This ensures that we won't block in the notifier if
-	 * there is data in the X queue, but not on the server socket.
+	 * If data is pending on the X queue, set the block time to zero. This
+	 * ensures that we won't block in the notifier if there is data in the
+	 * X queue, but not on the server socket. The requests generated while
+	 * handling those events are then sent together, once the queue has
+	 * drained and the notifier may wait for the server.
 	 */
 
-	XFlush(dispPtr->display);
 	if (QLength(dispPtr->display) > 0) {
 	    Tcl_SetMaxBlockTime(&blockTime);
+	    if (dispPtr->flags & TK_DISPLAY_BATCH_REQUESTS) {
+		continue;
+	    }
 	}
+	XFlush(dispPtr->display);
     }
 }
 
@@ -446,7 +456,14 @@ DisplayCheckProc(
 
     for (dispPtr = TkGetDisplayList(); dispPtr != NULL;
 	    dispPtr = dispPtr->nextPtr) {
-	XFlush(dispPtr->display);
+	/*
+	 * DisplaySetupProc has flushed the display already, unless there was
+	 * no need to.
+	 */
+
+	if (!(dispPtr->flags & TK_DISPLAY_BATCH_REQUESTS)) {
+	    XFlush(dispPtr->display);
+	}
 	TransferXEventsToTcl(dispPtr->display);
     }
 }
@@ -544,6 +561,7 @@ TkUnixDoOneXEvent(
     Tcl_Time now;
     int fd, index, numFound, numFdBits = 0;
     fd_mask bit, *readMaskPtr = readMask;
+    bool queued = false;
 
     /*
      * Look for queued events first.
@@ -580,16 +598,26 @@ TkUnixDoOneXEvent(
 
     /*
      * Set up the select mask for all of the displays. If a display has data
-     * pending, then we want to poll instead of blocking.
+     * pending, then we want to poll instead of blocking. Displays that batch
+     * their requests are only flushed when we may block, so that the events
+     * already queued are handled before anything is sent.
      */
 
-    memset(readMask, 0, MASK_SIZE*sizeof(fd_mask));
     for (dispPtr = TkGetDisplayList(); dispPtr != NULL;
 	    dispPtr = dispPtr->nextPtr) {
-	XFlush(dispPtr->display);
 	if (QLength(dispPtr->display) > 0) {
 	    blockTime.tv_sec = 0;
 	    blockTime.tv_usec = 0;
+	    timeoutPtr = &blockTime;
+	    queued = true;
+	    break;
+	}
+    }
+    memset(readMask, 0, MASK_SIZE*sizeof(fd_mask));
+    for (dispPtr = TkGetDisplayList(); dispPtr != NULL;
+	    dispPtr = dispPtr->nextPtr) {
+	if (!queued || !(dispPtr->flags & TK_DISPLAY_BATCH_REQUESTS)) {
+	    XFlush(dispPtr->display);
 	}
 	fd = ConnectionNumber(dispPtr->display);
 	index = fd/(NBBY*(int)sizeof(fd_mask));
@@ -671,13 +699,17 @@ void
 TkpSync(
     Display *display)		/* Display to sync. */
 {
+    Tcl_WideInt perfStart = TkPerfStart();
+
     XSync(display, False);
+    TkPerfStop(TK_PERF_ROUNDTRIP, perfStart);
 
     /*
      * Transfer events from the X event queue to the Tk event queue.
      */
 
     TransferXEventsToTcl(display);
+    TkPerfStop(TK_PERF_SYNC, perfStart);
 }
 #ifdef TK_USE_INPUT_METHODS
 
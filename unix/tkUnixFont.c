@@ -838,6 +838,7 @@ Tk_MeasureChars(
     SubFont *lastSubFontPtr;
     Tcl_Size curByte;
     int curX, ch;
+    Tcl_WideInt perfStart = TkPerfStart();
 
     /*
      * Unix does not use kerning or fractional character widths when
@@ -996,6 +997,7 @@ Tk_MeasureChars(
     }
 
     *lengthPtr = curX;
+    TkPerfStop(TK_PERF_MEASURE, perfStart);
     return curByte;
 }
 
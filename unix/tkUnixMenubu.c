@@ -76,11 +76,13 @@ TkpDisplayMenuButton(
     int haveImage = 0, haveText = 0;
     int padX, padY;
     int mbPtrBorderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     mbPtr->flags &= ~REDRAW_PENDING;
     if ((mbPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     if ((mbPtr->state == STATE_DISABLED) && (mbPtr->disabledFg != NULL)) {
 	gc = mbPtr->disabledGC;
@@ -303,6 +305,7 @@ TkpDisplayMenuButton(
 	    mbPtr->normalTextGC, 0, 0, (unsigned) Tk_Width(tkwin),
 	    (unsigned) Tk_Height(tkwin), 0, 0);
     Tk_FreePixmap(mbPtr->display, pixmap);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
@@ -151,17 +151,38 @@
 /*
  * Defined by configure when the Xrender client library is available.
  * TkImgPhotoDisplay then composites partial-alpha photo images server-side
- * with TkpPutRGBAImage instead of the XGetImage read-back + CPU blend.
+ * with TkpCompositeRGBAImage instead of the XGetImage read-back + CPU blend.
  * Unlike macOS/Windows, TK_CAN_RENDER_RGBA is deliberately NOT defined:
  * opaque and binary-alpha photos keep the zero-transfer XCopyArea path, and
  * the software blend remains the runtime fallback.
  */
 
 #ifdef HAVE_XRENDER
-MODULE_SCOPE int TkpPutRGBAImage(
-	Display *display, Drawable drawable, GC gc, XImage *image,
-	int src_x, int src_y, int dest_x, int dest_y,
+MODULE_SCOPE int TkpCompositeRGBAImage(
+	Display *display, Drawable drawable, int depth, int screen,
+	XImage *image, int src_x, int src_y, int dest_x, int dest_y,
 	unsigned int width, unsigned int height);
 #endif
 
+/*
+ * Defined by configure when the MIT-SHM extension is available. On a local
+ * display, TkImgDitherInstance dithers photo pixels directly into a shared
+ * memory segment and uploads them with TkpShmPutImage, so the pixels are not
+ * copied through the X connection. TkpShmCreateImage returns NULL whenever
+ * shared memory cannot be used; callers then take the XPutImage path.
+ */
+
+#ifdef HAVE_XSHM
+typedef struct TkShmSegment TkShmSegment;
+
+MODULE_SCOPE XImage *	TkpShmCreateImage(Display *display, Visual *visual,
+			    int depth, int width, int height,
+			    TkShmSegment **segmentPtrPtr);
+MODULE_SCOPE void	TkpShmPutImage(Display *display, Drawable drawable,
+			    GC gc, XImage *image, int dest_x, int dest_y,
+			    unsigned int width, unsigned int height);
+MODULE_SCOPE void	TkpShmFreeSegment(Display *display,
+			    TkShmSegment *segmentPtr);
+#endif
+
 #endif /* _UNIXPORT */
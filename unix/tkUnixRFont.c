@@ -759,6 +759,7 @@ Tk_MeasureChars(
     int curX, newX, curByte, newByte, sawNonSpace;
     int termByte = 0, termX = 0, errorFlag = 0;
     Tk_ErrorHandler handler;
+    Tcl_WideInt perfStart = TkPerfStart();
 #if DEBUG_FONTSEL
     char string[256];
     int len = 0;
@@ -844,6 +845,7 @@ measureCharsEnd:
     DEBUG(("MeasureChars: %s length %d bytes %d\n", string, curX, curByte));
 #endif /* DEBUG_FONTSEL */
     *lengthPtr = curX;
+    TkPerfStop(TK_PERF_MEASURE, perfStart);
     return curByte;
 }
 
@@ -565,6 +565,7 @@ TkpDisplayScale(
     XRectangle drawnArea;
     Tcl_DString buf;
     int highlightWidth, borderWidth;
+    Tcl_WideInt perfStart;
 
     scalePtr->flags &= ~REDRAW_PENDING;
     if ((tkwin == NULL) || !Tk_IsMapped(tkwin)) {
@@ -600,6 +601,7 @@ TkpDisplayScale(
 	return;
     }
     Tcl_Release(scalePtr);
+    perfStart = TkPerfStart();
 
 #ifndef TK_NO_DOUBLE_BUFFERING
     /*
@@ -669,6 +671,7 @@ TkpDisplayScale(
 	    drawnArea.height, drawnArea.x, drawnArea.y);
     Tk_FreePixmap(scalePtr->display, pixmap);
 #endif /* TK_NO_DOUBLE_BUFFERING */
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 
   done:
     scalePtr->flags &= ~REDRAW_ALL;
@@ -104,10 +104,12 @@ TkpDisplayScrollbar(
     int relief, width, elementBorderWidth;
     int borderWidth, highlightWidth;
     Pixmap pixmap;
+    Tcl_WideInt perfStart;
 
     if ((scrollPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	goto done;
     }
+    perfStart = TkPerfStart();
 
     if (scrollPtr->vertical) {
 	width = Tk_Width(tkwin) - 2 * scrollPtr->inset;
@@ -256,6 +258,7 @@ TkpDisplayScrollbar(
 	    ((UnixScrollbar*)scrollPtr)->copyGC, 0, 0,
 	    (unsigned) Tk_Width(tkwin), (unsigned) Tk_Height(tkwin), 0, 0);
     Tk_FreePixmap(scrollPtr->display, pixmap);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 
   done:
     scrollPtr->flags &= ~REDRAW_PENDING;
@@ -556,6 +556,7 @@ TkpDisplayButton(
 				/* Image information that will be used to
 				 * restrict disabled pixmap as well. */
     int padX, padY, borderWidth, highlightWidth;
+    Tcl_WideInt perfStart;
 
     ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
 	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
@@ -564,6 +565,7 @@ TkpDisplayButton(
     if ((butPtr->tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     Tk_GetPixelsFromObj(NULL, tkwin, butPtr->borderWidthObj, &borderWidth);
     Tk_GetPixelsFromObj(NULL, tkwin, butPtr->highlightWidthObj, &highlightWidth);
@@ -1009,6 +1011,7 @@ TkpDisplayButton(
 	    butPtr->copyGC, 0, 0, (unsigned) Tk_Width(tkwin),
 	    (unsigned) Tk_Height(tkwin), 0, 0);
     Tk_FreePixmap(butPtr->display, pixmap);
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*
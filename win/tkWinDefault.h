@@ -539,6 +539,7 @@
 #define DEF_TOPLEVEL_CLASS		"Toplevel"
 #define DEF_TOPLEVEL_MENU		""
 #define DEF_TOPLEVEL_SCREEN		""
+#define DEF_TOPLEVEL_SHARED_BUFFER	"0"
 #define DEF_TOPLEVEL_USE		""
 
 /*
@@ -277,11 +277,13 @@ TkpDisplayScrollbar(
 {
     WinScrollbar *scrollPtr = (WinScrollbar *)clientData;
     Tk_Window tkwin = scrollPtr->info.tkwin;
+    Tcl_WideInt perfStart;
 
     scrollPtr->info.flags &= ~REDRAW_PENDING;
     if ((tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    perfStart = TkPerfStart();
 
     /*
      * Destroy and recreate the scrollbar control if the orientation has
@@ -299,6 +301,7 @@ TkpDisplayScrollbar(
     } else {
 	UpdateScrollbar(scrollPtr);
     }
+    TkPerfStop(TK_PERF_DISPLAY, perfStart);
 }
 
 /*